@@ -0,0 +1,418 @@
+/**
+ * 横幅抓取阶段
+ * 扫描线程发现开放端口后只把结果放入队列，由独立的事件循环线程
+ * 用非阻塞连接并发抓取横幅，抓到后写回对应的结果。
+ * connect扫描建立的连接直接交给本阶段复用，不必再握手一次；
+ * 慢速服务只占用本阶段的一个连接，不会拖慢端口发现
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "port_scanner.h"
+
+#define BANNER_MAX_INFLIGHT 256    // 同时进行的横幅连接数
+#define BANNER_WAKE UINT32_MAX     // eventfd在epoll中的标识
+
+// 等待抓取的端口
+typedef struct {
+    struct in_addr addr;
+    int port;
+    int fd;                        // 探测时建立的连接，-1表示需要重新连接
+    ScanResult *result;            // 横幅写回的结果，位于扫描线程的结果块中
+} BannerJob;
+
+// 一个进行中的横幅连接
+typedef struct {
+    int fd;
+    BannerJob job;
+    int connected;
+    long deadline_ms;
+    int len;
+    char buf[MAX_BANNER_SIZE];
+} BannerConn;
+
+struct BannerStage {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    BannerJob *queue;              // 环形队列，按需扩容
+    size_t head;
+    size_t count;
+    size_t capacity;
+    size_t held_fds;               // 队列中持有的连接数
+    int closing;
+    int epfd;
+    int wake_fd;
+    int timeout_ms;
+    Pacer *pacer;
+    ResultStore *store;            // 横幅和版本信息写入它的字符串区
+    ResultStream *stream;          // 横幅处理完的结果在这里输出，可为NULL
+    unsigned long grabbed;
+};
+
+static long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+// 识别服务版本并把横幅写回结果。扫描线程不会再修改已写入的结果，
+// 检查点在job_done清除RESULT_BANNER_PENDING之前不读取它，不需要加锁
+static void attach_banner(BannerStage *stage, BannerConn *conn) {
+    ScanResult *result = conn->job.result;
+
+    // 整理横幅会改写原始数据，先做识别
+    ServiceMatch match;
+    if (fingerprint_match(conn->buf, conn->len, "tcp", &match)) {
+        apply_service_match(stage->store, result, &match);
+    }
+
+    char *banner = sanitize_banner(conn->buf, conn->len);
+    if (!banner) {
+        return;
+    }
+
+    result->banner = result_store_intern(stage->store, banner, RESULT_BANNER_MAX);
+    stage->grabbed++;
+
+    free(banner);
+}
+
+// 端口的横幅处理结束（无论是否抓到），结果不再变化，此后检查点可以复制它
+static void job_done(BannerStage *stage, ScanResult *result) {
+    if (stage->stream) {
+        result_stream_write(stage->stream, stage->store, result);
+    }
+    __atomic_and_fetch(&result->flags, (uint16_t)~RESULT_BANNER_PENDING, __ATOMIC_RELEASE);
+}
+
+static void finish_conn(BannerStage *stage, BannerConn *conn) {
+    if (conn->len > 0) {
+        attach_banner(stage, conn);
+    }
+    close_with_reset(conn->fd);
+    conn->fd = -1;
+    job_done(stage, conn->job.result);
+}
+
+// 发起连接，已有连接时直接等待可写；失败返回-1
+static int start_conn(BannerStage *stage, BannerConn *conn, uint32_t index, long now) {
+    int sock = conn->job.fd;
+
+    if (sock >= 0) {
+        fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+    } else {
+        sock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (sock < 0) {
+            return -1;
+        }
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(conn->job.port);
+        addr.sin_addr = conn->job.addr;
+
+        if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+            close(sock);
+            return -1;
+        }
+    }
+
+    // 已建立的连接立即可写，和新连接走同一条路径
+    struct epoll_event ev;
+    ev.events = EPOLLOUT;
+    ev.data.u32 = index;
+    if (epoll_ctl(stage->epfd, EPOLL_CTL_ADD, sock, &ev) < 0) {
+        close_with_reset(sock);
+        return -1;
+    }
+
+    conn->fd = sock;
+    conn->connected = 0;
+    conn->len = 0;
+    conn->deadline_ms = now + stage->timeout_ms;
+    return 0;
+}
+
+// 连接建立后发送探针并开始接收
+static void on_connected(BannerStage *stage, BannerConn *conn, uint32_t index, long now) {
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+        finish_conn(stage, conn);
+        return;
+    }
+
+    char probe[256];
+    int probe_len = get_banner_probe(conn->job.port, probe);
+    if (probe_len > 0) {
+        send(conn->fd, probe, probe_len, MSG_NOSIGNAL);
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u32 = index;
+    epoll_ctl(stage->epfd, EPOLL_CTL_MOD, conn->fd, &ev);
+    conn->connected = 1;
+    conn->deadline_ms = now + stage->timeout_ms;
+}
+
+// 读取已到达的数据，连接关闭或缓冲区已满时结束
+static void on_readable(BannerStage *stage, BannerConn *conn) {
+    while (conn->len < MAX_BANNER_SIZE - 1) {
+        int n = recv(conn->fd, conn->buf + conn->len, MAX_BANNER_SIZE - 1 - conn->len, 0);
+        if (n > 0) {
+            conn->len += n;
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+            return;
+        }
+        break;
+    }
+    finish_conn(stage, conn);
+}
+
+static void* banner_thread_func(void *arg) {
+    BannerStage *stage = (BannerStage *)arg;
+    BannerConn *conns = malloc(sizeof(BannerConn) * BANNER_MAX_INFLIGHT);
+    uint32_t free_list[BANNER_MAX_INFLIGHT];
+    struct epoll_event events[64];
+
+    if (!conns) {
+        return NULL;
+    }
+    for (int i = 0; i < BANNER_MAX_INFLIGHT; i++) {
+        conns[i].fd = -1;
+        free_list[i] = BANNER_MAX_INFLIGHT - 1 - i;
+    }
+    int free_count = BANNER_MAX_INFLIGHT;
+
+    while (1) {
+        long now = monotonic_ms();
+        long pace_wait_ns = 0;
+
+        // 取出队列中的端口，在并发上限和全局速率允许的范围内发起连接
+        pthread_mutex_lock(&stage->lock);
+        while (free_count > 0 && stage->count > 0) {
+            // 复用的连接不再发包，不占用令牌
+            if (stage->queue[stage->head].fd < 0 &&
+                (pace_wait_ns = pacer_try(stage->pacer)) > 0) {
+                break;
+            }
+            uint32_t index = free_list[--free_count];
+            conns[index].job = stage->queue[stage->head];
+            stage->head = (stage->head + 1) % stage->capacity;
+            stage->count--;
+            if (conns[index].job.fd >= 0) {
+                stage->held_fds--;
+            }
+
+            pthread_mutex_unlock(&stage->lock);
+            if (start_conn(stage, &conns[index], index, now) < 0) {
+                job_done(stage, conns[index].job.result);
+                free_list[free_count++] = index;
+            }
+            pthread_mutex_lock(&stage->lock);
+        }
+        int done = stage->closing && stage->count == 0 && free_count == BANNER_MAX_INFLIGHT;
+        pthread_mutex_unlock(&stage->lock);
+
+        if (done) {
+            break;
+        }
+
+        // 最多等到最早的截止时间或下一个令牌
+        long wait_ms = -1;
+        for (int i = 0; i < BANNER_MAX_INFLIGHT; i++) {
+            if (conns[i].fd >= 0 && (wait_ms < 0 || conns[i].deadline_ms - now < wait_ms)) {
+                wait_ms = conns[i].deadline_ms - now;
+                if (wait_ms < 0) wait_ms = 0;
+            }
+        }
+        if (pace_wait_ns > 0) {
+            long pace_ms = (pace_wait_ns + 999999L) / 1000000L;
+            if (wait_ms < 0 || pace_ms < wait_ms) wait_ms = pace_ms;
+        }
+
+        int n = epoll_wait(stage->epfd, events, 64, (int)wait_ms);
+        if (n < 0 && errno != EINTR) {
+            perror("epoll_wait失败");
+            break;
+        }
+
+        now = monotonic_ms();
+        for (int i = 0; i < n; i++) {
+            uint32_t index = events[i].data.u32;
+            if (index == BANNER_WAKE) {
+                uint64_t value;
+                if (read(stage->wake_fd, &value, sizeof(value)) < 0) {
+                    // 计数已被清零，忽略
+                }
+                continue;
+            }
+
+            BannerConn *conn = &conns[index];
+            if (conn->fd < 0) {
+                continue;
+            }
+            if (!conn->connected) {
+                on_connected(stage, conn, index, now);
+            } else {
+                on_readable(stage, conn);
+            }
+            if (conn->fd < 0) {
+                free_list[free_count++] = index;
+            }
+        }
+
+        // 超时的连接保留已收到的数据
+        for (int i = 0; i < BANNER_MAX_INFLIGHT; i++) {
+            if (conns[i].fd >= 0 && conns[i].deadline_ms <= now) {
+                finish_conn(stage, &conns[i]);
+                free_list[free_count++] = i;
+            }
+        }
+    }
+
+    for (int i = 0; i < BANNER_MAX_INFLIGHT; i++) {
+        if (conns[i].fd >= 0) {
+            close_with_reset(conns[i].fd);
+            job_done(stage, conns[i].job.result);
+        }
+    }
+    free(conns);
+    return NULL;
+}
+
+// 创建横幅抓取阶段并启动事件循环线程
+BannerStage* banner_stage_create(int timeout_ms, Pacer *pacer, ResultStore *store,
+                                 ResultStream *stream) {
+    BannerStage *stage = calloc(1, sizeof(BannerStage));
+    if (!stage) {
+        return NULL;
+    }
+
+    stage->timeout_ms = timeout_ms;
+    stage->pacer = pacer;
+    stage->store = store;
+    stage->stream = stream;
+    stage->epfd = epoll_create1(EPOLL_CLOEXEC);
+    stage->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    pthread_mutex_init(&stage->lock, NULL);
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u32 = BANNER_WAKE;
+    if (stage->epfd < 0 || stage->wake_fd < 0 ||
+        epoll_ctl(stage->epfd, EPOLL_CTL_ADD, stage->wake_fd, &ev) < 0 ||
+        pthread_create(&stage->thread, NULL, banner_thread_func, stage) != 0) {
+        if (stage->epfd >= 0) close(stage->epfd);
+        if (stage->wake_fd >= 0) close(stage->wake_fd);
+        pthread_mutex_destroy(&stage->lock);
+        free(stage);
+        return NULL;
+    }
+
+    return stage;
+}
+
+// 提交一个开放端口，横幅写回result；
+// fd为探测时建立的连接（-1表示没有），提交后由本阶段负责关闭
+void banner_stage_submit(BannerStage *stage, struct in_addr addr, int port, int fd,
+                         ScanResult *result) {
+    pthread_mutex_lock(&stage->lock);
+
+    // 排队的连接过多时关闭，轮到时重新连接，避免耗尽文件描述符
+    if (fd >= 0 && stage->held_fds + BANNER_MAX_INFLIGHT >= BANNER_MAX_FDS) {
+        close_with_reset(fd);
+        fd = -1;
+    }
+
+    if (stage->count == stage->capacity) {
+        size_t new_capacity = stage->capacity ? stage->capacity * 2 : 256;
+        BannerJob *queue = malloc(sizeof(BannerJob) * new_capacity);
+        if (!queue) {
+            pthread_mutex_unlock(&stage->lock);
+            if (fd >= 0) {
+                close_with_reset(fd);
+            }
+            job_done(stage, result);
+            return;
+        }
+        for (size_t i = 0; i < stage->count; i++) {
+            queue[i] = stage->queue[(stage->head + i) % stage->capacity];
+        }
+        free(stage->queue);
+        stage->queue = queue;
+        stage->capacity = new_capacity;
+        stage->head = 0;
+    }
+
+    BannerJob *job = &stage->queue[(stage->head + stage->count) % stage->capacity];
+    job->addr = addr;
+    job->port = port;
+    job->fd = fd;
+    job->result = result;
+    stage->count++;
+    if (fd >= 0) {
+        stage->held_fds++;
+    }
+    pthread_mutex_unlock(&stage->lock);
+
+    uint64_t one = 1;
+    if (write(stage->wake_fd, &one, sizeof(one)) < 0) {
+        // 计数溢出时事件循环已被唤醒
+    }
+}
+
+// 尚未完成的横幅数
+size_t banner_stage_pending(BannerStage *stage) {
+    pthread_mutex_lock(&stage->lock);
+    size_t pending = stage->count;
+    pthread_mutex_unlock(&stage->lock);
+    return pending;
+}
+
+// 等待队列中的端口全部处理完并释放，返回抓到的横幅数
+unsigned long banner_stage_finish(BannerStage *stage) {
+    if (!stage) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&stage->lock);
+    stage->closing = 1;
+    pthread_mutex_unlock(&stage->lock);
+
+    uint64_t one = 1;
+    if (write(stage->wake_fd, &one, sizeof(one)) < 0) {
+        // 同上
+    }
+    pthread_join(stage->thread, NULL);
+
+    // 事件循环异常退出时队列中可能还有连接
+    for (size_t i = 0; i < stage->count; i++) {
+        BannerJob *job = &stage->queue[(stage->head + i) % stage->capacity];
+        if (job->fd >= 0) {
+            close_with_reset(job->fd);
+        }
+        job_done(stage, job->result);
+    }
+
+    unsigned long grabbed = stage->grabbed;
+    close(stage->epfd);
+    close(stage->wake_fd);
+    pthread_mutex_destroy(&stage->lock);
+    free(stage->queue);
+    free(stage);
+    return grabbed;
+}
@@ -0,0 +1,395 @@
+/**
+ * 扫描检查点
+ * 检查点记录扫描空间的标识（目标、端口范围、扫描类型、探测顺序的密钥）、
+ * 尚未完成的探测序号区间和各状态的计数；已有的结果另存为"<检查点>.results"，
+ * 格式与bin结果文件相同，可以直接用export和query查看。
+ * 两个文件都先写临时文件再改名，写检查点时被中断不会破坏上一个检查点
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include "port_scanner.h"
+
+#define CHECKPOINT_MAGIC 0x534b5450U   // "PTKS"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_MAX_RANGES (1 << 20)
+
+// 检查点文件头，之后依次为目标、目标文件和端口范围字符串，以及未完成的序号区间
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t keys[4];
+    uint64_t digest;
+    uint64_t host_count;
+    uint64_t port_count;
+    int64_t states[PORT_STATE_COUNT];
+    int64_t elapsed_ms;
+    int32_t scan_type;
+    int32_t randomize;
+    uint32_t range_count;
+    uint32_t targets_len;        // 含结尾的'\0'，0表示NULL
+    uint32_t target_file_len;
+    uint32_t port_range_len;
+} CheckpointHeader;
+
+// 文件中的一个序号区间
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+} CheckpointRange;
+
+// 按给定的区间建立工作序号，空区间被跳过
+int scan_work_init(ScanWork *work, const SequenceRange *ranges, int count) {
+    work->ranges = malloc((count > 0 ? count : 1) * sizeof(SequenceRange));
+    work->range_count = 0;
+    work->total = 0;
+    if (!work->ranges) {
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (ranges[i].end <= ranges[i].start) {
+            continue;
+        }
+        SequenceRange *r = &work->ranges[work->range_count++];
+        r->start = ranges[i].start;
+        r->end = ranges[i].end;
+        r->offset = work->total;
+        work->total += r->end - r->start;
+    }
+    return 0;
+}
+
+void scan_work_free(ScanWork *work) {
+    free(work->ranges);
+    work->ranges = NULL;
+    work->range_count = 0;
+    work->total = 0;
+}
+
+// 第n个工作序号对应的探测序号
+uint64_t scan_work_sequence(const ScanWork *work, uint64_t n) {
+    if (work->range_count == 1) {
+        return work->ranges[0].start + n;
+    }
+
+    int lo = 0;
+    int hi = work->range_count - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (work->ranges[mid].offset <= n) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return work->ranges[lo].start + (n - work->ranges[lo].offset);
+}
+
+// 探测序号在本次工作中的序号，不在任何工作区间内时返回-1
+int64_t scan_work_offset(const ScanWork *work, uint64_t sequence) {
+    for (int i = 0; i < work->range_count; i++) {
+        const SequenceRange *r = &work->ranges[i];
+        if (sequence >= r->start && sequence < r->end) {
+            return (int64_t)(r->offset + (sequence - r->start));
+        }
+    }
+    return -1;
+}
+
+static int compare_ranges(const void *a, const void *b) {
+    const SequenceRange *x = a;
+    const SequenceRange *y = b;
+    return (x->start > y->start) - (x->start < y->start);
+}
+
+// 把尚未完成的工作序号区间换算为探测序号区间，首尾相接的区间合并
+// 工作区间不要求按探测序号排序
+// pending会被按起点排序
+int scan_work_remaining(const ScanWork *work, SequenceRange *pending, int count, ScanWork *out) {
+    qsort(pending, count, sizeof(SequenceRange), compare_ranges);
+
+    size_t capacity = 16;
+    size_t used = 0;
+    SequenceRange *ranges = malloc(capacity * sizeof(SequenceRange));
+    if (!ranges) {
+        return -1;
+    }
+
+    int r = 0;
+    for (int i = 0; i < count; i++) {
+        uint64_t start = pending[i].start;
+        uint64_t end = pending[i].end < work->total ? pending[i].end : work->total;
+        while (r < work->range_count &&
+               work->ranges[r].offset + (work->ranges[r].end - work->ranges[r].start) <= start) {
+            r++;
+        }
+        for (int k = r; k < work->range_count && work->ranges[k].offset < end; k++) {
+            const SequenceRange *w = &work->ranges[k];
+            uint64_t from = (start > w->offset ? start - w->offset : 0) + w->start;
+            uint64_t to = end - w->offset < w->end - w->start ? w->start + (end - w->offset) : w->end;
+            if (from >= to) {
+                continue;
+            }
+
+            if (used > 0 && ranges[used - 1].end == from) {
+                ranges[used - 1].end = to;
+                continue;
+            }
+            if (used == capacity) {
+                SequenceRange *grown = realloc(ranges, capacity * 2 * sizeof(SequenceRange));
+                if (!grown) {
+                    free(ranges);
+                    return -1;
+                }
+                ranges = grown;
+                capacity *= 2;
+            }
+            ranges[used].start = from;
+            ranges[used].end = to;
+            used++;
+        }
+    }
+
+    int ret = scan_work_init(out, ranges, (int)used);
+    free(ranges);
+    return ret;
+}
+
+static char* dup_or_null(const char *s) {
+    return s ? strdup(s) : NULL;
+}
+
+// 按扫描选项和扫描空间建立新扫描的检查点，全部探测都未完成
+int checkpoint_init(Checkpoint *ckpt, const ScanOptions *opts, const ScanSpace *space) {
+    memset(ckpt, 0, sizeof(*ckpt));
+    ckpt->targets = dup_or_null(opts->targets);
+    ckpt->target_file = dup_or_null(opts->target_file);
+    ckpt->port_range = dup_or_null(opts->port_range);
+    ckpt->scan_type = opts->scan_type;
+    ckpt->randomize = space->randomize;
+    memcpy(ckpt->keys, space->keys, sizeof(ckpt->keys));
+    ckpt->digest = scan_space_digest(space);
+    ckpt->host_count = space->host_count;
+    ckpt->port_count = space->port_count;
+
+    SequenceRange all = { .start = 0, .end = space->total };
+    if ((opts->targets && !ckpt->targets) || (opts->target_file && !ckpt->target_file) ||
+        !ckpt->port_range || scan_work_init(&ckpt->work, &all, 1) < 0) {
+        checkpoint_free(ckpt);
+        return -1;
+    }
+    return 0;
+}
+
+// 检查点与本次扫描的扫描空间是否一致
+int checkpoint_check(const Checkpoint *ckpt, const ScanOptions *opts, const ScanSpace *space) {
+    if (ckpt->scan_type != opts->scan_type) {
+        printf("错误: 检查点的扫描类型与本次扫描不同\n");
+        return -1;
+    }
+    if (ckpt->randomize != space->randomize) {
+        printf("错误: 检查点%s打乱探测顺序，与本次扫描不同\n", ckpt->randomize ? "" : "未");
+        return -1;
+    }
+    if (ckpt->host_count != space->host_count || ckpt->port_count != space->port_count ||
+        ckpt->digest != scan_space_digest(space)) {
+        printf("错误: 目标或端口范围与检查点不同 (检查点: %lu个主机 × %lu个端口)\n",
+               (unsigned long)ckpt->host_count, (unsigned long)ckpt->port_count);
+        return -1;
+    }
+    for (int i = 0; i < ckpt->work.range_count; i++) {
+        if (ckpt->work.ranges[i].end > space->total) {
+            printf("错误: 检查点已损坏\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int checkpoint_results_path(const char *path, char *buf, size_t size) {
+    return snprintf(buf, size, "%s.results", path) < (int)size ? 0 : -1;
+}
+
+// 把已写入的临时文件落盘后改名为目标文件
+static int commit_file(const char *tmp, const char *path) {
+    int fd = open(tmp, O_RDONLY);
+    if (fd < 0 || fsync(fd) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        unlink(tmp);
+        return -1;
+    }
+    close(fd);
+    if (rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+static int write_string(FILE *fp, const char *s) {
+    return !s || fwrite(s, strlen(s) + 1, 1, fp) == 1 ? 0 : -1;
+}
+
+static uint32_t string_size(const char *s) {
+    return s ? (uint32_t)strlen(s) + 1 : 0;
+}
+
+// 保存检查点和已有的结果，失败时返回-1，上一个检查点保持不变
+int checkpoint_save(const char *path, const Checkpoint *ckpt, ResultStore *store,
+                    const ScanResult *results, size_t count) {
+    char results_path[PATH_MAX];
+    char tmp[PATH_MAX + 8];
+    if (checkpoint_results_path(path, results_path, sizeof(results_path)) < 0) {
+        printf("错误: 路径过长\n");
+        return -1;
+    }
+
+    // 先保存结果: 只有结果保存成功才更新检查点，恢复时不会丢失已记为完成的结果
+    snprintf(tmp, sizeof(tmp), "%s.tmp", results_path);
+    ResultFileWriter *writer = result_file_create(tmp, store,
+                                                  ckpt->targets ? ckpt->targets : ckpt->target_file,
+                                                  time(NULL), 0);
+    if (!writer) {
+        return -1;
+    }
+    int ret = result_file_append(writer, results, count);
+    if (result_file_finish(writer) < 0 || ret < 0 || commit_file(tmp, results_path) < 0) {
+        unlink(tmp);
+        printf("错误: 写入检查点 %s 失败\n", results_path);
+        return -1;
+    }
+
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = CHECKPOINT_MAGIC;
+    header.version = CHECKPOINT_VERSION;
+    memcpy(header.keys, ckpt->keys, sizeof(header.keys));
+    header.digest = ckpt->digest;
+    header.host_count = ckpt->host_count;
+    header.port_count = ckpt->port_count;
+    for (int s = 0; s < PORT_STATE_COUNT; s++) {
+        header.states[s] = ckpt->states[s];
+    }
+    header.elapsed_ms = ckpt->elapsed_ms;
+    header.scan_type = ckpt->scan_type;
+    header.randomize = ckpt->randomize;
+    header.range_count = (uint32_t)ckpt->work.range_count;
+    header.targets_len = string_size(ckpt->targets);
+    header.target_file_len = string_size(ckpt->target_file);
+    header.port_range_len = string_size(ckpt->port_range);
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp) {
+        printf("错误: 无法创建检查点 %s (%s)\n", path, strerror(errno));
+        return -1;
+    }
+    int failed = fwrite(&header, sizeof(header), 1, fp) != 1 ||
+                 write_string(fp, ckpt->targets) < 0 ||
+                 write_string(fp, ckpt->target_file) < 0 ||
+                 write_string(fp, ckpt->port_range) < 0;
+    for (int i = 0; i < ckpt->work.range_count && !failed; i++) {
+        CheckpointRange range = { ckpt->work.ranges[i].start, ckpt->work.ranges[i].end };
+        failed = fwrite(&range, sizeof(range), 1, fp) != 1;
+    }
+    if (fclose(fp) != 0) {
+        failed = 1;
+    }
+    if (failed || commit_file(tmp, path) < 0) {
+        unlink(tmp);
+        printf("错误: 写入检查点 %s 失败\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+// 读取长度为len（含结尾的'\0'）的字符串，len为0时为NULL
+static int read_string(FILE *fp, uint32_t len, char **out) {
+    *out = NULL;
+    if (len == 0) {
+        return 0;
+    }
+    if (len > PATH_MAX * 16) {
+        return -1;
+    }
+    char *s = malloc(len);
+    if (!s || fread(s, len, 1, fp) != 1 || s[len - 1] != '\0') {
+        free(s);
+        return -1;
+    }
+    *out = s;
+    return 0;
+}
+
+// 读取检查点，失败时返回-1
+int checkpoint_load(const char *path, Checkpoint *ckpt) {
+    memset(ckpt, 0, sizeof(*ckpt));
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        printf("错误: 无法打开检查点 %s (%s)\n", path, strerror(errno));
+        return -1;
+    }
+
+    CheckpointHeader header;
+    if (fread(&header, sizeof(header), 1, fp) != 1 ||
+        header.magic != CHECKPOINT_MAGIC || header.version != CHECKPOINT_VERSION ||
+        header.range_count > CHECKPOINT_MAX_RANGES ||
+        (unsigned)header.scan_type > SCAN_UDP_CONNECT || header.port_range_len == 0) {
+        printf("错误: %s 不是有效的检查点文件\n", path);
+        fclose(fp);
+        return -1;
+    }
+
+    memcpy(ckpt->keys, header.keys, sizeof(ckpt->keys));
+    ckpt->digest = header.digest;
+    ckpt->host_count = header.host_count;
+    ckpt->port_count = header.port_count;
+    for (int s = 0; s < PORT_STATE_COUNT; s++) {
+        ckpt->states[s] = (long)header.states[s];
+    }
+    ckpt->elapsed_ms = (long)header.elapsed_ms;
+    ckpt->scan_type = (ScanType)header.scan_type;
+    ckpt->randomize = header.randomize;
+
+    SequenceRange *ranges = malloc((header.range_count > 0 ? header.range_count : 1) *
+                                   sizeof(SequenceRange));
+    int failed = !ranges ||
+                 read_string(fp, header.targets_len, &ckpt->targets) < 0 ||
+                 read_string(fp, header.target_file_len, &ckpt->target_file) < 0 ||
+                 read_string(fp, header.port_range_len, &ckpt->port_range) < 0;
+    for (uint32_t i = 0; i < header.range_count && !failed; i++) {
+        CheckpointRange range;
+        failed = fread(&range, sizeof(range), 1, fp) != 1 || range.end < range.start;
+        if (!failed) {
+            ranges[i].start = range.start;
+            ranges[i].end = range.end;
+        }
+    }
+    fclose(fp);
+
+    if (failed || (!ckpt->targets && !ckpt->target_file) ||
+        scan_work_init(&ckpt->work, ranges, (int)header.range_count) < 0) {
+        printf("错误: 检查点 %s 已损坏\n", path);
+        free(ranges);
+        checkpoint_free(ckpt);
+        return -1;
+    }
+    free(ranges);
+    return 0;
+}
+
+void checkpoint_free(Checkpoint *ckpt) {
+    free(ckpt->targets);
+    free(ckpt->target_file);
+    free(ckpt->port_range);
+    scan_work_free(&ckpt->work);
+    ckpt->targets = ckpt->target_file = ckpt->port_range = NULL;
+}
@@ -0,0 +1,372 @@
+/**
+ * epoll连接扫描引擎
+ * 每个线程用一个epoll实例维持大量非阻塞connect，
+ * 通过EPOLLOUT + SO_ERROR判断连接结果
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "port_scanner.h"
+
+#define EPOLL_BATCH 256
+#define FD_RESERVE 64     // 为日志、横幅抓取等保留的文件描述符
+
+// 一个未完成的连接
+typedef struct {
+    int fd;               // -1表示空闲
+    Probe probe;
+    long start_us;
+    long deadline_ms;
+    int heap_pos;         // 在截止时间堆中的位置
+} ConnectSlot;
+
+// 未完成连接按截止时间排成的最小堆，存放槽位下标
+typedef struct {
+    uint32_t *items;
+    int count;
+} DeadlineHeap;
+
+// 单调时钟毫秒数
+static long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+static long monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000L + ts.tv_nsec / 1000L;
+}
+
+// 提高文件描述符软限制，返回实际可用的并发窗口
+int raise_fd_limit(int wanted) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0) {
+        return wanted;
+    }
+
+    rlim_t need = (rlim_t)wanted + FD_RESERVE;
+    if (rl.rlim_cur < need) {
+        rl.rlim_cur = (rl.rlim_max == RLIM_INFINITY || rl.rlim_max >= need) ? need : rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+        getrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    if (rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur < need) {
+        int limited = (int)rl.rlim_cur - FD_RESERVE;
+        if (limited < 1) limited = 1;
+        printf("警告: 文件描述符上限为 %ld，并发窗口降为 %d\n", (long)rl.rlim_cur, limited);
+        return limited;
+    }
+
+    return wanted;
+}
+
+// 等待事件，超时精确到纳秒以便按令牌时间发出下一个连接；
+// 内核不支持epoll_pwait2时退回毫秒精度
+static int wait_events(int epfd, struct epoll_event *events, int max_events, long timeout_ns) {
+    static int pwait2_missing;
+
+    if (!pwait2_missing) {
+        struct timespec ts = { timeout_ns / 1000000000L, timeout_ns % 1000000000L };
+        int n = epoll_pwait2(epfd, events, max_events, &ts, NULL);
+        if (n >= 0 || errno != ENOSYS) {
+            return n;
+        }
+        pwait2_missing = 1;
+    }
+
+    return epoll_wait(epfd, events, max_events, (int)((timeout_ns + 999999L) / 1000000L));
+}
+
+static void heap_place(DeadlineHeap *heap, ConnectSlot *slots, int pos, uint32_t slot_index) {
+    heap->items[pos] = slot_index;
+    slots[slot_index].heap_pos = pos;
+}
+
+// 把pos处的元素移到堆中合适的位置
+static void heap_fix(DeadlineHeap *heap, ConnectSlot *slots, int pos) {
+    uint32_t item = heap->items[pos];
+    long deadline = slots[item].deadline_ms;
+
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (slots[heap->items[parent]].deadline_ms <= deadline) {
+            break;
+        }
+        heap_place(heap, slots, pos, heap->items[parent]);
+        pos = parent;
+    }
+    while (1) {
+        int child = pos * 2 + 1;
+        if (child >= heap->count) {
+            break;
+        }
+        if (child + 1 < heap->count &&
+            slots[heap->items[child + 1]].deadline_ms < slots[heap->items[child]].deadline_ms) {
+            child++;
+        }
+        if (slots[heap->items[child]].deadline_ms >= deadline) {
+            break;
+        }
+        heap_place(heap, slots, pos, heap->items[child]);
+        pos = child;
+    }
+    heap_place(heap, slots, pos, item);
+}
+
+static void heap_push(DeadlineHeap *heap, ConnectSlot *slots, uint32_t slot_index) {
+    heap_place(heap, slots, heap->count++, slot_index);
+    heap_fix(heap, slots, heap->count - 1);
+}
+
+// 连接完成或超时后从堆中移除
+static void heap_remove(DeadlineHeap *heap, ConnectSlot *slots, uint32_t slot_index) {
+    int pos = slots[slot_index].heap_pos;
+    heap->count--;
+    if (pos < heap->count) {
+        heap_place(heap, slots, pos, heap->items[heap->count]);
+        heap_fix(heap, slots, pos);
+    }
+}
+
+// 完成一个连接并释放槽位，已建立的连接从epoll移除后交给横幅阶段
+static void finish_slot(ThreadParams *params, int epfd, ConnectSlot *slot, int result) {
+    long response_time = -1;
+
+    // 连接成功和被拒绝都是一次完整的往返
+    if (result >= 0) {
+        long rtt_us = monotonic_us() - slot->start_us;
+        probe_answered(params, &slot->probe, rtt_us);
+        if (result > 0) {
+            response_time = rtt_us / 1000;
+        }
+    } else {
+        probe_unreachable(params, &slot->probe);
+    }
+
+    int fd = slot->fd;
+    slot->fd = -1;
+    if (result > 0 && params->banner_grab) {
+        epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+    } else {
+        close_with_reset(fd);
+        fd = -1;
+    }
+    record_connect_result(params, slot->probe.addr, slot->probe.port, result, response_time, fd);
+}
+
+// 连接超时，重传次数用完时记为过滤
+static void expire_slot(ThreadParams *params, ProbeScheduler *sched, ConnectSlot *slot) {
+    close_with_reset(slot->fd);
+    slot->fd = -1;
+
+    if (!probe_timed_out(params, sched, &slot->probe)) {
+        record_scan_result(params, slot->probe.addr, slot->probe.port, "tcp", -1, -1);
+    }
+}
+
+// 发起非阻塞连接，返回值: 1已加入epoll, 0已立即完成, -1资源不足需稍后重试
+static int start_connect(ThreadParams *params, int epfd, ConnectSlot *slot, uint32_t slot_index,
+                         const Probe *probe, int timeout_ms, long now) {
+    int sock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        return -1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(probe->port);
+    addr.sin_addr = probe->addr;
+
+    slot->fd = sock;
+    slot->probe = *probe;
+    slot->start_us = monotonic_us();
+    slot->deadline_ms = now + timeout_ms;
+
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+        finish_slot(params, epfd, slot, 1);
+        return 0;
+    }
+
+    if (errno == EINPROGRESS) {
+        struct epoll_event ev;
+        ev.events = EPOLLOUT;
+        ev.data.u32 = slot_index;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, sock, &ev) == 0) {
+            return 1;
+        }
+    }
+
+    if (errno == EAGAIN || errno == EADDRNOTAVAIL || errno == ENOBUFS) {
+        // 本地端口或内存耗尽，稍后重试同一探测
+        close(sock);
+        slot->fd = -1;
+        return -1;
+    }
+
+    finish_slot(params, epfd, slot, (errno == ECONNREFUSED) ? 0 : -1);
+    return 0;
+}
+
+// epoll连接扫描线程函数
+void* epoll_connect_thread_func(void *arg) {
+    ThreadParams *params = (ThreadParams *)arg;
+    int window = params->window > 0 ? params->window : 1;
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) {
+        perror("epoll_create1失败");
+        return NULL;
+    }
+
+    ConnectSlot *slots = malloc(sizeof(ConnectSlot) * window);
+    uint32_t *free_list = malloc(sizeof(uint32_t) * window);
+    DeadlineHeap heap = { malloc(sizeof(uint32_t) * window), 0 };
+    ProbeScheduler sched;
+    if (!slots || !free_list || !heap.items || probe_scheduler_init(&sched, window) < 0) {
+        free(slots);
+        free(free_list);
+        free(heap.items);
+        close(epfd);
+        return NULL;
+    }
+
+    for (int i = 0; i < window; i++) {
+        slots[i].fd = -1;
+        free_list[i] = window - 1 - i;
+    }
+    int free_count = window;
+    int inflight = 0;
+    int probes_exhausted = 0;
+    int blocked = 0;            // 主机窗口已满或资源不足，暂时不能发出新探测
+    struct epoll_event events[EPOLL_BATCH];
+
+    while (1) {
+        long now = monotonic_ms();
+
+        // 在主机拥塞窗口允许的范围内填满并发窗口
+        probes_exhausted = 0;
+        blocked = 0;
+        while (free_count > 0) {
+            Probe probe;
+            int timeout_ms;
+            int got = probe_scheduler_next(params, &sched, &probe, &timeout_ms);
+            if (got <= 0) {
+                probes_exhausted = (got < 0);
+                blocked = (got == 0);
+                break;
+            }
+
+            uint32_t slot_index = free_list[--free_count];
+            int ret = start_connect(params, epfd, &slots[slot_index], slot_index,
+                                    &probe, timeout_ms, now);
+            if (ret < 0) {
+                free_list[free_count++] = slot_index;
+                probe_scheduler_defer(params, &sched, &probe);
+                blocked = 1;
+                break;
+            }
+
+            if (ret == 0) {
+                free_list[free_count++] = slot_index;
+            } else {
+                heap_push(&heap, slots, slot_index);
+                inflight++;
+            }
+        }
+
+        if (inflight == 0) {
+            if (probes_exhausted) {
+                break;
+            }
+            // 资源暂时不足或主机窗口被其他线程占满，稍等再试；受速率限制时等到下一个令牌
+            if (sched.pace_wait_ns > 0) {
+                pacer_sleep(sched.pace_wait_ns);
+            } else {
+                usleep(1000);
+            }
+            continue;
+        }
+
+        int wait_ms = (int)(slots[heap.items[0]].deadline_ms - now);
+        if (wait_ms < 0) wait_ms = 0;
+        if (blocked && wait_ms > 10) wait_ms = 10;
+
+        long wait_ns = (long)wait_ms * 1000000L;
+        if (sched.pace_wait_ns > 0 && sched.pace_wait_ns < wait_ns) {
+            wait_ns = sched.pace_wait_ns;
+        }
+
+        int n = wait_events(epfd, events, EPOLL_BATCH, wait_ns);
+        if (n < 0 && errno != EINTR) {
+            perror("epoll_wait失败");
+            break;
+        }
+
+        now = monotonic_ms();
+
+        // 处理完成的连接
+        for (int i = 0; i < n; i++) {
+            uint32_t slot_index = events[i].data.u32;
+            ConnectSlot *slot = &slots[slot_index];
+            if (slot->fd < 0) {
+                continue;
+            }
+
+            int err = 0;
+            socklen_t len = sizeof(err);
+            if (getsockopt(slot->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) {
+                err = errno;
+            }
+
+            int result;
+            if (err == 0) {
+                result = 1;        // 开放
+            } else if (err == ECONNREFUSED) {
+                result = 0;        // 关闭
+            } else {
+                result = -1;       // 不可达等视为过滤
+            }
+
+            heap_remove(&heap, slots, slot_index);
+            finish_slot(params, epfd, slot, result);
+            free_list[free_count++] = slot_index;
+            inflight--;
+        }
+
+        // 从堆顶依次处理超时的连接
+        while (heap.count > 0 && slots[heap.items[0]].deadline_ms <= now) {
+            uint32_t slot_index = heap.items[0];
+            heap_remove(&heap, slots, slot_index);
+            expire_slot(params, &sched, &slots[slot_index]);
+            free_list[free_count++] = slot_index;
+            inflight--;
+        }
+    }
+
+    // 中途退出时关闭剩余连接
+    for (int i = 0; i < window; i++) {
+        if (slots[i].fd >= 0) {
+            close_with_reset(slots[i].fd);
+        }
+    }
+
+    probe_scheduler_free(&sched);
+    free(slots);
+    free(free_list);
+    free(heap.items);
+    close(epfd);
+    return NULL;
+}
@@ -0,0 +1,908 @@
+/**
+ * 服务版本识别
+ * 读取nmap-service-probes格式的探针和匹配规则，加载时编译:
+ * 每条规则的正则转换为POSIX扩展正则，并从中取出一段必须出现的字面串，
+ * 所有字面串构成一个Aho-Corasick自动机。识别时对横幅只扫描一遍，
+ * 只有字面串命中的规则（以及没有字面串的少数规则）才执行正则匹配
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <regex.h>
+#include "port_scanner.h"
+
+#define FP_MIN_LITERAL 3           // 短于此长度的字面串过滤效果差，规则总是执行正则
+#define FP_MAX_LITERAL 64
+#define FP_INITIAL_CANDIDATES 256  // 候选规则列表的初始容量，不够时扩大
+#define FP_MAX_GROUPS 10
+#define FP_MAX_MATCHES 32          // regexec返回的POSIX组数上限（含非捕获组）
+#define FP_PATTERN_SIZE 4096
+
+// 一条匹配规则
+typedef struct {
+    regex_t re;
+    int udp;
+    int soft;                      // softmatch只确定服务名
+    int group_map[FP_MAX_GROUPS];  // 原正则的捕获组 -> POSIX正则中的组号
+    char service[32];
+    char *product;                 // p//模板，可为NULL
+    char *version;                 // v//模板，可为NULL
+} FpSignature;
+
+// 一个探针
+typedef struct {
+    int udp;
+    char *payload;
+    int len;
+} FpProbe;
+
+typedef struct {
+    FpSignature *sigs;
+    int sig_count;
+    int sig_capacity;
+    int *always;                   // 没有可用字面串的规则
+    int always_count;
+
+    FpProbe *probes;
+    int probe_count;
+    int16_t port_probe[2][65536];  // 每个端口使用的第一个探针，-1表示没有
+
+    // Aho-Corasick自动机: 根节点的转移用数组，其余节点用边链表
+    int root_next[256];
+    int *first_edge;
+    int *fail;
+    int *dict;                     // 沿失败链最近的有输出的节点
+    int *node_sig;                 // 在此结束的第一条规则，规则间用sig_next相连
+    int node_count;
+    int node_capacity;
+    int *edge_to;
+    int *edge_next;
+    unsigned char *edge_byte;
+    int edge_count;
+    int edge_capacity;
+    int *sig_next;
+
+    int loaded;
+} FingerprintDb;
+
+static FingerprintDb *fp_db;
+
+// 按顺序查找的规则文件，PENTK_SERVICE_PROBES环境变量指定的文件优先
+static const char *probe_files[] = {
+    "/usr/share/nmap/nmap-service-probes",
+    "/usr/local/share/nmap/nmap-service-probes"
+};
+
+// 内置规则，排在文件中的规则之后
+static const char builtin_probes[] =
+    "Probe TCP NULL q||\n"
+    "match ssh m|^SSH-([\\d.]+)-OpenSSH_([\\w._-]+)[ -]?| p/OpenSSH/ v/$2/\n"
+    "match ssh m|^SSH-([\\d.]+)-dropbear_([\\w._-]+)| p/Dropbear sshd/ v/$2/\n"
+    "softmatch ssh m|^SSH-([\\d.]+)-|\n"
+    "match ftp m|^220[- ]\\(vsFTPd ([\\w._-]+)\\)| p/vsftpd/ v/$1/\n"
+    "match ftp m|^220[- ]ProFTPD ([\\w._-]+) Server| p/ProFTPD/ v/$1/\n"
+    "match ftp m|^220[- ].*Pure-FTPd| p/Pure-FTPd/\n"
+    "match ftp m|^220[- ]FileZilla Server(?: version)? ?([\\w._-]+)?| p/FileZilla ftpd/ v/$1/\n"
+    "match ftp m|^220[- ]Microsoft FTP Service| p/Microsoft ftpd/\n"
+    "softmatch ftp m|^220[- ].*FTP|i\n"
+    "match smtp m|^220[- ][^ ]+ ESMTP Postfix| p/Postfix smtpd/\n"
+    "match smtp m|^220[- ][^ ]+ ESMTP Exim ([\\w._-]+)| p/Exim smtpd/ v/$1/\n"
+    "match smtp m|^220[- ][^ ]+ ESMTP Sendmail ([\\w._/-]+)| p/Sendmail/ v/$1/\n"
+    "softmatch smtp m|^220[- ].*SMTP|i\n"
+    "match pop3 m|^\\+OK Dovecot| p/Dovecot pop3d/\n"
+    "match imap m|^\\* OK .*Dovecot| p/Dovecot imapd/\n"
+    "match http m|^HTTP/1\\.[01] \\d\\d\\d .*\\r\\nServer: nginx/([\\d.]+)|s p/nginx/ v/$1/\n"
+    "match http m|^HTTP/1\\.[01] \\d\\d\\d .*\\r\\nServer: nginx\\r\\n|s p/nginx/\n"
+    "match http m|^HTTP/1\\.[01] \\d\\d\\d .*\\r\\nServer: Apache/([\\d.]+)|s p/Apache httpd/ v/$1/\n"
+    "match http m|^HTTP/1\\.[01] \\d\\d\\d .*\\r\\nServer: Apache\\r\\n|s p/Apache httpd/\n"
+    "match http m|^HTTP/1\\.[01] \\d\\d\\d .*\\r\\nServer: Microsoft-IIS/([\\d.]+)|s p/Microsoft IIS httpd/ v/$1/\n"
+    "match http m|^HTTP/1\\.[01] \\d\\d\\d .*\\r\\nServer: lighttpd/([\\d.]+)|s p/lighttpd/ v/$1/\n"
+    "match http m|^HTTP/1\\.[01] \\d\\d\\d .*\\r\\nServer: Jetty\\(([\\w._-]+)\\)|s p/Jetty/ v/$1/\n"
+    "match http m|^HTTP/1\\.[01] \\d\\d\\d .*\\r\\nServer: SimpleHTTP/([\\d.]+) Python/([\\d.]+)|s p/SimpleHTTPServer/ v/$1/\n"
+    "softmatch http m|^HTTP/1\\.[01] \\d\\d\\d|\n"
+    "match redis m|^-NOAUTH Authentication required| p/Redis key-value store/\n"
+    "match redis m|^-ERR unknown command| p/Redis key-value store/\n"
+    "match memcached m|^ERROR\\r\\n$| p/Memcached/\n"
+    "match vnc m|^RFB 00(\\d)\\.00(\\d)\\n$| p/VNC/ v/$1.$2/\n";
+
+// ---------- 自动机 ----------
+
+static int ac_new_node(FingerprintDb *db) {
+    if (db->node_count == db->node_capacity) {
+        int cap = db->node_capacity ? db->node_capacity * 2 : 1024;
+        int *first = realloc(db->first_edge, sizeof(int) * cap);
+        if (first) db->first_edge = first;
+        int *fail = realloc(db->fail, sizeof(int) * cap);
+        if (fail) db->fail = fail;
+        int *dict = realloc(db->dict, sizeof(int) * cap);
+        if (dict) db->dict = dict;
+        int *node_sig = realloc(db->node_sig, sizeof(int) * cap);
+        if (node_sig) db->node_sig = node_sig;
+        if (!first || !fail || !dict || !node_sig) {
+            return -1;
+        }
+        db->node_capacity = cap;
+    }
+
+    int node = db->node_count++;
+    db->first_edge[node] = -1;
+    db->fail[node] = 0;
+    db->dict[node] = -1;
+    db->node_sig[node] = -1;
+    return node;
+}
+
+static int ac_child(const FingerprintDb *db, int node, unsigned char c) {
+    if (node == 0) {
+        return db->root_next[c];
+    }
+    for (int e = db->first_edge[node]; e >= 0; e = db->edge_next[e]) {
+        if (db->edge_byte[e] == c) {
+            return db->edge_to[e];
+        }
+    }
+    return -1;
+}
+
+static int ac_add_edge(FingerprintDb *db, int node, unsigned char c, int to) {
+    if (node == 0) {
+        db->root_next[c] = to;
+    }
+    if (db->edge_count == db->edge_capacity) {
+        int cap = db->edge_capacity ? db->edge_capacity * 2 : 1024;
+        int *to_arr = realloc(db->edge_to, sizeof(int) * cap);
+        if (to_arr) db->edge_to = to_arr;
+        int *next = realloc(db->edge_next, sizeof(int) * cap);
+        if (next) db->edge_next = next;
+        unsigned char *bytes = realloc(db->edge_byte, cap);
+        if (bytes) db->edge_byte = bytes;
+        if (!to_arr || !next || !bytes) {
+            return -1;
+        }
+        db->edge_capacity = cap;
+    }
+
+    // 根节点的边也记在链表中，构建失败链时统一遍历
+    int e = db->edge_count++;
+    db->edge_to[e] = to;
+    db->edge_byte[e] = c;
+    db->edge_next[e] = db->first_edge[node];
+    db->first_edge[node] = e;
+    return 0;
+}
+
+// 插入一条规则的字面串（已转为小写）
+static int ac_insert(FingerprintDb *db, const unsigned char *lit, int len, int sig) {
+    int node = 0;
+    for (int i = 0; i < len; i++) {
+        int next = ac_child(db, node, lit[i]);
+        if (next < 0) {
+            if ((next = ac_new_node(db)) < 0 || ac_add_edge(db, node, lit[i], next) < 0) {
+                return -1;
+            }
+        }
+        node = next;
+    }
+    db->sig_next[sig] = db->node_sig[node];
+    db->node_sig[node] = sig;
+    return 0;
+}
+
+// 广度优先计算失败链和输出链
+static int ac_build(FingerprintDb *db) {
+    int *queue = malloc(sizeof(int) * db->node_count);
+    if (!queue) {
+        return -1;
+    }
+    int head = 0, tail = 0;
+
+    for (int e = db->first_edge[0]; e >= 0; e = db->edge_next[e]) {
+        db->fail[db->edge_to[e]] = 0;
+        queue[tail++] = db->edge_to[e];
+    }
+
+    while (head < tail) {
+        int node = queue[head++];
+        for (int e = db->first_edge[node]; e >= 0; e = db->edge_next[e]) {
+            int child = db->edge_to[e];
+            unsigned char c = db->edge_byte[e];
+
+            int f = db->fail[node];
+            int next;
+            while ((next = ac_child(db, f, c)) < 0 && f != 0) {
+                f = db->fail[f];
+            }
+            db->fail[child] = (next >= 0 && next != child) ? next : 0;
+            int target = db->fail[child];
+            db->dict[child] = (db->node_sig[target] >= 0) ? target : db->dict[target];
+            queue[tail++] = child;
+        }
+    }
+
+    free(queue);
+    return 0;
+}
+
+// ---------- 规则编译 ----------
+
+static int hex_value(int c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// 解析字面转义(\r \n \t \xHH及标点)，返回字节值，不是字面字符时返回-1；
+// *i指向反斜杠，返回时指向转义的最后一个字符
+static int literal_escape(const char *s, int len, int *i) {
+    int c = (*i + 1 < len) ? (unsigned char)s[*i + 1] : -1;
+    if (c < 0) {
+        return -1;
+    }
+    (*i)++;
+    switch (c) {
+        case 'r': return '\r';
+        case 'n': return '\n';
+        case 't': return '\t';
+        case 'f': return '\f';
+        case 'v': return '\v';
+        case 'e': return 0x1b;
+        case 'a': return 0x07;
+        case '0': return 0;
+        case 'x': {
+            int value = 0, digits = 0;
+            while (digits < 2 && *i + 1 < len && hex_value(s[*i + 1]) >= 0) {
+                value = value * 16 + hex_value(s[++(*i)]);
+                digits++;
+            }
+            return digits ? value : -1;
+        }
+        default:
+            return isalnum(c) ? -1 : c;
+    }
+}
+
+// {n}、{n,}、{n,m}形式的量词，返回其长度，不是量词时返回0
+static int quantifier_len(const char *s, int len, int i) {
+    int j = i + 1;
+    int digits = 0;
+    while (j < len && isdigit((unsigned char)s[j])) { j++; digits++; }
+    if (!digits) return 0;
+    if (j < len && s[j] == ',') {
+        j++;
+        while (j < len && isdigit((unsigned char)s[j])) j++;
+    }
+    return (j < len && s[j] == '}') ? j - i + 1 : 0;
+}
+
+// 跳过字符类，i指向'['，返回']'之后的位置
+static int skip_bracket(const char *s, int len, int i) {
+    i++;
+    if (i < len && s[i] == '^') i++;
+    if (i < len && s[i] == ']') i++;
+    while (i < len && s[i] != ']') {
+        if (s[i] == '\\') {
+            i++;
+        } else if (s[i] == '[' && i + 1 < len && s[i + 1] == ':') {
+            const char *end = strstr(s + i + 2, ":]");
+            if (end && end - s < len) i = (int)(end - s) + 1;
+        }
+        i++;
+    }
+    return i + 1;
+}
+
+// 找出正则中必须出现的最长字面串（小写），没有时返回0
+static int extract_literal(const char *s, int len, unsigned char *best) {
+    unsigned char cur[FP_MAX_LITERAL];
+    int cur_len = 0, best_len = 0;
+
+    // 顶层有分支时没有必须出现的字面串
+    int depth = 0;
+    for (int i = 0; i < len; i++) {
+        if (s[i] == '\\') i++;
+        else if (s[i] == '[') i = skip_bracket(s, len, i) - 1;
+        else if (s[i] == '(') depth++;
+        else if (s[i] == ')') depth--;
+        else if (s[i] == '|' && depth == 0) return 0;
+    }
+
+#define END_RUN() do { \
+        if (cur_len > best_len) { memcpy(best, cur, cur_len); best_len = cur_len; } \
+        cur_len = 0; \
+    } while (0)
+
+    for (int i = 0; i < len; i++) {
+        char c = s[i];
+        int lit = -1;
+
+        if (c == '\\') {
+            lit = literal_escape(s, len, &i);
+        } else if (c == '[') {
+            i = skip_bracket(s, len, i) - 1;
+        } else if (c == '(') {
+            // 分组整体跳过
+            int d = 0;
+            for (; i < len; i++) {
+                if (s[i] == '\\') i++;
+                else if (s[i] == '[') i = skip_bracket(s, len, i) - 1;
+                else if (s[i] == '(') d++;
+                else if (s[i] == ')' && --d == 0) break;
+            }
+        } else if (c == '*' || c == '?') {
+            // 量词作用于前一个字符，它不是必须出现的
+            if (cur_len > 0) cur_len--;
+        } else if (c == '{') {
+            int q = quantifier_len(s, len, i);
+            if (q) {
+                if (cur_len > 0) cur_len--;
+                i += q - 1;
+            } else {
+                lit = '{';
+            }
+        } else if (c != '.' && c != '^' && c != '$' && c != '+' && c != ')') {
+            lit = (unsigned char)c;
+        }
+
+        if (lit >= 0 && cur_len < FP_MAX_LITERAL) {
+            cur[cur_len++] = (unsigned char)tolower(lit);
+        } else {
+            END_RUN();
+        }
+    }
+    END_RUN();
+#undef END_RUN
+
+    return best_len;
+}
+
+// 向输出追加字符串
+#define EMIT(str) do { \
+        size_t n_ = strlen(str); \
+        if (o + n_ >= size) return -1; \
+        memcpy(dst + o, str, n_); o += n_; \
+    } while (0)
+#define EMITC(ch) do { \
+        if (o + 1 >= size) return -1; \
+        dst[o++] = (char)(ch); \
+    } while (0)
+
+// 把PCRE风格的正则转换为POSIX扩展正则（含GNU扩展\w \s \b），
+// 记录捕获组的对应关系；不支持的语法返回-1。
+// 按PCRE的默认语义: 没有s标志时'.'不匹配换行；'$'还匹配末尾换行之前的位置
+static int translate_regex(const char *s, int len, int dotall, char *dst, size_t size,
+                           int *group_map) {
+    size_t o = 0;
+    int pcre_groups = 0, posix_groups = 0;
+
+    for (int i = 0; i < FP_MAX_GROUPS; i++) {
+        group_map[i] = -1;
+    }
+
+    for (int i = 0; i < len; i++) {
+        char c = s[i];
+
+        if (c == '\\') {
+            char e = (i + 1 < len) ? s[i + 1] : 0;
+            if (e == 'd') { EMIT("[0-9]"); i++; continue; }
+            if (e == 'D') { EMIT("[^0-9]"); i++; continue; }
+            if (e == 'w' || e == 'W' || e == 's' || e == 'S' || e == 'b' || e == 'B') {
+                EMITC('\\'); EMITC(e); i++; continue;
+            }
+            if (e == 'A') { EMITC('^'); i++; continue; }
+            if (e == 'Z') { EMIT("\n?$"); i++; continue; }
+            if (e == 'z') { EMITC('$'); i++; continue; }
+            int lit = literal_escape(s, len, &i);
+            if (lit <= 0) {
+                return -1;     // NUL、反向引用等无法表达
+            }
+            if (strchr(".[]()*+?{}|^$\\", lit)) {
+                EMITC('\\');
+            }
+            EMITC(lit);
+        } else if (c == '[') {
+            // 字符类: 转义只保留字面含义，'-'移到末尾
+            int dash = 0;
+            EMITC('[');
+            i++;
+            if (i < len && s[i] == '^') { EMITC('^'); i++; }
+            if (i < len && s[i] == ']') { EMITC(']'); i++; }
+            while (i < len && s[i] != ']') {
+                if (s[i] == '\\') {
+                    char e = (i + 1 < len) ? s[i + 1] : 0;
+                    if (e == 'd') { EMIT("0-9"); i += 2; continue; }
+                    if (e == 'w') { EMIT("[:alnum:]_"); i += 2; continue; }
+                    if (e == 's') { EMIT("[:space:]"); i += 2; continue; }
+                    if (e == '-') { dash = 1; i += 2; continue; }
+                    int lit = literal_escape(s, len, &i);
+                    if (lit <= 0 || lit == ']' || lit == '^' || lit == '[') {
+                        return -1;
+                    }
+                    EMITC(lit);
+                    i++;
+                } else if (s[i] == '[' && i + 1 < len && s[i + 1] == ':') {
+                    const char *end = strstr(s + i, ":]");
+                    if (!end || end - s >= len) return -1;
+                    while (s + i <= end) EMITC(s[i++]);
+                    EMITC(s[i++]);
+                } else {
+                    EMITC(s[i++]);
+                }
+            }
+            if (i >= len) {
+                return -1;
+            }
+            if (dash) EMITC('-');
+            EMITC(']');
+        } else if (c == '(') {
+            if (i + 1 < len && s[i + 1] == '?') {
+                if (i + 2 < len && s[i + 2] == ':') {
+                    i += 2;    // 非捕获组也占用POSIX组号
+                } else {
+                    return -1; // 断言、内联选项
+                }
+            } else {
+                pcre_groups++;
+                if (pcre_groups < FP_MAX_GROUPS) {
+                    group_map[pcre_groups] = posix_groups + 1;
+                }
+            }
+            posix_groups++;
+            EMITC('(');
+        } else if (c == '{') {
+            int q = quantifier_len(s, len, i);
+            if (!q) {
+                EMIT("\\{");
+                continue;
+            }
+            while (q-- > 0) EMITC(s[i++]);
+            i--;
+            // 非贪婪、占有量词按贪婪处理
+            if (i + 1 < len && (s[i + 1] == '?' || s[i + 1] == '+')) i++;
+        } else if (c == '*' || c == '+' || c == '?') {
+            EMITC(c);
+            if (i + 1 < len && (s[i + 1] == '?' || s[i + 1] == '+')) i++;
+        } else if (c == '}') {
+            EMIT("\\}");
+        } else if (c == '.' && !dotall) {
+            EMIT("[^\n]");
+        } else if (c == '$') {
+            EMIT("\n?$");
+        } else {
+            EMITC(c);
+        }
+    }
+
+    dst[o] = '\0';
+    return 0;
+}
+
+#undef EMIT
+#undef EMITC
+
+// 读取分隔符包围的字段，返回字段之后的位置；*out为分配的字段内容
+static const char* read_delimited(const char *p, char **out, int *out_len) {
+    char delim = *p++;
+    const char *end = strchr(p, delim);
+    if (!delim || !end) {
+        return NULL;
+    }
+    *out_len = (int)(end - p);
+    *out = strndup(p, end - p);
+    return *out ? end + 1 : NULL;
+}
+
+// 解析并编译一行match/softmatch
+static void parse_match(FingerprintDb *db, const char *line, int soft, int udp) {
+    char service[32];
+    int n = 0;
+    if (sscanf(line, "%31s %n", service, &n) != 1 || line[n] != 'm') {
+        return;
+    }
+
+    char *pattern = NULL;
+    int pattern_len = 0;
+    const char *p = read_delimited(line + n + 1, &pattern, &pattern_len);
+    if (!p) {
+        return;
+    }
+
+    int icase = 0, dotall = 0;
+    while (*p && !isspace((unsigned char)*p)) {
+        if (*p == 'i') icase = 1;
+        if (*p == 's') dotall = 1;
+        p++;
+    }
+
+    // 版本信息字段: p/产品/ v/版本/，其他字段跳过
+    char *product = NULL, *version = NULL;
+    while (*p) {
+        while (isspace((unsigned char)*p)) p++;
+        if (!*p) break;
+        char key = *p;
+        if (strncmp(p, "cpe:", 4) == 0) {
+            p += 3;
+        }
+        char *field;
+        int field_len;
+        p = read_delimited(p + 1, &field, &field_len);
+        if (!p) break;
+        if (key == 'p' && !product) product = field;
+        else if (key == 'v' && !version) version = field;
+        else free(field);
+        while (*p && !isspace((unsigned char)*p)) p++;   // cpe的a标志
+    }
+
+    char translated[FP_PATTERN_SIZE];
+    FpSignature sig;
+    memset(&sig, 0, sizeof(sig));
+    // 不用REG_NEWLINE: 它让'^'匹配每行的开头、[^x]不匹配换行，与PCRE不同
+    int cflags = REG_EXTENDED | (icase ? REG_ICASE : 0);
+    if (translate_regex(pattern, pattern_len, dotall, translated, sizeof(translated),
+                        sig.group_map) < 0 ||
+        regcomp(&sig.re, translated, cflags) != 0) {
+        free(pattern);
+        free(product);
+        free(version);
+        return;
+    }
+
+    if (db->sig_count == db->sig_capacity) {
+        int cap = db->sig_capacity ? db->sig_capacity * 2 : 256;
+        FpSignature *sigs = realloc(db->sigs, sizeof(FpSignature) * cap);
+        int *next = realloc(db->sig_next, sizeof(int) * cap);
+        if (sigs) db->sigs = sigs;
+        if (next) db->sig_next = next;
+        if (!sigs || !next) {
+            regfree(&sig.re);
+            free(pattern);
+            free(product);
+            free(version);
+            return;
+        }
+        db->sig_capacity = cap;
+    }
+
+    int id = db->sig_count++;
+    sig.udp = udp;
+    sig.soft = soft;
+    memcpy(sig.service, service, sizeof(sig.service));
+    sig.product = product;
+    sig.version = version;
+    db->sigs[id] = sig;
+    db->sig_next[id] = -1;
+
+    unsigned char literal[FP_MAX_LITERAL];
+    int literal_len = extract_literal(pattern, pattern_len, literal);
+    if (literal_len < FP_MIN_LITERAL || ac_insert(db, literal, literal_len, id) < 0) {
+        int *always = realloc(db->always, sizeof(int) * (db->always_count + 1));
+        if (always) {
+            db->always = always;
+            db->always[db->always_count++] = id;
+        }
+    }
+    free(pattern);
+}
+
+// 解析Probe行的载荷
+static void parse_probe(FingerprintDb *db, const char *line, int *udp) {
+    char proto[8], name[64];
+    int n = 0;
+    if (sscanf(line, "%7s %63s %n", proto, name, &n) != 2 || line[n] != 'q') {
+        return;
+    }
+    *udp = (strcmp(proto, "UDP") == 0);
+
+    char *raw;
+    int raw_len;
+    if (!read_delimited(line + n + 1, &raw, &raw_len)) {
+        return;
+    }
+
+    FpProbe *probes = realloc(db->probes, sizeof(FpProbe) * (db->probe_count + 1));
+    if (!probes) {
+        free(raw);
+        return;
+    }
+    db->probes = probes;
+
+    // 转义就地解码，结果不会比原文长
+    int len = 0;
+    for (int i = 0; i < raw_len; i++) {
+        if (raw[i] == '\\') {
+            int lit = literal_escape(raw, raw_len, &i);
+            raw[len++] = (char)(lit >= 0 ? lit : raw[i]);
+        } else {
+            raw[len++] = raw[i];
+        }
+    }
+
+    FpProbe *probe = &db->probes[db->probe_count++];
+    probe->udp = *udp;
+    probe->payload = raw;
+    probe->len = len;
+}
+
+// 解析ports行，把尚未分配探针的端口指向当前探针
+static void parse_ports(FingerprintDb *db, const char *list, int udp) {
+    int probe = db->probe_count - 1;
+    if (probe < 0 || db->probes[probe].len == 0) {
+        return;
+    }
+
+    const char *p = list;
+    while (*p) {
+        char *end;
+        long lo = strtol(p, &end, 10);
+        if (end == p) break;
+        long hi = lo;
+        if (*end == '-') {
+            hi = strtol(end + 1, &end, 10);
+        }
+        for (long port = lo; port <= hi && port < 65536; port++) {
+            if (port >= 0 && db->port_probe[udp][port] < 0) {
+                db->port_probe[udp][port] = (int16_t)probe;
+            }
+        }
+        p = end;
+        while (*p == ',' || isspace((unsigned char)*p)) p++;
+    }
+}
+
+static void parse_db(FingerprintDb *db, FILE *fp) {
+    char line[FP_PATTERN_SIZE];
+    int udp = 0;
+
+    while (fgets(line, sizeof(line), fp)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (strncmp(line, "match ", 6) == 0) {
+            parse_match(db, line + 6, 0, udp);
+        } else if (strncmp(line, "softmatch ", 10) == 0) {
+            parse_match(db, line + 10, 1, udp);
+        } else if (strncmp(line, "Probe ", 6) == 0) {
+            parse_probe(db, line + 6, &udp);
+        } else if (strncmp(line, "ports ", 6) == 0) {
+            parse_ports(db, line + 6, udp);
+        }
+    }
+}
+
+// 加载规则库，返回编译成功的规则数，失败返回-1
+int fingerprint_load(void) {
+    if (fp_db) {
+        return fp_db->sig_count;
+    }
+
+    FingerprintDb *db = calloc(1, sizeof(FingerprintDb));
+    if (!db) {
+        return -1;
+    }
+    memset(db->root_next, -1, sizeof(db->root_next));
+    memset(db->port_probe, -1, sizeof(db->port_probe));
+    if (ac_new_node(db) < 0) {
+        free(db);
+        return -1;
+    }
+
+    const char *env = getenv("PENTK_SERVICE_PROBES");
+    FILE *fp = (env && env[0]) ? fopen(env, "r") : NULL;
+    for (size_t i = 0; !fp && i < sizeof(probe_files) / sizeof(probe_files[0]); i++) {
+        fp = fopen(probe_files[i], "r");
+    }
+    if (fp) {
+        parse_db(db, fp);
+        fclose(fp);
+    }
+
+    fp = fmemopen((void *)builtin_probes, sizeof(builtin_probes) - 1, "r");
+    if (fp) {
+        parse_db(db, fp);
+        fclose(fp);
+    }
+
+    if (ac_build(db) < 0) {
+        fp_db = db;
+        fingerprint_free();
+        return -1;
+    }
+
+    db->loaded = 1;
+    fp_db = db;
+    return db->sig_count;
+}
+
+void fingerprint_free(void) {
+    FingerprintDb *db = fp_db;
+    if (!db) {
+        return;
+    }
+
+    for (int i = 0; i < db->sig_count; i++) {
+        regfree(&db->sigs[i].re);
+        free(db->sigs[i].product);
+        free(db->sigs[i].version);
+    }
+    for (int i = 0; i < db->probe_count; i++) {
+        free(db->probes[i].payload);
+    }
+    free(db->sigs);
+    free(db->sig_next);
+    free(db->always);
+    free(db->probes);
+    free(db->first_edge);
+    free(db->fail);
+    free(db->dict);
+    free(db->node_sig);
+    free(db->edge_to);
+    free(db->edge_next);
+    free(db->edge_byte);
+    free(db);
+    fp_db = NULL;
+}
+
+// ---------- 识别 ----------
+
+static int compare_int(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// 按模板生成字段，$n、$P(n)、$SUBST(n,...)、$I(n,...)替换为捕获组内容
+static void expand_template(const FpSignature *sig, const char *tpl, const char *data,
+                            const regmatch_t *m, char *out, size_t size) {
+    size_t o = 0;
+
+    for (const char *p = tpl; *p && o + 1 < size; p++) {
+        int group = -1;
+        if (*p == '$' && isdigit((unsigned char)p[1])) {
+            group = p[1] - '0';
+            p++;
+        } else if (*p == '$' && isupper((unsigned char)p[1])) {
+            const char *paren = strchr(p, '(');
+            const char *close = paren ? strchr(paren, ')') : NULL;
+            if (paren && close && isdigit((unsigned char)paren[1])) {
+                group = paren[1] - '0';
+                p = close;
+            }
+        }
+
+        if (group < 0) {
+            out[o++] = *p;
+            continue;
+        }
+
+        int index = (group < FP_MAX_GROUPS) ? sig->group_map[group] : -1;
+        if (index < 0 || index >= FP_MAX_MATCHES || m[index].rm_so < 0) {
+            continue;
+        }
+        for (regoff_t i = m[index].rm_so; i < m[index].rm_eo && o + 1 < size; i++) {
+            unsigned char c = (unsigned char)data[i];
+            if (isprint(c)) {
+                out[o++] = (char)c;
+            }
+        }
+    }
+    out[o] = '\0';
+}
+
+// 用一条规则匹配横幅，成功时填写match
+static int try_signature(const FpSignature *sig, const char *data, int len, ServiceMatch *match) {
+    regmatch_t m[FP_MAX_MATCHES];
+    m[0].rm_so = 0;
+    m[0].rm_eo = len;
+    if (regexec(&sig->re, data, FP_MAX_MATCHES, m, REG_STARTEND) != 0) {
+        return 0;
+    }
+
+    memset(match, 0, sizeof(*match));
+    memcpy(match->service, sig->service, sizeof(match->service));
+    if (sig->product) {
+        expand_template(sig, sig->product, data, m, match->product, sizeof(match->product));
+    }
+    if (sig->version) {
+        expand_template(sig, sig->version, data, m, match->version, sizeof(match->version));
+    }
+    return 1;
+}
+
+// 识别横幅对应的服务，返回1完全匹配、2只确定了服务名、0未识别
+int fingerprint_match(const char *data, int len, const char *protocol, ServiceMatch *match) {
+    const FingerprintDb *db = fp_db;
+    if (!db || !db->loaded || len <= 0) {
+        return 0;
+    }
+    int udp = (protocol && protocol[0] == 'u');
+
+    // 一遍扫描收集候选规则，字面量在横幅中重复出现时规则只记一次
+    int initial[FP_INITIAL_CANDIDATES];
+    int *candidates = initial;
+    int capacity = FP_INITIAL_CANDIDATES;
+    int count = 0;
+    uint64_t *seen = calloc((db->sig_count + 63) / 64, sizeof(uint64_t));
+    if (!seen) {
+        return 0;
+    }
+    int node = 0;
+    for (int i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)tolower((unsigned char)data[i]);
+        int next;
+        while ((next = ac_child(db, node, c)) < 0 && node != 0) {
+            node = db->fail[node];
+        }
+        node = next < 0 ? 0 : next;
+
+        for (int t = (db->node_sig[node] >= 0) ? node : db->dict[node]; t >= 0; t = db->dict[t]) {
+            for (int s = db->node_sig[t]; s >= 0; s = db->sig_next[s]) {
+                if (seen[s / 64] & (1ULL << (s % 64))) {
+                    continue;
+                }
+                seen[s / 64] |= 1ULL << (s % 64);
+                if (count == capacity) {
+                    int *grown = malloc(sizeof(int) * capacity * 2);
+                    if (!grown) {
+                        continue;
+                    }
+                    memcpy(grown, candidates, sizeof(int) * count);
+                    if (candidates != initial) {
+                        free(candidates);
+                    }
+                    candidates = grown;
+                    capacity *= 2;
+                }
+                candidates[count++] = s;
+            }
+        }
+    }
+    free(seen);
+    qsort(candidates, count, sizeof(int), compare_int);
+
+    // 按规则在库中的顺序合并两个列表，第一个完全匹配的规则生效
+    int soft = 0, full = 0;
+    int ci = 0, ai = 0;
+    while (ci < count || ai < db->always_count) {
+        int id;
+        if (ai >= db->always_count || (ci < count && candidates[ci] < db->always[ai])) {
+            id = candidates[ci++];
+        } else {
+            id = db->always[ai++];
+        }
+
+        const FpSignature *sig = &db->sigs[id];
+        if (sig->udp != udp || (soft && sig->soft)) {
+            continue;
+        }
+
+        ServiceMatch found;
+        if (!try_signature(sig, data, len, &found)) {
+            continue;
+        }
+        if (!sig->soft) {
+            *match = found;
+            full = 1;
+            break;
+        }
+        *match = found;
+        soft = 1;
+    }
+
+    if (candidates != initial) {
+        free(candidates);
+    }
+    return full ? 1 : (soft ? 2 : 0);
+}
+
+// 规则库中为该端口指定的探针，返回长度，没有时返回0
+int fingerprint_probe(int port, const char *protocol, char *probe, int size) {
+    const FingerprintDb *db = fp_db;
+    if (!db || port < 0 || port > 65535) {
+        return 0;
+    }
+    int index = db->port_probe[(protocol && protocol[0] == 'u') ? 1 : 0][port];
+    if (index < 0 || db->probes[index].len > size) {
+        return 0;
+    }
+    memcpy(probe, db->probes[index].payload, db->probes[index].len);
+    return db->probes[index].len;
+}
@@ -0,0 +1,282 @@
+/**
+ * 主机状态表
+ * 按目标地址记录平滑RTT和RTT方差（RFC 6298），据此为每个探测计算超时时间；
+ * 同时维护每个主机的拥塞窗口，限制同一主机上未完成的探测数。
+ * 空闲且处于初始状态的主机会被移除，内存与有响应的主机数成正比。
+ * 表按地址分片，每片各有一把锁，不同线程扫描不同主机时互不阻塞
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include "port_scanner.h"
+
+// 单个主机的状态
+typedef struct {
+    uint32_t addr;
+    int used;
+    long srtt_us;               // 平滑RTT
+    long rttvar_us;             // RTT平均偏差
+    unsigned long samples;
+    double cwnd;                // 拥塞窗口
+    double ssthresh;            // 慢启动阈值
+    int outstanding;            // 未完成的探测数
+    int limited;                // 是否曾因窗口已满而推迟探测
+    long last_decrease_us;      // 上次缩小窗口的时间
+} HostEntry;
+
+#define HOST_SHARD_BITS 6
+#define HOST_SHARDS (1 << HOST_SHARD_BITS)
+
+// 一个分片: 线性探测的开放寻址表，独占一个缓存行以免相邻分片的锁互相干扰
+typedef struct {
+    pthread_mutex_t lock;
+    HostEntry *entries;
+    size_t capacity;            // 2的幂
+    size_t count;
+} __attribute__((aligned(64))) HostShard;
+
+struct HostTable {
+    HostShard shards[HOST_SHARDS];
+    int initial_timeout_ms;     // 尚无样本时使用
+    int min_timeout_ms;
+    int max_timeout_ms;
+};
+
+static long monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000L + ts.tv_nsec / 1000L;
+}
+
+static size_t host_hash(uint32_t addr, size_t capacity) {
+    uint32_t h = addr * 0x9e3779b1U;
+    h ^= h >> 16;
+    return h & (capacity - 1);
+}
+
+// 分片号取另一个乘法散列的高位，与分片内的位置无关
+static HostShard* host_shard(HostTable *table, uint32_t addr) {
+    return &table->shards[(addr * 0x85ebca6bU) >> (32 - HOST_SHARD_BITS)];
+}
+
+HostTable* host_table_create(int initial_timeout_ms, int min_timeout_ms, int max_timeout_ms) {
+    HostTable *table = aligned_alloc(_Alignof(HostShard), sizeof(HostTable));
+    if (!table) {
+        return NULL;
+    }
+    memset(table, 0, sizeof(*table));
+
+    for (int i = 0; i < HOST_SHARDS; i++) {
+        HostShard *shard = &table->shards[i];
+        shard->capacity = 16;
+        shard->entries = calloc(shard->capacity, sizeof(HostEntry));
+        if (!shard->entries) {
+            while (--i >= 0) {
+                pthread_mutex_destroy(&table->shards[i].lock);
+                free(table->shards[i].entries);
+            }
+            free(table);
+            return NULL;
+        }
+        pthread_mutex_init(&shard->lock, NULL);
+    }
+
+    table->initial_timeout_ms = initial_timeout_ms;
+    table->min_timeout_ms = min_timeout_ms;
+    table->max_timeout_ms = max_timeout_ms;
+    return table;
+}
+
+void host_table_destroy(HostTable *table) {
+    if (!table) {
+        return;
+    }
+    for (int i = 0; i < HOST_SHARDS; i++) {
+        pthread_mutex_destroy(&table->shards[i].lock);
+        free(table->shards[i].entries);
+    }
+    free(table);
+}
+
+// 查找主机条目，create为真时不存在则创建，调用者持有分片的锁
+static HostEntry* host_lookup(HostShard *shard, uint32_t addr, int create) {
+    if (create && (shard->count + 1) * 2 > shard->capacity) {
+        size_t new_capacity = shard->capacity * 2;
+        HostEntry *entries = calloc(new_capacity, sizeof(HostEntry));
+        if (!entries) {
+            return NULL;
+        }
+        for (size_t i = 0; i < shard->capacity; i++) {
+            if (shard->entries[i].used) {
+                size_t pos = host_hash(shard->entries[i].addr, new_capacity);
+                while (entries[pos].used) pos = (pos + 1) & (new_capacity - 1);
+                entries[pos] = shard->entries[i];
+            }
+        }
+        free(shard->entries);
+        shard->entries = entries;
+        shard->capacity = new_capacity;
+    }
+
+    size_t pos = host_hash(addr, shard->capacity);
+    while (shard->entries[pos].used) {
+        if (shard->entries[pos].addr == addr) {
+            return &shard->entries[pos];
+        }
+        pos = (pos + 1) & (shard->capacity - 1);
+    }
+
+    if (!create) {
+        return NULL;
+    }
+
+    HostEntry *entry = &shard->entries[pos];
+    memset(entry, 0, sizeof(*entry));
+    entry->used = 1;
+    entry->addr = addr;
+    entry->cwnd = HOST_INITIAL_CWND;
+    entry->ssthresh = HOST_MAX_CWND;
+    shard->count++;
+    return entry;
+}
+
+// 删除条目，后续条目向前移动以保持线性探测链完整，调用者持有分片的锁
+static void host_remove(HostShard *shard, HostEntry *entry) {
+    size_t mask = shard->capacity - 1;
+    size_t hole = (size_t)(entry - shard->entries);
+    size_t next = hole;
+
+    shard->entries[hole].used = 0;
+    shard->count--;
+
+    while (1) {
+        next = (next + 1) & mask;
+        if (!shard->entries[next].used) {
+            break;
+        }
+        size_t home = host_hash(shard->entries[next].addr, shard->capacity);
+        // home落在(hole, next]之间时条目仍可被找到，不需要移动
+        int reachable = (hole <= next) ? (hole < home && home <= next)
+                                       : (hole < home || home <= next);
+        if (reachable) {
+            continue;
+        }
+        shard->entries[hole] = shard->entries[next];
+        shard->entries[next].used = 0;
+        hole = next;
+    }
+}
+
+// 主机当前的探测超时（毫秒）: SRTT + 4 * RTTVAR，限制在上下界之间
+static int entry_timeout_ms(const HostTable *table, const HostEntry *entry) {
+    if (entry->samples == 0) {
+        return table->initial_timeout_ms;
+    }
+
+    long rto_us = entry->srtt_us + 4 * entry->rttvar_us;
+    int timeout = (int)((rto_us + 999) / 1000);
+    if (timeout < table->min_timeout_ms) timeout = table->min_timeout_ms;
+    if (timeout > table->max_timeout_ms) timeout = table->max_timeout_ms;
+    return timeout;
+}
+
+// 记录一次RTT样本（微秒）
+static void entry_rtt_sample(HostEntry *entry, long rtt_us) {
+    if (entry->samples == 0) {
+        entry->srtt_us = rtt_us;
+        entry->rttvar_us = rtt_us / 2;
+    } else {
+        // RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|, SRTT = 7/8 SRTT + 1/8 R
+        long delta = entry->srtt_us - rtt_us;
+        if (delta < 0) delta = -delta;
+        entry->rttvar_us += (delta - entry->rttvar_us) / 4;
+        entry->srtt_us += (rtt_us - entry->srtt_us) / 8;
+    }
+    entry->samples++;
+}
+
+// 申请向主机发出一个探测，窗口已满时返回0；成功时给出该探测的超时
+// force为真时（实际速率低于--min-rate）不受窗口限制
+int host_probe_start(HostTable *table, struct in_addr addr, int force, int *timeout_ms) {
+    int ok = 0;
+    HostShard *shard = host_shard(table, addr.s_addr);
+
+    pthread_mutex_lock(&shard->lock);
+    HostEntry *entry = host_lookup(shard, addr.s_addr, 1);
+    if (!entry) {
+        // 内存不足时不做限制
+        *timeout_ms = table->initial_timeout_ms;
+        ok = 1;
+    } else if (entry->outstanding < (int)entry->cwnd || force) {
+        if (entry->outstanding >= (int)entry->cwnd) {
+            entry->limited = 1;
+        }
+        entry->outstanding++;
+        *timeout_ms = entry_timeout_ms(table, entry);
+        ok = 1;
+    } else {
+        entry->limited = 1;
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    return ok;
+}
+
+// 探测结束，按结果调整主机的RTT估计和拥塞窗口
+void host_probe_finish(HostTable *table, struct in_addr addr, ProbeOutcome outcome, long rtt_us) {
+    HostShard *shard = host_shard(table, addr.s_addr);
+    pthread_mutex_lock(&shard->lock);
+    HostEntry *entry = host_lookup(shard, addr.s_addr, 0);
+    if (!entry) {
+        pthread_mutex_unlock(&shard->lock);
+        return;
+    }
+
+    if (entry->outstanding > 0) {
+        entry->outstanding--;
+    }
+
+    if (outcome == PROBE_ANSWERED) {
+        // 只用首次发送的探测采样（Karn算法）
+        if (rtt_us >= 0) {
+            entry_rtt_sample(entry, rtt_us);
+        }
+        // 慢启动阶段每个响应加一，之后每个窗口加一；
+        // 窗口从未成为限制时不需要增长（RFC 7661）
+        if (entry->limited) {
+            if (entry->cwnd < entry->ssthresh) {
+                entry->cwnd += 1.0;
+            } else {
+                entry->cwnd += 1.0 / entry->cwnd;
+            }
+            if (entry->cwnd > HOST_MAX_CWND) {
+                entry->cwnd = HOST_MAX_CWND;
+            }
+        }
+    } else if (outcome == PROBE_NO_ANSWER) {
+        // 超时本身不能说明丢包（过滤端口同样没有响应），慢启动阶段照常增长；
+        // 检测到丢包后只有真正的响应才能让窗口越过阈值
+        if (entry->limited && entry->cwnd < entry->ssthresh) {
+            entry->cwnd += 1.0;
+        }
+    } else if (outcome == PROBE_RETRY_ANSWERED) {
+        // 重传的探测得到响应，说明原探测被丢弃: 窗口减半，每个RTT最多一次
+        long now = monotonic_us();
+        long interval = entry->samples > 0 ? entry->srtt_us : table->initial_timeout_ms * 1000L;
+        if (now - entry->last_decrease_us >= interval) {
+            entry->ssthresh = entry->cwnd / 2;
+            if (entry->ssthresh < 2) entry->ssthresh = 2;
+            entry->cwnd = entry->ssthresh;
+            entry->last_decrease_us = now;
+        }
+    }
+
+    // 处于初始状态的空闲主机不需要保留
+    if (entry->outstanding == 0 && entry->samples == 0 && !entry->limited) {
+        host_remove(shard, entry);
+    }
+    pthread_mutex_unlock(&shard->lock);
+}
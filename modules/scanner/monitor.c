@@ -0,0 +1,596 @@
+/**
+ * 持续监控
+ * 以上次的bin结果文件为基线，每轮先重扫基线中已知开放的端口（热区），
+ * 再扫描扫描空间中轮转的一段（冷区），只输出与基线相比的变化:
+ * 新开放的端口、关闭的端口和横幅或版本变化的端口，每个变化一行NDJSON。
+ * 冷区按固定的探测顺序轮转，位置和密钥保存在"<基线>.monitor"中，
+ * 每轮的冷区大小随新发现的开放端口增减，扫描量跟随变化率而不是地址空间的大小
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+#include "port_scanner.h"
+
+#define MONITOR_STATE_MAGIC 0x4d4b5450U   // "PTKM"
+#define MONITOR_STATE_VERSION 1
+#define MONITOR_FIELD_MAX 2048            // 转义后的一个字段的最大长度
+
+// 监控状态，跨多次运行保存
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t keys[4];        // 探测顺序的密钥，冷区按它轮转
+    uint64_t digest;         // 扫描空间摘要，目标或端口范围变化时重新开始轮转
+    uint64_t cursor;         // 下一轮冷区的起始序号
+    uint64_t slice;          // 每轮冷区的探测数
+    uint32_t rounds;         // 已完成的轮数
+    uint32_t reserved;
+} MonitorState;
+
+// 基线中的一个结果
+typedef struct {
+    uint32_t addr;           // 主机字节序
+    uint16_t port;
+    uint8_t protocol;
+    uint8_t state;
+    int32_t response_time;
+    int64_t timestamp_us;
+    int probed;              // 本轮热区是否重扫了该端口
+    char *service;
+    char *hostname;
+    char *banner;
+    char *product;
+    char *version;
+} BaselineEntry;
+
+typedef struct {
+    BaselineEntry *entries;
+    size_t count;
+    size_t capacity;
+} Baseline;
+
+static void entry_free(BaselineEntry *entry) {
+    free(entry->service);
+    free(entry->hostname);
+    free(entry->banner);
+    free(entry->product);
+    free(entry->version);
+}
+
+static void baseline_free(Baseline *baseline) {
+    for (size_t i = 0; i < baseline->count; i++) {
+        entry_free(&baseline->entries[i]);
+    }
+    free(baseline->entries);
+    memset(baseline, 0, sizeof(*baseline));
+}
+
+// 追加一个结果，字符串被复制
+static int baseline_add(Baseline *baseline, const ResultRow *row, uint8_t protocol, uint8_t state) {
+    if (baseline->count == baseline->capacity) {
+        size_t capacity = baseline->capacity ? baseline->capacity * 2 : 1024;
+        BaselineEntry *entries = realloc(baseline->entries, capacity * sizeof(BaselineEntry));
+        if (!entries) {
+            return -1;
+        }
+        baseline->entries = entries;
+        baseline->capacity = capacity;
+    }
+
+    BaselineEntry *entry = &baseline->entries[baseline->count];
+    memset(entry, 0, sizeof(*entry));
+    entry->addr = ntohl(row->addr.s_addr);
+    entry->port = (uint16_t)row->port;
+    entry->protocol = protocol;
+    entry->state = state;
+    entry->response_time = (int32_t)row->response_time;
+    entry->timestamp_us = row->timestamp_us;
+    entry->service = strdup(row->service);
+    entry->hostname = strdup(row->hostname);
+    entry->banner = strdup(row->banner);
+    entry->product = strdup(row->product);
+    entry->version = strdup(row->version);
+    if (!entry->service || !entry->hostname || !entry->banner || !entry->product || !entry->version) {
+        entry_free(entry);
+        return -1;
+    }
+    baseline->count++;
+    return 0;
+}
+
+static void entry_row(const BaselineEntry *entry, ResultRow *row) {
+    row->addr.s_addr = htonl(entry->addr);
+    row->port = entry->port;
+    row->protocol = result_protocol_name(entry->protocol);
+    row->state = port_state_name((PortState)entry->state);
+    row->service = entry->service;
+    row->hostname = entry->hostname;
+    row->banner = entry->banner;
+    row->product = entry->product;
+    row->version = entry->version;
+    row->response_time = entry->response_time;
+    row->timestamp_us = entry->timestamp_us;
+}
+
+// 与结果存储相同的顺序: 主机、端口、协议
+static int compare_key(uint32_t addr_a, int port_a, int proto_a, uint32_t addr_b, int port_b, int proto_b) {
+    if (addr_a != addr_b) {
+        return (addr_a > addr_b) - (addr_a < addr_b);
+    }
+    if (port_a != port_b) {
+        return port_a - port_b;
+    }
+    return proto_a - proto_b;
+}
+
+static int compare_entries(const void *a, const void *b) {
+    const BaselineEntry *x = a, *y = b;
+    return compare_key(x->addr, x->port, x->protocol, y->addr, y->port, y->protocol);
+}
+
+// 读取基线结果文件，文件不存在时为空基线
+static int baseline_load(const char *path, Baseline *baseline, char **target) {
+    memset(baseline, 0, sizeof(*baseline));
+    *target = NULL;
+    if (access(path, F_OK) != 0) {
+        return 0;
+    }
+
+    ResultFile *file = result_file_open(path);
+    if (!file) {
+        return -1;
+    }
+    *target = strdup(result_file_target(file));
+
+    int ret = *target ? 0 : -1;
+    for (uint32_t b = 0; b < result_file_blocks(file) && ret == 0; b++) {
+        ResultColumns cols;
+        if (result_file_read_block(file, b, &cols) < 0) {
+            ret = -1;
+            break;
+        }
+        uint64_t rows = result_file_block_rows(file, b);
+        for (uint64_t i = 0; i < rows && ret == 0; i++) {
+            ResultRow row;
+            result_file_row(file, &cols, i, &row);
+            ret = baseline_add(baseline, &row, cols.protocol[i], cols.state[i]);
+        }
+        result_columns_free(&cols);
+    }
+    result_file_close(file);
+
+    if (ret < 0) {
+        printf("错误: 读取基线 %s 失败\n", path);
+        baseline_free(baseline);
+        free(*target);
+        *target = NULL;
+        return -1;
+    }
+    qsort(baseline->entries, baseline->count, sizeof(BaselineEntry), compare_entries);
+    return 0;
+}
+
+// 把基线写回结果文件，字符串存入本轮的结果存储
+static int baseline_save(const char *path, const Baseline *baseline, ResultStore *store,
+                         const char *target) {
+    ScanResult *results = malloc((baseline->count > 0 ? baseline->count : 1) * sizeof(ScanResult));
+    if (!results) {
+        return -1;
+    }
+    for (size_t i = 0; i < baseline->count; i++) {
+        const BaselineEntry *entry = &baseline->entries[i];
+        ScanResult *result = &results[i];
+        memset(result, 0, sizeof(*result));
+        result->addr.s_addr = htonl(entry->addr);
+        result->port = entry->port;
+        result->protocol = entry->protocol;
+        result->state = entry->state;
+        result->service = strcmp(entry->service, service_name(0)) == 0 ? 0 : service_id_by_name(entry->service);
+        result->response_time = entry->response_time;
+        result->timestamp_us = entry->timestamp_us;
+        result->hostname = result_store_intern(store, entry->hostname, RESULT_HOSTNAME_MAX);
+        result->banner = result_store_intern(store, entry->banner, RESULT_BANNER_MAX);
+        result->product = result_store_intern(store, entry->product, RESULT_PRODUCT_MAX);
+        result->version = result_store_intern(store, entry->version, RESULT_VERSION_MAX);
+    }
+
+    // 写完整后再改名，中断时保留原来的基线
+    char tmp[PATH_MAX + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    ResultFileWriter *writer = result_file_create(tmp, store, target, time(NULL), 0);
+    if (!writer) {
+        free(results);
+        return -1;
+    }
+    int ret = result_file_append(writer, results, baseline->count);
+    free(results);
+    if (result_file_finish(writer) < 0 || ret < 0 || rename(tmp, path) != 0) {
+        unlink(tmp);
+        printf("错误: 写入基线 %s 失败\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+static int state_path(const char *baseline_path, char *buf, size_t size) {
+    return snprintf(buf, size, "%s.monitor", baseline_path) < (int)size ? 0 : -1;
+}
+
+// 读取监控状态，没有或与扫描空间不符时重新开始轮转
+static void state_load(const char *path, const ScanSpace *space, MonitorState *state) {
+    FILE *fp = fopen(path, "rb");
+    if (fp) {
+        int ok = fread(state, sizeof(*state), 1, fp) == 1 &&
+                 state->magic == MONITOR_STATE_MAGIC && state->version == MONITOR_STATE_VERSION &&
+                 state->digest == scan_space_digest(space) && state->cursor < space->total &&
+                 state->slice > 0;
+        fclose(fp);
+        if (ok) {
+            return;
+        }
+        printf("目标或端口范围已变化，冷区重新开始轮转\n");
+    }
+
+    memset(state, 0, sizeof(*state));
+    state->magic = MONITOR_STATE_MAGIC;
+    state->version = MONITOR_STATE_VERSION;
+    memcpy(state->keys, space->keys, sizeof(state->keys));
+    state->digest = scan_space_digest(space);
+}
+
+static void state_save(const char *path, const MonitorState *state) {
+    char tmp[PATH_MAX + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *fp = fopen(tmp, "wb");
+    int failed = !fp || fwrite(state, sizeof(*state), 1, fp) != 1;
+    if (fp && fclose(fp) != 0) {
+        failed = 1;
+    }
+    if (failed || rename(tmp, path) != 0) {
+        unlink(tmp);
+        printf("警告: 无法保存监控状态 %s (%s)\n", path, strerror(errno));
+    }
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// 本轮的探测: 先是基线中可以重扫的端口，再是冷区 [cursor, cursor + cold)，超出末尾时回绕
+static int build_work(const ScanSpace *space, Baseline *baseline, uint8_t protocol,
+                      uint64_t cursor, uint64_t cold, ScanWork *work, uint64_t *hot) {
+    uint64_t *sequences = malloc((baseline->count > 0 ? baseline->count : 1) * sizeof(uint64_t));
+    if (!sequences) {
+        return -1;
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < baseline->count; i++) {
+        BaselineEntry *entry = &baseline->entries[i];
+        struct in_addr addr = { .s_addr = htonl(entry->addr) };
+        int64_t index = entry->protocol == protocol ? scan_space_locate(space, addr, entry->port) : -1;
+        entry->probed = index >= 0;
+        if (index >= 0) {
+            sequences[count++] = scan_space_unpermute(space, (uint64_t)index);
+        }
+    }
+    qsort(sequences, count, sizeof(uint64_t), compare_u64);
+
+    SequenceRange *ranges = malloc((count + 2) * sizeof(SequenceRange));
+    if (!ranges) {
+        free(sequences);
+        return -1;
+    }
+    int range_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (range_count > 0 && ranges[range_count - 1].end >= sequences[i]) {
+            ranges[range_count - 1].end = sequences[i] + 1;
+            continue;
+        }
+        ranges[range_count].start = sequences[i];
+        ranges[range_count].end = sequences[i] + 1;
+        range_count++;
+    }
+    *hot = count;
+    free(sequences);
+
+    uint64_t end = cursor + cold;
+    ranges[range_count].start = cursor;
+    ranges[range_count].end = end < space->total ? end : space->total;
+    range_count++;
+    if (end > space->total) {
+        ranges[range_count].start = 0;
+        ranges[range_count].end = end - space->total;
+        range_count++;
+    }
+
+    int ret = scan_work_init(work, ranges, range_count);
+    free(ranges);
+    return ret;
+}
+
+// 写一个变化事件，previous为变化前的基线结果（仅changed）
+static void write_event(FILE *out, const char *event, const BaselineEntry *entry,
+                        const BaselineEntry *previous, int64_t now_us) {
+    char addr[INET_ADDRSTRLEN];
+    struct in_addr in = { .s_addr = htonl(entry->addr) };
+    inet_ntop(AF_INET, &in, addr, sizeof(addr));
+
+    char hostname[MONITOR_FIELD_MAX], service[MONITOR_FIELD_MAX], product[MONITOR_FIELD_MAX];
+    char version[MONITOR_FIELD_MAX], banner[MONITOR_FIELD_MAX];
+    json_escape(entry->hostname, hostname, sizeof(hostname));
+    json_escape(entry->service, service, sizeof(service));
+    json_escape(entry->product, product, sizeof(product));
+    json_escape(entry->version, version, sizeof(version));
+    json_escape(entry->banner, banner, sizeof(banner));
+
+    fprintf(out, "{\"event\":\"%s\",\"host\":\"%s\",\"hostname\":\"%s\",\"port\":%d,\"protocol\":\"%s\","
+                 "\"state\":\"%s\",\"service\":\"%s\",\"product\":\"%s\",\"version\":\"%s\","
+                 "\"banner\":\"%s\",\"timestamp\":%ld.%06ld",
+            event, addr, hostname, entry->port, result_protocol_name(entry->protocol),
+            port_state_name((PortState)entry->state), service, product, version, banner,
+            (long)(now_us / 1000000), (long)(now_us % 1000000));
+
+    if (previous) {
+        json_escape(previous->product, product, sizeof(product));
+        json_escape(previous->version, version, sizeof(version));
+        json_escape(previous->banner, banner, sizeof(banner));
+        fprintf(out, ",\"previous\":{\"state\":\"%s\",\"product\":\"%s\",\"version\":\"%s\",\"banner\":\"%s\"}",
+                port_state_name((PortState)previous->state), product, version, banner);
+    }
+    fprintf(out, "}\n");
+}
+
+// 横幅抓取关闭时沿用基线中的横幅和版本
+static int carry_strings(Baseline *next, const BaselineEntry *old) {
+    BaselineEntry *entry = &next->entries[next->count - 1];
+    char **fields[] = { &entry->banner, &entry->product, &entry->version, &entry->hostname };
+    char *const values[] = { old->banner, old->product, old->version, old->hostname };
+    for (int k = 0; k < 4; k++) {
+        if ((*fields[k])[0] || !values[k][0]) {
+            continue;
+        }
+        char *copy = strdup(values[k]);
+        if (!copy) {
+            return -1;
+        }
+        free(*fields[k]);
+        *fields[k] = copy;
+    }
+    return 0;
+}
+
+// 比较本轮结果和基线，输出变化并得到新的基线
+// 基线中本轮没有重扫的结果原样保留
+static int diff_results(ResultStore *store, Baseline *baseline, int banner_grab, FILE *out,
+                        Baseline *next, int *opened, int *closed, int *changed) {
+    size_t count;
+    ScanResult *results = result_store_results(store, &count);
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    int64_t now_us = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+
+    memset(next, 0, sizeof(*next));
+    size_t i = 0, j = 0;
+    while (i < count || j < baseline->count) {
+        const ScanResult *result = i < count ? &results[i] : NULL;
+        const BaselineEntry *old = j < baseline->count ? &baseline->entries[j] : NULL;
+        int cmp;
+        if (!result) {
+            cmp = 1;
+        } else if (!old) {
+            cmp = -1;
+        } else {
+            cmp = compare_key(ntohl(result->addr.s_addr), result->port, result->protocol,
+                              old->addr, old->port, old->protocol);
+        }
+
+        if (cmp > 0) {
+            // 只在基线中: 重扫过即为关闭，否则保留
+            if (old->probed) {
+                write_event(out, "closed", old, NULL, now_us);
+                (*closed)++;
+            } else {
+                ResultRow row;
+                entry_row(old, &row);
+                if (baseline_add(next, &row, old->protocol, old->state) < 0) {
+                    return -1;
+                }
+            }
+            j++;
+            continue;
+        }
+
+        ResultRow row;
+        result_store_row(store, result, &row);
+        if (baseline_add(next, &row, result->protocol, result->state) < 0) {
+            return -1;
+        }
+        const BaselineEntry *entry = &next->entries[next->count - 1];
+        if (cmp < 0) {
+            write_event(out, "opened", entry, NULL, now_us);
+            (*opened)++;
+        } else {
+            if (!banner_grab && carry_strings(next, old) < 0) {
+                return -1;
+            }
+            if (entry->state != old->state ||
+                (banner_grab && (strcmp(entry->banner, old->banner) != 0 ||
+                                 strcmp(entry->product, old->product) != 0 ||
+                                 strcmp(entry->version, old->version) != 0))) {
+                write_event(out, "changed", entry, old, now_us);
+                (*changed)++;
+            }
+            j++;
+        }
+        i++;
+    }
+    fflush(out);
+    return 0;
+}
+
+// 打开变化输出。输出到标准输出时，其余提示信息(包括加载基线和解析目标时的错误)
+// 都改到标准错误，*saved_stdout为原来的标准输出，由output_close恢复
+static FILE* output_open(const char *output_path, int *saved_stdout) {
+    FILE *out = NULL;
+    *saved_stdout = -1;
+    if (!output_path || strcmp(output_path, "-") == 0) {
+        fflush(stdout);
+        int fd = dup(STDOUT_FILENO);
+        *saved_stdout = dup(STDOUT_FILENO);
+        out = fd >= 0 ? fdopen(fd, "w") : NULL;
+        if (out && *saved_stdout >= 0) {
+            dup2(STDERR_FILENO, STDOUT_FILENO);
+        }
+    } else {
+        out = fopen(output_path, "w");
+    }
+    if (!out) {
+        printf("错误: 无法打开输出 %s\n", output_path ? output_path : "-");
+    }
+    return out;
+}
+
+static void output_close(FILE *out, int saved_stdout) {
+    if (out) {
+        fclose(out);
+    }
+    if (saved_stdout >= 0) {
+        fflush(stdout);
+        dup2(saved_stdout, STDOUT_FILENO);
+        close(saved_stdout);
+    }
+}
+
+// 执行监控: 每轮重扫热区和一段冷区，输出变化并更新基线
+int monitor_run(const ScanOptions *opts, const MonitorOptions *mon) {
+    int rotation = mon->rotation > 0 ? mon->rotation : MONITOR_DEFAULT_ROTATION;
+    uint8_t protocol = (opts->scan_type == SCAN_UDP) ? RESULT_UDP : RESULT_TCP;
+
+    int saved_stdout;
+    FILE *out = output_open(mon->output_path, &saved_stdout);
+    if (!out) {
+        output_close(out, saved_stdout);
+        return -1;
+    }
+
+    Baseline baseline;
+    char *baseline_target;
+    if (baseline_load(mon->baseline_path, &baseline, &baseline_target) < 0) {
+        output_close(out, saved_stdout);
+        return -1;
+    }
+
+    // 未指定目标时扫描基线的目标
+    ScanOptions scan = *opts;
+    if (!scan.targets && !scan.target_file) {
+        scan.targets = baseline_target;
+    }
+    if (!scan.targets && !scan.target_file) {
+        printf("错误: 需要指定目标\n");
+        baseline_free(&baseline);
+        output_close(out, saved_stdout);
+        return -1;
+    }
+
+    ScanSpace space;
+    if (dns_set_servers(scan.dns_servers) < 0 ||
+        scan_space_init(&space, scan.targets, scan.target_file, scan.port_range, scan.randomize) < 0) {
+        baseline_free(&baseline);
+        free(baseline_target);
+        output_close(out, saved_stdout);
+        return -1;
+    }
+
+    char path[PATH_MAX];
+    if (state_path(mon->baseline_path, path, sizeof(path)) < 0) {
+        printf("错误: 路径过长\n");
+        scan_space_free(&space);
+        baseline_free(&baseline);
+        free(baseline_target);
+        output_close(out, saved_stdout);
+        return -1;
+    }
+    MonitorState state;
+    state_load(path, &space, &state);
+    memcpy(space.keys, state.keys, sizeof(space.keys));
+    uint64_t base_slice = (space.total + rotation - 1) / rotation;
+    if (state.slice < base_slice) {
+        state.slice = base_slice;
+    }
+
+    int ret = 0;
+    for (int round = 0; ret == 0 && (mon->cycles <= 0 || round < mon->cycles); round++) {
+        if (round > 0 && mon->interval > 0) {
+            sleep(mon->interval);
+        }
+
+        // 没有基线时扫描整个空间建立基线
+        int first = baseline.count == 0 && state.rounds == 0;
+        uint64_t cold = first ? space.total : (state.slice < space.total ? state.slice : space.total);
+        ScanWork work;
+        uint64_t hot;
+        if (build_work(&space, &baseline, protocol, state.cursor, cold, &work, &hot) < 0) {
+            ret = -1;
+            break;
+        }
+        printf("第%u轮: 热区 %lu 个已知端口, 冷区 %lu 个探测 (%.1f%%)\n", state.rounds + 1,
+               (unsigned long)hot, (unsigned long)cold, cold * 100.0 / space.total);
+
+        ResultStore *store = NULL;
+        scan.work = &work;
+        scan.keys = state.keys;
+        int scanned = perform_scan(&scan, &store);
+        scan_work_free(&work);
+        if (scanned != 0 || !store) {
+            ret = -1;
+            break;
+        }
+
+        Baseline next;
+        int opened = 0, closed = 0, changed = 0;
+        if (diff_results(store, &baseline, scan.banner_grab, out, &next,
+                         &opened, &closed, &changed) < 0) {
+            baseline_free(&next);
+            result_store_free(store);
+            ret = -1;
+            break;
+        }
+        if (mon->update_baseline &&
+            baseline_save(mon->baseline_path, &next, store, scan.targets ? scan.targets : scan.target_file) < 0) {
+            ret = -1;
+        }
+        result_store_free(store);
+        baseline_free(&baseline);
+        baseline = next;
+
+        // 冷区发现新端口时加快轮转，没有变化时逐步回到每rotation轮扫完一遍
+        state.cursor = (state.cursor + cold) % space.total;
+        if (first) {
+            state.slice = base_slice;
+        } else if (opened > 0) {
+            state.slice = state.slice < space.total / 2 ? state.slice * 2 : space.total;
+        } else if (state.slice > base_slice) {
+            state.slice = state.slice / 2 > base_slice ? state.slice / 2 : base_slice;
+        }
+        state.rounds++;
+        state_save(path, &state);
+
+        printf("变化: 新开放 %d, 关闭 %d, 横幅/版本变化 %d; 下一轮冷区 %lu 个探测\n",
+               opened, closed, changed, (unsigned long)state.slice);
+        fflush(stdout);
+    }
+
+    output_close(out, saved_stdout);
+    scan_space_free(&space);
+    baseline_free(&baseline);
+    free(baseline_target);
+    return ret;
+}
@@ -0,0 +1,747 @@
+/**
+ * 模拟网络响应器
+ * 创建TUN网卡并把一个合成地址空间(默认10.0.0.0/8)路由到它，按种子确定的模型应答:
+ * 哪些主机存活、哪些主机有防火墙、哪些端口开放，以及每个主机的延迟和丢包率。
+ * SYN得到SYN-ACK或RST，UDP探测得到应答或ICMP端口不可达，ICMP回显请求得到回显应答。
+ * 模型只由种子和地址散列得出，不保存状态；verify命令按同样的参数检查扫描结果文件。
+ * 用法: make sim && ./net_sim run [选项]
+ *       ./net_sim verify <结果文件> --targets 10.0.0.0/16 --ports 1-1024 [--udp] [选项]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <net/route.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <netinet/tcp.h>
+#include <netinet/udp.h>
+#include <arpa/inet.h>
+#include <linux/if_tun.h>
+#include "port_scanner.h"
+
+#define SIM_DEFAULT_DEV "ptksim0"
+#define SIM_DEFAULT_NET "10.0.0.0/8"
+#define SIM_DEFAULT_LOCAL "198.18.0.1"
+#define SIM_PACKET_MAX 128         // 应答报文的最大长度，更大的回显请求不应答
+#define SIM_READ_BATCH 512         // 每次唤醒最多读取的报文数
+#define SIM_QUEUE_MAX (1 << 22)    // 等待发出的应答上限
+#define SIM_TXQUEUE_LEN 10000      // TUN网卡发送队列长度，扫描器发包快于读取时缓冲
+
+// 按端口开放概率较高的常见服务
+static const int common_tcp_ports[] = {
+    21, 22, 23, 25, 53, 80, 110, 143, 443, 445, 993, 995, 3306, 3389, 5432, 8080
+};
+static const int common_udp_ports[] = { 53, 123, 161, 500, 1900, 5353 };
+
+typedef struct {
+    uint64_t seed;
+    uint32_t net;              // 合成地址空间，主机字节序
+    uint32_t mask;
+    double alive;              // 存活主机的比例
+    double firewalled;         // 存活主机中丢弃关闭端口探测(不回RST/端口不可达)的比例
+    double tcp_open;           // 其他TCP端口开放的概率
+    double udp_open;           // 其他UDP端口开放的概率
+    double common_open;        // 常见服务端口开放的概率
+    double loss;               // 平均丢包率，每个主机在0到2倍之间均匀分布
+    int rtt_min_ms;            // 每个主机的基础RTT在上下界之间按对数均匀分布
+    int rtt_max_ms;
+    int jitter_ms;             // 每个应答另加0到该值之间的随机延迟
+} SimModel;
+
+// 等待发出的应答，按发出时间组成最小堆
+typedef struct {
+    long due_ns;
+    uint16_t len;
+    uint8_t data[SIM_PACKET_MAX];
+} SimReply;
+
+typedef struct {
+    unsigned long received;    // 目标在合成地址空间内的报文
+    unsigned long replied;
+    unsigned long lost;        // 按丢包率丢弃
+    unsigned long no_host;     // 目标主机不存活
+    unsigned long silent;      // 存活主机按模型不应答（防火墙、开放端口的FIN等）
+    unsigned long ignored;     // 非IPv4、不在地址空间内或无法解析的报文
+    unsigned long overflow;    // 应答队列已满而丢弃
+    unsigned long write_errors;
+} SimStats;
+
+static volatile sig_atomic_t sim_stop = 0;
+
+static void sim_stop_handler(int sig) {
+    (void)sig;
+    sim_stop = 1;
+}
+
+static long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static uint64_t mix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// 由种子、键和用途得到[0,1)上的均匀值
+static double model_unit(const SimModel *m, uint64_t key, uint64_t salt) {
+    return (mix64(m->seed ^ mix64(key ^ (salt << 56))) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static int in_space(const SimModel *m, uint32_t host) {
+    return (host & m->mask) == m->net;
+}
+
+static int host_alive(const SimModel *m, uint32_t host) {
+    return in_space(m, host) && model_unit(m, host, 1) < m->alive;
+}
+
+static int host_firewalled(const SimModel *m, uint32_t host) {
+    return model_unit(m, host, 2) < m->firewalled;
+}
+
+static int is_common_port(int port, int protocol) {
+    const int *list = protocol == IPPROTO_UDP ? common_udp_ports : common_tcp_ports;
+    size_t count = protocol == IPPROTO_UDP ?
+                   sizeof(common_udp_ports) / sizeof(int) : sizeof(common_tcp_ports) / sizeof(int);
+    for (size_t i = 0; i < count; i++) {
+        if (list[i] == port) return 1;
+    }
+    return 0;
+}
+
+static int port_open(const SimModel *m, uint32_t host, int port, int protocol) {
+    double p = is_common_port(port, protocol) ? m->common_open :
+               (protocol == IPPROTO_UDP ? m->udp_open : m->tcp_open);
+    return model_unit(m, host | ((uint64_t)port << 32) | ((uint64_t)protocol << 48), 3) < p;
+}
+
+static long host_rtt_ns(const SimModel *m, uint32_t host) {
+    double lo = m->rtt_min_ms > 0 ? m->rtt_min_ms : 0.001;
+    double hi = m->rtt_max_ms > lo ? m->rtt_max_ms : lo;
+    return (long)(lo * pow(hi / lo, model_unit(m, host, 4)) * 1e6);
+}
+
+static double host_loss(const SimModel *m, uint32_t host) {
+    double loss = m->loss * 2 * model_unit(m, host, 5);
+    return loss < 1 ? loss : 1;
+}
+
+// 丢包和抖动用的随机数，不要求可重现
+static uint64_t rng_state;
+
+static double rng_unit(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return ((rng_state * 0x2545f4914f6cdd1dULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// ---- 应答队列 ----
+
+typedef struct {
+    SimReply *items;
+    size_t count;
+    size_t capacity;
+} ReplyQueue;
+
+static SimReply* queue_push(ReplyQueue *q) {
+    if (q->count == q->capacity) {
+        if (q->capacity >= SIM_QUEUE_MAX) {
+            return NULL;
+        }
+        size_t capacity = q->capacity ? q->capacity * 2 : 4096;
+        SimReply *items = realloc(q->items, sizeof(SimReply) * capacity);
+        if (!items) {
+            return NULL;
+        }
+        q->items = items;
+        q->capacity = capacity;
+    }
+    return &q->items[q->count];
+}
+
+// 填好queue_push返回的应答后调用，上浮到堆中的位置
+static void queue_commit(ReplyQueue *q) {
+    size_t i = q->count++;
+    SimReply item = q->items[i];
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (q->items[parent].due_ns <= item.due_ns) break;
+        q->items[i] = q->items[parent];
+        i = parent;
+    }
+    q->items[i] = item;
+}
+
+static void queue_pop(ReplyQueue *q) {
+    SimReply last = q->items[--q->count];
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= q->count) break;
+        if (child + 1 < q->count && q->items[child + 1].due_ns < q->items[child].due_ns) child++;
+        if (last.due_ns <= q->items[child].due_ns) break;
+        q->items[i] = q->items[child];
+        i = child;
+    }
+    if (q->count > 0) {
+        q->items[i] = last;
+    }
+}
+
+// ---- 报文构造 ----
+
+static void ip_fill(struct iphdr *ip, const struct iphdr *req, int protocol, int total_len) {
+    memset(ip, 0, sizeof(*ip));
+    ip->version = 4;
+    ip->ihl = 5;
+    ip->ttl = 64;
+    ip->protocol = protocol;
+    ip->id = htons((uint16_t)(rng_unit() * 65536));
+    ip->tot_len = htons(total_len);
+    ip->saddr = req->daddr;
+    ip->daddr = req->saddr;
+    ip->check = csum_fold(csum_partial(ip, sizeof(*ip), 0));
+}
+
+// TCP和UDP校验和，含伪首部
+static uint16_t l4_checksum(const struct iphdr *ip, const void *l4, int len) {
+    struct {
+        uint32_t saddr, daddr;
+        uint8_t zero, protocol;
+        uint16_t length;
+    } __attribute__((packed)) pseudo = {
+        ip->saddr, ip->daddr, 0, ip->protocol, htons(len)
+    };
+    return csum_fold(csum_partial(l4, len, csum_partial(&pseudo, sizeof(pseudo), 0)));
+}
+
+// 按RFC 793应答: 开放端口的SYN回SYN-ACK，关闭端口回RST，带RST的报文不应答
+static int reply_tcp(const SimModel *m, const struct iphdr *req, const uint8_t *l4, int len,
+                     uint8_t *out) {
+    if (len < (int)sizeof(struct tcphdr)) return -1;
+    const struct tcphdr *th = (const struct tcphdr *)l4;
+    uint32_t host = ntohl(req->daddr);
+    int port = ntohs(th->dest);
+    int open = port_open(m, host, port, IPPROTO_TCP);
+
+    if (th->rst) return 0;
+    int syn_ack = th->syn && !th->ack && open;
+    if (!syn_ack) {
+        // 开放端口对FIN/NULL/Xmas不应答；有防火墙的主机丢弃所有得不到SYN-ACK的探测
+        if (host_firewalled(m, host) || (open && !th->ack && !th->syn)) return 0;
+    }
+
+    struct iphdr *ip = (struct iphdr *)out;
+    struct tcphdr *rt = (struct tcphdr *)(out + sizeof(*ip));
+    int tcp_len = sizeof(*rt) + (syn_ack ? 4 : 0);
+    memset(rt, 0, tcp_len);
+    rt->source = th->dest;
+    rt->dest = th->source;
+    rt->doff = tcp_len / 4;
+    if (syn_ack) {
+        rt->syn = 1;
+        rt->ack = 1;
+        rt->seq = htonl((uint32_t)mix64(m->seed ^ host ^ ((uint64_t)port << 32)));
+        rt->ack_seq = htonl(ntohl(th->seq) + 1);
+        rt->window = htons(64240);
+        uint8_t *opt = (uint8_t *)(rt + 1);
+        opt[0] = TCPOPT_MAXSEG;
+        opt[1] = TCPOLEN_MAXSEG;
+        opt[2] = 1460 >> 8;
+        opt[3] = 1460 & 0xff;
+    } else if (th->ack) {
+        rt->rst = 1;
+        rt->seq = th->ack_seq;
+    } else {
+        // 没有ACK的报文: RST的确认号为序号加上SYN、FIN和数据的长度
+        int seg_len = len - th->doff * 4;
+        if (seg_len < 0) seg_len = 0;
+        rt->rst = 1;
+        rt->ack = 1;
+        rt->ack_seq = htonl(ntohl(th->seq) + seg_len + th->syn + th->fin);
+    }
+    ip_fill(ip, req, IPPROTO_TCP, sizeof(*ip) + tcp_len);
+    rt->check = l4_checksum(ip, rt, tcp_len);
+    return sizeof(*ip) + tcp_len;
+}
+
+// ICMP端口不可达，附带原报文的IP头和前8个字节
+static int reply_unreachable(const struct iphdr *req, int req_len, uint8_t *out) {
+    int quoted = req->ihl * 4 + 8;
+    if (quoted > req_len) quoted = req_len;
+
+    struct iphdr *ip = (struct iphdr *)out;
+    struct icmphdr *icmp = (struct icmphdr *)(out + sizeof(*ip));
+    int icmp_len = sizeof(*icmp) + quoted;
+    memset(icmp, 0, sizeof(*icmp));
+    icmp->type = ICMP_DEST_UNREACH;
+    icmp->code = ICMP_PORT_UNREACH;
+    memcpy(icmp + 1, req, quoted);
+    icmp->checksum = csum_fold(csum_partial(icmp, icmp_len, 0));
+    ip_fill(ip, req, IPPROTO_ICMP, sizeof(*ip) + icmp_len);
+    return sizeof(*ip) + icmp_len;
+}
+
+static int reply_udp(const SimModel *m, const struct iphdr *req, int req_len,
+                     const uint8_t *l4, int len, uint8_t *out) {
+    static const char payload[] = "simulated\n";
+    if (len < (int)sizeof(struct udphdr)) return -1;
+    const struct udphdr *uh = (const struct udphdr *)l4;
+    uint32_t host = ntohl(req->daddr);
+
+    if (!port_open(m, host, ntohs(uh->dest), IPPROTO_UDP)) {
+        return host_firewalled(m, host) ? 0 : reply_unreachable(req, req_len, out);
+    }
+
+    struct iphdr *ip = (struct iphdr *)out;
+    struct udphdr *ru = (struct udphdr *)(out + sizeof(*ip));
+    int udp_len = sizeof(*ru) + sizeof(payload) - 1;
+    ru->source = uh->dest;
+    ru->dest = uh->source;
+    ru->len = htons(udp_len);
+    ru->check = 0;
+    memcpy(ru + 1, payload, sizeof(payload) - 1);
+    ip_fill(ip, req, IPPROTO_UDP, sizeof(*ip) + udp_len);
+    ru->check = l4_checksum(ip, ru, udp_len);
+    return sizeof(*ip) + udp_len;
+}
+
+static int reply_icmp(const struct iphdr *req, const uint8_t *l4, int len, uint8_t *out) {
+    if (len < (int)sizeof(struct icmphdr)) return -1;
+    const struct icmphdr *icmp = (const struct icmphdr *)l4;
+    if (icmp->type != ICMP_ECHO) return 0;
+    if ((int)sizeof(struct iphdr) + len > SIM_PACKET_MAX) return -1;
+
+    struct iphdr *ip = (struct iphdr *)out;
+    struct icmphdr *ri = (struct icmphdr *)(out + sizeof(*ip));
+    memcpy(ri, icmp, len);
+    ri->type = ICMP_ECHOREPLY;
+    ri->checksum = 0;
+    ri->checksum = csum_fold(csum_partial(ri, len, 0));
+    ip_fill(ip, req, IPPROTO_ICMP, sizeof(*ip) + len);
+    return sizeof(*ip) + len;
+}
+
+// 处理扫描器发往TUN网卡的一个报文，需要应答时放入队列
+static void handle_packet(const SimModel *m, const uint8_t *pkt, int n, ReplyQueue *queue,
+                          SimStats *stats) {
+    const struct iphdr *req = (const struct iphdr *)pkt;
+    if (n < (int)sizeof(*req) || req->version != 4 || req->ihl < 5 || req->ihl * 4 > n ||
+        !in_space(m, ntohl(req->daddr))) {
+        stats->ignored++;
+        return;
+    }
+    stats->received++;
+
+    uint32_t host = ntohl(req->daddr);
+    if (!host_alive(m, host)) {
+        stats->no_host++;
+        return;
+    }
+    if (rng_unit() < host_loss(m, host)) {
+        stats->lost++;
+        return;
+    }
+
+    SimReply *reply = queue_push(queue);
+    if (!reply) {
+        stats->overflow++;
+        return;
+    }
+
+    int ip_len = ntohs(req->tot_len);
+    if (ip_len > n) ip_len = n;
+    const uint8_t *l4 = pkt + req->ihl * 4;
+    int l4_len = ip_len - req->ihl * 4;
+    int len;
+    switch (req->protocol) {
+    case IPPROTO_TCP:
+        len = reply_tcp(m, req, l4, l4_len, reply->data);
+        break;
+    case IPPROTO_UDP:
+        len = reply_udp(m, req, ip_len, l4, l4_len, reply->data);
+        break;
+    case IPPROTO_ICMP:
+        len = reply_icmp(req, l4, l4_len, reply->data);
+        break;
+    default:
+        len = -1;
+        break;
+    }
+    if (len < 0) {
+        stats->ignored++;
+        return;
+    }
+    if (len == 0) {
+        stats->silent++;
+        return;
+    }
+
+    reply->len = len;
+    reply->due_ns = now_ns() + host_rtt_ns(m, host) + (long)(rng_unit() * m->jitter_ms * 1e6);
+    queue_commit(queue);
+}
+
+// ---- TUN网卡 ----
+
+static int tun_open(const char *name) {
+    int fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "错误: 无法打开/dev/net/tun: %s\n", strerror(errno));
+        return -1;
+    }
+
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    ifr.ifr_flags = IFF_TUN | IFF_NO_PI;
+    strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+    if (ioctl(fd, TUNSETIFF, &ifr) < 0) {
+        fprintf(stderr, "错误: 无法创建TUN网卡%s: %s\n", name, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void set_sockaddr(struct sockaddr *sa, uint32_t host) {
+    struct sockaddr_in *sin = (struct sockaddr_in *)sa;
+    memset(sin, 0, sizeof(*sin));
+    sin->sin_family = AF_INET;
+    sin->sin_addr.s_addr = htonl(host);
+}
+
+// 设置本机地址、启用网卡并把合成地址空间路由到网卡；网卡关闭时路由随之删除
+static int tun_configure(const char *name, uint32_t local, const SimModel *m) {
+    int sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        return -1;
+    }
+
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+
+    set_sockaddr(&ifr.ifr_addr, local);
+    if (ioctl(sock, SIOCSIFADDR, &ifr) < 0) goto fail;
+    set_sockaddr(&ifr.ifr_netmask, 0xffffffff);
+    if (ioctl(sock, SIOCSIFNETMASK, &ifr) < 0) goto fail;
+    ifr.ifr_qlen = SIM_TXQUEUE_LEN;
+    if (ioctl(sock, SIOCSIFTXQLEN, &ifr) < 0) goto fail;
+    if (ioctl(sock, SIOCGIFFLAGS, &ifr) < 0) goto fail;
+    ifr.ifr_flags |= IFF_UP | IFF_RUNNING;
+    if (ioctl(sock, SIOCSIFFLAGS, &ifr) < 0) goto fail;
+
+    struct rtentry rt;
+    memset(&rt, 0, sizeof(rt));
+    set_sockaddr(&rt.rt_dst, m->net);
+    set_sockaddr(&rt.rt_genmask, m->mask);
+    rt.rt_flags = RTF_UP;
+    rt.rt_dev = (char *)name;
+    if (ioctl(sock, SIOCADDRT, &rt) < 0 && errno != EEXIST) goto fail;
+
+    close(sock);
+    return 0;
+
+fail:
+    fprintf(stderr, "错误: 配置网卡%s失败: %s\n", name, strerror(errno));
+    close(sock);
+    return -1;
+}
+
+static void print_stats(FILE *out, const SimStats *stats, size_t queued, double seconds) {
+    fprintf(out, "{\"seconds\":%.1f,\"received\":%lu,\"replied\":%lu,\"lost\":%lu,"
+            "\"no_host\":%lu,\"silent\":%lu,\"ignored\":%lu,\"overflow\":%lu,"
+            "\"write_errors\":%lu,\"queued\":%zu,\"rx_pps\":%.0f}\n",
+            seconds, stats->received, stats->replied, stats->lost, stats->no_host,
+            stats->silent, stats->ignored, stats->overflow, stats->write_errors, queued,
+            seconds > 0 ? stats->received / seconds : 0.0);
+    fflush(out);
+}
+
+static int sim_run(const SimModel *m, const char *dev, uint32_t local, int stats_interval) {
+    int fd = tun_open(dev);
+    if (fd < 0) {
+        return -1;
+    }
+    if (tun_configure(dev, local, m) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    char net[INET_ADDRSTRLEN], addr[INET_ADDRSTRLEN];
+    struct in_addr in = { htonl(m->net) };
+    inet_ntop(AF_INET, &in, net, sizeof(net));
+    in.s_addr = htonl(local);
+    inet_ntop(AF_INET, &in, addr, sizeof(addr));
+    fprintf(stderr, "模拟网络: %s/%d 经 %s (本机地址 %s)，种子 %llu，按Ctrl+C停止\n",
+            net, __builtin_popcount(m->mask), dev, addr, (unsigned long long)m->seed);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sim_stop_handler;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    rng_state = mix64(m->seed ^ (uint64_t)now_ns()) | 1;
+    ReplyQueue queue = { NULL, 0, 0 };
+    SimStats stats;
+    memset(&stats, 0, sizeof(stats));
+    uint8_t buf[65536];
+    long start = now_ns();
+    long next_report = start + stats_interval * 1000000000L;
+
+    while (!sim_stop) {
+        long now = now_ns();
+        while (queue.count > 0 && queue.items[0].due_ns <= now) {
+            if (write(fd, queue.items[0].data, queue.items[0].len) < 0) {
+                stats.write_errors++;
+            } else {
+                stats.replied++;
+            }
+            queue_pop(&queue);
+        }
+
+        if (stats_interval > 0 && now >= next_report) {
+            print_stats(stderr, &stats, queue.count, (now - start) / 1e9);
+            next_report += stats_interval * 1000000000L;
+        }
+
+        long wait_ns = queue.count > 0 ? queue.items[0].due_ns - now : 100000000L;
+        if (wait_ns > 100000000L) wait_ns = 100000000L;
+        struct timespec ts = { wait_ns / 1000000000L, wait_ns % 1000000000L };
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        if (ppoll(&pfd, 1, &ts, NULL) <= 0) {
+            continue;
+        }
+
+        for (int i = 0; i < SIM_READ_BATCH; i++) {
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n < 0) break;
+            handle_packet(m, buf, (int)n, &queue, &stats);
+        }
+    }
+
+    print_stats(stdout, &stats, queue.count, (now_ns() - start) / 1e9);
+    free(queue.items);
+    close(fd);
+    return 0;
+}
+
+// ---- 结果检查 ----
+
+// 按模型检查结果文件中的开放端口: 误报是模型中不开放的端口，漏报是模型中开放但结果中没有的端口
+static int sim_verify(const SimModel *m, const char *path, const char *targets,
+                      const char *ports, int protocol) {
+    ScanSpace space;
+    if (scan_space_init(&space, targets, NULL, ports, 0) < 0) {
+        return -1;
+    }
+
+    unsigned long expected = 0;
+    for (int h = 0; h < space.host_range_count; h++) {
+        for (uint64_t host = space.hosts[h].start; host <= space.hosts[h].end; host++) {
+            if (!host_alive(m, (uint32_t)host)) continue;
+            for (int p = 0; p < space.port_range_count; p++) {
+                for (int port = space.ports[p].start; port <= space.ports[p].end; port++) {
+                    expected += port_open(m, (uint32_t)host, port, protocol);
+                }
+            }
+        }
+    }
+
+    ResultFile *file = result_file_open(path);
+    if (!file) {
+        scan_space_free(&space);
+        return -1;
+    }
+
+    uint8_t want = protocol == IPPROTO_UDP ? RESULT_UDP : RESULT_TCP;
+    unsigned long found = 0, matched = 0, false_positive = 0;
+    for (uint32_t b = 0; b < result_file_blocks(file); b++) {
+        ResultColumns cols;
+        if (result_file_read_block(file, b, &cols) < 0) {
+            result_file_close(file);
+            scan_space_free(&space);
+            return -1;
+        }
+        for (size_t i = 0; i < cols.rows; i++) {
+            if (cols.state[i] != PORT_OPEN || cols.protocol[i] != want) continue;
+            found++;
+            struct in_addr addr = { htonl(cols.addr[i]) };
+            if (scan_space_locate(&space, addr, cols.port[i]) >= 0 &&
+                host_alive(m, cols.addr[i]) && port_open(m, cols.addr[i], cols.port[i], protocol)) {
+                matched++;
+            } else if (++false_positive <= 10) {
+                fprintf(stderr, "误报: %s:%d\n", inet_ntoa(addr), cols.port[i]);
+            }
+        }
+        result_columns_free(&cols);
+    }
+    result_file_close(file);
+    scan_space_free(&space);
+
+    printf("{\"expected_open\":%lu,\"found_open\":%lu,\"matched\":%lu,\"false_positive\":%lu,"
+           "\"missed\":%lu,\"recall\":%.4f}\n",
+           expected, found, matched, false_positive, expected - matched,
+           expected > 0 ? (double)matched / expected : 1.0);
+    return false_positive > 0 ? 1 : 0;
+}
+
+static int parse_net(const char *text, uint32_t *net, uint32_t *mask) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%s", text);
+    char *slash = strchr(buf, '/');
+    int bits = 32;
+    if (slash) {
+        *slash = '\0';
+        bits = atoi(slash + 1);
+    }
+    struct in_addr in;
+    if (bits < 1 || bits > 32 || inet_pton(AF_INET, buf, &in) != 1) {
+        return -1;
+    }
+    *mask = bits == 32 ? 0xffffffff : ~(0xffffffffU >> bits);
+    *net = ntohl(in.s_addr) & *mask;
+    return 0;
+}
+
+// 模型参数，run和verify共用；返回1表示已处理
+static int parse_model_option(SimModel *m, const char *arg, const char *val) {
+    if (strcmp(arg, "--seed") == 0) m->seed = strtoull(val, NULL, 0);
+    else if (strcmp(arg, "--net") == 0) {
+        if (parse_net(val, &m->net, &m->mask) < 0) {
+            fprintf(stderr, "错误: 无效的地址空间 %s\n", val);
+            exit(1);
+        }
+    }
+    else if (strcmp(arg, "--alive") == 0) m->alive = atof(val);
+    else if (strcmp(arg, "--firewalled") == 0) m->firewalled = atof(val);
+    else if (strcmp(arg, "--tcp-open") == 0) m->tcp_open = atof(val);
+    else if (strcmp(arg, "--udp-open") == 0) m->udp_open = atof(val);
+    else if (strcmp(arg, "--common-open") == 0) m->common_open = atof(val);
+    else if (strcmp(arg, "--loss") == 0) m->loss = atof(val);
+    else if (strcmp(arg, "--rtt-min") == 0) m->rtt_min_ms = atoi(val);
+    else if (strcmp(arg, "--rtt-max") == 0) m->rtt_max_ms = atoi(val);
+    else if (strcmp(arg, "--jitter") == 0) m->jitter_ms = atoi(val);
+    else return 0;
+    return 1;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "用法: %s run [选项]\n"
+            "      %s verify <结果文件> --targets 目标 --ports 端口 [--udp] [模型选项]\n"
+            "run选项:\n"
+            "  --dev NAME         TUN网卡名 (默认 %s)\n"
+            "  --local ADDR       网卡的本机地址，不能在模拟地址空间内 (默认 %s)\n"
+            "  --stats N          每N秒向标准错误输出一行统计，0表示不输出 (默认 0)\n"
+            "模型选项 (verify时须与run一致):\n"
+            "  --seed N           模型种子 (默认 1)\n"
+            "  --net CIDR         模拟的地址空间 (默认 %s)\n"
+            "  --alive F          存活主机比例 (默认 0.1)\n"
+            "  --firewalled F     存活主机中丢弃关闭端口探测的比例 (默认 0.3)\n"
+            "  --tcp-open F       TCP端口开放概率 (默认 0.002)\n"
+            "  --udp-open F       UDP端口开放概率 (默认 0.002)\n"
+            "  --common-open F    常见服务端口开放概率 (默认 0.25)\n"
+            "  --loss F           平均丢包率 (默认 0.01)\n"
+            "  --rtt-min MS       主机RTT下界 (默认 5)\n"
+            "  --rtt-max MS       主机RTT上界 (默认 200)\n"
+            "  --jitter MS        每个应答的随机附加延迟上限 (默认 5)\n",
+            prog, prog, SIM_DEFAULT_DEV, SIM_DEFAULT_LOCAL, SIM_DEFAULT_NET);
+}
+
+int main(int argc, char **argv) {
+    SimModel model = {
+        .seed = 1,
+        .alive = 0.1,
+        .firewalled = 0.3,
+        .tcp_open = 0.002,
+        .udp_open = 0.002,
+        .common_open = 0.25,
+        .loss = 0.01,
+        .rtt_min_ms = 5,
+        .rtt_max_ms = 200,
+        .jitter_ms = 5
+    };
+    parse_net(SIM_DEFAULT_NET, &model.net, &model.mask);
+
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    const char *command = argv[1];
+    int verify = strcmp(command, "verify") == 0;
+    if (!verify && strcmp(command, "run") != 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const char *dev = SIM_DEFAULT_DEV;
+    const char *local_text = SIM_DEFAULT_LOCAL;
+    int stats_interval = 0;
+    const char *path = NULL;
+    const char *targets = NULL;
+    const char *ports = NULL;
+    int protocol = IPPROTO_TCP;
+
+    for (int i = 2; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *val = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (verify && strcmp(arg, "--udp") == 0) {
+            protocol = IPPROTO_UDP;
+            continue;
+        }
+        if (verify && !path && strncmp(arg, "--", 2) != 0) {
+            path = arg;
+            continue;
+        }
+        if (!val) {
+            usage(argv[0]);
+            return 1;
+        }
+        i++;
+        if (parse_model_option(&model, arg, val)) continue;
+        if (!verify && strcmp(arg, "--dev") == 0) dev = val;
+        else if (!verify && strcmp(arg, "--local") == 0) local_text = val;
+        else if (!verify && strcmp(arg, "--stats") == 0) stats_interval = atoi(val);
+        else if (verify && strcmp(arg, "--targets") == 0) targets = val;
+        else if (verify && strcmp(arg, "--ports") == 0) ports = val;
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (verify) {
+        if (!path || !targets || !ports) {
+            usage(argv[0]);
+            return 1;
+        }
+        int rc = sim_verify(&model, path, targets, ports, protocol);
+        return rc < 0 ? 1 : rc;
+    }
+
+    struct in_addr local;
+    if (inet_pton(AF_INET, local_text, &local) != 1 || in_space(&model, ntohl(local.s_addr))) {
+        fprintf(stderr, "错误: 本机地址 %s 无效或在模拟地址空间内\n", local_text);
+        return 1;
+    }
+    return sim_run(&model, dev, ntohl(local.s_addr), stats_interval) < 0 ? 1 : 0;
+}
@@ -0,0 +1,170 @@
+/**
+ * 全局发包速率控制
+ * 所有发送路径（connect、原始TCP、UDP）共用一个令牌桶，
+ * 令牌按纳秒级单调时钟逐个发放，使报文均匀发出而不是整批突发；
+ * 同时统计实际发出的报文数，用于--min-rate判断是否落后
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/prctl.h>
+#include "port_scanner.h"
+
+#define PACER_BUCKET_NS 50000L     // 桶深度: 最多积累50us的令牌
+#define PACER_SPIN_NS 60000L       // 剩余时间小于此值时忙等，避免睡眠唤醒延迟
+
+struct Pacer {
+    long interval_ns;          // 相邻两个令牌的间隔，0表示不限速
+    long bucket_ns;            // 可积累的令牌对应的时间
+    long next_ns;              // 下一个令牌的发放时间，多线程原子更新
+    double min_rate;
+    long start_ns;
+    long last_ns;              // 最近一个令牌的发放时间
+    unsigned long sent;        // 已发放的令牌数
+};
+
+long pacer_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+// 创建速率控制器，max_rate为0表示不限速，min_rate为0表示不要求最低速率
+Pacer* pacer_create(double max_rate, double min_rate) {
+    Pacer *pacer = calloc(1, sizeof(Pacer));
+    if (!pacer) {
+        return NULL;
+    }
+
+    if (max_rate > 0) {
+        pacer->interval_ns = (long)(1e9 / max_rate);
+        if (pacer->interval_ns < 1) pacer->interval_ns = 1;
+        // 桶深度至少一个令牌
+        pacer->bucket_ns = pacer->interval_ns > PACER_BUCKET_NS ? pacer->interval_ns : PACER_BUCKET_NS;
+    }
+    pacer->min_rate = min_rate;
+    pacer->start_ns = pacer_now_ns();
+    pacer->next_ns = pacer->start_ns;
+    return pacer;
+}
+
+void pacer_destroy(Pacer *pacer) {
+    free(pacer);
+}
+
+// 默认50us的定时器松弛会让短睡眠明显超时，每个线程首次使用时调低
+static void pacer_thread_init(void) {
+    static __thread int initialized;
+    if (!initialized) {
+        prctl(PR_SET_TIMERSLACK, 1000UL, 0, 0, 0);
+        initialized = 1;
+    }
+}
+
+// 记录发放了一个时间为due的令牌
+static void pacer_count(Pacer *pacer, long due) {
+    __atomic_add_fetch(&pacer->sent, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&pacer->last_ns, due, __ATOMIC_RELAXED);
+}
+
+// 取一个令牌的发放时间，now之前积累的令牌不超过桶深度
+static long pacer_take(Pacer *pacer, long now, int wait) {
+    long next = __atomic_load_n(&pacer->next_ns, __ATOMIC_RELAXED);
+    long due;
+
+    do {
+        due = next;
+        if (due < now - pacer->bucket_ns) {
+            due = now - pacer->bucket_ns;
+        }
+        if (!wait && due > now) {
+            return due;
+        }
+    } while (!__atomic_compare_exchange_n(&pacer->next_ns, &next, due + pacer->interval_ns,
+                                          1, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    pacer_count(pacer, due);
+    return due;
+}
+
+// 尝试取得一个令牌，成功返回0，否则返回需要等待的纳秒数
+long pacer_try(Pacer *pacer) {
+    if (!pacer) {
+        return 0;
+    }
+    pacer_thread_init();
+    long now = pacer_now_ns();
+    if (pacer->interval_ns == 0) {
+        pacer_count(pacer, now);
+        return 0;
+    }
+
+    long due = pacer_take(pacer, now, 0);
+    return due > now ? due - now : 0;
+}
+
+// 预约一个令牌，返回该报文可以发出的时间（单调时钟纳秒）
+long pacer_reserve(Pacer *pacer) {
+    long now = pacer_now_ns();
+    if (!pacer) {
+        return now;
+    }
+    pacer_thread_init();
+    if (pacer->interval_ns == 0) {
+        pacer_count(pacer, now);
+        return now;
+    }
+    return pacer_take(pacer, now, 1);
+}
+
+// 等到指定时间: 先睡眠，最后一段忙等
+void pacer_sleep_until(long deadline_ns) {
+    long remaining = deadline_ns - pacer_now_ns();
+    if (remaining <= 0) {
+        return;
+    }
+
+    if (remaining > PACER_SPIN_NS) {
+        long wake = deadline_ns - PACER_SPIN_NS;
+        struct timespec ts = { wake / 1000000000L, wake % 1000000000L };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0 && scan_running) {
+        }
+    }
+
+    while (pacer_now_ns() < deadline_ns) {
+    }
+}
+
+void pacer_sleep(long duration_ns) {
+    pacer_sleep_until(pacer_now_ns() + duration_ns);
+}
+
+// 实际发包数是否低于--min-rate要求
+int pacer_behind(Pacer *pacer) {
+    if (!pacer || pacer->min_rate <= 0) {
+        return 0;
+    }
+    double elapsed = (pacer_now_ns() - pacer->start_ns) / 1e9;
+    unsigned long sent = __atomic_load_n(&pacer->sent, __ATOMIC_RELAXED);
+    return sent < pacer->min_rate * elapsed;
+}
+
+// 从创建到最后一个令牌的平均发包速率
+double pacer_rate(Pacer *pacer) {
+    if (!pacer) {
+        return 0;
+    }
+    unsigned long sent = __atomic_load_n(&pacer->sent, __ATOMIC_RELAXED);
+    double elapsed = (__atomic_load_n(&pacer->last_ns, __ATOMIC_RELAXED) - pacer->start_ns) / 1e9;
+    if (sent < 2 || elapsed <= 0) {
+        return 0;
+    }
+    // n个令牌之间有n-1个间隔
+    return (sent - 1) / elapsed;
+}
+
+unsigned long pacer_sent(const Pacer *pacer) {
+    return pacer ? __atomic_load_n(&pacer->sent, __ATOMIC_RELAXED) : 0;
+}
@@ -19,94 +19,15 @@
 #include <netinet/tcp.h>
 #include <netinet/ip.h>
 #include <arpa/inet.h>
-#include <netdb.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <time.h>
 #include "framework/plugin_interface.h"
-
-#define MAX_THREADS 200
-#define MAX_PORTS 65535
-#define SCAN_TIMEOUT 2
-#define MAX_BANNER_SIZE 1024
-#define MAX_SERVICES 1000
-
-// 伪头部用于计算TCP校验和
-struct pseudo_header {
-    uint32_t source_address;
-    uint32_t dest_address;
-    uint8_t placeholder;
-    uint8_t protocol;
-    uint16_t tcp_length;
-};
-
-// 扫描类型枚举
-typedef enum {
-    SCAN_TCP_CONNECT = 0,
-    SCAN_TCP_SYN,
-    SCAN_TCP_ACK,
-    SCAN_TCP_FIN,
-    SCAN_TCP_XMAS,
-    SCAN_TCP_NULL,
-    SCAN_UDP,
-    SCAN_UDP_CONNECT
-} ScanType;
-
-// 端口状态枚举
-typedef enum {
-    PORT_OPEN = 0,
-    PORT_CLOSED,
-    PORT_FILTERED,
-    PORT_OPEN_FILTERED,
-    PORT_UNFILTERED
-} PortState;
-
-// 服务信息结构
-typedef struct {
-    int port;
-    char name[32];
-    char protocol[8];
-    char description[128];
-} ServiceInfo;
-
-// 扫描结果结构
-typedef struct {
-    int port;
-    char protocol[8];
-    char state[16];
-    char service[32];
-    char banner[256];
-    long response_time; // 响应时间(ms)
-    struct timeval timestamp;
-} ScanResult;
-
-// 线程参数结构
-typedef struct {
-    char *target;
-    struct in_addr target_addr;
-    int start_port;
-    int end_port;
-    int *ports_to_scan;
-    int port_count;
-    int timeout_ms;
-    ScanType scan_type;
-    int thread_id;
-    int *current_index;
-    pthread_mutex_t *index_mutex;
-    ScanResult *results;
-    int *result_count;
-    pthread_mutex_t *result_mutex;
-    int *total_scanned;
-    int *open_ports;
-    int *closed_ports;
-    int *filtered_ports;
-    int banner_grab;
-    int verbose;
-} ThreadParams;
+#include "port_scanner.h"
 
 // 全局变量
-static ServiceInfo *service_db = NULL;
-static int service_count = 0;
-static volatile int scan_running = 0;
+volatile int scan_running = 0;
+volatile sig_atomic_t scan_interrupted = 0;
 static pthread_mutex_t scan_mutex = PTHREAD_MUTEX_INITIALIZER;
 static struct timeval scan_start_time;
 
@@ -119,138 +40,9 @@ void get_plugin_info(PluginInfo *info) {
     strcpy(info->category, "scanner");
 }
 
-// 初始化服务数据库
-void init_service_database(void) {
-    // 常见服务端口映射
-    ServiceInfo common_services[] = {
-        {20, "ftp-data", "tcp", "FTP Data Transfer"},
-        {21, "ftp", "tcp", "File Transfer Protocol"},
-        {22, "ssh", "tcp", "Secure Shell"},
-        {23, "telnet", "tcp", "Telnet"},
-        {25, "smtp", "tcp", "Simple Mail Transfer Protocol"},
-        {53, "dns", "tcp/udp", "Domain Name System"},
-        {67, "dhcp", "udp", "DHCP Server"},
-        {68, "dhcp", "udp", "DHCP Client"},
-        {69, "tftp", "udp", "Trivial File Transfer Protocol"},
-        {80, "http", "tcp", "Hypertext Transfer Protocol"},
-        {110, "pop3", "tcp", "Post Office Protocol v3"},
-        {111, "rpcbind", "tcp/udp", "RPC Portmapper"},
-        {123, "ntp", "udp", "Network Time Protocol"},
-        {135, "msrpc", "tcp", "Microsoft RPC"},
-        {137, "netbios-ns", "udp", "NetBIOS Name Service"},
-        {138, "netbios-dgm", "udp", "NetBIOS Datagram Service"},
-        {139, "netbios-ssn", "tcp", "NetBIOS Session Service"},
-        {143, "imap", "tcp", "Internet Message Access Protocol"},
-        {161, "snmp", "udp", "Simple Network Management Protocol"},
-        {162, "snmptrap", "udp", "SNMP Trap"},
-        {389, "ldap", "tcp", "Lightweight Directory Access Protocol"},
-        {443, "https", "tcp", "HTTP over SSL/TLS"},
-        {445, "microsoft-ds", "tcp", "Microsoft Directory Services"},
-        {465, "smtps", "tcp", "SMTP over SSL"},
-        {514, "syslog", "udp", "System Logging Protocol"},
-        {587, "smtp", "tcp", "SMTP Submission"},
-        {636, "ldaps", "tcp", "LDAP over SSL"},
-        {993, "imaps", "tcp", "IMAP over SSL"},
-        {995, "pop3s", "tcp", "POP3 over SSL"},
-        {1080, "socks", "tcp", "SOCKS Proxy"},
-        {1433, "ms-sql-s", "tcp", "Microsoft SQL Server"},
-        {1521, "oracle", "tcp", "Oracle Database"},
-        {1723, "pptp", "tcp", "Point-to-Point Tunneling Protocol"},
-        {1883, "mqtt", "tcp", "MQ Telemetry Transport"},
-        {1900, "upnp", "udp", "Universal Plug and Play"},
-        {2049, "nfs", "tcp/udp", "Network File System"},
-        {2082, "cpanel", "tcp", "cPanel"},
-        {2083, "cpanel", "tcp", "cPanel SSL"},
-        {2086, "whm", "tcp", "WebHost Manager"},
-        {2087, "whm", "tcp", "WebHost Manager SSL"},
-        {2095, "webmail", "tcp", "cPanel WebMail"},
-        {2096, "webmail", "tcp", "cPanel WebMail SSL"},
-        {2181, "zookeeper", "tcp", "Apache ZooKeeper"},
-        {2375, "docker", "tcp", "Docker REST API"},
-        {2376, "docker", "tcp", "Docker REST API SSL"},
-        {3000, "nodejs", "tcp", "Node.js Application"},
-        {3306, "mysql", "tcp", "MySQL Database"},
-        {3389, "ms-wbt-server", "tcp", "Remote Desktop Protocol"},
-        {3690, "svn", "tcp", "Subversion"},
-        {4000, "remoteanything", "tcp", "Remote Anything"},
-        {4040, "yo", "tcp", "Yarn Application Manager"},
-        {4200, "angular", "tcp", "Angular Development Server"},
-        {4369, "epmd", "tcp", "Erlang Port Mapper Daemon"},
-        {5000, "upnp", "tcp", "Universal Plug and Play"},
-        {5432, "postgresql", "tcp", "PostgreSQL Database"},
-        {5601, "kibana", "tcp", "Kibana"},
-        {5672, "amqp", "tcp", "Advanced Message Queuing Protocol"},
-        {5900, "vnc", "tcp", "Virtual Network Computing"},
-        {5984, "couchdb", "tcp", "Apache CouchDB"},
-        {6379, "redis", "tcp", "Redis Key-Value Store"},
-        {7001, "weblogic", "tcp", "Oracle WebLogic Server"},
-        {7002, "weblogic", "tcp", "Oracle WebLogic Server SSL"},
-        {8000, "http-alt", "tcp", "HTTP Alternate"},
-        {8008, "http-alt", "tcp", "HTTP Alternate"},
-        {8080, "http-proxy", "tcp", "HTTP Proxy"},
-        {8081, "http-proxy", "tcp", "HTTP Proxy"},
-        {8088, "http-alt", "tcp", "HTTP Alternate"},
-        {8089, "splunk", "tcp", "Splunk"},
-        {8443, "https-alt", "tcp", "HTTPS Alternate"},
-        {8888, "http-alt", "tcp", "HTTP Alternate"},
-        {9000, "sonar", "tcp", "SonarQube"},
-        {9001, "tor", "tcp", "Tor"},
-        {9042, "cassandra", "tcp", "Apache Cassandra"},
-        {9092, "kafka", "tcp", "Apache Kafka"},
-        {9200, "elasticsearch", "tcp", "Elasticsearch"},
-        {9300, "elasticsearch", "tcp", "Elasticsearch Transport"},
-        {9418, "git", "tcp", "Git"},
-        {11211, "memcache", "tcp", "Memcached"},
-        {15672, "rabbitmq", "tcp", "RabbitMQ Management"},
-        {27017, "mongodb", "tcp", "MongoDB"},
-        {27018, "mongodb", "tcp", "MongoDB Sharding"},
-        {28017, "mongodb", "tcp", "MongoDB Web Interface"},
-        {50000, "db2", "tcp", "IBM DB2"},
-        {50070, "hadoop", "tcp", "Hadoop HDFS NameNode"},
-        {61616, "activemq", "tcp", "Apache ActiveMQ"}
-    };
-
-    service_count = sizeof(common_services) / sizeof(ServiceInfo);
-    service_db = malloc(sizeof(ServiceInfo) * service_count);
-    memcpy(service_db, common_services, sizeof(common_services));
-}
-
-// 根据端口号获取服务信息
-const char* get_service_by_port(int port, const char* protocol) {
-    for (int i = 0; i < service_count; i++) {
-        if (service_db[i].port == port) {
-            // 检查协议是否匹配
-            if (strstr(service_db[i].protocol, protocol) != NULL) {
-                return service_db[i].name;
-            }
-        }
-    }
-    return "unknown";
-}
-
 // 计算TCP校验和
 unsigned short tcp_checksum(unsigned short *ptr, int nbytes) {
-    register long sum;
-    unsigned short oddbyte;
-    register short answer;
-
-    sum = 0;
-    while (nbytes > 1) {
-        sum += *ptr++;
-        nbytes -= 2;
-    }
-
-    if (nbytes == 1) {
-        oddbyte = 0;
-        *((unsigned char*)&oddbyte) = *(unsigned char*)ptr;
-        sum += oddbyte;
-    }
-
-    sum = (sum >> 16) + (sum & 0xffff);
-    sum = sum + (sum >> 16);
-    answer = (short)~sum;
-
-    return answer;
+    return csum_fold(csum_partial(ptr, nbytes, 0));
 }
 
 // 创建原始套接字
@@ -273,8 +65,16 @@ int create_raw_socket(void) {
     return sock;
 }
 
-// TCP Connect扫描
-int tcp_connect_scan(const char *target, int port, int timeout_ms) {
+// 以RST方式关闭连接，不在本地留下TIME_WAIT
+void close_with_reset(int fd) {
+    struct linger lg = { .l_onoff = 1, .l_linger = 0 };
+    setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+    close(fd);
+}
+
+// TCP Connect扫描，返回响应时间，-2表示连接被拒绝，-1表示超时或不可达
+// keep_fd不为NULL时连接成功的套接字不关闭，通过它交给调用者
+int tcp_connect_scan(const struct sockaddr_in *addr, int timeout_ms, int *keep_fd) {
     int sock = socket(AF_INET, SOCK_STREAM, 0);
     if (sock < 0) {
         return -1;
@@ -287,269 +87,34 @@ int tcp_connect_scan(const char *target, int port, int timeout_ms) {
     setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
     setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
 
-    // 解析目标地址
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(port);
-
-    if (inet_pton(AF_INET, target, &addr.sin_addr) <= 0) {
-        // DNS解析
-        struct hostent *host = gethostbyname(target);
-        if (!host) {
-            close(sock);
-            return -1;
-        }
-        memcpy(&addr.sin_addr, host->h_addr_list[0], host->h_length);
-    }
-
     // 尝试连接
     struct timeval start, end;
     gettimeofday(&start, NULL);
 
-    int result = connect(sock, (struct sockaddr *)&addr, sizeof(addr));
+    int result = connect(sock, (const struct sockaddr *)addr, sizeof(*addr));
+    int err = errno;
 
     gettimeofday(&end, NULL);
     long response_time = (end.tv_sec - start.tv_sec) * 1000 +
     (end.tv_usec - start.tv_usec) / 1000;
 
-    close(sock);
+    if (result == 0 && keep_fd) {
+        *keep_fd = sock;
+    } else {
+        close_with_reset(sock);
+    }
 
     if (result == 0) {
         return response_time; // 返回响应时间
+    } else if (err == ECONNREFUSED) {
+        return -2; // 连接被拒绝
     } else {
         return -1;
     }
 }
 
-// TCP SYN扫描（半开放扫描）
-int tcp_syn_scan(const char *target, int port, int timeout_ms) {
-    int raw_sock = create_raw_socket();
-    if (raw_sock < 0) {
-        return -1;
-    }
-
-    // 需要root权限
-    if (geteuid() != 0) {
-        printf("警告: TCP SYN扫描需要root权限\n");
-        close(raw_sock);
-        return -2;
-    }
-
-    // 构造IP头部
-    char packet[4096];
-    struct iphdr *iph = (struct iphdr *)packet;
-    struct tcphdr *tcph = (struct tcphdr *)(packet + sizeof(struct iphdr));
-    struct sockaddr_in sin;
-
-    // 目标地址
-    sin.sin_family = AF_INET;
-    sin.sin_port = htons(port);
-
-    if (inet_pton(AF_INET, target, &sin.sin_addr) <= 0) {
-        struct hostent *host = gethostbyname(target);
-        if (!host) {
-            close(raw_sock);
-            return -1;
-        }
-        memcpy(&sin.sin_addr, host->h_addr_list[0], host->h_length);
-    }
-
-    // 填充IP头部
-    iph->ihl = 5;
-    iph->version = 4;
-    iph->tos = 0;
-    iph->tot_len = sizeof(struct iphdr) + sizeof(struct tcphdr);
-    iph->id = htonl(54321); // 随机ID
-    iph->frag_off = 0;
-    iph->ttl = 255;
-    iph->protocol = IPPROTO_TCP;
-    iph->check = 0;
-    iph->saddr = inet_addr("192.168.1.100"); // 伪造源地址
-    iph->daddr = sin.sin_addr.s_addr;
-
-    // 填充TCP头部
-    tcph->source = htons(12345); // 随机源端口
-    tcph->dest = htons(port);
-    tcph->seq = htonl(1105024978);
-    tcph->ack_seq = 0;
-    tcph->doff = 5;
-    tcph->fin = 0;
-    tcph->syn = 1;
-    tcph->rst = 0;
-    tcph->psh = 0;
-    tcph->ack = 0;
-    tcph->urg = 0;
-    tcph->window = htons(5840);
-    tcph->check = 0;
-    tcph->urg_ptr = 0;
-
-    // 计算TCP校验和
-    struct pseudo_header psh;
-    psh.source_address = iph->saddr;
-    psh.dest_address = sin.sin_addr.s_addr;
-    psh.placeholder = 0;
-    psh.protocol = IPPROTO_TCP;
-    psh.tcp_length = htons(sizeof(struct tcphdr));
-
-    int psize = sizeof(struct pseudo_header) + sizeof(struct tcphdr);
-    char *pseudogram = malloc(psize);
-    memcpy(pseudogram, (char*)&psh, sizeof(struct pseudo_header));
-    memcpy(pseudogram + sizeof(struct pseudo_header), tcph, sizeof(struct tcphdr));
-
-    tcph->check = tcp_checksum((unsigned short*)pseudogram, psize);
-    free(pseudogram);
-
-    // 发送SYN包
-    int sent = sendto(raw_sock, packet, iph->tot_len, 0,
-                      (struct sockaddr *)&sin, sizeof(sin));
-
-    if (sent < 0) {
-        perror("发送SYN包失败");
-        close(raw_sock);
-        return -1;
-    }
-
-    // 设置接收超时
-    struct timeval tv;
-    tv.tv_sec = timeout_ms / 1000;
-    tv.tv_usec = (timeout_ms % 1000) * 1000;
-    setsockopt(raw_sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-
-    // 接收响应
-    char buffer[4096];
-    struct sockaddr_in from;
-    socklen_t fromlen = sizeof(from);
-
-    fd_set readfds;
-    FD_ZERO(&readfds);
-    FD_SET(raw_sock, &readfds);
-
-    struct timeval select_timeout = tv;
-    int ret = select(raw_sock + 1, &readfds, NULL, NULL, &select_timeout);
-
-    if (ret > 0) {
-        int received = recvfrom(raw_sock, buffer, sizeof(buffer), 0,
-                                (struct sockaddr *)&from, &fromlen);
-        if (received > 0) {
-            struct iphdr *recv_iph = (struct iphdr *)buffer;
-            struct tcphdr *recv_tcph = (struct tcphdr *)(buffer + (recv_iph->ihl * 4));
-
-            // 检查是否是SYN-ACK响应
-            if (recv_tcph->syn && recv_tcph->ack) {
-                close(raw_sock);
-                return 1; // 端口开放
-            } else if (recv_tcph->rst) {
-                close(raw_sock);
-                return 0; // 端口关闭
-            }
-        }
-    }
-
-    close(raw_sock);
-    return -1; // 端口被过滤或无响应
-}
-
-// UDP扫描
-int udp_scan(const char *target, int port, int timeout_ms) {
-    int sock = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sock < 0) {
-        return -1;
-    }
-
-    // 设置超时
-    struct timeval tv;
-    tv.tv_sec = timeout_ms / 1000;
-    tv.tv_usec = (timeout_ms % 1000) * 1000;
-    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(port);
-
-    if (inet_pton(AF_INET, target, &addr.sin_addr) <= 0) {
-        struct hostent *host = gethostbyname(target);
-        if (!host) {
-            close(sock);
-            return -1;
-        }
-        memcpy(&addr.sin_addr, host->h_addr_list[0], host->h_length);
-    }
-
-    // 发送空数据包
-    char buffer[1] = {0};
-    int sent = sendto(sock, buffer, 1, 0, (struct sockaddr *)&addr, sizeof(addr));
-
-    if (sent < 0) {
-        close(sock);
-        return -1;
-    }
-
-    // 尝试接收ICMP端口不可达消息
-    char recv_buffer[1024];
-    struct sockaddr_in from;
-    socklen_t fromlen = sizeof(from);
-
-    int received = recvfrom(sock, recv_buffer, sizeof(recv_buffer), 0,
-                            (struct sockaddr *)&from, &fromlen);
-
-    close(sock);
-
-    if (received < 0) {
-        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-            return 1; // 端口可能开放（UDP无响应）
-        }
-        return -1;
-    }
-
-    // 检查是否是ICMP端口不可达消息
-    // 简化处理：如果有响应，可能是ICMP错误
-    return 0; // 端口关闭
-}
-
-// 横幅抓取
-char* grab_banner(const char *target, int port, int timeout_ms, const char *protocol) {
-    if (strcmp(protocol, "tcp") != 0) {
-        return NULL; // 只支持TCP横幅抓取
-    }
-
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0) {
-        return NULL;
-    }
-
-    // 设置超时
-    struct timeval tv;
-    tv.tv_sec = timeout_ms / 1000;
-    tv.tv_usec = (timeout_ms % 1000) * 1000;
-    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
-
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(port);
-
-    if (inet_pton(AF_INET, target, &addr.sin_addr) <= 0) {
-        struct hostent *host = gethostbyname(target);
-        if (!host) {
-            close(sock);
-            return NULL;
-        }
-        memcpy(&addr.sin_addr, host->h_addr_list[0], host->h_length);
-    }
-
-    // 连接
-    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
-        close(sock);
-        return NULL;
-    }
-
-    // 根据端口发送不同的探针
-    char *banner = malloc(MAX_BANNER_SIZE);
-    memset(banner, 0, MAX_BANNER_SIZE);
-    char probe[256];
+// 根据端口选择横幅探针，返回探针长度（0表示只等待服务端发送）
+int get_banner_probe(int port, char *probe) {
     int probe_len = 0;
 
     if (port == 80 || port == 8080 || port == 8000 || port == 8888) {
@@ -583,106 +148,329 @@ char* grab_banner(const char *target, int port, int timeout_ms, const char *prot
         // MySQL
         strcpy(probe, "\x0a"); // Protocol version 10
         probe_len = 1;
-    } else {
-        // 通用探针：发送换行符
+    } else if ((probe_len = fingerprint_probe(port, "tcp", probe, 256)) == 0) {
+        // 规则库没有为该端口指定探针时发送换行符
         strcpy(probe, "\r\n");
         probe_len = 2;
     }
 
-    // 发送探针
-    if (probe_len > 0) {
-        send(sock, probe, probe_len, 0);
-    }
-
-    // 接收响应
-    char buffer[1024];
-    int total_received = 0;
-    int received;
-
-    while (total_received < MAX_BANNER_SIZE - 1) {
-        received = recv(sock, buffer, sizeof(buffer) - 1, 0);
-        if (received <= 0) {
-            break;
-        }
-
-        buffer[received] = '\0';
-
-        // 过滤不可打印字符
-        for (int i = 0; i < received; i++) {
-            if (buffer[i] < 32 && buffer[i] != '\n' && buffer[i] != '\r' && buffer[i] != '\t') {
-                buffer[i] = '.';
-            }
-        }
+    return probe_len;
+}
 
-        // 添加到banner
-        if (total_received + received < MAX_BANNER_SIZE) {
-            strcat(banner + total_received, buffer);
-            total_received += received;
-        } else {
-            strncat(banner + total_received, buffer, MAX_BANNER_SIZE - total_received - 1);
-            break;
+// 将收到的原始数据整理为可显示的横幅，数据为空时返回NULL
+char* sanitize_banner(char *raw, int len) {
+    // 过滤不可打印字符
+    for (int i = 0; i < len; i++) {
+        if (raw[i] < 32 && raw[i] != '\n' && raw[i] != '\r' && raw[i] != '\t') {
+            raw[i] = '.';
         }
     }
 
-    close(sock);
-
     // 清理banner：去除多余空白字符
-    char *clean_banner = malloc(strlen(banner) + 1);
-    char *src = banner;
+    char *clean_banner = malloc(len + 1);
+    if (!clean_banner) {
+        return NULL;
+    }
+
     char *dst = clean_banner;
     int in_space = 0;
 
-    while (*src) {
-        if (*src == ' ' || *src == '\t' || *src == '\n' || *src == '\r') {
+    for (int i = 0; i < len; i++) {
+        char c = raw[i];
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
             if (!in_space && dst > clean_banner) {
                 *dst++ = ' ';
                 in_space = 1;
             }
         } else {
-            *dst++ = *src;
+            *dst++ = c;
             in_space = 0;
         }
-        src++;
     }
+
+    // 去除末尾空格
+    while (dst > clean_banner && *(dst - 1) == ' ') dst--;
     *dst = '\0';
 
-    // 去除首尾空格
-    char *start = clean_banner;
-    while (*start == ' ') start++;
+    if (dst == clean_banner) {
+        free(clean_banner);
+        return NULL;
+    }
 
-    char *end = start + strlen(start) - 1;
-    while (end > start && *end == ' ') end--;
-    *(end + 1) = '\0';
+    return clean_banner;
+}
 
-    free(banner);
+// 获取下一个探测的目标地址和端口，没有剩余探测时返回-1
+// 序号按块原子领取，块内的探测不再访问共享状态
+int next_probe(ThreadParams *params, struct in_addr *addr, int *port) {
+    // 中断后不再发出探测，已领取块中剩余的序号由检查点记为未完成
+    if (scan_interrupted) {
+        return -1;
+    }
+    if (params->chunk_next >= params->chunk_end) {
+        // 引擎出错停止扫描时不再领取新的块
+        if (!scan_running) {
+            return -1;
+        }
+        uint64_t total = params->work->total;
+        uint64_t start = __atomic_fetch_add(params->next_sequence, params->work_chunk,
+                                            __ATOMIC_RELAXED);
+        if (start >= total) {
+            return -1;
+        }
+        params->chunk_next = start;
+        params->chunk_end = (total - start < (uint64_t)params->work_chunk)
+                            ? total : start + params->work_chunk;
+    }
 
-    if (strlen(start) == 0) {
-        free(clean_banner);
-        return NULL;
+    uint64_t sequence = params->chunk_next++;
+    scan_space_decode(params->space, probe_index(params, sequence), addr, port);
+    return 0;
+}
+
+// 第n个工作序号在扫描空间中的下标
+uint64_t probe_index(const ThreadParams *params, uint64_t n) {
+    return scan_space_permute(params->space, scan_work_sequence(params->work, n));
+}
+
+// 已发出的工作序号数 [0, n)，用于只有一个发送线程的无状态引擎；
+// 被中断时本线程所领取的块中剩余的序号没有发出
+uint64_t probes_dispatched(const ThreadParams *params) {
+    if (params->chunk_next < params->chunk_end) {
+        return params->chunk_next;
+    }
+    uint64_t next = __atomic_load_n(params->next_sequence, __ATOMIC_RELAXED);
+    return next < params->work->total ? next : params->work->total;
+}
+
+// 端口状态名称
+const char* port_state_name(PortState state) {
+    switch (state) {
+        case PORT_OPEN: return "open";
+        case PORT_CLOSED: return "closed";
+        case PORT_FILTERED: return "filtered";
+        case PORT_OPEN_FILTERED: return "open|filtered";
+        case PORT_UNFILTERED: return "unfiltered";
+        default: return "unknown";
+    }
+}
+
+// 更新本线程的统计，只有所属线程写入，原子存储只为让进度线程读到完整的值
+static void count_state(ThreadParams *params, PortState state, long count) {
+    ThreadShard *shard = params->shard;
+    if ((unsigned)state >= PORT_STATE_COUNT) {
+        state = PORT_FILTERED;
+    }
+    __atomic_store_n(&shard->states[state], shard->states[state] + count, __ATOMIC_RELAXED);
+    __atomic_store_n(&shard->scanned, shard->scanned + count, __ATOMIC_RELAXED);
+}
+
+// 在本线程的结果块中分配一个结果，内存不足时返回NULL
+static ScanResult* shard_alloc_result(ThreadShard *shard) {
+    if (!shard->tail || shard->tail->count == RESULT_BLOCK_SIZE) {
+        ResultBlock *block = malloc(sizeof(ResultBlock));
+        if (!block) {
+            return NULL;
+        }
+        block->next = NULL;
+        block->count = 0;
+        if (shard->tail) {
+            shard->tail->next = block;
+        } else {
+            shard->head = block;
+        }
+        shard->tail = block;
+    }
+
+    shard->result_count++;
+    return &shard->tail->items[shard->tail->count++];
+}
+
+// 把版本识别结果写入扫描结果
+void apply_service_match(ResultStore *store, ScanResult *result, const ServiceMatch *match) {
+    if (match->service[0]) {
+        uint16_t service = service_id_by_name(match->service);
+        if (service) {
+            result->service = service;
+        }
+    }
+    result->product = result_store_intern(store, match->product, RESULT_PRODUCT_MAX);
+    result->version = result_store_intern(store, match->version, RESULT_VERSION_MAX);
+}
+
+// 保存单个端口的扫描结果，grab为真时把开放的TCP端口交给横幅抓取阶段，
+// fd为探测时建立的连接（-1表示没有），横幅阶段直接使用它，否则关闭
+static void store_scan_result(ThreadParams *params, struct in_addr addr, int port,
+                              const char *protocol, PortState state, long response_time,
+                              const char *banner, const ServiceMatch *match, int grab, int fd) {
+    char host[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &addr, host, sizeof(host));
+
+    ScanResult *scan_result = NULL;
+
+    // 开放、开放|过滤和未过滤的端口保存到结果中，同一端口重复的响应
+    // （包括从检查点继续时重新探测到的端口）只保存和计数一次
+    int mark = -1;
+    if (state == PORT_OPEN || state == PORT_OPEN_FILTERED || state == PORT_UNFILTERED) {
+        mark = result_store_mark(params->store, addr, port, state);
+    }
+    if (mark == 0) {
+        if (fd >= 0) {
+            close_with_reset(fd);
+        }
+        return;
+    }
+
+    // 更新统计
+    count_state(params, state, 1);
+
+    int queue_banner = grab && params->banners &&
+                       state == PORT_OPEN && strcmp(protocol, "tcp") == 0;
+    if (mark == 1) {
+        scan_result = shard_alloc_result(params->shard);
+        if (scan_result) {
+            struct timeval now;
+            gettimeofday(&now, NULL);
+
+            memset(scan_result, 0, sizeof(*scan_result));
+            scan_result->addr = addr;
+            scan_result->port = port;
+            scan_result->protocol = result_protocol(protocol);
+            scan_result->state = state;
+            scan_result->service = get_service_id(port, protocol);
+            scan_result->banner = result_store_intern(params->store, banner, RESULT_BANNER_MAX);
+            if (match) {
+                apply_service_match(params->store, scan_result, match);
+            }
+            scan_result->response_time = (response_time > 0) ? response_time : 0;
+            scan_result->timestamp_us = (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+            scan_result->flags = queue_banner ? RESULT_BANNER_PENDING : 0;
+            // 结果写完后才对检查点可见
+            __atomic_store_n(&params->shard->published, params->shard->result_count,
+                             __ATOMIC_RELEASE);
+        }
+    }
+
+    // 横幅异步抓取，到达后直接写回结果，由横幅阶段输出到流
+    if (queue_banner && scan_result) {
+        banner_stage_submit(params->banners, addr, port, fd, scan_result);
+    } else {
+        if (fd >= 0) {
+            close_with_reset(fd);
+        }
+        if (params->stream && scan_result) {
+            result_stream_write(params->stream, params->store, scan_result);
+        }
     }
 
-    return start;
+    // 显示进度（如果启用详细模式）
+    if (params->verbose) {
+        const char *names[] = {"开放", "关闭", "过滤", "开放|过滤", "未过滤"};
+        pthread_mutex_lock(&scan_mutex);
+        printf("线程 %d: 扫描 %s:%d - %s\n",
+               params->thread_id, host, port, names[state]);
+        pthread_mutex_unlock(&scan_mutex);
+    }
+}
+
+// 记录单个端口的扫描结果 (result: 1开放, 0关闭, -1过滤)
+void record_scan_result(ThreadParams *params, struct in_addr addr, int port,
+                        const char *protocol, int result, long response_time) {
+    PortState state = (result > 0) ? PORT_OPEN : (result == 0) ? PORT_CLOSED : PORT_FILTERED;
+    store_scan_result(params, addr, port, protocol, state, response_time,
+                      NULL, NULL, params->banner_grab, -1);
+}
+
+// 记录connect扫描结果，fd为已建立的连接（-1表示没有），由本函数接管
+void record_connect_result(ThreadParams *params, struct in_addr addr, int port,
+                           int result, long response_time, int fd) {
+    PortState state = (result > 0) ? PORT_OPEN : (result == 0) ? PORT_CLOSED : PORT_FILTERED;
+    store_scan_result(params, addr, port, "tcp", state, response_time,
+                      NULL, NULL, params->banner_grab, fd);
+}
+
+// 记录扫描结果，横幅和版本识别结果已由引擎自行得到（可为NULL）
+void record_scan_result_banner(ThreadParams *params, struct in_addr addr, int port,
+                               const char *protocol, int result, long response_time,
+                               const char *banner, const ServiceMatch *match) {
+    PortState state = (result > 0) ? PORT_OPEN : (result == 0) ? PORT_CLOSED : PORT_FILTERED;
+    store_scan_result(params, addr, port, protocol, state, response_time,
+                      banner, match, 0, -1);
+}
+
+// 按端口状态记录扫描结果，用于能区分更多状态的引擎
+void record_port_state(ThreadParams *params, struct in_addr addr, int port,
+                       const char *protocol, PortState state, long response_time,
+                       const char *banner) {
+    store_scan_result(params, addr, port, protocol, state, response_time,
+                      banner, NULL, banner == NULL && params->banner_grab, -1);
+}
+
+// 只计数不保存结果，用于大规模扫描中无响应的探测
+void record_state_count(ThreadParams *params, PortState state, long count) {
+    count_state(params, state, count);
+}
+
+// 记录无状态引擎中没有收到响应的探测，只包括已发出的探测；
+// unsent中是分配了但发送失败的探测，不记录状态，可为NULL。
+// 探测数不超过MAX_SILENT_RESULTS时逐个保存，否则只计数
+void record_silent_probes(ThreadParams *params, const IndexSet *answered,
+                          const IndexSet *unsent, const char *protocol, PortState state) {
+    const ScanSpace *space = params->space;
+    uint64_t dispatched = probes_dispatched(params);
+    uint64_t skipped = answered->count + (unsent ? unsent->count : 0);
+
+    if (dispatched > MAX_SILENT_RESULTS) {
+        uint64_t silent = dispatched > skipped ? dispatched - skipped : 0;
+        record_state_count(params, state, (long)silent);
+        return;
+    }
+
+    for (uint64_t n = 0; n < dispatched; n++) {
+        uint64_t index = probe_index(params, n);
+        if (index_set_contains(answered, index) || (unsent && index_set_contains(unsent, index))) {
+            continue;
+        }
+        struct in_addr addr;
+        int port;
+        scan_space_decode(space, index, &addr, &port);
+        record_port_state(params, addr, port, protocol, state, -1, NULL);
+    }
 }
 
 // 扫描线程函数
 void* scan_thread_func(void *arg) {
     ThreadParams *params = (ThreadParams *)arg;
 
-    while (scan_running) {
-        int port_index = -1;
+    // 每个线程同时只有一个探测，重传队列只需一个位置
+    ProbeScheduler sched;
+    if (probe_scheduler_init(&sched, 1) < 0) {
+        return NULL;
+    }
 
-        // 获取下一个要扫描的端口
-        pthread_mutex_lock(params->index_mutex);
-        if (*params->current_index < params->port_count) {
-            port_index = (*params->current_index)++;
+    while (1) {
+        // 获取下一个探测
+        Probe probe;
+        int timeout_ms;
+        int got = probe_scheduler_next(params, &sched, &probe, &timeout_ms);
+        if (got < 0) {
+            break; // 所有探测都已完成
         }
-        pthread_mutex_unlock(params->index_mutex);
-
-        if (port_index == -1) {
-            break; // 所有端口都已扫描
+        if (got == 0) {
+            // 主机拥塞窗口已满，或等待全局速率的下一个令牌
+            if (sched.pace_wait_ns > 0) {
+                pacer_sleep(sched.pace_wait_ns);
+            } else {
+                usleep(1000);
+            }
+            continue;
         }
 
-        int port = params->ports_to_scan[port_index];
+        struct sockaddr_in target;
+        memset(&target, 0, sizeof(target));
+        target.sin_family = AF_INET;
+        target.sin_port = htons(probe.port);
+        target.sin_addr = probe.addr;
 
         // 执行扫描
         int result = -1;
@@ -690,186 +478,538 @@ void* scan_thread_func(void *arg) {
         const char *protocol = "tcp";
 
         switch (params->scan_type) {
-            case SCAN_TCP_CONNECT:
-                response_time = tcp_connect_scan(params->target, port, params->timeout_ms);
+            case SCAN_TCP_CONNECT: {
+                struct timespec t0, t1;
+                clock_gettime(CLOCK_MONOTONIC, &t0);
+                int fd = -1;
+                response_time = tcp_connect_scan(&target, timeout_ms,
+                                                 params->banner_grab ? &fd : NULL);
+                clock_gettime(CLOCK_MONOTONIC, &t1);
+
+                if (response_time >= 0 || response_time == -2) {
+                    // 连接成功和被拒绝都是一次完整的往返
+                    probe_answered(params, &probe,
+                                   (t1.tv_sec - t0.tv_sec) * 1000000L +
+                                   (t1.tv_nsec - t0.tv_nsec) / 1000L);
+                } else if (probe_timed_out(params, &sched, &probe)) {
+                    continue; // 等待重传
+                }
+
                 if (response_time >= 0) {
                     result = 1; // 开放
-                } else {
+                } else if (response_time == -2) {
                     result = 0; // 关闭
+                    response_time = -1;
+                } else {
+                    result = -1; // 超时视为过滤
                 }
-                break;
-
-            case SCAN_TCP_SYN:
-                result = tcp_syn_scan(params->target, port, params->timeout_ms);
-                protocol = "tcp";
-                break;
-
-            case SCAN_UDP:
-                result = udp_scan(params->target, port, params->timeout_ms);
-                protocol = "udp";
-                break;
+                // 已建立的连接直接交给横幅阶段
+                record_connect_result(params, probe.addr, probe.port, result, response_time, fd);
+                continue;
+            }
 
             default:
+                probe_unreachable(params, &probe);
                 result = -1;
         }
 
-        // 更新统计
-        pthread_mutex_lock(params->result_mutex);
-        (*params->total_scanned)++;
-
-        if (result > 0) {
-            // 端口开放
-            (*params->open_ports)++;
-
-            // 添加结果
-            if (*params->result_count < MAX_PORTS) {
-                ScanResult *scan_result = &params->results[*params->result_count];
-                scan_result->port = port;
-                strcpy(scan_result->protocol, protocol);
-                strcpy(scan_result->state, "open");
-
-                const char *service = get_service_by_port(port, protocol);
-                strncpy(scan_result->service, service, sizeof(scan_result->service) - 1);
-
-                // 抓取横幅
-                if (params->banner_grab && result > 0 && strcmp(protocol, "tcp") == 0) {
-                    char *banner = grab_banner(params->target, port, params->timeout_ms, protocol);
-                    if (banner) {
-                        strncpy(scan_result->banner, banner, sizeof(scan_result->banner) - 1);
-                        free(banner);
-                    } else {
-                        scan_result->banner[0] = '\0';
-                    }
-                } else {
-                    scan_result->banner[0] = '\0';
-                }
+        record_scan_result(params, probe.addr, probe.port, protocol, result, response_time);
+    }
 
-                scan_result->response_time = (response_time > 0) ? response_time : 0;
-                gettimeofday(&scan_result->timestamp, NULL);
+    probe_scheduler_free(&sched);
+    return NULL;
+}
 
-                (*params->result_count)++;
-            }
-        } else if (result == 0) {
-            (*params->closed_ports)++;
-        } else {
-            (*params->filtered_ports)++;
+// 批量反向解析结果中出现的主机，结果已按主机排序
+static void reverse_resolve_results(ResultStore *store, ScanResult *results, size_t count) {
+    DnsLookup *lookups = malloc(sizeof(DnsLookup) * (count > 0 ? count : 1));
+    if (!lookups) {
+        return;
+    }
+
+    int hosts = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (hosts == 0 || lookups[hosts - 1].addr.s_addr != results[i].addr.s_addr) {
+            memset(&lookups[hosts], 0, sizeof(DnsLookup));
+            lookups[hosts].addr = results[i].addr;
+            hosts++;
         }
-        pthread_mutex_unlock(params->result_mutex);
-
-        // 显示进度（如果启用详细模式）
-        if (params->verbose) {
-            pthread_mutex_lock(&scan_mutex);
-            printf("线程 %d: 扫描端口 %d - %s\n",
-                   params->thread_id, port,
-                   (result > 0) ? "开放" : (result == 0) ? "关闭" : "过滤");
-            pthread_mutex_unlock(&scan_mutex);
+    }
+
+    int resolved = dns_reverse(lookups, hosts);
+    printf("反向解析: %d/%d个主机\n", resolved, hosts);
+
+    uint32_t hostname = 0;
+    for (size_t i = 0, h = 0; i < count; i++) {
+        if (i == 0 || results[i - 1].addr.s_addr != results[i].addr.s_addr) {
+            while (lookups[h].addr.s_addr != results[i].addr.s_addr) h++;
+            // 过长的名字截断，同一主机的结果共用一份
+            hostname = lookups[h].resolved ?
+                       result_store_intern(store, lookups[h].name, RESULT_HOSTNAME_MAX) : 0;
         }
+        results[i].hostname = hostname;
     }
 
+    free(lookups);
+}
+
+// 进度样本，用于确定定期检查点中已完成的序号
+typedef struct {
+    long time_ms;
+    uint64_t next;                   // 此时已领取的工作序号
+    long states[PORT_STATE_COUNT];
+} ProgressSample;
+
+// 已结束的扫描线程数，最后一个线程结束时立即唤醒进度循环
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int finished;
+} ScanDone;
+
+// 扫描线程: 运行引擎后增加结束计数
+typedef struct {
+    void *(*func)(void *);
+    ThreadParams *params;
+    ScanDone *done;
+} ScanWorker;
+
+static void* scan_worker(void *arg) {
+    ScanWorker *worker = (ScanWorker *)arg;
+    worker->func(worker->params);
+
+    pthread_mutex_lock(&worker->done->lock);
+    worker->done->finished++;
+    pthread_cond_signal(&worker->done->cond);
+    pthread_mutex_unlock(&worker->done->lock);
     return NULL;
 }
 
-// 解析端口范围字符串
-int* parse_port_range(const char *range_str, int *count) {
-    int *ports = NULL;
-    *count = 0;
+static void scan_done_init(ScanDone *done) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&done->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&done->lock, NULL);
+    done->finished = 0;
+}
 
-    if (!range_str || strlen(range_str) == 0) {
-        return NULL;
+static void scan_done_destroy(ScanDone *done) {
+    pthread_cond_destroy(&done->cond);
+    pthread_mutex_destroy(&done->lock);
+}
+
+// 等到count个线程都结束或超时，返回已结束的线程数
+static int scan_done_wait(ScanDone *done, int count, int timeout_ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
     }
 
-    // 分配初始内存
-    ports = malloc(MAX_PORTS * sizeof(int));
-    if (!ports) {
-        return NULL;
+    pthread_mutex_lock(&done->lock);
+    while (done->finished < count &&
+           pthread_cond_timedwait(&done->cond, &done->lock, &deadline) == 0) {
     }
+    int finished = done->finished;
+    pthread_mutex_unlock(&done->lock);
+    return finished;
+}
 
-    char *token, *str, *tofree;
-    tofree = str = strdup(range_str);
+// 中断信号: 停止发出新的探测，再次收到时按默认方式退出
+static void stop_scan_handler(int sig) {
+    if (scan_interrupted) {
+        signal(sig, SIG_DFL);
+        raise(sig);
+        return;
+    }
+    scan_interrupted = 1;
+    scan_running = 0;
+}
 
-    while ((token = strsep(&str, ",")) != NULL) {
-        char *dash = strchr(token, '-');
-        if (dash) {
-            // 端口范围
-            *dash = '\0';
-            int start = atoi(token);
-            int end = atoi(dash + 1);
+static void sum_states(ThreadShard *shards, int count, long *states) {
+    for (int s = 0; s < PORT_STATE_COUNT; s++) {
+        states[s] = 0;
+        for (int i = 0; i < count; i++) {
+            states[s] += __atomic_load_n(&shards[i].states[s], __ATOMIC_RELAXED);
+        }
+    }
+}
 
-            if (start < 1) start = 1;
-            if (end > MAX_PORTS) end = MAX_PORTS;
-            if (start > end) {
-                int temp = start;
-                start = end;
-                end = temp;
-            }
+// 不晚于before的最新样本，没有时返回NULL
+static const ProgressSample* completed_sample(const ProgressSample *samples, int count,
+                                              int capacity, long before) {
+    const ProgressSample *found = NULL;
+    int first = count > capacity ? count - capacity : 0;
+    for (int i = first; i < count; i++) {
+        const ProgressSample *sample = &samples[i % capacity];
+        if (sample->time_ms <= before) {
+            found = sample;
+        }
+    }
+    return found;
+}
 
-            for (int i = start; i <= end && *count < MAX_PORTS; i++) {
-                ports[(*count)++] = i;
-            }
-        } else {
-            // 单个端口
-            int port = atoi(token);
-            if (port >= 1 && port <= MAX_PORTS && *count < MAX_PORTS) {
-                ports[(*count)++] = port;
+static long elapsed_since(const struct timeval *start) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - start->tv_sec) * 1000 + (now.tv_usec - start->tv_usec) / 1000;
+}
+
+// 复制各线程已写完的结果，扫描线程可以同时追加。横幅还在抓取的结果仍会被
+// 横幅阶段改写，不复制，其下标写入deferred（调用者释放），由检查点记为未完成
+static ScanResult* collect_results(ThreadShard *shards, int count, const ScanSpace *space,
+                                   size_t *total, uint64_t **deferred, size_t *deferred_count) {
+    int published[count];
+    size_t limit = 0;
+    for (int i = 0; i < count; i++) {
+        published[i] = __atomic_load_n(&shards[i].published, __ATOMIC_ACQUIRE);
+        limit += published[i];
+    }
+
+    ScanResult *results = malloc((limit > 0 ? limit : 1) * sizeof(ScanResult));
+    *deferred = malloc((limit > 0 ? limit : 1) * sizeof(uint64_t));
+    if (!results || !*deferred) {
+        free(results);
+        free(*deferred);
+        *deferred = NULL;
+        return NULL;
+    }
+    // 结果块按顺序写满，前published个结果都在完整的块或最后一块的前部
+    size_t n = 0;
+    *deferred_count = 0;
+    for (int i = 0; i < count; i++) {
+        int left = published[i];
+        for (ResultBlock *block = shards[i].head; block && left > 0; block = block->next) {
+            int take = left < RESULT_BLOCK_SIZE ? left : RESULT_BLOCK_SIZE;
+            for (int j = 0; j < take; j++) {
+                ScanResult *result = &block->items[j];
+                // 地址和端口写入后不再变化，可以直接读取
+                if (__atomic_load_n(&result->flags, __ATOMIC_ACQUIRE) & RESULT_BANNER_PENDING) {
+                    int64_t index = scan_space_locate(space, result->addr, result->port);
+                    if (index >= 0) {
+                        (*deferred)[(*deferred_count)++] = (uint64_t)index;
+                    }
+                    continue;
+                }
+                results[n++] = *result;
             }
+            left -= take;
         }
     }
+    *total = n;
+    return results;
+}
 
-    free(tofree);
+// 保存检查点，pending为本次运行中尚未完成的工作序号区间（互不重叠）。
+// 横幅还在抓取的端口不保存结果，其探测也记为未完成，恢复时重新探测并抓取
+static int save_checkpoint(const char *path, const Checkpoint *ckpt, SequenceRange *pending,
+                           int pending_count, const long *states, long elapsed_ms,
+                           ResultStore *store, const ScanSpace *space,
+                           ThreadShard *shards, int thread_count) {
+    size_t count, deferred_count;
+    uint64_t *deferred;
+    ScanResult *results = collect_results(shards, thread_count, space, &count,
+                                          &deferred, &deferred_count);
+    SequenceRange *ranges = results ? malloc((pending_count + deferred_count) * sizeof(SequenceRange))
+                                    : NULL;
+    if (!ranges) {
+        free(results);
+        free(deferred);
+        return -1;
+    }
+    memcpy(ranges, pending, pending_count * sizeof(SequenceRange));
+    int range_count = pending_count;
+    for (size_t d = 0; d < deferred_count; d++) {
+        int64_t n = scan_work_offset(&ckpt->work, scan_space_unpermute(space, deferred[d]));
+        int covered = n < 0;
+        for (int r = 0; r < pending_count && !covered; r++) {
+            covered = (uint64_t)n >= pending[r].start && (uint64_t)n < pending[r].end;
+        }
+        if (!covered) {
+            ranges[range_count].start = (uint64_t)n;
+            ranges[range_count].end = (uint64_t)n + 1;
+            range_count++;
+        }
+    }
+    free(deferred);
+
+    Checkpoint saved = *ckpt;
+    int ret = -1;
+    if (scan_work_remaining(&ckpt->work, ranges, range_count, &saved.work) == 0) {
+        memcpy(saved.states, states, sizeof(saved.states));
+        saved.elapsed_ms = elapsed_ms;
+        ret = checkpoint_save(path, &saved, store, results, count);
+        scan_work_free(&saved.work);
+    }
+    free(ranges);
+    free(results);
+    return ret;
+}
+
+// 把检查点中的结果放回第一个线程的分片并标记端口状态，重新探测到的端口不会重复保存。
+// 有结果的状态按恢复的结果重新计数，其余状态沿用检查点的计数
+static int restore_results(const char *path, Checkpoint *ckpt, ResultStore *store,
+                           ThreadShard *shard) {
+    char results_path[PATH_MAX];
+    if (checkpoint_results_path(path, results_path, sizeof(results_path)) < 0) {
+        printf("错误: 路径过长\n");
+        return -1;
+    }
+    ResultFile *file = result_file_open(results_path);
+    if (!file) {
+        return -1;
+    }
 
-    // 重新分配内存到实际大小
-    if (*count > 0) {
-        int *temp = realloc(ports, *count * sizeof(int));
-        if (temp) {
-            ports = temp;
+    long found[PORT_STATE_COUNT] = {0};
+    int ret = 0;
+    for (uint32_t b = 0; b < result_file_blocks(file) && ret == 0; b++) {
+        ResultColumns cols;
+        if (result_file_read_block(file, b, &cols) < 0) {
+            ret = -1;
+            break;
         }
-    } else {
-        free(ports);
-        ports = NULL;
+        uint64_t rows = result_file_block_rows(file, b);
+        for (uint64_t i = 0; i < rows; i++) {
+            ResultRow row;
+            result_file_row(file, &cols, i, &row);
+            PortState state = (PortState)cols.state[i];
+            if (state >= PORT_STATE_COUNT ||
+                result_store_mark(store, row.addr, row.port, state) != 1) {
+                continue;
+            }
+
+            ScanResult *result = shard_alloc_result(shard);
+            if (!result) {
+                ret = -1;
+                break;
+            }
+            memset(result, 0, sizeof(*result));
+            result->addr = row.addr;
+            result->port = row.port;
+            result->protocol = cols.protocol[i];
+            result->state = state;
+            // 下标0为未知服务，不按名称登记
+            result->service = strcmp(row.service, service_name(0)) == 0 ? 0 : service_id_by_name(row.service);
+            result->response_time = row.response_time;
+            result->timestamp_us = row.timestamp_us;
+            result->hostname = result_store_intern(store, row.hostname, RESULT_HOSTNAME_MAX);
+            result->banner = result_store_intern(store, row.banner, RESULT_BANNER_MAX);
+            result->product = result_store_intern(store, row.product, RESULT_PRODUCT_MAX);
+            result->version = result_store_intern(store, row.version, RESULT_VERSION_MAX);
+            found[state]++;
+        }
+        result_columns_free(&cols);
+    }
+    result_file_close(file);
+    if (ret < 0) {
+        printf("错误: 读取检查点结果 %s 失败\n", results_path);
+        return -1;
     }
 
-    return ports;
+    ckpt->states[PORT_OPEN] = found[PORT_OPEN];
+    ckpt->states[PORT_OPEN_FILTERED] = found[PORT_OPEN_FILTERED];
+    ckpt->states[PORT_UNFILTERED] = found[PORT_UNFILTERED];
+    shard->scanned = 0;
+    for (int s = 0; s < PORT_STATE_COUNT; s++) {
+        shard->states[s] = ckpt->states[s];
+        shard->scanned += ckpt->states[s];
+    }
+    shard->published = shard->result_count;
+    return 0;
 }
 
 // 执行扫描
-int perform_scan(const char *target, const char *port_range,
-                 int thread_count, int timeout_ms, ScanType scan_type,
-                 int banner_grab, int verbose,
-                 ScanResult **results_ptr, int *result_count) {
+int perform_scan(const ScanOptions *opts, ResultStore **store_ptr) {
+    int thread_count = opts->thread_count;
+    int timeout_ms = opts->timeout_ms;
+    ScanType scan_type = opts->scan_type;
+    ScanEngine engine = opts->engine;
+    int window = opts->window;
+    int batch_size = opts->batch_size;
+    int batch_delay_us = opts->batch_delay_us;
+    int banner_grab = opts->banner_grab;
+    int verbose = opts->verbose;
+    int retries = opts->retries;
+    double max_rate = opts->max_rate > 0 ? opts->max_rate : 0;
+    double min_rate = opts->min_rate > 0 ? opts->min_rate : 0;
+
+    if (max_rate > 0 && min_rate > max_rate) {
+        printf("错误: --min-rate (%.0f) 不能大于 --max-rate (%.0f)\n", min_rate, max_rate);
+        return -1;
+    }
 
     if (thread_count < 1) thread_count = 1;
     if (thread_count > MAX_THREADS) thread_count = MAX_THREADS;
-    if (timeout_ms < 100) timeout_ms = 100;
-    if (timeout_ms > 10000) timeout_ms = 10000;
+    // 超时从初始值开始，按每个主机测得的RTT在上下界之间调整
+    int min_timeout_ms = opts->min_timeout_ms > 0 ? opts->min_timeout_ms : MIN_RTT_TIMEOUT;
+    int max_timeout_ms = opts->max_timeout_ms > 0 ? opts->max_timeout_ms : MAX_RTT_TIMEOUT;
+    if (max_timeout_ms < min_timeout_ms) max_timeout_ms = min_timeout_ms;
+    if (timeout_ms < min_timeout_ms) timeout_ms = min_timeout_ms;
+    if (timeout_ms > max_timeout_ms) timeout_ms = max_timeout_ms;
+
+    // 原始TCP和UDP扫描固定使用无状态引擎: 一个发送线程 + 一个接收线程
+    int raw_scan = is_raw_tcp_scan(scan_type);
+    if (raw_scan || scan_type == SCAN_UDP) {
+        engine = ENGINE_THREAD;
+        thread_count = 1;
+    }
+
+    if (retries < 0) retries = 0;
+    if (retries > MAX_RETRIES) retries = MAX_RETRIES;
+
+    if (batch_size < 1) batch_size = 1;
+    if (batch_size > MAX_TX_BATCH) batch_size = MAX_TX_BATCH;
+    if (batch_delay_us < 0) batch_delay_us = 0;
+
+    // 事件驱动引擎只支持TCP Connect扫描
+    if (engine != ENGINE_THREAD && scan_type != SCAN_TCP_CONNECT) {
+        printf("警告: %s引擎仅支持connect扫描，改用线程引擎\n",
+               (engine == ENGINE_URING) ? "io_uring" : "epoll");
+        engine = ENGINE_THREAD;
+    }
+
+    // 内核不支持io_uring时退回epoll
+    if (engine == ENGINE_URING && !uring_engine_available()) {
+        printf("警告: 当前内核不支持io_uring，改用epoll引擎\n");
+        engine = ENGINE_EPOLL;
+    }
+
+    // 事件驱动引擎: 少量事件循环线程，每个线程维持大量未完成的连接
+    if (engine != ENGINE_THREAD) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        if (cpus < 1) cpus = 1;
+        if (thread_count > cpus) thread_count = cpus;
+        if (thread_count > MAX_EVENT_THREADS) thread_count = MAX_EVENT_THREADS;
+
+        if (window < 1) window = DEFAULT_CONNECT_WINDOW;
+        if (window > MAX_CONNECT_WINDOW) window = MAX_CONNECT_WINDOW;
+        // 横幅阶段持有的连接另外预留
+        int banner_fds = opts->banner_grab ? BANNER_MAX_FDS : 0;
+        window = raise_fd_limit(window + banner_fds) - banner_fds;
+        if (window < 1) window = 1;
+        if (window < thread_count) thread_count = window;
+    } else if (opts->banner_grab) {
+        raise_fd_limit(thread_count + BANNER_MAX_FDS);
+    }
 
-    // 解析端口范围
-    int port_count = 0;
-    int *ports = parse_port_range(port_range, &port_count);
+    // 结果确定后立即写到流式输出；输出到标准输出时，之后的提示信息改到标准错误
+    ResultStream *stream = NULL;
+    if (opts->stream_path) {
+        size_t flush_bytes = opts->stream_flush_bytes > 0 ? opts->stream_flush_bytes : DEFAULT_STREAM_FLUSH;
+        int interval_ms = opts->stream_interval_ms > 0 ? opts->stream_interval_ms : DEFAULT_STREAM_INTERVAL;
+        stream = result_stream_open(opts->stream_path, flush_bytes, interval_ms);
+        if (!stream) {
+            return -1;
+        }
+    }
+
+    // 主机名在开始探测前统一解析，探测函数直接使用地址
+    if (dns_set_servers(opts->dns_servers) < 0) {
+        result_stream_close(stream);
+        return -1;
+    }
 
-    if (!ports || port_count == 0) {
-        printf("错误: 无效的端口范围\n");
+    // 解析目标和端口范围，探测顺序按需生成
+    ScanSpace space;
+    if (scan_space_init(&space, opts->targets, opts->target_file,
+                        opts->port_range, opts->randomize) < 0) {
+        result_stream_close(stream);
         return -1;
     }
 
-    // 解析目标地址
-    struct in_addr target_addr;
-    if (inet_pton(AF_INET, target, &target_addr) <= 0) {
-        struct hostent *host = gethostbyname(target);
-        if (!host) {
-            printf("错误: 无法解析目标地址 %s\n", target);
-            free(ports);
+    // 从检查点继续时沿用上次的探测顺序，只发出未完成的探测；
+    // 不使用检查点时也由它给出本次要发出的探测序号
+    Checkpoint ckpt;
+    const char *checkpoint_path = opts->checkpoint_path ? opts->checkpoint_path : opts->resume_path;
+    if (opts->resume_path) {
+        if (checkpoint_load(opts->resume_path, &ckpt) < 0) {
+            result_stream_close(stream);
+            scan_space_free(&space);
+            return -1;
+        }
+        if (checkpoint_check(&ckpt, opts, &space) < 0) {
+            checkpoint_free(&ckpt);
+            result_stream_close(stream);
+            scan_space_free(&space);
             return -1;
         }
-        memcpy(&target_addr, host->h_addr_list[0], sizeof(target_addr));
+        memcpy(space.keys, ckpt.keys, sizeof(space.keys));
+    } else {
+        // 调用方给出密钥和探测序号时，按它们的探测顺序只发出指定的探测
+        if (opts->keys) {
+            memcpy(space.keys, opts->keys, sizeof(space.keys));
+        }
+        if (checkpoint_init(&ckpt, opts, &space) < 0) {
+            result_stream_close(stream);
+            scan_space_free(&space);
+            return -1;
+        }
+        if (opts->work) {
+            scan_work_free(&ckpt.work);
+            if (scan_work_init(&ckpt.work, opts->work->ranges, opts->work->range_count) < 0) {
+                checkpoint_free(&ckpt);
+                result_stream_close(stream);
+                scan_space_free(&space);
+                return -1;
+            }
+        }
     }
 
-    printf("开始扫描 %s (%s)\n", target, inet_ntoa(target_addr));
-    printf("端口范围: %s (%d个端口)\n", port_range, port_count);
-    printf("线程数: %d, 超时: %dms, 扫描类型: ", thread_count, timeout_ms);
+    // 结果的字符串区和端口状态位图，随结果增长
+    ResultStore *store = result_store_create(&space);
+    if (!store) {
+        checkpoint_free(&ckpt);
+        result_stream_close(stream);
+        scan_space_free(&space);
+        return -1;
+    }
+
+    const char *target = opts->targets ? opts->targets : opts->target_file;
+    if (space.host_count == 1) {
+        struct in_addr target_addr = { .s_addr = htonl(space.hosts[0].start) };
+        printf("开始扫描 %s (%s)\n", target, inet_ntoa(target_addr));
+    } else {
+        printf("开始扫描 %s (%lu个主机)\n", target, (unsigned long)space.host_count);
+    }
+    printf("端口范围: %s (%lu个端口)\n", opts->port_range, (unsigned long)space.port_count);
+    if (opts->resume_path) {
+        printf("从检查点继续: 剩余 %lu/%lu 个探测\n",
+               (unsigned long)ckpt.work.total, (unsigned long)space.total);
+    } else if (opts->work) {
+        printf("本次探测: %lu/%lu 个\n", (unsigned long)ckpt.work.total, (unsigned long)space.total);
+    }
+    if (raw_scan || scan_type == SCAN_UDP) {
+        printf("引擎: 无状态%s (发送线程 + 接收线程), 批量发送: %d个/批",
+               raw_scan ? "原始TCP" : "UDP", batch_size);
+        if (batch_delay_us > 0) {
+            printf(", 批间隔: %dus", batch_delay_us);
+        }
+        printf("\n");
+    } else if (engine != ENGINE_THREAD) {
+        printf("引擎: %s, 事件线程: %d, 并发窗口: %d\n",
+               (engine == ENGINE_URING) ? "io_uring" : "epoll", thread_count, window);
+    }
+    if (max_rate > 0 || min_rate > 0) {
+        printf("发包速率: ");
+        if (min_rate > 0) printf("至少 %.0f pps ", min_rate);
+        if (max_rate > 0) printf("至多 %.0f pps", max_rate);
+        printf("\n");
+    }
+    printf("线程数: %d, 超时: %dms (按主机RTT自适应: %d-%dms), 重传: %d, 扫描类型: ",
+           thread_count, timeout_ms, min_timeout_ms, max_timeout_ms, retries);
 
     switch (scan_type) {
         case SCAN_TCP_CONNECT: printf("TCP Connect\n"); break;
         case SCAN_TCP_SYN: printf("TCP SYN\n"); break;
+        case SCAN_TCP_ACK: printf("TCP ACK\n"); break;
+        case SCAN_TCP_FIN: printf("TCP FIN\n"); break;
+        case SCAN_TCP_XMAS: printf("TCP XMAS\n"); break;
+        case SCAN_TCP_NULL: printf("TCP NULL\n"); break;
         case SCAN_UDP: printf("UDP\n"); break;
         default: printf("Unknown\n"); break;
     }
@@ -877,96 +1017,259 @@ int perform_scan(const char *target, const char *port_range,
     printf("横幅抓取: %s\n", banner_grab ? "启用" : "禁用");
     printf("========================================\n");
 
-    // 初始化结果数组
-    ScanResult *results = malloc(MAX_PORTS * sizeof(ScanResult));
-    int total_results = 0;
-
-    // 统计信息
-    int total_scanned = 0;
-    int open_ports = 0;
-    int closed_ports = 0;
-    int filtered_ports = 0;
+    // 每个线程一份统计和结果，扫描结束后合并
+    ThreadShard *shards = aligned_alloc(sizeof(ThreadShard), sizeof(ThreadShard) * thread_count);
+    if (shards) {
+        memset(shards, 0, sizeof(ThreadShard) * thread_count);
+    }
+    HostTable *hosts = host_table_create(timeout_ms, min_timeout_ms, max_timeout_ms);
+    // 所有线程共用一个令牌桶
+    Pacer *pacer = NULL;
+    if (max_rate > 0 || min_rate > 0) {
+        pacer = pacer_create(max_rate, min_rate);
+    }
+    // 横幅抓取在独立阶段进行，抓到后写回结果块
+    BannerStage *banners = NULL;
+    if (banner_grab) {
+        banners = banner_stage_create(timeout_ms, pacer, store, stream);
+    }
+    if (!shards || !hosts || ((max_rate > 0 || min_rate > 0) && !pacer) ||
+        (banner_grab && !banners) ||
+        (opts->resume_path && restore_results(opts->resume_path, &ckpt, store, &shards[0]) < 0)) {
+        banner_stage_finish(banners);
+        result_stream_close(stream);
+        result_store_free(store);
+        free(shards);
+        host_table_destroy(hosts);
+        pacer_destroy(pacer);
+        checkpoint_free(&ckpt);
+        scan_space_free(&space);
+        return -1;
+    }
 
     // 线程管理
     pthread_t threads[thread_count];
     ThreadParams thread_params[thread_count];
-    int current_index = 0;
+    ScanWorker workers[thread_count];
+    uint64_t next_sequence = 0;
+    ScanDone finished;
+    scan_done_init(&finished);
 
-    pthread_mutex_t index_mutex = PTHREAD_MUTEX_INITIALIZER;
-    pthread_mutex_t result_mutex = PTHREAD_MUTEX_INITIALIZER;
+    // 探测序号按块领取；扫描空间较小时缩小块，使每个线程都能分到探测
+    uint64_t per_thread = ckpt.work.total / ((uint64_t)thread_count * 16);
+    int work_chunk = per_thread >= WORK_CHUNK ? WORK_CHUNK : (per_thread > 0 ? (int)per_thread : 1);
 
     // 设置扫描状态
     scan_running = 1;
+    scan_interrupted = 0;
     gettimeofday(&scan_start_time, NULL);
 
+    // 保存检查点时，中断信号只停止发出新的探测，进行中的探测结束后保存最终的检查点
+    struct sigaction old_actions[3];
+    const int stop_signals[3] = { SIGINT, SIGTERM, SIGHUP };
+    if (checkpoint_path) {
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = stop_scan_handler;
+        sigemptyset(&action.sa_mask);
+        for (int i = 0; i < 3; i++) {
+            sigaction(stop_signals[i], &action, &old_actions[i]);
+        }
+    }
+
     // 创建线程
     for (int i = 0; i < thread_count; i++) {
-        thread_params[i].target = strdup(target);
-        thread_params[i].target_addr = target_addr;
-        thread_params[i].ports_to_scan = ports;
-        thread_params[i].port_count = port_count;
-        thread_params[i].start_port = ports[0];
-        thread_params[i].end_port = ports[port_count - 1];
+        thread_params[i].space = &space;
+        thread_params[i].work = &ckpt.work;
+        thread_params[i].hosts = hosts;
+        thread_params[i].pacer = pacer;
+        thread_params[i].banners = banners;
+        thread_params[i].stream = stream;
+        thread_params[i].store = store;
         thread_params[i].timeout_ms = timeout_ms;
+        thread_params[i].retries = retries;
         thread_params[i].scan_type = scan_type;
         thread_params[i].thread_id = i;
-        thread_params[i].current_index = &current_index;
-        thread_params[i].index_mutex = &index_mutex;
-        thread_params[i].results = results;
-        thread_params[i].result_count = &total_results;
-        thread_params[i].result_mutex = &result_mutex;
-        thread_params[i].total_scanned = &total_scanned;
-        thread_params[i].open_ports = &open_ports;
-        thread_params[i].closed_ports = &closed_ports;
-        thread_params[i].filtered_ports = &filtered_ports;
+        thread_params[i].next_sequence = &next_sequence;
+        thread_params[i].chunk_next = 0;
+        thread_params[i].chunk_end = 0;
+        thread_params[i].work_chunk = work_chunk;
+        thread_params[i].shard = &shards[i];
         thread_params[i].banner_grab = banner_grab;
         thread_params[i].verbose = verbose;
+        // 并发窗口平均分配给各事件线程
+        thread_params[i].window = window / thread_count + (i < window % thread_count ? 1 : 0);
+        thread_params[i].batch_size = batch_size;
+        thread_params[i].batch_delay_us = batch_delay_us;
+
+        void *(*thread_func)(void *) = scan_thread_func;
+        if (raw_scan) {
+            thread_func = raw_scan_thread_func;
+        } else if (scan_type == SCAN_UDP) {
+            thread_func = udp_scan_thread_func;
+        } else if (engine == ENGINE_EPOLL) {
+            thread_func = epoll_connect_thread_func;
+        } else if (engine == ENGINE_URING) {
+            thread_func = uring_connect_thread_func;
+        }
 
-        pthread_create(&threads[i], NULL, scan_thread_func, &thread_params[i]);
+        workers[i].func = thread_func;
+        workers[i].params = &thread_params[i];
+        workers[i].done = &finished;
+        pthread_create(&threads[i], NULL, scan_worker, &workers[i]);
     }
 
     // 显示进度
     struct timeval last_update;
     gettimeofday(&last_update, NULL);
+    struct timeval last_checkpoint = last_update;
+
+    // 定期检查点只把足够早领取的序号记为完成: 领取后的探测最长经过
+    // max_timeout × (重传次数 + 1) 结束，线程引擎逐个完成一块中的探测。
+    // 无状态引擎在扫描结束时才记录无响应的探测，定期检查点只保存结果，不推进进度
+    int checkpoint_interval = opts->checkpoint_interval > 0 ? opts->checkpoint_interval
+                                                            : DEFAULT_CHECKPOINT_INTERVAL;
+    long probe_lifetime_ms = (long)max_timeout_ms * (retries + 1) + 1000;
+    if (engine == ENGINE_THREAD) {
+        probe_lifetime_ms *= work_chunk;
+    }
+    int sample_capacity = (int)(probe_lifetime_ms / 1000) + 2;
+    ProgressSample *samples = NULL;
+    int sample_count = 0;
+    if (checkpoint_path && !raw_scan && scan_type != SCAN_UDP) {
+        samples = malloc(sample_capacity * sizeof(ProgressSample));
+    }
 
-    while (scan_running) {
-        sleep(1);
+    // 序号领取完后各线程还要发完已领取的块，所有线程结束才算完成
+    while (scan_done_wait(&finished, thread_count, 1000) < thread_count) {
 
         struct timeval now;
         gettimeofday(&now, NULL);
 
+        long now_ms = now.tv_sec * 1000L + now.tv_usec / 1000;
+        if (samples) {
+            ProgressSample *sample = &samples[sample_count++ % sample_capacity];
+            sample->time_ms = now_ms;
+            sample->next = __atomic_load_n(&next_sequence, __ATOMIC_RELAXED);
+            if (sample->next > ckpt.work.total) {
+                sample->next = ckpt.work.total;
+            }
+            sum_states(shards, thread_count, sample->states);
+        }
+
+        if (checkpoint_path && scan_running &&
+            now.tv_sec - last_checkpoint.tv_sec >= checkpoint_interval) {
+            // 还没有足够早的样本时，本次运行的探测都记为未完成
+            SequenceRange pending = { .start = 0, .end = ckpt.work.total };
+            long states[PORT_STATE_COUNT];
+            memcpy(states, ckpt.states, sizeof(states));
+            const ProgressSample *done = completed_sample(samples, sample_count, sample_capacity,
+                                                         now_ms - probe_lifetime_ms);
+            if (done) {
+                pending.start = done->next;
+                memcpy(states, done->states, sizeof(states));
+            }
+            save_checkpoint(checkpoint_path, &ckpt, &pending, 1, states,
+                            ckpt.elapsed_ms + elapsed_since(&scan_start_time),
+                            store, &space, shards, thread_count);
+            last_checkpoint = now;
+        }
+
         // 每2秒更新一次进度
         if ((now.tv_sec - last_update.tv_sec) >= 2) {
-            pthread_mutex_lock(&result_mutex);
-            int scanned = total_scanned;
-            int open = open_ports;
-            pthread_mutex_unlock(&result_mutex);
-
-            float progress = (float)scanned / port_count * 100;
-            printf("进度: %d/%d (%.1f%%) - 开放端口: %d\r",
-                   scanned, port_count, progress, open);
+            long scanned = 0;
+            long open = 0;
+            for (int i = 0; i < thread_count; i++) {
+                scanned += __atomic_load_n(&shards[i].scanned, __ATOMIC_RELAXED);
+                open += __atomic_load_n(&shards[i].states[PORT_OPEN], __ATOMIC_RELAXED);
+            }
+
+            float progress = (float)scanned / space.total * 100;
+            printf("进度: %ld/%lu (%.1f%%) - 开放端口: %ld\r",
+                   scanned, (unsigned long)space.total, progress, open);
             fflush(stdout);
 
             last_update = now;
         }
+    }
+    free(samples);
 
-        // 检查是否完成
-        pthread_mutex_lock(&index_mutex);
-        if (current_index >= port_count) {
-            scan_running = 0;
-        }
-        pthread_mutex_unlock(&index_mutex);
+    if (scan_interrupted) {
+        printf("\n收到中断信号，等待进行中的探测结束...");
+        fflush(stdout);
     }
 
     // 等待所有线程完成
     for (int i = 0; i < thread_count; i++) {
         pthread_join(threads[i], NULL);
-        free(thread_params[i].target);
+    }
+    scan_running = 0;
+    scan_done_destroy(&finished);
+
+    // 等待横幅抓取阶段处理完剩余的开放端口
+    if (banners) {
+        size_t pending = banner_stage_pending(banners);
+        if (pending > 0) {
+            printf("\n等待 %zu 个端口的横幅...", pending);
+            fflush(stdout);
+        }
+        unsigned long grabbed = banner_stage_finish(banners);
+        if (verbose) {
+            printf("\n抓取到 %lu 个横幅", grabbed);
+        }
     }
 
-    // 清理互斥锁
-    pthread_mutex_destroy(&index_mutex);
-    pthread_mutex_destroy(&result_mutex);
+    // 合并各线程的统计和结果
+    long states[PORT_STATE_COUNT];
+    sum_states(shards, thread_count, states);
+    if (opts->latency) {
+        for (int i = 0; i < thread_count; i++) {
+            for (int b = 0; b < LATENCY_BUCKETS; b++) {
+                opts->latency[b] += shards[i].latency[b];
+            }
+        }
+    }
+
+    // 线程都已退出，领取而未发出的序号是准确的: 各线程块中剩余的部分和从未领取的部分
+    int checkpoint_saved = 0;
+    if (checkpoint_path) {
+        SequenceRange pending[thread_count + 1];
+        int pending_count = 0;
+        for (int i = 0; i < thread_count; i++) {
+            if (thread_params[i].chunk_next < thread_params[i].chunk_end) {
+                pending[pending_count].start = thread_params[i].chunk_next;
+                pending[pending_count].end = thread_params[i].chunk_end;
+                pending_count++;
+            }
+        }
+        pending[pending_count].start = next_sequence < ckpt.work.total ? next_sequence : ckpt.work.total;
+        pending[pending_count].end = ckpt.work.total;
+        pending_count++;
+        checkpoint_saved = save_checkpoint(checkpoint_path, &ckpt, pending, pending_count, states,
+                                           ckpt.elapsed_ms + elapsed_since(&scan_start_time),
+                                           store, &space, shards, thread_count) == 0;
+        for (int i = 0; i < 3; i++) {
+            sigaction(stop_signals[i], &old_actions[i], NULL);
+        }
+    }
+    long open_ports = states[PORT_OPEN];
+    long closed_ports = states[PORT_CLOSED];
+    long filtered_ports = states[PORT_FILTERED];
+    long open_filtered_ports = states[PORT_OPEN_FILTERED];
+    long unfiltered_ports = states[PORT_UNFILTERED];
+
+    // 探测顺序是随机的，结果按主机和端口排序
+    int merged = result_store_finish(store, shards, thread_count);
+    free(shards);
+    if (merged < 0) {
+        result_stream_close(stream);
+        result_store_free(store);
+        host_table_destroy(hosts);
+        pacer_destroy(pacer);
+        checkpoint_free(&ckpt);
+        scan_space_free(&space);
+        return -1;
+    }
 
     // 计算扫描时间
     struct timeval scan_end_time;
@@ -974,170 +1277,392 @@ int perform_scan(const char *target, const char *port_range,
     long scan_time = (scan_end_time.tv_sec - scan_start_time.tv_sec) * 1000 +
     (scan_end_time.tv_usec - scan_start_time.tv_usec) / 1000;
 
-    printf("\n\n扫描完成!\n");
-    printf("扫描时间: %.2f秒\n", scan_time / 1000.0);
-    printf("统计: 开放=%d, 关闭=%d, 过滤=%d\n",
+    printf("\n\n%s\n", scan_interrupted ? "扫描已中断!" : "扫描完成!");
+    if (opts->resume_path) {
+        printf("扫描时间: %.2f秒 (累计 %.2f秒)\n", scan_time / 1000.0,
+               (scan_time + ckpt.elapsed_ms) / 1000.0);
+    } else {
+        printf("扫描时间: %.2f秒\n", scan_time / 1000.0);
+    }
+    if (checkpoint_saved && scan_interrupted) {
+        printf("检查点已保存到 %s，使用 --resume %s 继续扫描\n", checkpoint_path, checkpoint_path);
+    }
+    printf("统计: 开放=%ld, 关闭=%ld, 过滤=%ld",
            open_ports, closed_ports, filtered_ports);
+    if (open_filtered_ports > 0) {
+        printf(", 开放|过滤=%ld", open_filtered_ports);
+    }
+    if (unfiltered_ports > 0) {
+        printf(", 未过滤=%ld", unfiltered_ports);
+    }
+    printf("\n");
+    if (pacer) {
+        double rate = pacer_rate(pacer);
+        printf("发包: %lu个, 平均 %.0f pps\n", pacer_sent(pacer), rate);
+        if (min_rate > 0 && rate < min_rate) {
+            printf("警告: 平均发包速率低于 --min-rate %.0f pps，可增加线程数或并发窗口\n", min_rate);
+        }
+    }
 
-    // 返回结果
-    *results_ptr = results;
-    *result_count = total_results;
+    size_t total_results;
+    ScanResult *results = result_store_results(store, &total_results);
+    if (opts->reverse_dns) {
+        reverse_resolve_results(store, results, total_results);
+    }
+    if (verbose) {
+        printf("结果存储: %zu个结果, %.1f KB\n", total_results,
+               result_store_memory(store) / 1024.0);
+    }
+    *store_ptr = store;
 
-    free(ports);
+    // 标准输出在关闭流之后才恢复，扫描摘要不会混入结果流
+    if (stream) {
+        unsigned long streamed = result_stream_close(stream);
+        if (verbose) {
+            printf("流式输出 %lu 个结果到 %s\n", streamed, opts->stream_path);
+        }
+    }
+
+    host_table_destroy(hosts);
+    pacer_destroy(pacer);
+    checkpoint_free(&ckpt);
+    scan_space_free(&space);
     return 0;
                  }
 
+                 // 主机显示为"地址"或"地址 (主机名)"
+                 static const char* format_host(const ResultRow *row, char *buf, size_t size) {
+                     char addr[INET_ADDRSTRLEN];
+                     inet_ntop(AF_INET, &row->addr, addr, sizeof(addr));
+                     if (row->hostname[0]) {
+                         snprintf(buf, size, "%s (%s)", addr, row->hostname);
+                     } else {
+                         snprintf(buf, size, "%s", addr);
+                     }
+                     return buf;
+                 }
+
+                 // 版本显示为"产品 版本"，未识别时为空
+                 static const char* format_version(const ResultRow *row, char *buf, size_t size) {
+                     if (row->product[0] && row->version[0]) {
+                         snprintf(buf, size, "%s %s", row->product, row->version);
+                     } else {
+                         snprintf(buf, size, "%s", row->product);
+                     }
+                     return buf;
+                 }
+
                  // 显示扫描结果
-                 void display_results(ScanResult *results, int count, int show_banner) {
+                 void display_results(ResultStore *store, int show_banner) {
+                     size_t count;
+                     ScanResult *results = result_store_results(store, &count);
                      if (count == 0) {
                          printf("未发现开放端口\n");
                          return;
                      }
 
-                     printf("\n扫描结果 (%d个开放端口):\n", count);
+                     printf("\n扫描结果 (%zu个开放端口):\n", count);
                      printf("================================================================================\n");
                      if (show_banner) {
-                         printf("%-8s %-8s %-10s %-20s %-8s %s\n",
-                                "端口", "协议", "状态", "服务", "响应时间", "横幅");
-                         printf("%-8s %-8s %-10s %-20s %-8s %s\n",
-                                "----", "----", "----", "----", "--------", "------");
-
-                         for (int i = 0; i < count; i++) {
-                             printf("%-8d %-8s %-10s %-20s %-8ldms %s\n",
-                                    results[i].port,
-                                    results[i].protocol,
-                                    results[i].state,
-                                    results[i].service,
-                                    results[i].response_time,
-                                    results[i].banner[0] ? results[i].banner : "");
-                         }
+                         printf("%-16s %-8s %-8s %-10s %-20s %-8s %-24s %s\n",
+                                "主机", "端口", "协议", "状态", "服务", "响应时间", "版本", "横幅");
+                         printf("%-16s %-8s %-8s %-10s %-20s %-8s %-24s %s\n",
+                                "----", "----", "----", "----", "----", "--------", "----", "------");
                      } else {
-                         printf("%-8s %-8s %-10s %-20s %-8s\n",
-                                "端口", "协议", "状态", "服务", "响应时间");
-                         printf("%-8s %-8s %-10s %-20s %-8s\n",
-                                "----", "----", "----", "----", "--------");
-
-                         for (int i = 0; i < count; i++) {
-                             printf("%-8d %-8s %-10s %-20s %-8ldms\n",
-                                    results[i].port,
-                                    results[i].protocol,
-                                    results[i].state,
-                                    results[i].service,
-                                    results[i].response_time);
+                         printf("%-16s %-8s %-8s %-10s %-20s %-8s\n",
+                                "主机", "端口", "协议", "状态", "服务", "响应时间");
+                         printf("%-16s %-8s %-8s %-10s %-20s %-8s\n",
+                                "----", "----", "----", "----", "----", "--------");
+                     }
+
+                     for (size_t i = 0; i < count; i++) {
+                         ResultRow row;
+                         char host[128];
+                         result_store_row(store, &results[i], &row);
+                         format_host(&row, host, sizeof(host));
+                         if (show_banner) {
+                             char version[128];
+                             printf("%-16s %-8d %-8s %-10s %-20s %-8ldms %-24s %s\n",
+                                    host, row.port, row.protocol, row.state, row.service, row.response_time,
+                                    format_version(&row, version, sizeof(version)), row.banner);
+                         } else {
+                             printf("%-16s %-8d %-8s %-10s %-20s %-8ldms\n",
+                                    host, row.port, row.protocol, row.state, row.service, row.response_time);
                          }
                      }
                  }
 
-                 // 保存结果到文件
-                 void save_results(const char *filename, const char *format,
-                                   ScanResult *results, int count, const char *target) {
+                 // 按txt、csv或json格式逐行写出结果，扫描结果、结果文件导出和查询共用
+                 typedef struct {
+                     FILE *fp;
+                     const char *format;
+                     size_t rows;
+                 } ResultOutput;
 
-                     if (count == 0) {
-                         printf("没有结果可保存\n");
-                         return;
-                     }
-
-                     FILE *fp = fopen(filename, "w");
-                     if (!fp) {
-                         printf("错误: 无法创建文件 %s\n", filename);
-                         return;
-                     }
+                 static void output_begin(ResultOutput *out, FILE *fp, const char *format,
+                                          const char *target, time_t scan_time, size_t count) {
+                     out->fp = fp;
+                     out->format = format;
+                     out->rows = 0;
 
-                     time_t now = time(NULL);
-                     struct tm *tm_info = localtime(&now);
+                     struct tm *tm_info = localtime(&scan_time);
                      char time_str[64];
                      strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
 
                      if (strcmp(format, "json") == 0) {
+                         char target_escaped[1024];
+                         json_escape(target ? target : "", target_escaped, sizeof(target_escaped));
                          fprintf(fp, "{\n");
                          fprintf(fp, "  \"scan_info\": {\n");
-                         fprintf(fp, "    \"target\": \"%s\",\n", target);
+                         fprintf(fp, "    \"target\": \"%s\",\n", target_escaped);
                          fprintf(fp, "    \"scan_time\": \"%s\",\n", time_str);
-                         fprintf(fp, "    \"open_ports\": %d\n", count);
+                         fprintf(fp, "    \"open_ports\": %zu\n", count);
                          fprintf(fp, "  },\n");
                          fprintf(fp, "  \"results\": [\n");
-
-                         for (int i = 0; i < count; i++) {
-                             fprintf(fp, "    {\n");
-                             fprintf(fp, "      \"port\": %d,\n", results[i].port);
-                             fprintf(fp, "      \"protocol\": \"%s\",\n", results[i].protocol);
-                             fprintf(fp, "      \"state\": \"%s\",\n", results[i].state);
-                             fprintf(fp, "      \"service\": \"%s\",\n", results[i].service);
-                             fprintf(fp, "      \"response_time\": %ld,\n", results[i].response_time);
-                             fprintf(fp, "      \"banner\": \"%s\"\n", results[i].banner);
-
-                             if (i < count - 1) {
-                                 fprintf(fp, "    },\n");
-                             } else {
-                                 fprintf(fp, "    }\n");
-                             }
-                         }
-
-                         fprintf(fp, "  ]\n");
-                         fprintf(fp, "}\n");
                      } else if (strcmp(format, "csv") == 0) {
-                         fprintf(fp, "Port,Protocol,State,Service,Response_Time,Banner\n");
-                         for (int i = 0; i < count; i++) {
-                             // 转义引号
-                             char escaped_banner[512];
-                             char *src = results[i].banner;
-                             char *dst = escaped_banner;
-                             while (*src && (dst - escaped_banner) < 510) {
-                                 if (*src == '"') {
-                                     *dst++ = '"';
-                                     *dst++ = '"';
-                                 } else {
-                                     *dst++ = *src;
-                                 }
-                                 src++;
-                             }
-                             *dst = '\0';
-
-                             fprintf(fp, "%d,%s,%s,%s,%ld,\"%s\"\n",
-                                     results[i].port,
-                                     results[i].protocol,
-                                     results[i].state,
-                                     results[i].service,
-                                     results[i].response_time,
-                                     escaped_banner);
-                         }
+                         fprintf(fp, "Host,Hostname,Port,Protocol,State,Service,Product,Version,Response_Time,Banner,Timestamp\n");
                      } else {
                          // 纯文本格式
                          fprintf(fp, "端口扫描结果\n");
-                         fprintf(fp, "目标: %s\n", target);
+                         fprintf(fp, "目标: %s\n", target ? target : "");
                          fprintf(fp, "扫描时间: %s\n", time_str);
-                         fprintf(fp, "开放端口: %d\n\n", count);
-
-                         for (int i = 0; i < count; i++) {
-                             fprintf(fp, "端口 %d (%s):\n", results[i].port, results[i].protocol);
-                             fprintf(fp, "  状态: %s\n", results[i].state);
-                             fprintf(fp, "  服务: %s\n", results[i].service);
-                             fprintf(fp, "  响应时间: %ldms\n", results[i].response_time);
-                             if (results[i].banner[0]) {
-                                 fprintf(fp, "  横幅: %s\n", results[i].banner);
-                             }
-                             fprintf(fp, "\n");
+                         fprintf(fp, "开放端口: %zu\n\n", count);
+                     }
+                 }
+
+                 // CSV字段中的引号写两次
+                 static const char* csv_escape(const char *src, char *dst, size_t size) {
+                     size_t n = 0;
+                     for (; *src && n + 2 < size; src++) {
+                         if (*src == '"') {
+                             dst[n++] = '"';
                          }
+                         dst[n++] = *src;
+                     }
+                     dst[n] = '\0';
+                     return dst;
+                 }
+
+                 static void output_row(ResultOutput *out, const ResultRow *row) {
+                     FILE *fp = out->fp;
+                     char addr[INET_ADDRSTRLEN];
+                     inet_ntop(AF_INET, &row->addr, addr, sizeof(addr));
+                     long seconds = (long)(row->timestamp_us / 1000000);
+                     long micros = (long)(row->timestamp_us % 1000000);
+
+                     if (strcmp(out->format, "json") == 0) {
+                         char hostname[RESULT_HOSTNAME_MAX * 6];
+                         char service[32 * 6];
+                         char product[RESULT_PRODUCT_MAX * 6];
+                         char version[RESULT_VERSION_MAX * 6];
+                         char banner[RESULT_BANNER_MAX * 6];
+                         json_escape(row->hostname, hostname, sizeof(hostname));
+                         json_escape(row->service, service, sizeof(service));
+                         json_escape(row->product, product, sizeof(product));
+                         json_escape(row->version, version, sizeof(version));
+                         json_escape(row->banner, banner, sizeof(banner));
+
+                         if (out->rows > 0) {
+                             fprintf(fp, ",\n");
+                         }
+                         fprintf(fp, "    {\n");
+                         fprintf(fp, "      \"host\": \"%s\",\n", addr);
+                         fprintf(fp, "      \"hostname\": \"%s\",\n", hostname);
+                         fprintf(fp, "      \"port\": %d,\n", row->port);
+                         fprintf(fp, "      \"protocol\": \"%s\",\n", row->protocol);
+                         fprintf(fp, "      \"state\": \"%s\",\n", row->state);
+                         fprintf(fp, "      \"service\": \"%s\",\n", service);
+                         fprintf(fp, "      \"product\": \"%s\",\n", product);
+                         fprintf(fp, "      \"version\": \"%s\",\n", version);
+                         fprintf(fp, "      \"response_time\": %ld,\n", row->response_time);
+                         fprintf(fp, "      \"banner\": \"%s\",\n", banner);
+                         fprintf(fp, "      \"timestamp\": %ld.%06ld\n", seconds, micros);
+                         fprintf(fp, "    }");
+                     } else if (strcmp(out->format, "csv") == 0) {
+                         // 转义引号
+                         char product[RESULT_PRODUCT_MAX * 2];
+                         char version[RESULT_VERSION_MAX * 2];
+                         char banner[RESULT_BANNER_MAX * 2];
+                         fprintf(fp, "%s,%s,%d,%s,%s,%s,\"%s\",\"%s\",%ld,\"%s\",%ld.%06ld\n",
+                                 addr, row->hostname, row->port, row->protocol, row->state, row->service,
+                                 csv_escape(row->product, product, sizeof(product)),
+                                 csv_escape(row->version, version, sizeof(version)),
+                                 row->response_time,
+                                 csv_escape(row->banner, banner, sizeof(banner)),
+                                 seconds, micros);
+                     } else {
+                         char host[128];
+                         fprintf(fp, "%s 端口 %d (%s):\n", format_host(row, host, sizeof(host)),
+                                 row->port, row->protocol);
+                         fprintf(fp, "  状态: %s\n", row->state);
+                         fprintf(fp, "  服务: %s\n", row->service);
+                         if (row->product[0]) {
+                             char version[128];
+                             fprintf(fp, "  版本: %s\n", format_version(row, version, sizeof(version)));
+                         }
+                         fprintf(fp, "  响应时间: %ldms\n", row->response_time);
+                         if (row->banner[0]) {
+                             fprintf(fp, "  横幅: %s\n", row->banner);
+                         }
+                         fprintf(fp, "\n");
+                     }
+                     out->rows++;
+                 }
+
+                 static void output_end(ResultOutput *out) {
+                     if (strcmp(out->format, "json") == 0) {
+                         fprintf(out->fp, "%s  ]\n", out->rows > 0 ? "\n" : "");
+                         fprintf(out->fp, "}\n");
+                     }
+                 }
+
+                 // 保存结果到文件，bin为二进制结果文件，compress为真时压缩其中的列
+                 void save_results(const char *filename, const char *format,
+                                   ResultStore *store, const char *target, int compress) {
+                     size_t count;
+                     ScanResult *results = result_store_results(store, &count);
+
+                     if (count == 0) {
+                         printf("没有结果可保存\n");
+                         return;
+                     }
+
+                     if (strcmp(format, "bin") == 0) {
+                         ResultFileWriter *writer = result_file_create(filename, store, target, time(NULL), compress);
+                         if (!writer) {
+                             return;
+                         }
+                         int ret = result_file_append(writer, results, count);
+                         if (result_file_finish(writer) < 0 || ret < 0) {
+                             printf("错误: 写入文件 %s 失败\n", filename);
+                             return;
+                         }
+                         printf("结果已保存到: %s (格式: bin%s)\n", filename, compress ? ", 压缩" : "");
+                         return;
                      }
 
+                     FILE *fp = fopen(filename, "w");
+                     if (!fp) {
+                         printf("错误: 无法创建文件 %s\n", filename);
+                         return;
+                     }
+
+                     ResultOutput out;
+                     output_begin(&out, fp, format, target, time(NULL), count);
+                     for (size_t i = 0; i < count; i++) {
+                         ResultRow row;
+                         result_store_row(store, &results[i], &row);
+                         output_row(&out, &row);
+                     }
+                     output_end(&out);
+
                      fclose(fp);
                      printf("结果已保存到: %s (格式: %s)\n", filename, format);
-                                   }
+                 }
+
+                 // 把二进制结果文件转换为txt、csv或json，output为NULL时写到标准输出
+                 static int export_results(const char *input, const char *output, const char *format) {
+                     ResultFile *file = result_file_open(input);
+                     if (!file) {
+                         return -1;
+                     }
+
+                     FILE *fp = output ? fopen(output, "w") : stdout;
+                     if (!fp) {
+                         printf("错误: 无法创建文件 %s\n", output);
+                         result_file_close(file);
+                         return -1;
+                     }
+
+                     ResultOutput out;
+                     output_begin(&out, fp, format, result_file_target(file), result_file_time(file),
+                                  (size_t)result_file_rows(file));
+
+                     int ret = 0;
+                     for (uint32_t b = 0; b < result_file_blocks(file); b++) {
+                         ResultColumns cols;
+                         if (result_file_read_block(file, b, &cols) < 0) {
+                             fprintf(stderr, "错误: %s 的第%u块已损坏\n", input, b);
+                             ret = -1;
+                             break;
+                         }
+                         for (size_t i = 0; i < cols.rows; i++) {
+                             ResultRow row;
+                             result_file_row(file, &cols, i, &row);
+                             output_row(&out, &row);
+                         }
+                         result_columns_free(&cols);
+                     }
+                     output_end(&out);
+
+                     if (output) {
+                         fclose(fp);
+                         if (ret == 0) {
+                             printf("已导出 %lu 个结果到: %s (格式: %s)\n",
+                                    (unsigned long)result_file_rows(file), output, format);
+                         }
+                     }
+                     result_file_close(file);
+                     return ret;
+                 }
+
+                 // 按条件查询二进制结果文件，以txt、csv或json输出
+                 static int query_results(const char *input, const ResultQuery *query,
+                                          const char *output, const char *format) {
+                     ResultFile *file = result_file_open(input);
+                     if (!file) {
+                         return -1;
+                     }
+
+                     ResultRow *rows = NULL;
+                     size_t count = 0;
+                     if (result_query_run(input, file, query, &rows, &count) < 0) {
+                         result_file_close(file);
+                         return -1;
+                     }
+
+                     FILE *fp = output ? fopen(output, "w") : stdout;
+                     if (!fp) {
+                         printf("错误: 无法创建文件 %s\n", output);
+                         free(rows);
+                         result_file_close(file);
+                         return -1;
+                     }
+
+                     ResultOutput out;
+                     output_begin(&out, fp, format, result_file_target(file), result_file_time(file), count);
+                     for (size_t i = 0; i < count; i++) {
+                         output_row(&out, &rows[i]);
+                     }
+                     output_end(&out);
+
+                     if (output) {
+                         fclose(fp);
+                         printf("查询到 %zu 个结果，已保存到: %s (格式: %s)\n", count, output, format);
+                     }
+                     free(rows);
+                     result_file_close(file);
+                     return 0;
+                 }
 
                                    // 插件初始化
+                                   // 初始化和清理的提示写到标准错误: 命令可能把NDJSON结果写到标准输出
                                    int port_scanner_init(void) {
-                                       printf("端口扫描器初始化...\n");
-                                       init_service_database();
+                                       fprintf(stderr, "端口扫描器初始化...\n");
+                                       if (service_table_load() < 0) {
+                                           fprintf(stderr, "警告: 服务名称表加载失败\n");
+                                       }
+                                       if (fingerprint_load() < 0) {
+                                           fprintf(stderr, "警告: 版本识别规则加载失败\n");
+                                       }
                                        return 0;
                                    }
 
                                    // 插件清理
                                    void port_scanner_cleanup(void) {
-                                       if (service_db) {
-                                           free(service_db);
-                                           service_db = NULL;
-                                       }
-                                       printf("端口扫描器清理完成\n");
+                                       service_table_free();
+                                       fingerprint_free();
+                                       fprintf(stderr, "端口扫描器清理完成\n");
                                    }
 
                                    // 执行命令
@@ -1145,59 +1670,175 @@ int perform_scan(const char *target, const char *port_range,
                                        if (argc < 2) {
                                            printf("用法: port-scanner <命令> [参数]\n");
                                            printf("命令:\n");
-                                           printf("  scan <目标> [选项]         执行端口扫描\n");
+                                           printf("  scan <目标> [选项]         执行端口扫描 (目标可为地址、主机名、CIDR、地址范围，逗号分隔)\n");
+                                           printf("  export <结果文件> [-f txt|csv|json] [-o 文件]  把bin格式的结果文件转换为其他格式 (默认: json，输出到标准输出)\n");
+                                           printf("  query <结果文件> [条件]    按索引查询bin格式的结果文件，首次查询时建立<结果文件>.idx\n");
+                                           printf("  monitor [目标] --baseline <结果文件> [选项]  以上次结果为基线持续监控，只输出变化 (NDJSON)\n");
                                            printf("  help                       显示详细帮助\n");
+                                           printf("\n监控选项 (另可使用扫描选项):\n");
+                                           printf("  --baseline <文件>         基线结果文件(bin)，不存在时第一轮扫描整个空间建立基线\n");
+                                           printf("  --rotation <轮数>         已知开放端口每轮重扫，其余空间每多少轮扫完一遍 (默认: %d)\n", MONITOR_DEFAULT_ROTATION);
+                                           printf("  --cycles <轮数>           监控的轮数，0表示一直运行 (默认: 1)\n");
+                                           printf("  --interval <秒>           两轮之间的间隔 (默认: %d)\n", MONITOR_DEFAULT_INTERVAL);
+                                           printf("  --no-update               不更新基线\n");
+                                           printf("  -o <文件>                 变化输出到文件 (默认: 标准输出)\n");
+                                           printf("\n查询条件:\n");
+                                           printf("  -p, --ports <范围>        端口，格式同扫描\n");
+                                           printf("  --host <目标>             地址、CIDR或地址范围\n");
+                                           printf("  --service <名称>          服务名称\n");
+                                           printf("  --banner <通配符>         横幅或\"产品 版本\"包含匹配的内容，如 'OpenSSH 7.*'\n");
+                                           printf("  --state <状态>            open, open|filtered, unfiltered\n");
+                                           printf("  --protocol <协议>         tcp, udp\n");
+                                           printf("  --sort <字段>             host, port, service, rtt, time (默认: host)\n");
+                                           printf("  --reverse                 降序\n");
+                                           printf("  --limit <数量>            最多输出的结果数\n");
+                                           printf("  --rebuild-index           重建索引\n");
+                                           printf("  -f, -o                    输出格式 (txt, csv, json) 和输出文件，默认输出到标准输出\n");
                                            printf("\n扫描选项:\n");
-                                           printf("  -p, --ports <范围>        端口范围 (默认: 1-1024)\n");
+                                           printf("  -p, --ports <范围>        端口范围 (默认: 1-1024，UDP扫描为常见UDP服务端口)\n");
+                                           printf("  -iL, --target-file <文件> 从文件读取目标，每行一个\n");
+                                           printf("  --no-randomize            按顺序扫描，不打乱主机和端口\n");
+                                           printf("  --dns-servers <列表>      DNS服务器，逗号分隔的地址[:端口] (默认: /etc/resolv.conf)\n");
+                                           printf("  -R, --reverse-dns         反向解析有结果的主机名\n");
                                            printf("  -t, --threads <数量>      线程数量 (默认: 50)\n");
-                                           printf("  -T, --timeout <毫秒>      超时时间 (默认: 2000)\n");
-                                           printf("  -s, --scan-type <类型>    扫描类型: connect, syn, udp (默认: connect)\n");
+                                           printf("  -T, --timeout <毫秒>      初始超时时间，之后按主机RTT自适应 (默认: 2000)\n");
+                                           printf("  --min-rtt-timeout <毫秒>  自适应超时下界 (默认: %d)\n", MIN_RTT_TIMEOUT);
+                                           printf("  --max-rtt-timeout <毫秒>  自适应超时上界 (默认: %d)\n", MAX_RTT_TIMEOUT);
+                                           printf("  --retries <次数>          connect/UDP扫描超时探测的重传次数 (默认: %d)\n", DEFAULT_RETRIES);
+                                           printf("  --max-rate <包/秒>        所有发送路径合计的最大发包速率 (默认: 不限)\n");
+                                           printf("  --min-rate <包/秒>        最低发包速率，落后时不受主机拥塞窗口和批间隔限制\n");
+                                           printf("  -s, --scan-type <类型>    扫描类型: connect, syn, ack, fin, xmas, null, udp (默认: connect)\n");
+                                           printf("  -e, --engine <引擎>       探测引擎: thread, epoll, uring (默认: thread)\n");
+                                           printf("  -w, --window <数量>       epoll/uring引擎并发连接数 (默认: %d)\n", DEFAULT_CONNECT_WINDOW);
+                                           printf("  --batch <数量>            原始/UDP扫描每次sendmmsg发送的包数 (默认: %d)\n", DEFAULT_TX_BATCH);
+                                           printf("  --batch-delay <微秒>      原始/UDP扫描两批之间的间隔 (默认: 0)\n");
                                            printf("  -b, --banner              启用横幅抓取\n");
                                            printf("  -v, --verbose             显示详细输出\n");
                                            printf("  -o, --output <文件>       输出文件\n");
-                                           printf("  -f, --format <格式>       输出格式: txt, csv, json (默认: txt)\n");
+                                           printf("  -f, --format <格式>       输出格式: txt, csv, json, ndjson, bin (默认: txt)，ndjson边扫描边写入-o文件\n");
+                                           printf("  --compress                bin格式按列差分压缩\n");
+                                           printf("  --stream <文件|->         发现结果时立即以NDJSON写入文件、管道或标准输出(-)\n");
+                                           printf("  --stream-flush <字节>     流式输出缓冲达到该大小时写出 (默认: %d)\n", DEFAULT_STREAM_FLUSH);
+                                           printf("  --stream-interval <毫秒>  流式输出最长的写出间隔 (默认: %d)\n", DEFAULT_STREAM_INTERVAL);
+                                           printf("  --checkpoint <文件>       定期保存检查点，收到SIGINT/SIGTERM/SIGHUP时停止并保存\n");
+                                           printf("  --checkpoint-interval <秒> 保存检查点的间隔 (默认: %d)\n", DEFAULT_CHECKPOINT_INTERVAL);
+                                           printf("  --resume <文件>           从检查点继续扫描，目标和端口范围可省略，继续保存到该检查点\n");
                                            printf("  --no-banner               不显示横幅信息\n");
                                            return 0;
                                        }
 
                                        char *command = argv[0];
 
-                                       if (strcmp(command, "scan") == 0) {
+                                       // monitor与scan使用相同的扫描选项，另有基线和轮转选项
+                                       int monitor = strcmp(command, "monitor") == 0;
+                                       if (strcmp(command, "scan") == 0 || monitor) {
                                            if (argc < 2) {
                                                fprintf(stderr, "错误: 需要指定目标\n");
                                                return 1;
                                            }
 
-                                           char *target = argv[1];
-                                           char *port_range = "1-1024";
+                                           // 目标可省略，由-iL指定的文件提供
+                                           char *target = (argv[1][0] != '-') ? argv[1] : NULL;
+                                           char *target_file = NULL;
+                                           char *dns_servers = NULL;
+                                           int reverse_dns = 0;
+                                           const char *port_range = NULL;
                                            int thread_count = 50;
                                            int timeout_ms = 2000;
+                                           int min_timeout_ms = MIN_RTT_TIMEOUT;
+                                           int max_timeout_ms = MAX_RTT_TIMEOUT;
+                                           int retries = DEFAULT_RETRIES;
                                            ScanType scan_type = SCAN_TCP_CONNECT;
+                                           ScanEngine engine = ENGINE_THREAD;
+                                           int window = DEFAULT_CONNECT_WINDOW;
+                                           int batch_size = DEFAULT_TX_BATCH;
+                                           int batch_delay_us = 0;
+                                           double max_rate = 0;
+                                           double min_rate = 0;
+                                           int randomize = 1;
                                            int banner_grab = 0;
                                            int verbose = 0;
                                            char *output_file = NULL;
                                            char *format = "txt";
                                            int show_banner = 1;
+                                           const char *stream_path = NULL;
+                                           int stream_flush_bytes = DEFAULT_STREAM_FLUSH;
+                                           int stream_interval_ms = DEFAULT_STREAM_INTERVAL;
+                                           int compress = 0;
+                                           const char *checkpoint_path = NULL;
+                                           int checkpoint_interval = DEFAULT_CHECKPOINT_INTERVAL;
+                                           const char *resume_path = NULL;
+                                           int scan_type_set = 0;
+                                           MonitorOptions mon = {
+                                               .rotation = MONITOR_DEFAULT_ROTATION,
+                                               .cycles = 1,
+                                               .interval = MONITOR_DEFAULT_INTERVAL,
+                                               .update_baseline = 1,
+                                           };
 
                                            // 解析选项
-                                           for (int i = 2; i < argc; i++) {
+                                           for (int i = target ? 2 : 1; i < argc; i++) {
                                                if ((strcmp(argv[i], "-p") == 0 || strcmp(argv[i], "--ports") == 0) && i + 1 < argc) {
                                                    port_range = argv[++i];
+                                               } else if ((strcmp(argv[i], "-iL") == 0 || strcmp(argv[i], "--target-file") == 0) && i + 1 < argc) {
+                                                   target_file = argv[++i];
+                                               } else if (strcmp(argv[i], "--no-randomize") == 0) {
+                                                   randomize = 0;
+                                               } else if (strcmp(argv[i], "--dns-servers") == 0 && i + 1 < argc) {
+                                                   dns_servers = argv[++i];
+                                               } else if (strcmp(argv[i], "-R") == 0 || strcmp(argv[i], "--reverse-dns") == 0) {
+                                                   reverse_dns = 1;
                                                } else if ((strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--threads") == 0) && i + 1 < argc) {
                                                    thread_count = atoi(argv[++i]);
                                                } else if ((strcmp(argv[i], "-T") == 0 || strcmp(argv[i], "--timeout") == 0) && i + 1 < argc) {
                                                    timeout_ms = atoi(argv[++i]);
+                                               } else if (strcmp(argv[i], "--min-rtt-timeout") == 0 && i + 1 < argc) {
+                                                   min_timeout_ms = atoi(argv[++i]);
+                                               } else if (strcmp(argv[i], "--max-rtt-timeout") == 0 && i + 1 < argc) {
+                                                   max_timeout_ms = atoi(argv[++i]);
+                                               } else if (strcmp(argv[i], "--retries") == 0 && i + 1 < argc) {
+                                                   retries = atoi(argv[++i]);
+                                               } else if (strcmp(argv[i], "--max-rate") == 0 && i + 1 < argc) {
+                                                   max_rate = atof(argv[++i]);
+                                               } else if (strcmp(argv[i], "--min-rate") == 0 && i + 1 < argc) {
+                                                   min_rate = atof(argv[++i]);
                                                } else if ((strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--scan-type") == 0) && i + 1 < argc) {
                                                    char *type = argv[++i];
+                                                   scan_type_set = 1;
                                                    if (strcmp(type, "connect") == 0) {
                                                        scan_type = SCAN_TCP_CONNECT;
                                                    } else if (strcmp(type, "syn") == 0) {
                                                        scan_type = SCAN_TCP_SYN;
+                                                   } else if (strcmp(type, "ack") == 0) {
+                                                       scan_type = SCAN_TCP_ACK;
+                                                   } else if (strcmp(type, "fin") == 0) {
+                                                       scan_type = SCAN_TCP_FIN;
+                                                   } else if (strcmp(type, "xmas") == 0) {
+                                                       scan_type = SCAN_TCP_XMAS;
+                                                   } else if (strcmp(type, "null") == 0) {
+                                                       scan_type = SCAN_TCP_NULL;
                                                    } else if (strcmp(type, "udp") == 0) {
                                                        scan_type = SCAN_UDP;
                                                    } else {
                                                        fprintf(stderr, "警告: 未知扫描类型 '%s'，使用默认connect\n", type);
                                                    }
+                                               } else if ((strcmp(argv[i], "-e") == 0 || strcmp(argv[i], "--engine") == 0) && i + 1 < argc) {
+                                                   char *name = argv[++i];
+                                                   if (strcmp(name, "thread") == 0) {
+                                                       engine = ENGINE_THREAD;
+                                                   } else if (strcmp(name, "epoll") == 0) {
+                                                       engine = ENGINE_EPOLL;
+                                                   } else if (strcmp(name, "uring") == 0 || strcmp(name, "io_uring") == 0) {
+                                                       engine = ENGINE_URING;
+                                                   } else {
+                                                       fprintf(stderr, "警告: 未知引擎 '%s'，使用默认thread\n", name);
+                                                   }
+                                               } else if ((strcmp(argv[i], "-w") == 0 || strcmp(argv[i], "--window") == 0) && i + 1 < argc) {
+                                                   window = atoi(argv[++i]);
+                                               } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+                                                   batch_size = atoi(argv[++i]);
+                                               } else if (strcmp(argv[i], "--batch-delay") == 0 && i + 1 < argc) {
+                                                   batch_delay_us = atoi(argv[++i]);
                                                } else if (strcmp(argv[i], "-b") == 0 || strcmp(argv[i], "--banner") == 0) {
                                                    banner_grab = 1;
                                                } else if (strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--verbose") == 0) {
@@ -1208,32 +1849,226 @@ int perform_scan(const char *target, const char *port_range,
                                                    format = argv[++i];
                                                } else if (strcmp(argv[i], "--no-banner") == 0) {
                                                    show_banner = 0;
+                                               } else if (strcmp(argv[i], "--stream") == 0 && i + 1 < argc) {
+                                                   stream_path = argv[++i];
+                                               } else if (strcmp(argv[i], "--stream-flush") == 0 && i + 1 < argc) {
+                                                   stream_flush_bytes = atoi(argv[++i]);
+                                               } else if (strcmp(argv[i], "--stream-interval") == 0 && i + 1 < argc) {
+                                                   stream_interval_ms = atoi(argv[++i]);
+                                               } else if (strcmp(argv[i], "--compress") == 0) {
+                                                   compress = 1;
+                                               } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+                                                   checkpoint_path = argv[++i];
+                                               } else if (strcmp(argv[i], "--checkpoint-interval") == 0 && i + 1 < argc) {
+                                                   checkpoint_interval = atoi(argv[++i]);
+                                               } else if (strcmp(argv[i], "--resume") == 0 && i + 1 < argc) {
+                                                   resume_path = argv[++i];
+                                               } else if (monitor && strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+                                                   mon.baseline_path = argv[++i];
+                                               } else if (monitor && strcmp(argv[i], "--rotation") == 0 && i + 1 < argc) {
+                                                   mon.rotation = atoi(argv[++i]);
+                                               } else if (monitor && strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+                                                   mon.cycles = atoi(argv[++i]);
+                                               } else if (monitor && strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+                                                   mon.interval = atoi(argv[++i]);
+                                               } else if (monitor && strcmp(argv[i], "--no-update") == 0) {
+                                                   mon.update_baseline = 0;
+                                               }
+                                           }
+
+                                           // 从检查点继续时，未指定的目标、端口范围和扫描类型取自检查点
+                                           Checkpoint resume;
+                                           memset(&resume, 0, sizeof(resume));
+                                           if (resume_path) {
+                                               if (checkpoint_load(resume_path, &resume) < 0) {
+                                                   return 1;
+                                               }
+                                               if (!target && !target_file) {
+                                                   target = resume.targets;
+                                                   target_file = resume.target_file;
+                                               }
+                                               if (!port_range) {
+                                                   port_range = resume.port_range;
+                                               }
+                                               if (!scan_type_set) {
+                                                   scan_type = resume.scan_type;
                                                }
+                                               randomize = resume.randomize;
+                                           }
+
+                                           if (monitor) {
+                                               if (!mon.baseline_path) {
+                                                   fprintf(stderr, "错误: monitor需要 --baseline <结果文件>\n");
+                                                   return 1;
+                                               }
+                                               if (resume_path || checkpoint_path) {
+                                                   fprintf(stderr, "错误: monitor不支持检查点\n");
+                                                   checkpoint_free(&resume);
+                                                   return 1;
+                                               }
+                                           } else if (!target && !target_file) {
+                                               fprintf(stderr, "错误: 需要指定目标\n");
+                                               checkpoint_free(&resume);
+                                               return 1;
+                                           }
+
+                                           // ndjson格式在扫描过程中写入输出文件，结束后不再保存
+                                           if (strcmp(format, "ndjson") == 0 && output_file) {
+                                               if (stream_path) {
+                                                   fprintf(stderr, "错误: -f ndjson -o 与 --stream 不能同时使用\n");
+                                                   checkpoint_free(&resume);
+                                                   return 1;
+                                               }
+                                               stream_path = output_file;
+                                               output_file = NULL;
+                                           }
+
+                                           // 未指定端口时，UDP扫描内置服务表中的UDP端口
+                                           if (!port_range) {
+                                               port_range = (scan_type == SCAN_UDP) ? service_udp_ports() : "1-1024";
                                            }
 
                                            // 执行扫描
-                                           ScanResult *results = NULL;
-                                           int result_count = 0;
+                                           ResultStore *store = NULL;
+
+                                           ScanOptions opts = {
+                                               .targets = target,
+                                               .target_file = target_file,
+                                               .dns_servers = dns_servers,
+                                               .reverse_dns = reverse_dns,
+                                               .port_range = port_range,
+                                               .thread_count = thread_count,
+                                               .timeout_ms = timeout_ms,
+                                               .min_timeout_ms = min_timeout_ms,
+                                               .max_timeout_ms = max_timeout_ms,
+                                               .retries = retries,
+                                               .max_rate = max_rate,
+                                               .min_rate = min_rate,
+                                               .scan_type = scan_type,
+                                               .engine = engine,
+                                               .window = window,
+                                               .batch_size = batch_size,
+                                               .batch_delay_us = batch_delay_us,
+                                               .randomize = randomize,
+                                               .banner_grab = banner_grab,
+                                               .verbose = verbose,
+                                               .stream_path = stream_path,
+                                               .stream_flush_bytes = stream_flush_bytes,
+                                               .stream_interval_ms = stream_interval_ms,
+                                               .checkpoint_path = checkpoint_path,
+                                               .checkpoint_interval = checkpoint_interval,
+                                               .resume_path = resume_path,
+                                           };
+
+                                           // 监控只输出变化，-o为变化的输出文件，目标可取自基线
+                                           if (monitor) {
+                                               mon.output_path = output_file;
+                                               return monitor_run(&opts, &mon) == 0 ? 0 : 1;
+                                           }
 
-                                           int ret = perform_scan(target, port_range, thread_count, timeout_ms,
-                                                                  scan_type, banner_grab, verbose,
-                                                                  &results, &result_count);
+                                           int ret = perform_scan(&opts, &store);
 
-                                           if (ret == 0 && results) {
-                                               // 显示结果
-                                               display_results(results, result_count, show_banner);
+                                           if (ret == 0 && store) {
+                                               // 显示结果；结果已流式写到标准输出时不再重复
+                                               if (!stream_path || strcmp(stream_path, "-") != 0) {
+                                                   display_results(store, show_banner);
+                                               }
 
                                                // 保存结果
                                                if (output_file) {
-                                                   save_results(output_file, format, results, result_count, target);
+                                                   save_results(output_file, format, store,
+                                                                target ? target : target_file, compress);
                                                }
 
                                                // 释放结果内存
-                                               free(results);
+                                               result_store_free(store);
                                            }
+                                           checkpoint_free(&resume);
 
+                                           // 被中断时返回130，与被SIGINT终止时的退出码一致
+                                           if (ret == 0 && scan_interrupted) {
+                                               return 130;
+                                           }
                                            return (ret == 0) ? 0 : 1;
 
+                                       } else if (strcmp(command, "export") == 0) {
+                                           if (argc < 2 || argv[1][0] == '-') {
+                                               fprintf(stderr, "用法: port-scanner export <结果文件> [-f txt|csv|json] [-o 输出文件]\n");
+                                               return 1;
+                                           }
+
+                                           const char *format = "json";
+                                           const char *output_file = NULL;
+                                           for (int i = 2; i < argc; i++) {
+                                               if ((strcmp(argv[i], "-f") == 0 || strcmp(argv[i], "--format") == 0) && i + 1 < argc) {
+                                                   format = argv[++i];
+                                               } else if ((strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--output") == 0) && i + 1 < argc) {
+                                                   output_file = argv[++i];
+                                               }
+                                           }
+                                           if (strcmp(format, "txt") != 0 && strcmp(format, "csv") != 0 &&
+                                               strcmp(format, "json") != 0) {
+                                               fprintf(stderr, "错误: export只支持txt、csv和json格式\n");
+                                               return 1;
+                                           }
+
+                                           return export_results(argv[1], output_file, format) == 0 ? 0 : 1;
+
+                                       } else if (strcmp(command, "query") == 0) {
+                                           if (argc < 2 || argv[1][0] == '-') {
+                                               fprintf(stderr, "用法: port-scanner query <结果文件> [条件] [-f txt|csv|json] [-o 输出文件]\n");
+                                               return 1;
+                                           }
+
+                                           ResultQuery query = { .state = -1, .protocol = -1 };
+                                           const char *format = "txt";
+                                           const char *output_file = NULL;
+                                           for (int i = 2; i < argc; i++) {
+                                               if ((strcmp(argv[i], "-p") == 0 || strcmp(argv[i], "--ports") == 0) && i + 1 < argc) {
+                                                   query.ports = argv[++i];
+                                               } else if (strcmp(argv[i], "--host") == 0 && i + 1 < argc) {
+                                                   query.hosts = argv[++i];
+                                               } else if (strcmp(argv[i], "--service") == 0 && i + 1 < argc) {
+                                                   query.service = argv[++i];
+                                               } else if (strcmp(argv[i], "--banner") == 0 && i + 1 < argc) {
+                                                   query.banner = argv[++i];
+                                               } else if (strcmp(argv[i], "--state") == 0 && i + 1 < argc) {
+                                                   const char *name = argv[++i];
+                                                   query.state = -2;
+                                                   for (int st = 0; st < PORT_STATE_COUNT; st++) {
+                                                       if (strcmp(name, port_state_name(st)) == 0) query.state = st;
+                                                   }
+                                                   if (query.state == -2) {
+                                                       fprintf(stderr, "错误: 未知的端口状态 '%s'\n", name);
+                                                       return 1;
+                                                   }
+                                               } else if (strcmp(argv[i], "--protocol") == 0 && i + 1 < argc) {
+                                                   query.protocol = result_protocol(argv[++i]);
+                                               } else if (strcmp(argv[i], "--sort") == 0 && i + 1 < argc) {
+                                                   query.sort = argv[++i];
+                                               } else if (strcmp(argv[i], "--reverse") == 0) {
+                                                   query.reverse = 1;
+                                               } else if (strcmp(argv[i], "--limit") == 0 && i + 1 < argc) {
+                                                   long limit = atol(argv[++i]);
+                                                   query.limit = limit > 0 ? (size_t)limit : 0;
+                                               } else if (strcmp(argv[i], "--rebuild-index") == 0) {
+                                                   query.rebuild = 1;
+                                               } else if (strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--verbose") == 0) {
+                                                   query.verbose = 1;
+                                               } else if ((strcmp(argv[i], "-f") == 0 || strcmp(argv[i], "--format") == 0) && i + 1 < argc) {
+                                                   format = argv[++i];
+                                               } else if ((strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--output") == 0) && i + 1 < argc) {
+                                                   output_file = argv[++i];
+                                               }
+                                           }
+                                           if (strcmp(format, "txt") != 0 && strcmp(format, "csv") != 0 &&
+                                               strcmp(format, "json") != 0) {
+                                               fprintf(stderr, "错误: query只支持txt、csv和json格式\n");
+                                               return 1;
+                                           }
+
+                                           return query_results(argv[1], &query, output_file, format) == 0 ? 0 : 1;
+
                                        } else if (strcmp(command, "help") == 0) {
                                            printf("端口扫描器帮助\n");
                                            printf("==============\n");
@@ -1241,16 +2076,47 @@ int perform_scan(const char *target, const char *port_range,
                                            printf("支持的扫描类型:\n");
                                            printf("  connect  - TCP连接扫描（最常用）\n");
                                            printf("  syn      - TCP SYN扫描（半开放扫描，需要root权限）\n");
-                                           printf("  udp      - UDP扫描（速度较慢）\n\n");
+                                           printf("  ack      - TCP ACK扫描（判断防火墙是否过滤，需要root权限）\n");
+                                           printf("  fin/xmas/null - 隐蔽扫描，无响应视为开放|过滤（需要root权限）\n");
+                                           printf("  udp      - UDP扫描，对DNS/NTP/SNMP/NetBIOS/SSDP发送协议负载，\n");
+                                           printf("             收到应答为开放，ICMP端口不可达为关闭，其他ICMP不可达为过滤\n\n");
+                                           printf("探测引擎:\n");
+                                           printf("  thread   - 每个线程一次阻塞探测（默认）\n");
+                                           printf("  epoll    - 少量线程通过epoll维持数千个非阻塞连接，适合大范围connect扫描\n");
+                                           printf("  uring    - io_uring批量提交connect/send/recv，内核不支持时自动改用epoll\n\n");
+                                           printf("超时:\n");
+                                           printf("  -T为初始超时。收到主机的响应后，按平滑RTT + 4倍RTT偏差计算该主机的超时，\n");
+                                           printf("  并限制在--min-rtt-timeout和--max-rtt-timeout之间，低延迟网络上过滤端口等待更短\n\n");
+                                           printf("拥塞控制 (connect扫描):\n");
+                                           printf("  每个主机维护一个拥塞窗口，限制该主机上同时未完成的探测数。窗口从%d开始慢启动，\n", HOST_INITIAL_CWND);
+                                           printf("  超时的探测最多重传--retries次；重传的探测得到响应说明原探测被丢弃，窗口减半\n\n");
+                                           printf("发包速率:\n");
+                                           printf("  --max-rate限制connect、原始TCP和UDP扫描合计的每秒发包数，包按微秒级间隔均匀发出；\n");
+                                           printf("  --min-rate在实际速率落后时忽略主机拥塞窗口和批间隔，结束时报告平均速率\n\n");
                                            printf("端口范围格式:\n");
                                            printf("  单个端口: 80\n");
                                            printf("  端口范围: 1-1000\n");
                                            printf("  多个端口: 80,443,8080\n");
                                            printf("  混合格式: 1-100,443,8080-8088\n\n");
+                                           printf("目标格式:\n");
+                                           printf("  单个地址: 192.168.1.1 或 example.com\n");
+                                           printf("  CIDR:     10.0.0.0/16\n");
+                                           printf("  地址范围: 10.0.0.1-10.0.0.50 或 10.0.0.1-50\n");
+                                           printf("  多个目标: 10.0.0.1,10.0.1.0/24\n");
+                                           printf("  目标文件: -iL targets.txt（每行一个目标，#开头为注释）\n");
+                                           printf("主机名在扫描开始前批量解析一次，结果按TTL缓存；--dns-servers可指定服务器\n");
+                                           printf("主机和端口的探测顺序默认随机打乱，使负载分散到各个目标上\n\n");
                                            printf("示例:\n");
                                            printf("  pentk port-scanner scan 192.168.1.1\n");
                                            printf("  pentk port-scanner scan example.com -p 1-65535 -t 100 -s syn\n");
                                            printf("  pentk port-scanner scan 10.0.0.1 -p 80,443,8080 -b -o result.json -f json\n");
+                                           printf("  pentk port-scanner scan 10.0.0.1 -p 1-65535 -e epoll -w 4096\n");
+                                           printf("  pentk port-scanner scan 10.0.0.0/16 -p 22,80,443 -s syn\n");
+                                           printf("  pentk port-scanner scan 10.0.0.0/16 -p 1-1024 -e epoll --max-rate 5000\n");
+                                           printf("  pentk port-scanner scan 10.0.0.0/8 -p 22,443 -s syn -o sweep.bin -f bin --compress\n");
+                                           printf("  pentk port-scanner export sweep.bin -f csv -o sweep.csv\n");
+                                           printf("  pentk port-scanner query sweep.bin -p 3389\n");
+                                           printf("  pentk port-scanner query sweep.bin --banner 'OpenSSH 7.*' -f json\n");
                                            return 0;
 
                                        } else {
@@ -1264,18 +2130,44 @@ int perform_scan(const char *target, const char *port_range,
                                        return
                                        "端口扫描器\n"
                                        "====================\n"
-                                       "命令: scan <目标> [选项]\n\n"
+                                       "命令: scan <目标> [选项]\n"
+                                       "      export <结果文件> [-f txt|csv|json] [-o 文件]\n"
+                                       "      query <结果文件> [-p 端口] [--host 目标] [--service 名称] [--banner 通配符]\n"
+                                       "            [--state 状态] [--protocol 协议] [--sort 字段] [--reverse] [--limit 数量]\n"
+                                       "      monitor [目标] --baseline <结果文件> [--rotation 轮数] [--cycles 轮数] [--interval 秒]\n"
+                                       "            [--no-update] [扫描选项]  重扫已知开放端口和轮转的一段空间，输出变化\n"
+                                       "目标: 地址、主机名、CIDR、地址范围，逗号分隔\n\n"
                                        "选项:\n"
-                                       "  -p, --ports <范围>    端口范围 (默认: 1-1024)\n"
+                                       "  -p, --ports <范围>    端口范围 (默认: 1-1024，UDP为常见UDP服务端口)\n"
+                                       "  -iL <文件>            从文件读取目标\n"
+                                       "  --no-randomize        按顺序扫描，不打乱主机和端口\n"
+                                       "  --dns-servers <列表>  DNS服务器，逗号分隔的地址[:端口]\n"
+                                       "  -R, --reverse-dns     反向解析有结果的主机名\n"
                                        "  -t, --threads <数>    线程数 (默认: 50，最大: 200)\n"
-                                       "  -T, --timeout <毫秒>  超时时间 (默认: 2000)\n"
-                                       "  -s, --scan-type <类型> 扫描类型: connect, syn, udp\n"
+                                       "  -T, --timeout <毫秒>  初始超时时间 (默认: 2000)，之后按主机RTT自适应\n"
+                                       "  --min-rtt-timeout <毫秒>  自适应超时下界 (默认: 100)\n"
+                                       "  --max-rtt-timeout <毫秒>  自适应超时上界 (默认: 10000)\n"
+                                       "  --retries <次数>      connect/UDP扫描超时探测的重传次数 (默认: 1)\n"
+                                       "  --max-rate <包/秒>    最大发包速率 (默认: 不限)\n"
+                                       "  --min-rate <包/秒>    最低发包速率\n"
+                                       "  -s, --scan-type <类型> 扫描类型: connect, syn, ack, fin, xmas, null, udp\n"
+                                       "  -e, --engine <引擎>   探测引擎: thread, epoll, uring\n"
+                                       "  -w, --window <数>     epoll/uring引擎并发连接数 (默认: 1024)\n"
+                                       "  --batch <数>          原始/UDP扫描每批发送的包数 (默认: 64)\n"
+                                       "  --batch-delay <微秒>  原始/UDP扫描两批之间的间隔\n"
                                        "  -b, --banner          启用横幅抓取\n"
                                        "  -v, --verbose         显示详细输出\n"
                                        "  -o, --output <文件>   输出到文件\n"
-                                       "  -f, --format <格式>   输出格式: txt, csv, json\n"
+                                       "  -f, --format <格式>   输出格式: txt, csv, json, ndjson, bin\n"
+                                       "  --compress            bin格式按列差分压缩\n"
+                                       "  --stream <文件|->     发现结果时立即以NDJSON输出\n"
+                                       "  --stream-flush <字节> 流式输出的缓冲大小 (默认: 65536)\n"
+                                       "  --stream-interval <毫秒> 流式输出最长的写出间隔 (默认: 200)\n"
+                                       "  --checkpoint <文件>   定期保存检查点，中断时保存后退出\n"
+                                       "  --checkpoint-interval <秒> 保存检查点的间隔 (默认: 60)\n"
+                                       "  --resume <文件>       从检查点继续扫描\n"
                                        "  --no-banner           输出时不显示横幅信息\n\n"
-                                       "注意: SYN扫描需要root权限\n";
+                                       "注意: SYN/ACK/FIN/XMAS/NULL扫描需要root权限\n";
                                    }
 
                                    // 获取插件函数
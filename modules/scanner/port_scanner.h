@@ -0,0 +1,615 @@
+/**
+ * 端口扫描器内部头文件
+ * 扫描引擎之间共享的类型和函数声明
+ */
+
+#ifndef PORT_SCANNER_H
+#define PORT_SCANNER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <time.h>
+#include <signal.h>
+#include <netinet/in.h>
+
+#define MAX_THREADS 200
+#define MAX_PORTS 65535
+#define SCAN_TIMEOUT 2
+#define MAX_BANNER_SIZE 1024
+#define MAX_SERVICES 1000
+#define MAX_HOSTNAME 256
+
+#define MIN_RTT_TIMEOUT 100          // 自适应超时默认下界(ms)
+#define MAX_RTT_TIMEOUT 10000        // 自适应超时默认上界(ms)
+#define HOST_INITIAL_CWND 10         // 每个主机的初始拥塞窗口
+#define HOST_MAX_CWND MAX_CONNECT_WINDOW
+#define DEFAULT_RETRIES 1            // 超时探测的默认重传次数
+#define MAX_RETRIES 10
+#define DEFAULT_CONNECT_WINDOW 1024   // 事件驱动引擎默认并发连接数
+#define MAX_CONNECT_WINDOW 65536
+#define MAX_EVENT_THREADS 16          // 事件驱动引擎最多使用的线程数
+#define BANNER_MAX_FDS 512            // 横幅阶段最多持有的连接数（进行中和排队中）
+#define DEFAULT_TX_BATCH 64           // 每次sendmmsg发送的探测包数
+#define MAX_TX_BATCH 1024
+#define MAX_SILENT_RESULTS (1 << 20)  // 无响应的探测逐个记录的上限，超过时只计数
+#define PACER_SLACK_NS 20000L         // 限速时报文为凑批允许推迟的最长时间
+#define WORK_CHUNK 64                 // 每个线程一次领取的探测序号数上限
+#define RESULT_BLOCK_SIZE 256         // 结果分片中每块的结果数
+#define DEFAULT_STREAM_FLUSH 65536    // 流式输出缓冲达到该字节数时写出
+#define DEFAULT_STREAM_INTERVAL 200   // 流式输出最长的写出间隔(ms)
+#define DEFAULT_CHECKPOINT_INTERVAL 60 // 定期保存检查点的默认间隔(秒)
+#define MONITOR_DEFAULT_ROTATION 7    // 监控时冷区默认每7轮扫完一遍
+#define MONITOR_DEFAULT_INTERVAL 3600 // 多轮监控默认的间隔(秒)
+#define LATENCY_BUCKETS 512           // 探测延迟直方图的桶数，见latency_bucket()
+#define RESULT_FILE_BLOCK_ROWS 65536  // 二进制结果文件每块的最多行数
+
+// 伪头部用于计算TCP校验和
+struct pseudo_header {
+    uint32_t source_address;
+    uint32_t dest_address;
+    uint8_t placeholder;
+    uint8_t protocol;
+    uint16_t tcp_length;
+};
+
+// 扫描类型枚举
+typedef enum {
+    SCAN_TCP_CONNECT = 0,
+    SCAN_TCP_SYN,
+    SCAN_TCP_ACK,
+    SCAN_TCP_FIN,
+    SCAN_TCP_XMAS,
+    SCAN_TCP_NULL,
+    SCAN_UDP,
+    SCAN_UDP_CONNECT
+} ScanType;
+
+// 端口状态枚举
+typedef enum {
+    PORT_OPEN = 0,
+    PORT_CLOSED,
+    PORT_FILTERED,
+    PORT_OPEN_FILTERED,
+    PORT_UNFILTERED
+} PortState;
+
+#define PORT_STATE_COUNT (PORT_UNFILTERED + 1)
+
+// 探测引擎枚举
+typedef enum {
+    ENGINE_THREAD = 0,   // 每个线程一次阻塞探测
+    ENGINE_EPOLL,        // epoll事件循环 + 非阻塞connect
+    ENGINE_URING         // io_uring批量提交connect/send/recv
+} ScanEngine;
+
+// 服务信息结构
+typedef struct {
+    int port;
+    char name[32];
+    char protocol[8];
+    char description[128];
+} ServiceInfo;
+
+// 结果中的协议
+typedef enum {
+    RESULT_TCP = 0,
+    RESULT_UDP
+} ResultProtocol;
+
+// 写入结果存储的字符串长度上限（含结尾的0）
+#define RESULT_HOSTNAME_MAX 64
+#define RESULT_BANNER_MAX 256
+#define RESULT_PRODUCT_MAX 64
+#define RESULT_VERSION_MAX 32
+
+// ScanResult.flags: 横幅阶段还会写入该结果，写完后以release清除
+#define RESULT_BANNER_PENDING 0x1
+
+// 扫描结果结构（紧凑布局）
+// 字符串保存在结果存储的字符串区中，字段为偏移，0表示空字符串
+typedef struct {
+    int64_t timestamp_us;    // 发现时间（微秒）
+    struct in_addr addr;
+    uint16_t port;
+    uint8_t protocol;        // ResultProtocol
+    uint8_t state;           // PortState
+    uint16_t service;        // 服务名称下标，见service_name()
+    uint16_t flags;          // RESULT_BANNER_PENDING，检查点用原子读取
+    int32_t response_time;   // 响应时间(ms)
+    uint32_t hostname;       // 反向解析得到的主机名，可为空
+    uint32_t banner;
+    uint32_t product;        // 版本识别得到的产品名，可为空
+    uint32_t version;
+} ScanResult;
+
+// 输出用的一行结果，字符串已从结果存储或结果文件中取出
+typedef struct {
+    struct in_addr addr;
+    int port;
+    const char *protocol;
+    const char *state;
+    const char *service;
+    const char *hostname;
+    const char *banner;
+    const char *product;
+    const char *version;
+    long response_time;
+    int64_t timestamp_us;
+} ResultRow;
+
+// 结果文件中一块的各列，字符串列为文件字符串区中的偏移
+typedef struct {
+    size_t rows;
+    const uint32_t *addr;            // 主机字节序
+    const uint16_t *port;
+    const uint8_t *protocol;         // ResultProtocol
+    const uint8_t *state;            // PortState
+    const uint16_t *service;         // 文件服务名称表的下标
+    const int32_t *response_time;
+    const int64_t *timestamp_us;
+    const uint32_t *hostname;
+    const uint32_t *banner;
+    const uint32_t *product;
+    const uint32_t *version;
+    void *owned;                     // 解压的列，由result_columns_free释放
+} ResultColumns;
+
+// 结果文件的查询条件
+typedef struct {
+    const char *hosts;       // 地址、CIDR、地址范围，逗号分隔，NULL表示不限
+    const char *ports;       // 端口列表，格式同-p
+    const char *service;     // 服务名称，不区分大小写
+    const char *banner;      // 匹配横幅或"产品 版本"的通配符，匹配其中一部分即可
+    int state;               // PortState，-1表示不限
+    int protocol;            // ResultProtocol，-1表示不限
+    const char *sort;        // host, port, service, rtt, time，NULL为host
+    int reverse;             // 降序
+    size_t limit;            // 最多输出的行数，0表示不限
+    int rebuild;             // 重建索引
+    int verbose;
+} ResultQuery;
+
+// 版本识别结果
+typedef struct {
+    char service[32];
+    char product[64];
+    char version[32];
+} ServiceMatch;
+
+// 结果块，写入后位置不变，横幅阶段可以直接持有结果的指针
+typedef struct ResultBlock {
+    struct ResultBlock *next;
+    int count;
+    ScanResult items[RESULT_BLOCK_SIZE];
+} ResultBlock;
+
+// 每个线程独占的统计和结果，只有所属线程写入，不需要加锁；
+// 按缓存行对齐，避免相邻线程的计数器互相使缓存失效
+typedef struct {
+    long scanned;                    // 进度线程用原子读取
+    long states[PORT_STATE_COUNT];   // 按端口状态的计数
+    ResultBlock *head;
+    ResultBlock *tail;
+    int result_count;
+    int published;                   // 已写完的结果数，检查点用原子读取
+    unsigned long latency[LATENCY_BUCKETS]; // 首次发送即得到响应的探测的延迟直方图
+} __attribute__((aligned(64))) ThreadShard;
+
+// 地址区间 [start, end]，主机字节序
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+    uint64_t offset;     // 之前各区间的主机总数
+} AddrRange;
+
+// 端口区间 [start, end]
+typedef struct {
+    int start;
+    int end;
+    uint64_t offset;     // 之前各区间的端口总数
+} PortRange;
+
+// 扫描空间: 主机区间 × 端口区间，按需生成探测顺序
+typedef struct {
+    AddrRange *hosts;
+    int host_range_count;
+    uint64_t host_count;
+    PortRange *ports;
+    int port_range_count;
+    uint64_t port_count;
+    uint64_t total;      // host_count * port_count
+    int randomize;       // 是否打乱探测顺序
+    int half_bits;       // Feistel网络半块位宽
+    uint64_t half_mask;
+    uint64_t keys[4];
+} ScanSpace;
+
+// 探测序号区间 [start, end)
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    uint64_t offset;     // 之前各区间的序号总数
+} SequenceRange;
+
+// 本次扫描要发出的探测序号，恢复扫描时只有上次未完成的区间
+// 线程领取的是 [0, total) 中的序号，再映射到扫描空间的探测序号
+typedef struct {
+    SequenceRange *ranges;
+    int range_count;
+    uint64_t total;
+} ScanWork;
+
+// 探测下标集合
+typedef struct {
+    uint64_t *slots;
+    size_t capacity;
+    size_t count;
+} IndexSet;
+
+// 一次DNS查询: 正向由name得到addr，反向由addr得到name
+typedef struct {
+    char name[MAX_HOSTNAME];
+    struct in_addr addr;
+    int resolved;
+} DnsLookup;
+
+typedef struct HostTable HostTable;
+typedef struct Pacer Pacer;
+typedef struct BannerStage BannerStage;
+typedef struct ResultStream ResultStream;
+typedef struct ResultStore ResultStore;
+typedef struct ResultFile ResultFile;
+typedef struct ResultFileWriter ResultFileWriter;
+
+// 探测结果，用于调整主机的拥塞窗口
+typedef enum {
+    PROBE_ANSWERED = 0,      // 首次发送即得到响应
+    PROBE_RETRY_ANSWERED,    // 重传后才得到响应，说明原探测被丢弃
+    PROBE_NO_ANSWER,         // 超时或不可达
+    PROBE_CANCELLED          // 未能发出
+} ProbeOutcome;
+
+// 一个探测
+typedef struct {
+    struct in_addr addr;
+    int port;
+    int attempt;             // 0为首次发送
+} Probe;
+
+// 连接扫描线程的探测调度状态
+typedef struct {
+    Probe *retries;          // 等待重传的探测（环形队列）
+    int capacity;
+    int head;
+    int count;
+    Probe pending;           // 因主机窗口已满或资源不足而暂缓的探测
+    int has_pending;
+    int exhausted;
+    long pace_wait_ns;       // 因全局速率限制暂缓时，距下一个令牌的时间
+} ProbeScheduler;
+
+// 扫描选项
+typedef struct {
+    const char *targets;       // 逗号分隔的目标: 地址、主机名、CIDR、地址范围
+    const char *target_file;   // 目标文件，可为NULL
+    const char *dns_servers;   // 逗号分隔的DNS服务器，NULL表示使用系统配置
+    int reverse_dns;           // 是否反向解析有结果的主机
+    const char *port_range;
+    int thread_count;
+    int timeout_ms;            // 初始超时，获得RTT样本后按主机自适应
+    int min_timeout_ms;
+    int max_timeout_ms;
+    int retries;               // 超时探测的重传次数
+    double max_rate;           // 每秒最多发出的探测包数，0表示不限
+    double min_rate;           // 每秒至少发出的探测包数，0表示不要求
+    ScanType scan_type;
+    ScanEngine engine;
+    int window;
+    int batch_size;
+    int batch_delay_us;
+    int randomize;
+    int banner_grab;
+    int verbose;
+    const char *stream_path;   // 流式NDJSON输出，"-"为标准输出，NULL表示不输出
+    int stream_flush_bytes;    // 缓冲达到该字节数时写出
+    int stream_interval_ms;    // 距上次写出超过该时间时写出
+    const char *checkpoint_path; // 检查点文件，NULL表示不保存
+    int checkpoint_interval;   // 定期保存检查点的间隔(秒)
+    const char *resume_path;   // 从该检查点继续扫描，NULL表示从头开始
+    const ScanWork *work;      // 只发出这些探测序号，NULL表示整个扫描空间
+    const uint64_t *keys;      // 探测顺序的Feistel密钥，NULL表示随机生成
+    unsigned long *latency;    // 非NULL时累加本次扫描的探测延迟直方图 (LATENCY_BUCKETS个桶)
+} ScanOptions;
+
+// 监控选项
+typedef struct {
+    const char *baseline_path; // 基线结果文件(bin)，不存在时第一轮建立
+    const char *output_path;   // 变化输出(NDJSON)，NULL或"-"为标准输出
+    int rotation;              // 冷区每多少轮扫完一遍
+    int cycles;                // 轮数，0表示一直运行
+    int interval;              // 两轮之间的间隔(秒)
+    int update_baseline;       // 每轮结束后用新结果更新基线
+} MonitorOptions;
+
+// 扫描检查点: 扫描空间的标识、尚未完成的探测序号和统计，
+// 已有的结果另存为同名加.results后缀的bin格式结果文件
+typedef struct {
+    char *targets;             // 可为NULL
+    char *target_file;         // 可为NULL
+    char *port_range;
+    ScanType scan_type;
+    int randomize;
+    uint64_t keys[4];          // 探测顺序的Feistel密钥
+    uint64_t digest;           // 主机区间和端口区间的摘要
+    uint64_t host_count;
+    uint64_t port_count;
+    ScanWork work;             // 尚未完成的探测序号区间
+    long states[PORT_STATE_COUNT];
+    long elapsed_ms;           // 之前各次运行累计的扫描时间
+} Checkpoint;
+
+// 线程参数结构
+typedef struct {
+    ScanSpace *space;
+    const ScanWork *work; // 本次扫描要发出的探测序号
+    HostTable *hosts;    // 每个主机的RTT估计和拥塞窗口
+    Pacer *pacer;        // 全局发包速率控制，可为NULL
+    BannerStage *banners; // 横幅抓取阶段，未启用横幅抓取时为NULL
+    ResultStream *stream; // 流式输出，未启用时为NULL
+    ResultStore *store;  // 结果的字符串区和端口状态位图
+    int timeout_ms;
+    int retries;
+    ScanType scan_type;
+    int thread_id;
+    uint64_t *next_sequence;   // 下一个未领取的序号（ScanWork中），各线程原子领取
+    uint64_t chunk_next;       // 本线程已领取的序号区间 [chunk_next, chunk_end)
+    uint64_t chunk_end;
+    int work_chunk;            // 每次领取的序号数
+    ThreadShard *shard;        // 本线程的统计和结果
+    int banner_grab;
+    int verbose;
+    int window;          // 事件驱动引擎: 本线程的并发连接上限
+    int batch_size;      // 批量发送: 每批的包数
+    int batch_delay_us;  // 批量发送: 两批之间的间隔
+} ThreadParams;
+
+// 接收环回调: packet指向IP头
+typedef void (*PacketHandler)(const uint8_t *packet, size_t len, void *user);
+typedef struct PacketRing PacketRing;
+typedef struct TxBatch TxBatch;
+// 批量发送中报文无法发出时的回调，dst为该报文的目标
+typedef void (*TxFailureHandler)(void *user, const struct sockaddr_in *dst);
+
+// 扫描运行标志
+extern volatile int scan_running;
+extern volatile sig_atomic_t scan_interrupted;
+
+// 是否为原始TCP扫描类型
+static inline int is_raw_tcp_scan(ScanType type) {
+    return type == SCAN_TCP_SYN || type == SCAN_TCP_ACK || type == SCAN_TCP_FIN ||
+           type == SCAN_TCP_XMAS || type == SCAN_TCP_NULL;
+}
+
+// 探测延迟(微秒)所在的桶: 64微秒以下每微秒一个桶，之后每个2的幂区间分16个桶
+static inline int latency_bucket(long us) {
+    if (us < 64) {
+        return us < 0 ? 0 : (int)us;
+    }
+    int e = 63 - __builtin_clzl((unsigned long)us);
+    int bucket = 64 + (e - 6) * 16 + (int)((us >> (e - 4)) & 15);
+    return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+
+// 桶的下界(微秒)
+static inline long latency_bucket_floor(int bucket) {
+    if (bucket < 64) {
+        return bucket;
+    }
+    int e = (bucket - 64) / 16 + 6;
+    return (long)(16 + (bucket - 64) % 16) << (e - 4);
+}
+
+// 公共函数
+unsigned short tcp_checksum(unsigned short *ptr, int nbytes);
+int create_raw_socket(void);
+const char* port_state_name(PortState state);
+int get_banner_probe(int port, char *probe);
+char* sanitize_banner(char *raw, int len);
+void close_with_reset(int fd);
+int tcp_connect_scan(const struct sockaddr_in *addr, int timeout_ms, int *keep_fd);
+int next_probe(ThreadParams *params, struct in_addr *addr, int *port);
+uint64_t probe_index(const ThreadParams *params, uint64_t n);
+uint64_t probes_dispatched(const ThreadParams *params);
+void record_scan_result(ThreadParams *params, struct in_addr addr, int port,
+                        const char *protocol, int result, long response_time);
+void record_scan_result_banner(ThreadParams *params, struct in_addr addr, int port,
+                               const char *protocol, int result, long response_time,
+                               const char *banner, const ServiceMatch *match);
+void record_connect_result(ThreadParams *params, struct in_addr addr, int port,
+                           int result, long response_time, int fd);
+void record_port_state(ThreadParams *params, struct in_addr addr, int port,
+                       const char *protocol, PortState state, long response_time,
+                       const char *banner);
+void record_state_count(ThreadParams *params, PortState state, long count);
+void record_silent_probes(ThreadParams *params, const IndexSet *answered,
+                          const IndexSet *unsent, const char *protocol, PortState state);
+int perform_scan(const ScanOptions *opts, ResultStore **store_ptr);
+
+// 扫描空间 (targets.c)
+int scan_space_init(ScanSpace *space, const char *targets, const char *target_file,
+                    const char *port_range, int randomize);
+void scan_space_free(ScanSpace *space);
+uint64_t scan_space_permute(const ScanSpace *space, uint64_t sequence);
+uint64_t scan_space_unpermute(const ScanSpace *space, uint64_t index);
+uint64_t scan_space_digest(const ScanSpace *space);
+void scan_space_decode(const ScanSpace *space, uint64_t index, struct in_addr *addr, int *port);
+int64_t scan_space_host_index(const ScanSpace *space, struct in_addr addr);
+int64_t scan_space_locate(const ScanSpace *space, struct in_addr addr, int port);
+int index_set_add(IndexSet *set, uint64_t value);
+int index_set_contains(const IndexSet *set, uint64_t value);
+void index_set_free(IndexSet *set);
+
+// DNS解析 (resolver.c)
+int dns_set_servers(const char *servers);
+int dns_resolve(DnsLookup *lookups, int count);
+int dns_reverse(DnsLookup *lookups, int count);
+void dns_cache_clear(void);
+
+// 主机状态表 (host_table.c)
+HostTable* host_table_create(int initial_timeout_ms, int min_timeout_ms, int max_timeout_ms);
+void host_table_destroy(HostTable *table);
+int host_probe_start(HostTable *table, struct in_addr addr, int force, int *timeout_ms);
+void host_probe_finish(HostTable *table, struct in_addr addr, ProbeOutcome outcome, long rtt_us);
+
+// 校验和 (checksum.c)
+uint32_t csum_partial(const void *data, size_t len, uint32_t sum);
+uint16_t csum_fold(uint32_t sum);
+uint16_t csum_replace2(uint16_t check, uint16_t old, uint16_t new_value);
+uint16_t csum_replace4(uint16_t check, uint32_t old, uint32_t new_value);
+
+// 把32位字段按内存中的两个16位字计入部分和
+static inline uint32_t csum_add32(uint32_t sum, uint32_t value) {
+    return sum + (value >> 16) + (value & 0xffff);
+}
+
+// 服务名称表 (services.c)
+int service_table_load(void);
+void service_table_free(void);
+const char* get_service_by_port(int port, const char* protocol);
+double get_service_frequency(int port, const char *protocol);
+const char* service_udp_ports(void);
+uint16_t get_service_id(int port, const char *protocol);
+const char* service_name(uint16_t id);
+uint16_t service_id_by_name(const char *name);
+
+// 服务版本识别 (fingerprint.c)
+int fingerprint_load(void);
+void fingerprint_free(void);
+int fingerprint_match(const char *data, int len, const char *protocol, ServiceMatch *match);
+int fingerprint_probe(int port, const char *protocol, char *probe, int size);
+void apply_service_match(ResultStore *store, ScanResult *result, const ServiceMatch *match);
+
+// 横幅抓取阶段 (banner.c)
+BannerStage* banner_stage_create(int timeout_ms, Pacer *pacer, ResultStore *store,
+                                 ResultStream *stream);
+void banner_stage_submit(BannerStage *stage, struct in_addr addr, int port, int fd,
+                         ScanResult *result);
+size_t banner_stage_pending(BannerStage *stage);
+unsigned long banner_stage_finish(BannerStage *stage);
+
+// 流式结果输出 (stream.c)
+ResultStream* result_stream_open(const char *path, size_t flush_bytes, int flush_ms);
+void result_stream_write(ResultStream *stream, ResultStore *store, const ScanResult *result);
+unsigned long result_stream_close(ResultStream *stream);
+size_t json_escape(const char *src, char *dst, size_t size);
+
+// 结果存储 (result_store.c)
+ResultStore* result_store_create(const ScanSpace *space);
+void result_store_free(ResultStore *store);
+uint32_t result_store_intern(ResultStore *store, const char *s, size_t max_len);
+const char* result_string(const ResultStore *store, uint32_t offset);
+int result_store_mark(ResultStore *store, struct in_addr addr, int port, PortState state);
+int result_store_state(ResultStore *store, struct in_addr addr, int port);
+int result_store_finish(ResultStore *store, ThreadShard *shards, int count);
+ScanResult* result_store_results(ResultStore *store, size_t *count);
+size_t result_store_memory(const ResultStore *store);
+uint8_t result_protocol(const char *name);
+const char* result_protocol_name(uint8_t protocol);
+void result_store_row(const ResultStore *store, const ScanResult *result, ResultRow *row);
+
+// 二进制结果文件 (result_file.c)
+ResultFileWriter* result_file_create(const char *path, ResultStore *store,
+                                     const char *target, time_t scan_time, int compress);
+int result_file_append(ResultFileWriter *writer, const ScanResult *results, size_t count);
+int result_file_finish(ResultFileWriter *writer);
+ResultFile* result_file_open(const char *path);
+void result_file_close(ResultFile *file);
+uint64_t result_file_rows(const ResultFile *file);
+uint32_t result_file_blocks(const ResultFile *file);
+const char* result_file_target(const ResultFile *file);
+time_t result_file_time(const ResultFile *file);
+const char* result_file_string(const ResultFile *file, uint32_t offset);
+uint64_t result_file_block_rows(const ResultFile *file, uint32_t block);
+uint32_t result_file_services(const ResultFile *file);
+const char* result_file_service(const ResultFile *file, uint32_t index);
+void result_file_block_range(const ResultFile *file, uint32_t block,
+                             uint32_t *min_addr, uint32_t *max_addr, int *min_port, int *max_port);
+int result_file_read_block(const ResultFile *file, uint32_t block, ResultColumns *cols);
+void result_columns_free(ResultColumns *cols);
+void result_file_row(const ResultFile *file, const ResultColumns *cols, size_t i, ResultRow *row);
+
+// 结果文件查询 (result_query.c)
+int result_query_run(const char *path, const ResultFile *file, const ResultQuery *query,
+                     ResultRow **rows, size_t *count);
+
+// 检查点 (checkpoint.c)
+int scan_work_init(ScanWork *work, const SequenceRange *ranges, int count);
+void scan_work_free(ScanWork *work);
+uint64_t scan_work_sequence(const ScanWork *work, uint64_t n);
+int64_t scan_work_offset(const ScanWork *work, uint64_t sequence);
+int scan_work_remaining(const ScanWork *work, SequenceRange *pending, int count, ScanWork *out);
+int checkpoint_init(Checkpoint *ckpt, const ScanOptions *opts, const ScanSpace *space);
+int checkpoint_check(const Checkpoint *ckpt, const ScanOptions *opts, const ScanSpace *space);
+int checkpoint_save(const char *path, const Checkpoint *ckpt, ResultStore *store,
+                    const ScanResult *results, size_t count);
+int checkpoint_load(const char *path, Checkpoint *ckpt);
+void checkpoint_free(Checkpoint *ckpt);
+int checkpoint_results_path(const char *path, char *buf, size_t size);
+
+// 持续监控 (monitor.c)
+int monitor_run(const ScanOptions *opts, const MonitorOptions *mon);
+
+// 全局发包速率控制 (pacer.c)
+Pacer* pacer_create(double max_rate, double min_rate);
+void pacer_destroy(Pacer *pacer);
+long pacer_now_ns(void);
+long pacer_try(Pacer *pacer);
+long pacer_reserve(Pacer *pacer);
+void pacer_sleep_until(long deadline_ns);
+void pacer_sleep(long duration_ns);
+int pacer_behind(Pacer *pacer);
+double pacer_rate(Pacer *pacer);
+unsigned long pacer_sent(const Pacer *pacer);
+
+// 探测调度 (scheduler.c)
+int probe_scheduler_init(ProbeScheduler *sched, int capacity);
+void probe_scheduler_free(ProbeScheduler *sched);
+int probe_scheduler_next(ThreadParams *params, ProbeScheduler *sched,
+                         Probe *probe, int *timeout_ms);
+void probe_scheduler_defer(ThreadParams *params, ProbeScheduler *sched, const Probe *probe);
+void probe_answered(ThreadParams *params, const Probe *probe, long rtt_us);
+int probe_timed_out(ThreadParams *params, ProbeScheduler *sched, const Probe *probe);
+void probe_unreachable(ThreadParams *params, const Probe *probe);
+
+// epoll连接扫描引擎 (epoll_engine.c)
+int raise_fd_limit(int wanted);
+void* epoll_connect_thread_func(void *arg);
+
+// io_uring连接扫描引擎 (uring_engine.c)
+int uring_engine_available(void);
+void* uring_connect_thread_func(void *arg);
+
+// 无状态原始TCP扫描引擎 (syn_engine.c)
+void* raw_scan_thread_func(void *arg);
+
+// TPACKET_V3接收环 (packet_ring.c)
+PacketRing* packet_ring_open(uint32_t local_addr);
+int packet_ring_poll(PacketRing *ring, int timeout_ms, PacketHandler handler, void *user);
+void packet_ring_close(PacketRing *ring);
+
+// 批量发送阶段 (tx_batch.c)
+TxBatch* tx_batch_create(int fd, int batch_size, int packet_size, int batch_delay_us,
+                         Pacer *pacer);
+uint8_t* tx_batch_slot(TxBatch *tx);
+void tx_batch_commit(TxBatch *tx, int len, const struct sockaddr_in *dst);
+int tx_batch_flush(TxBatch *tx);
+void tx_batch_on_failure(TxBatch *tx, TxFailureHandler handler, void *user);
+unsigned long tx_batch_failed(const TxBatch *tx);
+void tx_batch_destroy(TxBatch *tx);
+
+// UDP扫描引擎 (udp_engine.c)
+void* udp_scan_thread_func(void *arg);
+
+#endif // PORT_SCANNER_H
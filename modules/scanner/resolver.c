@@ -0,0 +1,872 @@
+/**
+ * DNS解析
+ * 批量异步解析: 一个UDP套接字同时发出多个查询，按事务ID匹配响应，
+ * 超时后换下一个服务器重发。结果按记录的TTL缓存，
+ * 同一进程内的多次扫描不会重复查询。
+ * 未显式指定服务器时读取/etc/resolv.conf和/etc/hosts，按search/ndots补全短名字，
+ * DNS服务器没有应答时再交给系统解析器；nsswitch.conf配置了files和dns以外的来源时，
+ * 名字不存在的也交给它
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <limits.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include "port_scanner.h"
+
+#define DNS_PORT 53
+#define DNS_MAX_SERVERS 8
+#define DNS_MAX_INFLIGHT 256       // 同时未完成的查询数
+#define DNS_TIMEOUT_MS 1000        // 单次查询超时
+#define DNS_TRIES 3                // 每个名字最多发送次数，依次换服务器
+#define DNS_NEGATIVE_TTL 60        // 名字不存在时的缓存时间(秒)
+#define DNS_CACHE_BUCKETS 1024
+#define DNS_MAX_SEARCH 6           // search列表最多的域名数，与glibc相同
+#define DNS_PACKET_SIZE 1232
+
+#define DNS_TYPE_A 1
+#define DNS_TYPE_PTR 12
+#define DNS_CLASS_IN 1
+
+#define DNS_RCODE_NOERROR 0
+#define DNS_RCODE_NXDOMAIN 3
+
+// 缓存条目，key为查询名（小写）
+typedef struct DnsCacheEntry {
+    struct DnsCacheEntry *next;
+    int type;
+    int found;                  // 0表示否定缓存
+    time_t expires;             // 单调时钟秒
+    struct in_addr addr;
+    char *key;
+    char *name;                 // PTR结果
+} DnsCacheEntry;
+
+// 未完成的查询
+typedef struct {
+    int lookup;                 // 对应的DnsLookup下标
+    uint16_t id;
+    int server;
+    int tries;
+    long deadline_ms;
+} DnsInflight;
+
+static struct sockaddr_in dns_servers[DNS_MAX_SERVERS];
+static int dns_server_count;
+static int dns_servers_loaded;
+static int dns_servers_explicit;   // 由--dns-servers指定时不使用/etc/hosts和系统解析器
+static char dns_search[DNS_MAX_SEARCH][256];  // resolv.conf的search/domain列表
+static int dns_search_count;
+static int dns_ndots = 1;          // 点数少于该值的名字先按search列表补全
+static int dns_nss_other;          // nsswitch.conf的hosts行有files和dns以外的来源
+
+static DnsCacheEntry *dns_cache[DNS_CACHE_BUCKETS];
+static pthread_mutex_t dns_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static long dns_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+static time_t dns_now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+static unsigned dns_hash(const char *key, int type) {
+    unsigned h = 2166136261U ^ (unsigned)type;
+    for (; *key; key++) {
+        h = (h ^ (unsigned char)*key) * 16777619U;
+    }
+    return h % DNS_CACHE_BUCKETS;
+}
+
+// 查找未过期的缓存条目，调用者持有锁
+static DnsCacheEntry* cache_find(const char *key, int type) {
+    time_t now = dns_now_s();
+    DnsCacheEntry **link = &dns_cache[dns_hash(key, type)];
+
+    while (*link) {
+        DnsCacheEntry *entry = *link;
+        if (entry->expires <= now) {
+            // 顺便删除过期条目
+            *link = entry->next;
+            free(entry->key);
+            free(entry->name);
+            free(entry);
+            continue;
+        }
+        if (entry->type == type && strcmp(entry->key, key) == 0) {
+            return entry;
+        }
+        link = &entry->next;
+    }
+    return NULL;
+}
+
+// 写入缓存，ttl为0时不缓存
+static void cache_store(const char *key, int type, int found, uint32_t ttl,
+                        struct in_addr addr, const char *name) {
+    if (ttl == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&dns_cache_lock);
+    DnsCacheEntry *entry = cache_find(key, type);
+    if (!entry) {
+        entry = calloc(1, sizeof(DnsCacheEntry));
+        if (!entry || !(entry->key = strdup(key))) {
+            free(entry);
+            pthread_mutex_unlock(&dns_cache_lock);
+            return;
+        }
+        unsigned bucket = dns_hash(key, type);
+        entry->type = type;
+        entry->next = dns_cache[bucket];
+        dns_cache[bucket] = entry;
+    }
+
+    entry->found = found;
+    entry->addr = addr;
+    entry->expires = (ttl == UINT32_MAX) ? LONG_MAX : dns_now_s() + (time_t)ttl;
+    free(entry->name);
+    entry->name = name ? strdup(name) : NULL;
+    pthread_mutex_unlock(&dns_cache_lock);
+}
+
+void dns_cache_clear(void) {
+    pthread_mutex_lock(&dns_cache_lock);
+    for (int i = 0; i < DNS_CACHE_BUCKETS; i++) {
+        while (dns_cache[i]) {
+            DnsCacheEntry *entry = dns_cache[i];
+            dns_cache[i] = entry->next;
+            free(entry->key);
+            free(entry->name);
+            free(entry);
+        }
+    }
+    pthread_mutex_unlock(&dns_cache_lock);
+    dns_servers_loaded = 0;
+}
+
+// 规范化查询名: 小写，去掉末尾的点
+static int normalize_name(const char *name, char *out, size_t size) {
+    size_t len = strlen(name);
+    if (len > 0 && name[len - 1] == '.') len--;
+    if (len == 0 || len >= size || len > 253) {
+        return -1;
+    }
+    for (size_t i = 0; i < len; i++) {
+        out[i] = (char)tolower((unsigned char)name[i]);
+    }
+    out[len] = '\0';
+    return 0;
+}
+
+// 地址对应的in-addr.arpa名
+static void reverse_name(struct in_addr addr, char *out, size_t size) {
+    const uint8_t *b = (const uint8_t *)&addr.s_addr;
+    snprintf(out, size, "%u.%u.%u.%u.in-addr.arpa", b[3], b[2], b[1], b[0]);
+}
+
+// 解析"地址[:端口]"形式的服务器
+static int add_server(const char *spec) {
+    char host[64];
+    int port = DNS_PORT;
+
+    snprintf(host, sizeof(host), "%s", spec);
+    char *colon = strchr(host, ':');
+    if (colon) {
+        *colon = '\0';
+        port = atoi(colon + 1);
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (port <= 0 || port > 65535 || inet_pton(AF_INET, host, &addr.sin_addr) <= 0) {
+        return -1;
+    }
+
+    if (dns_server_count < DNS_MAX_SERVERS) {
+        dns_servers[dns_server_count++] = addr;
+    }
+    return 0;
+}
+
+// /etc/hosts中的名字永久缓存
+static void load_hosts_file(void) {
+    FILE *fp = fopen("/etc/hosts", "r");
+    if (!fp) {
+        return;
+    }
+
+    char line[512];
+    while (fgets(line, sizeof(line), fp)) {
+        char *comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+
+        char *saveptr = NULL;
+        char *ip = strtok_r(line, " \t\r\n", &saveptr);
+        struct in_addr addr;
+        if (!ip || inet_pton(AF_INET, ip, &addr) <= 0) {
+            continue;
+        }
+
+        char key[256];
+        for (char *name = strtok_r(NULL, " \t\r\n", &saveptr); name;
+             name = strtok_r(NULL, " \t\r\n", &saveptr)) {
+            if (normalize_name(name, key, sizeof(key)) == 0) {
+                pthread_mutex_lock(&dns_cache_lock);
+                int exists = cache_find(key, DNS_TYPE_A) != NULL;
+                pthread_mutex_unlock(&dns_cache_lock);
+                // 与系统解析器一致，同名取第一行
+                if (!exists) {
+                    cache_store(key, DNS_TYPE_A, 1, UINT32_MAX, addr, NULL);
+                }
+            }
+        }
+    }
+    fclose(fp);
+}
+
+// search和domain行替换之前的列表，与glibc一致以最后一行为准
+static void load_search_list(char *list) {
+    dns_search_count = 0;
+    char *saveptr = NULL;
+    for (char *domain = strtok_r(list, " \t\r\n", &saveptr);
+         domain && dns_search_count < DNS_MAX_SEARCH;
+         domain = strtok_r(NULL, " \t\r\n", &saveptr)) {
+        if (normalize_name(domain, dns_search[dns_search_count], sizeof(dns_search[0])) == 0) {
+            dns_search_count++;
+        }
+    }
+}
+
+static void load_system_servers(void) {
+    FILE *fp = fopen("/etc/resolv.conf", "r");
+    if (!fp) {
+        return;
+    }
+
+    char line[1024];
+    while (fgets(line, sizeof(line), fp)) {
+        char addr[64];
+        if (sscanf(line, " nameserver %63s", addr) == 1) {
+            add_server(addr);       // IPv6服务器忽略
+        } else if (strncmp(line, "search", 6) == 0 && isspace((unsigned char)line[6])) {
+            load_search_list(line + 6);
+        } else if (strncmp(line, "domain", 6) == 0 && isspace((unsigned char)line[6])) {
+            load_search_list(line + 6);
+        } else if (strncmp(line, "options", 7) == 0) {
+            char *ndots = strstr(line, "ndots:");
+            if (ndots) {
+                int value = atoi(ndots + 6);
+                dns_ndots = value < 0 ? 0 : (value > 15 ? 15 : value);
+            }
+        }
+    }
+    fclose(fp);
+}
+
+// 读取nsswitch.conf的hosts行。只有files和dns时，DNS说名字不存在就是最终结果；
+// 没有该文件时glibc默认也只用这两个来源
+static void load_nsswitch(void) {
+    FILE *fp = fopen("/etc/nsswitch.conf", "r");
+    if (!fp) {
+        return;
+    }
+
+    char line[1024];
+    while (fgets(line, sizeof(line), fp)) {
+        char *p = line;
+        while (isspace((unsigned char)*p)) p++;
+        if (strncmp(p, "hosts:", 6) != 0) {
+            continue;
+        }
+        char *saveptr = NULL;
+        for (char *source = strtok_r(p + 6, " \t\r\n", &saveptr); source;
+             source = strtok_r(NULL, " \t\r\n", &saveptr)) {
+            if (source[0] == '#') {
+                break;
+            }
+            // [NOTFOUND=return]等动作说明不是来源
+            if (source[0] == '[' || strchr(source, ']')) {
+                continue;
+            }
+            if (strcmp(source, "files") != 0 && strcmp(source, "dns") != 0) {
+                dns_nss_other = 1;
+            }
+        }
+    }
+    fclose(fp);
+}
+
+// 设置DNS服务器，逗号分隔的"地址[:端口]"；NULL表示使用系统配置
+int dns_set_servers(const char *servers) {
+    dns_server_count = 0;
+    dns_search_count = 0;
+    dns_ndots = 1;
+    dns_nss_other = 0;
+    dns_servers_explicit = (servers && *servers);
+
+    if (dns_servers_explicit) {
+        char *copy = strdup(servers);
+        if (!copy) {
+            return -1;
+        }
+        char *saveptr = NULL;
+        for (char *item = strtok_r(copy, ", ", &saveptr); item;
+             item = strtok_r(NULL, ", ", &saveptr)) {
+            if (add_server(item) < 0) {
+                printf("错误: 无效的DNS服务器 '%s'\n", item);
+                free(copy);
+                dns_server_count = 0;
+                return -1;
+            }
+        }
+        free(copy);
+    } else {
+        load_system_servers();
+        load_hosts_file();
+        load_nsswitch();
+    }
+
+    dns_servers_loaded = 1;
+    return 0;
+}
+
+// 构造查询报文，返回长度
+static int build_query(uint8_t *buf, uint16_t id, const char *qname, int type) {
+    memset(buf, 0, 12);
+    buf[0] = id >> 8;
+    buf[1] = id & 0xff;
+    buf[2] = 0x01;              // RD
+    buf[5] = 1;                 // QDCOUNT
+
+    int off = 12;
+    const char *label = qname;
+    while (*label) {
+        const char *dot = strchr(label, '.');
+        size_t len = dot ? (size_t)(dot - label) : strlen(label);
+        if (len == 0 || len > 63) {
+            return -1;
+        }
+        buf[off++] = (uint8_t)len;
+        memcpy(buf + off, label, len);
+        off += (int)len;
+        label += len;
+        if (*label == '.') label++;
+    }
+    buf[off++] = 0;
+    buf[off++] = 0;
+    buf[off++] = (uint8_t)type;
+    buf[off++] = 0;
+    buf[off++] = DNS_CLASS_IN;
+    return off;
+}
+
+// 读取可能被压缩的名字，off移到名字之后
+static int read_name(const uint8_t *msg, int len, int *off, char *out, size_t size) {
+    int pos = *off;
+    int jumped = 0;
+    int hops = 0;
+    size_t out_len = 0;
+
+    while (1) {
+        if (pos >= len) {
+            return -1;
+        }
+        uint8_t c = msg[pos];
+        if ((c & 0xc0) == 0xc0) {
+            if (pos + 1 >= len || ++hops > 16) {
+                return -1;
+            }
+            if (!jumped) {
+                *off = pos + 2;
+            }
+            pos = ((c & 0x3f) << 8) | msg[pos + 1];
+            jumped = 1;
+            continue;
+        }
+        if (c == 0) {
+            if (!jumped) {
+                *off = pos + 1;
+            }
+            break;
+        }
+        if (c > 63 || pos + 1 + c > len) {
+            return -1;
+        }
+        if (out_len + c + 2 > size) {
+            return -1;
+        }
+        if (out_len > 0) {
+            out[out_len++] = '.';
+        }
+        for (int i = 0; i < c; i++) {
+            out[out_len++] = (char)tolower(msg[pos + 1 + i]);
+        }
+        pos += 1 + c;
+    }
+
+    out[out_len] = '\0';
+    return 0;
+}
+
+// 解析响应。返回1为得到结果，0为名字不存在或没有该类型的记录，
+// -1为报文无效或与查询不符，-2为服务器失败需换服务器重试
+static int parse_response(const uint8_t *msg, int len, const char *qname, int type,
+                          DnsLookup *lookup, uint32_t *ttl) {
+    if (len < 12 || !(msg[2] & 0x80)) {
+        return -1;
+    }
+
+    int rcode = msg[3] & 0x0f;
+    int qdcount = (msg[4] << 8) | msg[5];
+    int ancount = (msg[6] << 8) | msg[7];
+    int off = 12;
+    char name[256];
+
+    // 问题部分必须与查询一致，防止错配
+    if (qdcount != 1 || read_name(msg, len, &off, name, sizeof(name)) < 0 ||
+        strcmp(name, qname) != 0 || off + 4 > len ||
+        ((msg[off] << 8) | msg[off + 1]) != type) {
+        return -1;
+    }
+    off += 4;
+
+    if (rcode == DNS_RCODE_NXDOMAIN) {
+        *ttl = DNS_NEGATIVE_TTL;
+        return 0;
+    }
+    if (rcode != DNS_RCODE_NOERROR) {
+        return -2;
+    }
+
+    for (int i = 0; i < ancount; i++) {
+        if (read_name(msg, len, &off, name, sizeof(name)) < 0 || off + 10 > len) {
+            return -1;
+        }
+        int rtype = (msg[off] << 8) | msg[off + 1];
+        uint32_t rttl = ((uint32_t)msg[off + 4] << 24) | ((uint32_t)msg[off + 5] << 16) |
+                        ((uint32_t)msg[off + 6] << 8) | msg[off + 7];
+        int rdlength = (msg[off + 8] << 8) | msg[off + 9];
+        off += 10;
+        if (off + rdlength > len) {
+            return -1;
+        }
+
+        // CNAME链上的A记录由递归服务器一并给出，取第一条所需类型的记录
+        if (rtype == DNS_TYPE_A && type == DNS_TYPE_A && rdlength == 4) {
+            memcpy(&lookup->addr.s_addr, msg + off, 4);
+            *ttl = rttl;
+            return 1;
+        }
+        if (rtype == DNS_TYPE_PTR && type == DNS_TYPE_PTR) {
+            int name_off = off;
+            if (read_name(msg, len, &name_off, lookup->name, sizeof(lookup->name)) < 0) {
+                return -1;
+            }
+            *ttl = rttl;
+            return 1;
+        }
+        off += rdlength;
+    }
+
+    *ttl = DNS_NEGATIVE_TTL;
+    return 0;
+}
+
+static uint16_t random_id(void) {
+    uint16_t id;
+    if (getrandom(&id, sizeof(id), 0) != sizeof(id)) {
+        id = (uint16_t)(rand() ^ dns_now_ms());
+    }
+    return id;
+}
+
+// 查询名和类型，供发送和校验使用
+static void lookup_qname(const DnsLookup *lookup, int type, char *qname, size_t size) {
+    if (type == DNS_TYPE_A) {
+        if (normalize_name(lookup->name, qname, size) < 0) {
+            qname[0] = '\0';
+        }
+    } else {
+        reverse_name(lookup->addr, qname, size);
+    }
+}
+
+static int send_query(int sock, const DnsLookup *lookup, int type, DnsInflight *q) {
+    uint8_t buf[DNS_PACKET_SIZE];
+    char qname[256];
+
+    lookup_qname(lookup, type, qname, sizeof(qname));
+    int len = build_query(buf, q->id, qname, type);
+    if (len < 0) {
+        return -1;
+    }
+
+    const struct sockaddr_in *server = &dns_servers[q->server % dns_server_count];
+    q->deadline_ms = dns_now_ms() + DNS_TIMEOUT_MS;
+    sendto(sock, buf, len, 0, (const struct sockaddr *)server, sizeof(*server));
+    return 0;
+}
+
+// 批量查询，type为DNS_TYPE_A或DNS_TYPE_PTR
+static void dns_query_batch(DnsLookup *lookups, int count, int type) {
+    int sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        return;
+    }
+
+    DnsInflight inflight[DNS_MAX_INFLIGHT];
+    int active = 0;
+    int next = 0;
+
+    while (next < count || active > 0) {
+        // 补满未完成的查询
+        while (active < DNS_MAX_INFLIGHT && next < count) {
+            int i = next++;
+            if (lookups[i].resolved) {
+                continue;
+            }
+            DnsInflight *q = &inflight[active];
+            q->lookup = i;
+            q->id = random_id();
+            q->server = 0;
+            q->tries = 1;
+            if (send_query(sock, &lookups[i], type, q) == 0) {
+                active++;
+            }
+        }
+
+        if (active == 0) {
+            break;
+        }
+
+        long now = dns_now_ms();
+        long wait = inflight[0].deadline_ms - now;
+        for (int i = 1; i < active; i++) {
+            if (inflight[i].deadline_ms - now < wait) {
+                wait = inflight[i].deadline_ms - now;
+            }
+        }
+        if (wait < 0) wait = 0;
+
+        struct pollfd pfd = { .fd = sock, .events = POLLIN };
+        if (poll(&pfd, 1, (int)wait) < 0 && errno != EINTR) {
+            break;
+        }
+
+        // 读取所有已到达的响应
+        uint8_t buf[DNS_PACKET_SIZE];
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        int len;
+        while ((len = recvfrom(sock, buf, sizeof(buf), MSG_DONTWAIT,
+                               (struct sockaddr *)&from, &from_len)) >= 0) {
+            from_len = sizeof(from);
+            if (len < 12) {
+                continue;
+            }
+            uint16_t id = (uint16_t)((buf[0] << 8) | buf[1]);
+
+            for (int i = 0; i < active; i++) {
+                DnsInflight *q = &inflight[i];
+                const struct sockaddr_in *server = &dns_servers[q->server % dns_server_count];
+                if (q->id != id || from.sin_addr.s_addr != server->sin_addr.s_addr ||
+                    from.sin_port != server->sin_port) {
+                    continue;
+                }
+
+                DnsLookup *lookup = &lookups[q->lookup];
+                char qname[256];
+                uint32_t ttl = 0;
+                lookup_qname(lookup, type, qname, sizeof(qname));
+                int ret = parse_response(buf, len, qname, type, lookup, &ttl);
+                if (ret == -1) {
+                    break;
+                }
+                if (ret == -2) {
+                    // 服务器失败，立即换下一个
+                    q->deadline_ms = 0;
+                    break;
+                }
+
+                // 名字不存在时记为-1，未显式指定服务器时仍交给系统解析器
+                lookup->resolved = ret ? 1 : -1;
+                cache_store(qname, type, ret, ttl, lookup->addr, ret && type == DNS_TYPE_PTR ? lookup->name : NULL);
+                inflight[i] = inflight[--active];
+                break;
+            }
+        }
+
+        // 超时的查询换服务器重发
+        now = dns_now_ms();
+        for (int i = 0; i < active; ) {
+            DnsInflight *q = &inflight[i];
+            if (q->deadline_ms > now) {
+                i++;
+                continue;
+            }
+            if (q->tries < DNS_TRIES) {
+                q->tries++;
+                q->server++;
+                q->id = random_id();
+                if (send_query(sock, &lookups[q->lookup], type, q) == 0) {
+                    i++;
+                    continue;
+                }
+            }
+            inflight[i] = inflight[--active];
+        }
+    }
+
+    close(sock);
+}
+
+// 从缓存取结果，返回仍需查询的数量
+static int resolve_from_cache(DnsLookup *lookups, int count, int type) {
+    int pending = 0;
+
+    pthread_mutex_lock(&dns_cache_lock);
+    for (int i = 0; i < count; i++) {
+        char qname[256];
+        lookups[i].resolved = 0;
+        lookup_qname(&lookups[i], type, qname, sizeof(qname));
+        if (!qname[0]) {
+            lookups[i].resolved = -1;   // 名字无效
+            continue;
+        }
+
+        DnsCacheEntry *entry = cache_find(qname, type);
+        if (!entry) {
+            pending++;
+            continue;
+        }
+        if (!entry->found) {
+            lookups[i].resolved = -1;
+        } else if (type == DNS_TYPE_A) {
+            lookups[i].addr = entry->addr;
+            lookups[i].resolved = 1;
+        } else {
+            snprintf(lookups[i].name, sizeof(lookups[i].name), "%s", entry->name);
+            lookups[i].resolved = 1;
+        }
+    }
+    pthread_mutex_unlock(&dns_cache_lock);
+
+    return pending;
+}
+
+// 待查询的名字，用于合并同一批中的重复名字
+typedef struct {
+    char qname[256];
+    int index;
+} DnsPending;
+
+static int compare_pending(const void *a, const void *b) {
+    const DnsPending *x = a, *y = b;
+    int cmp = strcmp(x->qname, y->qname);
+    return cmp ? cmp : x->index - y->index;
+}
+
+// 同名查询只发一次，重复的条目标记为-2，查询结束后从第一个条目复制结果
+static void query_unique(DnsLookup *lookups, int count, int pending, int type) {
+    DnsPending *names = malloc(sizeof(DnsPending) * pending);
+    int *primary = malloc(sizeof(int) * count);
+    if (!names || !primary) {
+        free(names);
+        free(primary);
+        dns_query_batch(lookups, count, type);
+        return;
+    }
+
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        primary[i] = i;
+        if (lookups[i].resolved == 0) {
+            lookup_qname(&lookups[i], type, names[n].qname, sizeof(names[n].qname));
+            names[n].index = i;
+            n++;
+        }
+    }
+    qsort(names, n, sizeof(DnsPending), compare_pending);
+    for (int i = 1; i < n; i++) {
+        if (strcmp(names[i].qname, names[i - 1].qname) == 0) {
+            primary[names[i].index] = primary[names[i - 1].index];
+            lookups[names[i].index].resolved = -2;
+        }
+    }
+
+    dns_query_batch(lookups, count, type);
+
+    for (int i = 0; i < count; i++) {
+        if (primary[i] != i) {
+            const DnsLookup *first = &lookups[primary[i]];
+            lookups[i].resolved = first->resolved;
+            if (type == DNS_TYPE_A) {
+                lookups[i].addr = first->addr;
+            } else {
+                memcpy(lookups[i].name, first->name, sizeof(lookups[i].name));
+            }
+        }
+    }
+
+    free(names);
+    free(primary);
+}
+
+// 名字按search列表的第n个查询名，没有第n个时返回-1。
+// 以点结尾的名字只查本身；点数不少于ndots时先查本身再补全，否则先补全最后查本身
+static int search_candidate(const char *name, int n, char *out, size_t size) {
+    size_t len = strlen(name);
+    if (len > 0 && name[len - 1] == '.') {
+        return n == 0 ? (snprintf(out, size, "%s", name) < (int)size ? 0 : -1) : -1;
+    }
+
+    int dots = 0;
+    for (const char *p = name; *p; p++) {
+        dots += *p == '.';
+    }
+    int as_is = dots >= dns_ndots ? 0 : dns_search_count;
+    if (n == as_is) {
+        return snprintf(out, size, "%s", name) < (int)size ? 0 : -1;
+    }
+    int domain = n > as_is ? n - 1 : n;
+    if (domain >= dns_search_count) {
+        return -1;
+    }
+    return snprintf(out, size, "%s.%s", name, dns_search[domain]) < (int)size ? 0 : -1;
+}
+
+// 按search列表依次查询各个候选名，取第一个有结果的；
+// /etc/hosts和缓存中的原名优先，与系统解析器先查hosts文件一致
+static void query_search_list(DnsLookup *lookups, int count) {
+    DnsLookup *batch = malloc(sizeof(DnsLookup) * count);
+    int *owner = malloc(sizeof(int) * count);
+    if (!batch || !owner) {
+        free(batch);
+        free(owner);
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        lookups[i].resolved = 0;
+    }
+    resolve_from_cache(lookups, count, DNS_TYPE_A);
+    for (int i = 0; i < count; i++) {
+        if (lookups[i].resolved != 1) {
+            lookups[i].resolved = 0;
+        }
+    }
+
+    for (int n = 0; n <= dns_search_count; n++) {
+        int m = 0;
+        for (int i = 0; i < count; i++) {
+            if (lookups[i].resolved == 1 ||
+                search_candidate(lookups[i].name, n, batch[m].name, sizeof(batch[m].name)) < 0) {
+                continue;
+            }
+            owner[m++] = i;
+        }
+        if (m == 0) {
+            continue;
+        }
+
+        int pending = resolve_from_cache(batch, m, DNS_TYPE_A);
+        if (pending > 0 && dns_server_count > 0) {
+            query_unique(batch, m, pending, DNS_TYPE_A);
+        }
+        for (int j = 0; j < m; j++) {
+            if (batch[j].resolved == 1) {
+                lookups[owner[j]].addr = batch[j].addr;
+                lookups[owner[j]].resolved = 1;
+            }
+        }
+    }
+
+    // 所有候选名都没有结果的名字记为不存在
+    for (int i = 0; i < count; i++) {
+        if (lookups[i].resolved != 1) {
+            lookups[i].resolved = -1;
+        }
+    }
+    free(batch);
+    free(owner);
+}
+
+static int dns_lookup(DnsLookup *lookups, int count, int type) {
+    if (!dns_servers_loaded) {
+        dns_set_servers(NULL);
+    }
+
+    if (type == DNS_TYPE_A && dns_search_count > 0) {
+        query_search_list(lookups, count);
+    } else {
+        int pending = resolve_from_cache(lookups, count, type);
+        if (pending > 0 && dns_server_count > 0) {
+            query_unique(lookups, count, pending, type);
+        }
+    }
+
+    int resolved = 0;
+    for (int i = 0; i < count; i++) {
+        // DNS没有应答时交给系统解析器。正向解析时名字不存在只在nsswitch.conf
+        // 配置了其他来源(如mDNS、LDAP)时才交给它，否则系统解析器只会逐个重复同样的DNS查询
+        int fallback = lookups[i].resolved == 0 ||
+                       (lookups[i].resolved == -1 && type == DNS_TYPE_A && dns_nss_other);
+        if (fallback && !dns_servers_explicit) {
+            if (type == DNS_TYPE_A) {
+                struct addrinfo hints, *res = NULL;
+                memset(&hints, 0, sizeof(hints));
+                hints.ai_family = AF_INET;
+                hints.ai_socktype = SOCK_STREAM;
+                if (getaddrinfo(lookups[i].name, NULL, &hints, &res) == 0 && res) {
+                    lookups[i].addr = ((struct sockaddr_in *)res->ai_addr)->sin_addr;
+                    lookups[i].resolved = 1;
+                    freeaddrinfo(res);
+                }
+            } else {
+                struct sockaddr_in sa;
+                memset(&sa, 0, sizeof(sa));
+                sa.sin_family = AF_INET;
+                sa.sin_addr = lookups[i].addr;
+                if (getnameinfo((struct sockaddr *)&sa, sizeof(sa), lookups[i].name,
+                                sizeof(lookups[i].name), NULL, 0, NI_NAMEREQD) == 0) {
+                    lookups[i].resolved = 1;
+                }
+            }
+        }
+        if (lookups[i].resolved == 1) {
+            resolved++;
+        } else {
+            lookups[i].resolved = 0;
+        }
+    }
+    return resolved;
+}
+
+// 正向解析: 由name得到addr，返回解析成功的数量
+int dns_resolve(DnsLookup *lookups, int count) {
+    return dns_lookup(lookups, count, DNS_TYPE_A);
+}
+
+// 反向解析: 由addr得到name，返回解析成功的数量
+int dns_reverse(DnsLookup *lookups, int count) {
+    return dns_lookup(lookups, count, DNS_TYPE_PTR);
+}
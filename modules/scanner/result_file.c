@@ -0,0 +1,665 @@
+/**
+ * 二进制结果文件
+ * 结果按块追加写入，每块最多RESULT_FILE_BLOCK_ROWS行，块内按列存放
+ * （地址、端口、协议、状态、服务、响应时间、时间戳和各字符串的偏移），
+ * 每列可以单独用差分+变长整数压缩。文件末尾是字符串区、服务名称表和块索引，
+ * 最后改写文件头，因此文件头中的块索引偏移为0表示写入未完成。
+ * 读取时整个文件映射到内存，未压缩的列直接使用映射中的数据
+ *
+ * 文件布局:
+ *   文件头 | 块头 列 列 ... | 块头 列 列 ... | 字符串区 | 服务名称表 | 块索引
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "port_scanner.h"
+
+#define RESULT_FILE_MAGIC 0x524b5450U   // "PTKR"
+#define RESULT_FILE_VERSION 1
+#define RESULT_FILE_ALIGN 8
+
+// 列编号
+enum {
+    COL_ADDR = 0,
+    COL_PORT,
+    COL_PROTOCOL,
+    COL_STATE,
+    COL_SERVICE,
+    COL_RTT,
+    COL_TIMESTAMP,
+    COL_HOSTNAME,
+    COL_BANNER,
+    COL_PRODUCT,
+    COL_VERSION,
+    COL_COUNT
+};
+
+// 列的编码
+enum {
+    CODEC_RAW = 0,      // 定长数组
+    CODEC_DELTA         // 与前一行的差做zigzag + LEB128变长整数
+};
+
+// 每列元素的字节数，时间戳为有符号数，响应时间为有符号32位
+static const uint8_t column_width[COL_COUNT] = { 4, 2, 1, 1, 2, 4, 8, 4, 4, 4, 4 };
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    uint64_t row_count;
+    uint32_t block_count;
+    uint32_t service_count;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+    uint64_t services_offset;     // service_count个uint32，字符串区中的偏移
+    uint64_t index_offset;        // block_count个BlockIndex，0表示文件未写完
+    int64_t scan_time;            // 扫描时间（Unix秒）
+    uint32_t target;              // 扫描目标，字符串区中的偏移
+    uint32_t reserved;
+} FileHeader;
+
+typedef struct {
+    uint64_t offset;              // 列数据在文件中的偏移
+    uint32_t size;                // 列数据的字节数
+    uint8_t codec;
+    uint8_t reserved[3];
+} ColumnInfo;
+
+typedef struct {
+    uint32_t rows;
+    uint32_t reserved;
+    ColumnInfo columns[COL_COUNT];
+} BlockHeader;
+
+// 块索引，附带块内地址和端口的范围，查询时可以跳过不相关的块
+typedef struct {
+    uint64_t offset;              // 块头在文件中的偏移
+    uint32_t rows;
+    uint32_t min_addr;            // 主机字节序
+    uint32_t max_addr;
+    uint16_t min_port;
+    uint16_t max_port;
+} BlockIndex;
+
+struct ResultFileWriter {
+    FILE *fp;
+    ResultStore *store;
+    int compress;
+    FileHeader header;
+
+    BlockIndex *index;
+    size_t index_capacity;
+
+    // 文件自己的字符串区，偏移0为空字符串
+    char *strings;
+    size_t strings_len;
+    size_t strings_capacity;
+    // 结果存储中的偏移到文件字符串区偏移的映射（存储中的字符串已去重）
+    uint32_t *map_keys;
+    uint32_t *map_values;
+    size_t map_capacity;
+    size_t map_count;
+
+    // 服务名称下标到文件服务名称表下标+1的映射
+    uint16_t *service_map;
+    uint32_t *services;
+    uint32_t service_count;
+
+    uint8_t *scratch;             // 列编码缓冲
+    int failed;
+};
+
+struct ResultFile {
+    int fd;
+    const uint8_t *map;
+    size_t size;
+    const FileHeader *header;
+    const BlockIndex *index;
+    const char *strings;
+    const uint32_t *services;
+};
+
+// 写入并对齐到RESULT_FILE_ALIGN，返回写入位置
+static uint64_t write_aligned(ResultFileWriter *w, const void *data, size_t len) {
+    static const uint8_t zeros[RESULT_FILE_ALIGN];
+    long pos = ftell(w->fp);
+    if (pos < 0) {
+        w->failed = 1;
+        return 0;
+    }
+    size_t pad = (RESULT_FILE_ALIGN - (size_t)pos % RESULT_FILE_ALIGN) % RESULT_FILE_ALIGN;
+    if ((pad && fwrite(zeros, 1, pad, w->fp) != pad) ||
+        (len && fwrite(data, 1, len, w->fp) != len)) {
+        w->failed = 1;
+    }
+    return (uint64_t)pos + pad;
+}
+
+// 把字符串追加到文件字符串区，返回偏移
+static uint32_t add_string(ResultFileWriter *w, const char *s) {
+    size_t len = strlen(s) + 1;
+    if (len == 1) {
+        return 0;
+    }
+    if (w->strings_len + len > UINT32_MAX) {
+        w->failed = 1;
+        return 0;
+    }
+    if (w->strings_len + len > w->strings_capacity) {
+        size_t capacity = w->strings_capacity * 2;
+        while (capacity < w->strings_len + len) capacity *= 2;
+        char *strings = realloc(w->strings, capacity);
+        if (!strings) {
+            w->failed = 1;
+            return 0;
+        }
+        w->strings = strings;
+        w->strings_capacity = capacity;
+    }
+    uint32_t offset = (uint32_t)w->strings_len;
+    memcpy(w->strings + w->strings_len, s, len);
+    w->strings_len += len;
+    return offset;
+}
+
+static uint32_t hash_offset(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    return x;
+}
+
+// 结果存储中的字符串偏移转换为文件中的偏移
+static uint32_t map_string(ResultFileWriter *w, uint32_t store_offset) {
+    if (store_offset == 0) {
+        return 0;
+    }
+    if ((w->map_count + 1) * 2 > w->map_capacity) {
+        size_t capacity = w->map_capacity ? w->map_capacity * 2 : 1024;
+        uint32_t *keys = calloc(capacity, sizeof(uint32_t));
+        uint32_t *values = malloc(capacity * sizeof(uint32_t));
+        if (!keys || !values) {
+            free(keys);
+            free(values);
+            w->failed = 1;
+            return 0;
+        }
+        for (size_t i = 0; i < w->map_capacity; i++) {
+            if (w->map_keys[i]) {
+                size_t pos = hash_offset(w->map_keys[i]) & (capacity - 1);
+                while (keys[pos]) pos = (pos + 1) & (capacity - 1);
+                keys[pos] = w->map_keys[i];
+                values[pos] = w->map_values[i];
+            }
+        }
+        free(w->map_keys);
+        free(w->map_values);
+        w->map_keys = keys;
+        w->map_values = values;
+        w->map_capacity = capacity;
+    }
+
+    size_t pos = hash_offset(store_offset) & (w->map_capacity - 1);
+    while (w->map_keys[pos]) {
+        if (w->map_keys[pos] == store_offset) {
+            return w->map_values[pos];
+        }
+        pos = (pos + 1) & (w->map_capacity - 1);
+    }
+    w->map_keys[pos] = store_offset;
+    w->map_values[pos] = add_string(w, result_string(w->store, store_offset));
+    w->map_count++;
+    return w->map_values[pos];
+}
+
+// 服务名称下标转换为文件服务名称表的下标
+static uint16_t map_service(ResultFileWriter *w, uint16_t id) {
+    if (!w->service_map[id]) {
+        if (w->service_count == UINT16_MAX) {
+            return 0;
+        }
+        w->services[w->service_count] = add_string(w, service_name(id));
+        w->service_map[id] = (uint16_t)++w->service_count;
+    }
+    return w->service_map[id] - 1;
+}
+
+// 创建结果文件，字符串来自store；compress为真时对能变小的列做差分压缩
+ResultFileWriter* result_file_create(const char *path, ResultStore *store,
+                                     const char *target, time_t scan_time, int compress) {
+    ResultFileWriter *w = calloc(1, sizeof(ResultFileWriter));
+    if (!w) {
+        return NULL;
+    }
+    w->store = store;
+    w->compress = compress;
+    w->strings_capacity = 4096;
+    w->strings = malloc(w->strings_capacity);
+    w->service_map = calloc(65536, sizeof(uint16_t));
+    w->services = malloc(65536 * sizeof(uint32_t));
+    // 最坏情况下每个值编码为10字节
+    w->scratch = malloc((size_t)RESULT_FILE_BLOCK_ROWS * 10);
+    w->fp = fopen(path, "wb");
+    if (!w->strings || !w->service_map || !w->services || !w->scratch || !w->fp) {
+        if (!w->fp) {
+            printf("错误: 无法创建文件 %s (%s)\n", path, strerror(errno));
+        } else {
+            fclose(w->fp);
+        }
+        free(w->strings);
+        free(w->service_map);
+        free(w->services);
+        free(w->scratch);
+        free(w);
+        return NULL;
+    }
+    w->strings[0] = '\0';
+    w->strings_len = 1;
+
+    w->header.magic = RESULT_FILE_MAGIC;
+    w->header.version = RESULT_FILE_VERSION;
+    w->header.scan_time = (int64_t)scan_time;
+    w->header.target = add_string(w, target ? target : "");
+
+    // 先写入未完成的文件头，结束时改写
+    if (fwrite(&w->header, sizeof(w->header), 1, w->fp) != 1) {
+        w->failed = 1;
+    }
+    return w;
+}
+
+static uint64_t zigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v) {
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static int64_t load_value(const void *column, int width, int signed_value, size_t i) {
+    switch (width) {
+        case 1: return ((const uint8_t *)column)[i];
+        case 2: return ((const uint16_t *)column)[i];
+        case 4:
+            if (signed_value) {
+                return ((const int32_t *)column)[i];
+            }
+            return ((const uint32_t *)column)[i];
+        default: return ((const int64_t *)column)[i];
+    }
+}
+
+static void store_value(void *column, int width, size_t i, int64_t v) {
+    switch (width) {
+        case 1: ((uint8_t *)column)[i] = (uint8_t)v; break;
+        case 2: ((uint16_t *)column)[i] = (uint16_t)v; break;
+        case 4: ((uint32_t *)column)[i] = (uint32_t)v; break;
+        default: ((int64_t *)column)[i] = v; break;
+    }
+}
+
+// 差分编码一列，返回编码后的长度
+static size_t delta_encode(const void *column, int width, int signed_value, size_t rows, uint8_t *out) {
+    size_t n = 0;
+    int64_t prev = 0;
+    for (size_t i = 0; i < rows; i++) {
+        int64_t v = load_value(column, width, signed_value, i);
+        uint64_t u = zigzag(v - prev);
+        prev = v;
+        while (u >= 0x80) {
+            out[n++] = (uint8_t)(u | 0x80);
+            u >>= 7;
+        }
+        out[n++] = (uint8_t)u;
+    }
+    return n;
+}
+
+// 解码差分编码的列，数据不完整时返回-1
+static int delta_decode(const uint8_t *in, size_t size, int width, size_t rows, void *column) {
+    size_t n = 0;
+    int64_t prev = 0;
+    for (size_t i = 0; i < rows; i++) {
+        uint64_t u = 0;
+        int shift = 0;
+        while (1) {
+            if (n >= size || shift > 63) {
+                return -1;
+            }
+            uint8_t byte = in[n++];
+            u |= (uint64_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                break;
+            }
+            shift += 7;
+        }
+        prev += unzigzag(u);
+        store_value(column, width, i, prev);
+    }
+    return 0;
+}
+
+// 写入一块
+static void write_block(ResultFileWriter *w, const ScanResult *results, size_t rows) {
+    // 先按列整理
+    uint8_t *columns[COL_COUNT];
+    for (int c = 0; c < COL_COUNT; c++) {
+        columns[c] = malloc(rows * column_width[c]);
+        if (!columns[c]) {
+            while (c-- > 0) free(columns[c]);
+            w->failed = 1;
+            return;
+        }
+    }
+
+    BlockIndex entry = { .rows = (uint32_t)rows, .min_addr = UINT32_MAX, .min_port = UINT16_MAX };
+    for (size_t i = 0; i < rows; i++) {
+        const ScanResult *r = &results[i];
+        uint32_t addr = ntohl(r->addr.s_addr);
+        if (addr < entry.min_addr) entry.min_addr = addr;
+        if (addr > entry.max_addr) entry.max_addr = addr;
+        if (r->port < entry.min_port) entry.min_port = r->port;
+        if (r->port > entry.max_port) entry.max_port = r->port;
+
+        ((uint32_t *)columns[COL_ADDR])[i] = addr;
+        ((uint16_t *)columns[COL_PORT])[i] = r->port;
+        columns[COL_PROTOCOL][i] = r->protocol;
+        columns[COL_STATE][i] = r->state;
+        ((uint16_t *)columns[COL_SERVICE])[i] = map_service(w, r->service);
+        ((int32_t *)columns[COL_RTT])[i] = r->response_time;
+        ((int64_t *)columns[COL_TIMESTAMP])[i] = r->timestamp_us;
+        ((uint32_t *)columns[COL_HOSTNAME])[i] = map_string(w, r->hostname);
+        ((uint32_t *)columns[COL_BANNER])[i] = map_string(w, r->banner);
+        ((uint32_t *)columns[COL_PRODUCT])[i] = map_string(w, r->product);
+        ((uint32_t *)columns[COL_VERSION])[i] = map_string(w, r->version);
+    }
+
+    // 块头占位，列写完后改写
+    BlockHeader header;
+    memset(&header, 0, sizeof(header));
+    header.rows = (uint32_t)rows;
+    entry.offset = write_aligned(w, &header, sizeof(header));
+
+    for (int c = 0; c < COL_COUNT; c++) {
+        const void *data = columns[c];
+        size_t size = rows * column_width[c];
+        uint8_t codec = CODEC_RAW;
+        if (w->compress) {
+            size_t encoded = delta_encode(columns[c], column_width[c],
+                                          c == COL_RTT || c == COL_TIMESTAMP, rows, w->scratch);
+            if (encoded < size) {
+                data = w->scratch;
+                size = encoded;
+                codec = CODEC_DELTA;
+            }
+        }
+        header.columns[c].offset = write_aligned(w, data, size);
+        header.columns[c].size = (uint32_t)size;
+        header.columns[c].codec = codec;
+        free(columns[c]);
+    }
+
+    long end = ftell(w->fp);
+    if (fseek(w->fp, (long)entry.offset, SEEK_SET) != 0 ||
+        fwrite(&header, sizeof(header), 1, w->fp) != 1 ||
+        fseek(w->fp, end, SEEK_SET) != 0) {
+        w->failed = 1;
+    }
+
+    if (w->header.block_count == w->index_capacity) {
+        size_t capacity = w->index_capacity ? w->index_capacity * 2 : 64;
+        BlockIndex *index = realloc(w->index, capacity * sizeof(BlockIndex));
+        if (!index) {
+            w->failed = 1;
+            return;
+        }
+        w->index = index;
+        w->index_capacity = capacity;
+    }
+    w->index[w->header.block_count++] = entry;
+    w->header.row_count += rows;
+}
+
+// 追加结果，超过块大小时分为多块
+int result_file_append(ResultFileWriter *w, const ScanResult *results, size_t count) {
+    for (size_t i = 0; i < count && !w->failed; i += RESULT_FILE_BLOCK_ROWS) {
+        size_t rows = count - i < RESULT_FILE_BLOCK_ROWS ? count - i : RESULT_FILE_BLOCK_ROWS;
+        write_block(w, results + i, rows);
+    }
+    return w->failed ? -1 : 0;
+}
+
+// 写入字符串区、服务名称表和块索引，改写文件头并关闭，失败时返回-1
+int result_file_finish(ResultFileWriter *w) {
+    w->header.strings_offset = write_aligned(w, w->strings, w->strings_len);
+    w->header.strings_size = w->strings_len;
+    w->header.services_offset = write_aligned(w, w->services, w->service_count * sizeof(uint32_t));
+    w->header.service_count = w->service_count;
+    w->header.index_offset = write_aligned(w, w->index, w->header.block_count * sizeof(BlockIndex));
+
+    if (fseek(w->fp, 0, SEEK_SET) != 0 ||
+        fwrite(&w->header, sizeof(w->header), 1, w->fp) != 1) {
+        w->failed = 1;
+    }
+    if (fclose(w->fp) != 0) {
+        w->failed = 1;
+    }
+
+    int ret = w->failed ? -1 : 0;
+    free(w->index);
+    free(w->strings);
+    free(w->map_keys);
+    free(w->map_values);
+    free(w->service_map);
+    free(w->services);
+    free(w->scratch);
+    free(w);
+    return ret;
+}
+
+// 区间[offset, offset + size)是否在文件内
+static int in_file(const ResultFile *file, uint64_t offset, uint64_t size) {
+    return offset <= file->size && size <= file->size - offset;
+}
+
+// 打开结果文件，不是完整的结果文件时返回NULL
+ResultFile* result_file_open(const char *path) {
+    ResultFile *file = calloc(1, sizeof(ResultFile));
+    if (!file) {
+        return NULL;
+    }
+
+    file->fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (file->fd < 0 || fstat(file->fd, &st) < 0) {
+        printf("错误: 无法打开结果文件 %s (%s)\n", path, strerror(errno));
+        if (file->fd >= 0) close(file->fd);
+        free(file);
+        return NULL;
+    }
+    file->size = (size_t)st.st_size;
+
+    if (file->size >= sizeof(FileHeader)) {
+        void *map = mmap(NULL, file->size, PROT_READ, MAP_SHARED, file->fd, 0);
+        if (map != MAP_FAILED) {
+            file->map = map;
+            // 查询时按块顺序读取
+            madvise(map, file->size, MADV_WILLNEED);
+        }
+    }
+
+    const FileHeader *header = (const FileHeader *)file->map;
+    if (!header || header->magic != RESULT_FILE_MAGIC || header->version != RESULT_FILE_VERSION ||
+        header->index_offset == 0 ||
+        !in_file(file, header->strings_offset, header->strings_size) || header->strings_size == 0 ||
+        !in_file(file, header->services_offset, (uint64_t)header->service_count * sizeof(uint32_t)) ||
+        !in_file(file, header->index_offset, (uint64_t)header->block_count * sizeof(BlockIndex))) {
+        printf("错误: %s 不是完整的结果文件\n", path);
+        result_file_close(file);
+        return NULL;
+    }
+
+    file->header = header;
+    file->strings = (const char *)file->map + header->strings_offset;
+    file->services = (const uint32_t *)(file->map + header->services_offset);
+    file->index = (const BlockIndex *)(file->map + header->index_offset);
+    // 字符串区必须以0结尾，否则偏移可能越界
+    if (file->strings[header->strings_size - 1] != '\0' || header->target >= header->strings_size) {
+        printf("错误: %s 的字符串区已损坏\n", path);
+        result_file_close(file);
+        return NULL;
+    }
+    return file;
+}
+
+void result_file_close(ResultFile *file) {
+    if (!file) {
+        return;
+    }
+    if (file->map) {
+        munmap((void *)file->map, file->size);
+    }
+    close(file->fd);
+    free(file);
+}
+
+uint64_t result_file_rows(const ResultFile *file) {
+    return file->header->row_count;
+}
+
+uint32_t result_file_blocks(const ResultFile *file) {
+    return file->header->block_count;
+}
+
+const char* result_file_target(const ResultFile *file) {
+    return file->strings + file->header->target;
+}
+
+time_t result_file_time(const ResultFile *file) {
+    return (time_t)file->header->scan_time;
+}
+
+// 文件字符串区中的字符串，偏移无效时返回空字符串
+const char* result_file_string(const ResultFile *file, uint32_t offset) {
+    return offset < file->header->strings_size ? file->strings + offset : "";
+}
+
+uint64_t result_file_block_rows(const ResultFile *file, uint32_t block) {
+    return file->index[block].rows;
+}
+
+// 文件服务名称表
+uint32_t result_file_services(const ResultFile *file) {
+    return file->header->service_count;
+}
+
+const char* result_file_service(const ResultFile *file, uint32_t index) {
+    return index < file->header->service_count ?
+           result_file_string(file, file->services[index]) : "unknown";
+}
+
+// 块内地址和端口的范围，地址为主机字节序
+void result_file_block_range(const ResultFile *file, uint32_t block,
+                             uint32_t *min_addr, uint32_t *max_addr, int *min_port, int *max_port) {
+    const BlockIndex *entry = &file->index[block];
+    *min_addr = entry->min_addr;
+    *max_addr = entry->max_addr;
+    *min_port = entry->min_port;
+    *max_port = entry->max_port;
+}
+
+// 读取一块的各列。未压缩的列直接指向映射，压缩的列解码到cols->owned中
+int result_file_read_block(const ResultFile *file, uint32_t block, ResultColumns *cols) {
+    memset(cols, 0, sizeof(*cols));
+    if (block >= file->header->block_count) {
+        return -1;
+    }
+
+    const BlockIndex *entry = &file->index[block];
+    if (!in_file(file, entry->offset, sizeof(BlockHeader)) || entry->offset % RESULT_FILE_ALIGN) {
+        return -1;
+    }
+    const BlockHeader *header = (const BlockHeader *)(file->map + entry->offset);
+    // 查询按索引中的行数遍历和预分配，块头与之不一致时文件已损坏
+    if (header->rows != entry->rows) {
+        return -1;
+    }
+    size_t rows = header->rows;
+
+    // 压缩列解码后的总大小
+    size_t owned_size = 0;
+    for (int c = 0; c < COL_COUNT; c++) {
+        if (header->columns[c].codec == CODEC_DELTA) {
+            owned_size += (rows * column_width[c] + RESULT_FILE_ALIGN - 1) & ~(size_t)(RESULT_FILE_ALIGN - 1);
+        }
+    }
+    uint8_t *owned = NULL;
+    if (owned_size > 0 && !(owned = malloc(owned_size))) {
+        return -1;
+    }
+
+    const void *data[COL_COUNT];
+    size_t used = 0;
+    for (int c = 0; c < COL_COUNT; c++) {
+        const ColumnInfo *info = &header->columns[c];
+        if (!in_file(file, info->offset, info->size)) {
+            free(owned);
+            return -1;
+        }
+        const uint8_t *src = file->map + info->offset;
+        if (info->codec == CODEC_RAW && info->size == rows * column_width[c] &&
+            info->offset % RESULT_FILE_ALIGN == 0) {
+            data[c] = src;
+        } else if (info->codec == CODEC_DELTA &&
+                   delta_decode(src, info->size, column_width[c], rows, owned + used) == 0) {
+            data[c] = owned + used;
+            used += (rows * column_width[c] + RESULT_FILE_ALIGN - 1) & ~(size_t)(RESULT_FILE_ALIGN - 1);
+        } else {
+            free(owned);
+            return -1;
+        }
+    }
+
+    cols->rows = rows;
+    cols->addr = data[COL_ADDR];
+    cols->port = data[COL_PORT];
+    cols->protocol = data[COL_PROTOCOL];
+    cols->state = data[COL_STATE];
+    cols->service = data[COL_SERVICE];
+    cols->response_time = data[COL_RTT];
+    cols->timestamp_us = data[COL_TIMESTAMP];
+    cols->hostname = data[COL_HOSTNAME];
+    cols->banner = data[COL_BANNER];
+    cols->product = data[COL_PRODUCT];
+    cols->version = data[COL_VERSION];
+    cols->owned = owned;
+    return 0;
+}
+
+void result_columns_free(ResultColumns *cols) {
+    free(cols->owned);
+    cols->owned = NULL;
+}
+
+// 块中第i行转换为输出用的结果
+void result_file_row(const ResultFile *file, const ResultColumns *cols, size_t i, ResultRow *row) {
+    uint16_t service = cols->service[i];
+    row->addr.s_addr = htonl(cols->addr[i]);
+    row->port = cols->port[i];
+    row->protocol = result_protocol_name(cols->protocol[i]);
+    row->state = port_state_name((PortState)cols->state[i]);
+    row->service = result_file_service(file, service);
+    row->hostname = result_file_string(file, cols->hostname[i]);
+    row->banner = result_file_string(file, cols->banner[i]);
+    row->product = result_file_string(file, cols->product[i]);
+    row->version = result_file_string(file, cols->version[i]);
+    row->response_time = cols->response_time[i];
+    row->timestamp_us = cols->timestamp_us[i];
+}
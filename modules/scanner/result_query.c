@@ -0,0 +1,906 @@
+/**
+ * 结果文件查询
+ * 第一次查询时为结果文件建立二级索引，保存在"<结果文件>.idx"，之后映射到内存使用。
+ * 端口、服务、主机、横幅和"产品 版本"各一个索引，每个索引是按键排序的
+ * 倒排表: 不同的键、每个键的起始位置和按行号排序的行号。
+ * 查询时先用能选出最少行的索引得到候选行，再按行号顺序读取各块并检查其余条件
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include "port_scanner.h"
+
+#define INDEX_FILE_MAGIC 0x494b5450U   // "PTKI"
+#define INDEX_FILE_VERSION 1
+#define INDEX_ALIGN 8
+
+// 索引编号
+enum {
+    INDEX_PORT = 0,
+    INDEX_SERVICE,      // 键为文件服务名称表的下标
+    INDEX_HOST,         // 键为主机字节序的地址
+    INDEX_BANNER,       // 键为横幅在文件字符串区中的偏移（字符串已去重）
+    INDEX_VERSION,      // 键为(产品, 版本)组合的编号，组合表另外保存
+    INDEX_COUNT
+};
+
+static const char *index_names[INDEX_COUNT] = { "port", "service", "host", "banner", "version" };
+
+typedef struct {
+    uint64_t key_count;
+    uint64_t keys_offset;         // key_count个uint32，升序
+    uint64_t starts_offset;       // key_count + 1个uint64
+    uint64_t rows_offset;         // row_count个uint32
+} IndexSection;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t source_size;         // 建立索引时结果文件的大小和修改时间，不一致时重建
+    int64_t source_mtime;
+    uint64_t row_count;
+    uint64_t pair_count;          // (产品, 版本)组合表，每项两个uint32偏移
+    uint64_t pairs_offset;
+    IndexSection sections[INDEX_COUNT];
+} IndexHeader;
+
+// 一个倒排索引
+typedef struct {
+    uint64_t key_count;
+    const uint32_t *keys;
+    const uint64_t *starts;
+    const uint32_t *rows;
+} Postings;
+
+typedef struct {
+    void *map;                    // 从索引文件映射，或为NULL
+    size_t map_size;
+    void *owned[INDEX_COUNT * 3 + 1];   // 本次建立、未映射时持有的内存
+    Postings postings[INDEX_COUNT];
+    const uint32_t *pairs;
+    uint64_t pair_count;
+} QueryIndex;
+
+// 一个条件对应的若干键区间 [lo, hi)（下标为倒排表中键的下标）
+typedef struct {
+    uint64_t *lo;
+    uint64_t *hi;
+    size_t count;
+    size_t capacity;
+    uint64_t rows;                // 命中的总行数
+} KeySpans;
+
+static int span_add(KeySpans *spans, const Postings *p, uint64_t lo, uint64_t hi) {
+    if (lo >= hi) {
+        return 0;
+    }
+    if (spans->count == spans->capacity) {
+        size_t capacity = spans->capacity ? spans->capacity * 2 : 16;
+        uint64_t *l = realloc(spans->lo, capacity * sizeof(uint64_t));
+        if (!l) return -1;
+        spans->lo = l;
+        uint64_t *h = realloc(spans->hi, capacity * sizeof(uint64_t));
+        if (!h) return -1;
+        spans->hi = h;
+        spans->capacity = capacity;
+    }
+    spans->lo[spans->count] = lo;
+    spans->hi[spans->count] = hi;
+    spans->count++;
+    spans->rows += p->starts[hi] - p->starts[lo];
+    return 0;
+}
+
+static void spans_free(KeySpans *spans) {
+    free(spans->lo);
+    free(spans->hi);
+    memset(spans, 0, sizeof(*spans));
+}
+
+// 第一个不小于key的键的下标
+static uint64_t lower_bound(const Postings *p, uint32_t key) {
+    uint64_t lo = 0, hi = p->key_count;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (p->keys[mid] < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// 键在[start, end]内的区间
+static int spans_add_range(KeySpans *spans, const Postings *p, uint32_t start, uint32_t end) {
+    uint64_t lo = lower_bound(p, start);
+    uint64_t hi = (end == UINT32_MAX) ? p->key_count : lower_bound(p, end + 1);
+    return span_add(spans, p, lo, hi);
+}
+
+// ---------------------------------------------------------------- 建立索引
+
+// (产品, 版本)组合到编号的哈希表
+typedef struct {
+    uint64_t *keys;               // product << 32 | version，0为空槽
+    uint32_t *ids;
+    size_t capacity;
+    uint32_t *pairs;              // 按编号排列的组合
+    uint64_t count;
+} PairTable;
+
+static uint64_t hash_pair(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// 组合的编号，(0, 0)即没有版本信息的行编号为0
+static int pair_id(PairTable *table, uint32_t product, uint32_t version, uint32_t *id) {
+    uint64_t key = ((uint64_t)product << 32) | version;
+    if (key == 0) {
+        *id = 0;
+        return 0;
+    }
+    if ((table->count + 1) * 2 > table->capacity) {
+        size_t capacity = table->capacity ? table->capacity * 2 : 1024;
+        uint64_t *keys = calloc(capacity, sizeof(uint64_t));
+        uint32_t *ids = malloc(capacity * sizeof(uint32_t));
+        uint32_t *pairs = realloc(table->pairs, capacity * sizeof(uint32_t));
+        if (!keys || !ids || !pairs) {
+            free(keys);
+            free(ids);
+            if (pairs) table->pairs = pairs;
+            return -1;
+        }
+        table->pairs = pairs;
+        for (size_t i = 0; i < table->capacity; i++) {
+            if (table->keys[i]) {
+                size_t pos = hash_pair(table->keys[i]) & (capacity - 1);
+                while (keys[pos]) pos = (pos + 1) & (capacity - 1);
+                keys[pos] = table->keys[i];
+                ids[pos] = table->ids[i];
+            }
+        }
+        free(table->keys);
+        free(table->ids);
+        table->keys = keys;
+        table->ids = ids;
+        table->capacity = capacity;
+        if (table->count == 0) {
+            // 编号0保留给空组合
+            table->pairs[0] = table->pairs[1] = 0;
+            table->count = 1;
+        }
+    }
+
+    size_t pos = hash_pair(key) & (table->capacity - 1);
+    while (table->keys[pos]) {
+        if (table->keys[pos] == key) {
+            *id = table->ids[pos];
+            return 0;
+        }
+        pos = (pos + 1) & (table->capacity - 1);
+    }
+    table->keys[pos] = key;
+    table->ids[pos] = (uint32_t)table->count;
+    table->pairs[table->count * 2] = product;
+    table->pairs[table->count * 2 + 1] = version;
+    *id = (uint32_t)table->count++;
+    return 0;
+}
+
+// 读出每一行在某个索引中的键
+static int collect_keys(const ResultFile *file, int which, uint32_t *keys, PairTable *pairs) {
+    uint64_t row = 0;
+    for (uint32_t b = 0; b < result_file_blocks(file); b++) {
+        ResultColumns cols;
+        if (result_file_read_block(file, b, &cols) < 0) {
+            return -1;
+        }
+        for (size_t i = 0; i < cols.rows; i++, row++) {
+            switch (which) {
+                case INDEX_PORT: keys[row] = cols.port[i]; break;
+                case INDEX_SERVICE: keys[row] = cols.service[i]; break;
+                case INDEX_HOST: keys[row] = cols.addr[i]; break;
+                case INDEX_BANNER: keys[row] = cols.banner[i]; break;
+                default:
+                    if (pair_id(pairs, cols.product[i], cols.version[i], &keys[row]) < 0) {
+                        result_columns_free(&cols);
+                        return -1;
+                    }
+            }
+        }
+        result_columns_free(&cols);
+    }
+    return 0;
+}
+
+// 按键对行号做两趟16位的稳定基数排序，得到倒排表
+static int build_postings(const uint32_t *keys, uint64_t rows, Postings *out, void **owned) {
+    uint32_t *a = malloc((rows > 0 ? rows : 1) * sizeof(uint32_t));
+    uint32_t *b = malloc((rows > 0 ? rows : 1) * sizeof(uint32_t));
+    uint64_t *count = malloc(65537 * sizeof(uint64_t));
+    if (!a || !b || !count) {
+        free(a);
+        free(b);
+        free(count);
+        return -1;
+    }
+
+    uint32_t max = 0;
+    for (uint64_t i = 0; i < rows; i++) {
+        if (keys[i] > max) max = keys[i];
+    }
+
+    // 低16位
+    memset(count, 0, 65537 * sizeof(uint64_t));
+    for (uint64_t i = 0; i < rows; i++) count[(keys[i] & 0xffff) + 1]++;
+    for (int k = 0; k < 65536; k++) count[k + 1] += count[k];
+    for (uint64_t i = 0; i < rows; i++) a[count[keys[i] & 0xffff]++] = (uint32_t)i;
+
+    // 高16位，键都小于65536时不需要
+    if (max > 0xffff) {
+        memset(count, 0, 65537 * sizeof(uint64_t));
+        for (uint64_t i = 0; i < rows; i++) count[(keys[a[i]] >> 16) + 1]++;
+        for (int k = 0; k < 65536; k++) count[k + 1] += count[k];
+        for (uint64_t i = 0; i < rows; i++) b[count[keys[a[i]] >> 16]++] = a[i];
+        uint32_t *tmp = a;
+        a = b;
+        b = tmp;
+    }
+    free(count);
+
+    // b改作不同的键，再分配起始位置
+    uint64_t key_count = 0;
+    for (uint64_t i = 0; i < rows; i++) {
+        if (i == 0 || keys[a[i]] != keys[a[i - 1]]) {
+            b[key_count++] = keys[a[i]];
+        }
+    }
+    uint64_t *starts = malloc((key_count + 1) * sizeof(uint64_t));
+    if (!starts) {
+        free(a);
+        free(b);
+        return -1;
+    }
+    for (uint64_t i = 0, k = 0; i < rows; i++) {
+        if (i == 0 || keys[a[i]] != keys[a[i - 1]]) {
+            starts[k++] = i;
+        }
+    }
+    starts[key_count] = rows;
+
+    out->key_count = key_count;
+    out->keys = b;
+    out->starts = starts;
+    out->rows = a;
+    owned[0] = b;
+    owned[1] = starts;
+    owned[2] = a;
+    return 0;
+}
+
+static uint64_t write_section(FILE *fp, const void *data, size_t len, int *failed) {
+    static const uint8_t zeros[INDEX_ALIGN];
+    long pos = ftell(fp);
+    if (pos < 0) {
+        *failed = 1;
+        return 0;
+    }
+    size_t pad = (INDEX_ALIGN - (size_t)pos % INDEX_ALIGN) % INDEX_ALIGN;
+    if ((pad && fwrite(zeros, 1, pad, fp) != pad) || (len && fwrite(data, 1, len, fp) != len)) {
+        *failed = 1;
+    }
+    return (uint64_t)pos + pad;
+}
+
+// 把索引写入文件，失败时只警告，本次查询照常使用内存中的索引
+static void save_index(const char *path, const QueryIndex *index, const struct stat *source, uint64_t rows) {
+    char tmp[PATH_MAX + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp) {
+        fprintf(stderr, "警告: 无法保存索引 %s (%s)\n", path, strerror(errno));
+        return;
+    }
+
+    IndexHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = INDEX_FILE_MAGIC;
+    header.version = INDEX_FILE_VERSION;
+    header.source_size = (uint64_t)source->st_size;
+    header.source_mtime = (int64_t)source->st_mtime;
+    header.row_count = rows;
+
+    int failed = fwrite(&header, sizeof(header), 1, fp) != 1;
+    header.pair_count = index->pair_count;
+    header.pairs_offset = write_section(fp, index->pairs, index->pair_count * 2 * sizeof(uint32_t), &failed);
+    for (int i = 0; i < INDEX_COUNT; i++) {
+        const Postings *p = &index->postings[i];
+        header.sections[i].key_count = p->key_count;
+        header.sections[i].keys_offset = write_section(fp, p->keys, p->key_count * sizeof(uint32_t), &failed);
+        header.sections[i].starts_offset = write_section(fp, p->starts, (p->key_count + 1) * sizeof(uint64_t), &failed);
+        header.sections[i].rows_offset = write_section(fp, p->rows, rows * sizeof(uint32_t), &failed);
+    }
+
+    if (fseek(fp, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, fp) != 1) {
+        failed = 1;
+    }
+    if (fclose(fp) != 0) {
+        failed = 1;
+    }
+    // 写完整后再改名，中断时不会留下不完整的索引
+    if (failed || rename(tmp, path) != 0) {
+        fprintf(stderr, "警告: 无法保存索引 %s\n", path);
+        unlink(tmp);
+    }
+}
+
+static int build_index(const ResultFile *file, QueryIndex *index) {
+    uint64_t rows = result_file_rows(file);
+    uint32_t *keys = malloc((rows > 0 ? rows : 1) * sizeof(uint32_t));
+    if (!keys) {
+        return -1;
+    }
+
+    PairTable pairs;
+    memset(&pairs, 0, sizeof(pairs));
+    for (int i = 0; i < INDEX_COUNT; i++) {
+        if (collect_keys(file, i, keys, &pairs) < 0 ||
+            build_postings(keys, rows, &index->postings[i], &index->owned[i * 3]) < 0) {
+            free(keys);
+            free(pairs.keys);
+            free(pairs.ids);
+            free(pairs.pairs);
+            return -1;
+        }
+    }
+    free(keys);
+    free(pairs.keys);
+    free(pairs.ids);
+
+    index->pairs = pairs.pairs;
+    index->pair_count = pairs.count;
+    index->owned[INDEX_COUNT * 3] = pairs.pairs;
+    return 0;
+}
+
+// 检查映射进来的倒排表: 键严格升序，starts从0开始单调不减并以总行数结束，
+// 否则starts作为行号表的下标时会越界
+static int postings_valid(const Postings *p, uint64_t rows, uint64_t key_limit) {
+    if (p->starts[0] != 0 || p->starts[p->key_count] != rows) {
+        return 0;
+    }
+    for (uint64_t k = 0; k < p->key_count; k++) {
+        if (p->starts[k] > p->starts[k + 1] || p->keys[k] >= key_limit ||
+            (k > 0 && p->keys[k - 1] >= p->keys[k])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// 映射已保存的索引，不存在、已过期或损坏时返回-1
+static int load_index(const char *path, const struct stat *source, uint64_t rows, QueryIndex *index) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(IndexHeader)) {
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+
+    const uint8_t *base = map;
+    size_t size = (size_t)st.st_size;
+    const IndexHeader *header = map;
+    int ok = header->magic == INDEX_FILE_MAGIC && header->version == INDEX_FILE_VERSION &&
+             header->source_size == (uint64_t)source->st_size &&
+             header->source_mtime == (int64_t)source->st_mtime &&
+             header->row_count == rows &&
+             header->pairs_offset <= size && header->pair_count <= (size - header->pairs_offset) / 8;
+    for (int i = 0; ok && i < INDEX_COUNT; i++) {
+        const IndexSection *s = &header->sections[i];
+        ok = s->key_count <= size / 4 &&
+             s->keys_offset <= size && s->key_count * 4 <= size - s->keys_offset &&
+             s->starts_offset <= size && (s->key_count + 1) * 8 <= size - s->starts_offset &&
+             s->rows_offset <= size && rows * 4 <= size - s->rows_offset;
+        if (ok) {
+            Postings *p = &index->postings[i];
+            p->key_count = s->key_count;
+            p->keys = (const uint32_t *)(base + s->keys_offset);
+            p->starts = (const uint64_t *)(base + s->starts_offset);
+            p->rows = (const uint32_t *)(base + s->rows_offset);
+            // 版本索引的键是组合表的编号
+            uint64_t key_limit = (i == INDEX_VERSION) ? header->pair_count : (uint64_t)UINT32_MAX + 1;
+            ok = postings_valid(p, rows, key_limit);
+        }
+    }
+    if (!ok) {
+        munmap(map, size);
+        memset(index->postings, 0, sizeof(index->postings));
+        return -1;
+    }
+
+    index->map = map;
+    index->map_size = size;
+    index->pairs = (const uint32_t *)(base + header->pairs_offset);
+    index->pair_count = header->pair_count;
+    return 0;
+}
+
+static void index_free(QueryIndex *index) {
+    if (index->map) {
+        munmap(index->map, index->map_size);
+    }
+    for (size_t i = 0; i < sizeof(index->owned) / sizeof(index->owned[0]); i++) {
+        free(index->owned[i]);
+    }
+}
+
+// ---------------------------------------------------------------- 查询
+
+typedef struct {
+    const ResultFile *file;
+    const QueryIndex *index;
+    const ResultQuery *query;
+    ScanSpace space;              // 主机和端口条件
+    int has_space;
+    uint8_t *services;            // 文件服务名称表中匹配的下标
+    uint32_t service_count;
+    uint8_t *banner_match;        // 按横幅索引中键的下标
+    uint8_t *pair_match;          // 按(产品, 版本)编号
+    uint64_t *pair_keys;          // 匹配的组合(product << 32 | version)，升序
+    size_t pair_key_count;
+} QueryState;
+
+static int in_host_ranges(const ScanSpace *space, uint32_t addr) {
+    int lo = 0, hi = space->host_range_count - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (addr < space->hosts[mid].start) {
+            hi = mid - 1;
+        } else if (addr > space->hosts[mid].end) {
+            lo = mid + 1;
+        } else {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int in_port_ranges(const ScanSpace *space, int port) {
+    int lo = 0, hi = space->port_range_count - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (port < space->ports[mid].start) {
+            hi = mid - 1;
+        } else if (port > space->ports[mid].end) {
+            lo = mid + 1;
+        } else {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// 通配符匹配，不区分大小写，可以只匹配字符串的一部分
+static int glob_match(const char *pattern, const char *text) {
+    return fnmatch(pattern, text, FNM_CASEFOLD) == 0;
+}
+
+// 横幅条件: 对每个不同的横幅和(产品, 版本)组合各匹配一次
+static int prepare_banner(QueryState *state, const char *banner) {
+    const QueryIndex *index = state->index;
+    const Postings *p = &index->postings[INDEX_BANNER];
+    size_t len = strlen(banner) + 3;
+    char *pattern = malloc(len);
+    state->banner_match = calloc(p->key_count + 1, 1);
+    state->pair_match = calloc(index->pair_count + 1, 1);
+    if (!pattern || !state->banner_match || !state->pair_match) {
+        free(pattern);
+        return -1;
+    }
+    snprintf(pattern, len, "*%s*", banner);
+    state->pair_keys = malloc((index->pair_count + 1) * sizeof(uint64_t));
+    if (!state->pair_keys) {
+        free(pattern);
+        return -1;
+    }
+
+    for (uint64_t k = 0; k < p->key_count; k++) {
+        state->banner_match[k] = p->keys[k] != 0 &&
+                                 glob_match(pattern, result_file_string(state->file, p->keys[k]));
+    }
+    for (uint64_t id = 1; id < index->pair_count; id++) {
+        char text[RESULT_PRODUCT_MAX + RESULT_VERSION_MAX + 2];
+        const char *product = result_file_string(state->file, index->pairs[id * 2]);
+        const char *version = result_file_string(state->file, index->pairs[id * 2 + 1]);
+        snprintf(text, sizeof(text), "%s%s%s", product, version[0] ? " " : "", version);
+        state->pair_match[id] = glob_match(pattern, text);
+        if (state->pair_match[id]) {
+            state->pair_keys[state->pair_key_count++] =
+                ((uint64_t)index->pairs[id * 2] << 32) | index->pairs[id * 2 + 1];
+        }
+    }
+    qsort(state->pair_keys, state->pair_key_count, sizeof(uint64_t), compare_u64);
+    free(pattern);
+    return 0;
+}
+
+// 键在倒排表中的下标，不存在时返回-1
+static int64_t key_index(const Postings *p, uint32_t key) {
+    uint64_t k = lower_bound(p, key);
+    return (k < p->key_count && p->keys[k] == key) ? (int64_t)k : -1;
+}
+
+// 检查一行是否满足全部条件
+static int row_matches(const QueryState *state, const ResultColumns *cols, size_t i) {
+    const ResultQuery *query = state->query;
+
+    if (query->state >= 0 && cols->state[i] != query->state) {
+        return 0;
+    }
+    if (query->protocol >= 0 && cols->protocol[i] != query->protocol) {
+        return 0;
+    }
+    if (state->has_space &&
+        (!in_host_ranges(&state->space, cols->addr[i]) || !in_port_ranges(&state->space, cols->port[i]))) {
+        return 0;
+    }
+    if (query->service &&
+        (cols->service[i] >= state->service_count || !state->services[cols->service[i]])) {
+        return 0;
+    }
+    if (query->banner) {
+        int64_t k = key_index(&state->index->postings[INDEX_BANNER], cols->banner[i]);
+        if (k >= 0 && state->banner_match[k]) {
+            return 1;
+        }
+        uint64_t pair = ((uint64_t)cols->product[i] << 32) | cols->version[i];
+        if (!bsearch(&pair, state->pair_keys, state->pair_key_count, sizeof(uint64_t), compare_u64)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// 选择候选行最少的索引，返回候选行号（升序）；没有可用的索引条件时返回-1表示全表扫描
+static int64_t pick_candidates(QueryState *state, uint32_t **rows_out, const char **index_name) {
+    const QueryIndex *index = state->index;
+    const ResultQuery *query = state->query;
+    KeySpans spans[INDEX_COUNT + 1];
+    memset(spans, 0, sizeof(spans));
+    int usable[INDEX_COUNT + 1] = {0};
+
+    if (query->ports) {
+        const Postings *p = &index->postings[INDEX_PORT];
+        for (int r = 0; r < state->space.port_range_count; r++) {
+            spans_add_range(&spans[INDEX_PORT], p, state->space.ports[r].start, state->space.ports[r].end);
+        }
+        usable[INDEX_PORT] = 1;
+    }
+    if (query->hosts) {
+        const Postings *p = &index->postings[INDEX_HOST];
+        for (int r = 0; r < state->space.host_range_count; r++) {
+            spans_add_range(&spans[INDEX_HOST], p, state->space.hosts[r].start, state->space.hosts[r].end);
+        }
+        usable[INDEX_HOST] = 1;
+    }
+    if (query->service) {
+        const Postings *p = &index->postings[INDEX_SERVICE];
+        for (uint32_t s = 0; s < state->service_count; s++) {
+            if (state->services[s]) {
+                int64_t k = key_index(p, s);
+                if (k >= 0) span_add(&spans[INDEX_SERVICE], p, k, k + 1);
+            }
+        }
+        usable[INDEX_SERVICE] = 1;
+    }
+    if (query->banner) {
+        // 横幅和版本两个索引的并集
+        const Postings *p = &index->postings[INDEX_BANNER];
+        for (uint64_t k = 0; k < p->key_count; k++) {
+            if (state->banner_match[k]) span_add(&spans[INDEX_BANNER], p, k, k + 1);
+        }
+        const Postings *v = &index->postings[INDEX_VERSION];
+        for (uint64_t k = 0; k < v->key_count; k++) {
+            if (state->pair_match[v->keys[k]]) span_add(&spans[INDEX_VERSION], v, k, k + 1);
+        }
+        usable[INDEX_BANNER] = 1;
+    }
+
+    int best = -1;
+    uint64_t best_rows = 0;
+    for (int i = 0; i < INDEX_COUNT; i++) {
+        if (!usable[i]) continue;
+        uint64_t n = spans[i].rows + (i == INDEX_BANNER ? spans[INDEX_VERSION].rows : 0);
+        if (best < 0 || n < best_rows) {
+            best = i;
+            best_rows = n;
+        }
+    }
+
+    int64_t ret = -1;
+    if (best >= 0) {
+        uint32_t *rows = malloc((best_rows > 0 ? best_rows : 1) * sizeof(uint32_t));
+        if (rows) {
+            // 横幅条件取横幅和版本两个索引的并集
+            int sources[2] = { best, INDEX_VERSION };
+            int source_count = (best == INDEX_BANNER) ? 2 : 1;
+            uint64_t n = 0, keys = 0;
+            for (int j = 0; j < source_count; j++) {
+                const Postings *p = &index->postings[sources[j]];
+                const KeySpans *sp = &spans[sources[j]];
+                for (size_t s = 0; s < sp->count; s++) {
+                    uint64_t from = p->starts[sp->lo[s]], to = p->starts[sp->hi[s]];
+                    memcpy(rows + n, p->rows + from, (to - from) * sizeof(uint32_t));
+                    n += to - from;
+                    keys += sp->hi[s] - sp->lo[s];
+                }
+            }
+            // 每个键的行号已升序，多个键合并后重新排序，读取时各块只解码一次
+            if (keys > 1) {
+                qsort(rows, n, sizeof(uint32_t), compare_u32);
+            }
+            // 横幅和版本可能同时命中同一行
+            uint64_t unique = 0;
+            for (uint64_t i = 0; i < n; i++) {
+                if (unique == 0 || rows[i] != rows[unique - 1]) rows[unique++] = rows[i];
+            }
+            *rows_out = rows;
+            *index_name = index_names[best];
+            ret = (int64_t)unique;
+        }
+    }
+
+    for (int i = 0; i < INDEX_COUNT; i++) {
+        spans_free(&spans[i]);
+    }
+    return ret;
+}
+
+typedef struct {
+    ResultRow *rows;
+    size_t count;
+    size_t capacity;
+} RowList;
+
+static int row_list_add(RowList *list, const ResultFile *file, const ResultColumns *cols, size_t i) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 256;
+        ResultRow *rows = realloc(list->rows, capacity * sizeof(ResultRow));
+        if (!rows) {
+            return -1;
+        }
+        list->rows = rows;
+        list->capacity = capacity;
+    }
+    result_file_row(file, cols, i, &list->rows[list->count++]);
+    return 0;
+}
+
+static int sort_key;
+static int sort_reverse;
+
+enum { SORT_HOST = 0, SORT_PORT, SORT_SERVICE, SORT_RTT, SORT_TIME };
+
+static int compare_rows(const void *a, const void *b) {
+    const ResultRow *x = a, *y = b;
+    uint32_t hx = ntohl(x->addr.s_addr), hy = ntohl(y->addr.s_addr);
+    int c = 0;
+
+    switch (sort_key) {
+        case SORT_PORT: c = x->port - y->port; break;
+        case SORT_SERVICE: c = strcmp(x->service, y->service); break;
+        case SORT_RTT: c = (x->response_time > y->response_time) - (x->response_time < y->response_time); break;
+        case SORT_TIME: c = (x->timestamp_us > y->timestamp_us) - (x->timestamp_us < y->timestamp_us); break;
+        default: break;
+    }
+    if (c == 0) c = (hx > hy) - (hx < hy);
+    if (c == 0) c = x->port - y->port;
+    if (c == 0) c = strcmp(x->protocol, y->protocol);
+    return sort_reverse ? -c : c;
+}
+
+// 在结果文件中查询，返回的行引用文件映射中的字符串，在关闭文件前有效
+int result_query_run(const char *path, const ResultFile *file, const ResultQuery *query,
+                     ResultRow **rows_out, size_t *count_out) {
+    struct stat source;
+    if (stat(path, &source) < 0) {
+        fprintf(stderr, "错误: 无法访问 %s (%s)\n", path, strerror(errno));
+        return -1;
+    }
+    uint64_t total = result_file_rows(file);
+    if (total > UINT32_MAX) {
+        fprintf(stderr, "错误: 结果文件超过%u行，不支持建立索引\n", UINT32_MAX);
+        return -1;
+    }
+
+    if (query->sort && strcmp(query->sort, "host") != 0 && strcmp(query->sort, "port") != 0 &&
+        strcmp(query->sort, "service") != 0 && strcmp(query->sort, "rtt") != 0 &&
+        strcmp(query->sort, "time") != 0) {
+        fprintf(stderr, "错误: 未知的排序字段 '%s'\n", query->sort);
+        return -1;
+    }
+
+    QueryState state;
+    memset(&state, 0, sizeof(state));
+    state.file = file;
+    state.query = query;
+
+    // 主机和端口条件按扫描目标的格式解析
+    if (query->hosts || query->ports) {
+        if (scan_space_init(&state.space, query->hosts ? query->hosts : "0.0.0.0/0", NULL,
+                            query->ports ? query->ports : "1-65535", 0) < 0) {
+            return -1;
+        }
+        state.has_space = 1;
+    }
+
+    struct timespec t0, t1, t2;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    char index_path[PATH_MAX];
+    if (snprintf(index_path, sizeof(index_path), "%s.idx", path) >= (int)sizeof(index_path)) {
+        fprintf(stderr, "错误: 路径过长\n");
+        scan_space_free(&state.space);
+        return -1;
+    }
+    QueryIndex index;
+    memset(&index, 0, sizeof(index));
+    if (query->rebuild || load_index(index_path, &source, total, &index) < 0) {
+        fprintf(stderr, "建立索引: %lu行...\n", (unsigned long)total);
+        if (build_index(file, &index) < 0) {
+            fprintf(stderr, "错误: 建立索引失败\n");
+            index_free(&index);
+            scan_space_free(&state.space);
+            return -1;
+        }
+        save_index(index_path, &index, &source, total);
+    }
+    state.index = &index;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    int ret = 0;
+    RowList list;
+    memset(&list, 0, sizeof(list));
+    uint32_t *candidates = NULL;
+    const char *used_index = NULL;
+
+    // 服务名称在文件自己的服务名称表中查找
+    if (query->service) {
+        state.service_count = result_file_services(file);
+        state.services = calloc(state.service_count + 1, 1);
+        if (!state.services) {
+            ret = -1;
+            goto out;
+        }
+        for (uint32_t s = 0; s < state.service_count; s++) {
+            state.services[s] = strcasecmp(result_file_service(file, s), query->service) == 0;
+        }
+    }
+    if (query->banner && prepare_banner(&state, query->banner) < 0) {
+        ret = -1;
+        goto out;
+    }
+
+    int64_t candidate_count = pick_candidates(&state, &candidates, &used_index);
+    if (candidate_count >= 0) {
+        // 候选行按行号升序，逐块读取
+        uint64_t block_start = 0;
+        uint32_t block = 0;
+        ResultColumns cols;
+        int loaded = 0;
+        for (int64_t c = 0; c < candidate_count && ret == 0; c++) {
+            uint64_t row = candidates[c];
+            // 候选行必须升序，损坏的索引可能给出乱序的行号
+            if (row < block_start) {
+                ret = -1;
+                break;
+            }
+            while (block < result_file_blocks(file) && row >= block_start + result_file_block_rows(file, block)) {
+                block_start += result_file_block_rows(file, block);
+                block++;
+                if (loaded) {
+                    result_columns_free(&cols);
+                    loaded = 0;
+                }
+            }
+            if (!loaded) {
+                if (result_file_read_block(file, block, &cols) < 0) {
+                    ret = -1;
+                    break;
+                }
+                loaded = 1;
+            }
+            size_t i = (size_t)(row - block_start);
+            if (row_matches(&state, &cols, i) && row_list_add(&list, file, &cols, i) < 0) {
+                ret = -1;
+            }
+        }
+        if (loaded) {
+            result_columns_free(&cols);
+        }
+    } else {
+        // 只有状态、协议条件或没有条件时全表扫描
+        used_index = "全表扫描";
+        for (uint32_t b = 0; b < result_file_blocks(file) && ret == 0; b++) {
+            ResultColumns cols;
+            if (result_file_read_block(file, b, &cols) < 0) {
+                ret = -1;
+                break;
+            }
+            for (size_t i = 0; i < cols.rows && ret == 0; i++) {
+                if (row_matches(&state, &cols, i) && row_list_add(&list, file, &cols, i) < 0) {
+                    ret = -1;
+                }
+            }
+            result_columns_free(&cols);
+        }
+    }
+
+    if (ret == 0) {
+        sort_key = !query->sort ? SORT_HOST :
+                   strcmp(query->sort, "port") == 0 ? SORT_PORT :
+                   strcmp(query->sort, "service") == 0 ? SORT_SERVICE :
+                   strcmp(query->sort, "rtt") == 0 ? SORT_RTT :
+                   strcmp(query->sort, "time") == 0 ? SORT_TIME : SORT_HOST;
+        sort_reverse = query->reverse;
+        qsort(list.rows, list.count, sizeof(ResultRow), compare_rows);
+        if (query->limit > 0 && list.count > query->limit) {
+            list.count = query->limit;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        if (query->verbose) {
+            fprintf(stderr, "查询: %zu个结果, 索引: %s, 加载索引 %.1fms, 查询 %.1fms\n",
+                    list.count, used_index,
+                    (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6,
+                    (t2.tv_sec - t1.tv_sec) * 1e3 + (t2.tv_nsec - t1.tv_nsec) / 1e6);
+        }
+        *rows_out = list.rows;
+        *count_out = list.count;
+    } else {
+        fprintf(stderr, "错误: 查询失败\n");
+        free(list.rows);
+    }
+
+out:
+    free(candidates);
+    free(state.services);
+    free(state.banner_match);
+    free(state.pair_match);
+    free(state.pair_keys);
+    index_free(&index);
+    scan_space_free(&state.space);
+    return ret;
+}
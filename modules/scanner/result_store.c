@@ -0,0 +1,450 @@
+/**
+ * 扫描结果存储
+ * 结果为定长的紧凑记录: 协议和状态为枚举，服务为名称下标，
+ * 横幅、产品、版本和主机名去重后存放在共享的字符串区，记录中只保存偏移。
+ * 每个有结果的主机另有一张端口状态位图（每端口2位），
+ * 用于去掉重复的结果和按主机、端口查询状态。位图按1024个端口分页，
+ * 页在第一次写入时分配，每个有结果的主机只常驻一张页指针表（65535个端口为512字节），
+ * 内存大致与结果数成正比
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include "port_scanner.h"
+
+#define STRING_CHUNK_BITS 16
+#define STRING_CHUNK_SIZE (1U << STRING_CHUNK_BITS)
+#define STRING_CHUNK_MAX 16384      // 字符串区最多1GB
+#define STATE_PAGE_PORTS 1024       // 位图每页的端口数
+#define STATE_PAGE_WORDS (STATE_PAGE_PORTS * 2 / 64)
+
+// 位图中的端口状态编码，0表示没有结果（关闭、过滤或未扫描）
+enum {
+    STATE_BITS_NONE = 0,
+    STATE_BITS_OPEN,
+    STATE_BITS_OPEN_FILTERED,
+    STATE_BITS_UNFILTERED
+};
+
+// 一个主机的端口状态位图，按扫描空间中的端口下标排列
+typedef struct {
+    uint32_t addr;                 // 主机字节序
+    uint64_t **pages;              // 位图页，未写入的页为NULL；整个表为NULL表示空槽
+} HostStates;
+
+struct ResultStore {
+    // 字符串区: 定长块只追加、不移动，已发出的偏移可以不加锁读取
+    pthread_mutex_t string_lock;
+    char **chunks;
+    uint32_t chunk_count;
+    uint32_t chunk_used;           // 当前块已用的字节数
+    uint32_t *string_slots;        // 去重用的开放寻址哈希，值为偏移，0表示空槽
+    size_t string_capacity;
+    size_t string_count;
+    size_t string_bytes;
+
+    // 端口状态位图
+    pthread_mutex_t state_lock;
+    HostStates *hosts;
+    size_t host_capacity;
+    size_t host_count;
+    PortRange *ports;
+    int port_range_count;
+    uint64_t port_count;
+    size_t page_count;             // 每个主机的位图页数
+    size_t pages_used;             // 已分配的位图页总数
+
+    // 扫描结束后合并、排序的结果
+    ScanResult *results;
+    size_t result_count;
+};
+
+static uint32_t hash_bytes(const char *s, size_t len) {
+    uint32_t h = 2166136261U;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)s[i]) * 16777619U;
+    }
+    return h;
+}
+
+static uint32_t hash_addr(uint32_t addr) {
+    addr ^= addr >> 16;
+    addr *= 0x7feb352dU;
+    addr ^= addr >> 15;
+    addr *= 0x846ca68bU;
+    addr ^= addr >> 16;
+    return addr;
+}
+
+// 创建结果存储，端口下标与扫描空间一致
+ResultStore* result_store_create(const ScanSpace *space) {
+    ResultStore *store = calloc(1, sizeof(ResultStore));
+    if (!store) {
+        return NULL;
+    }
+
+    store->chunks = calloc(STRING_CHUNK_MAX, sizeof(char *));
+    store->ports = malloc(sizeof(PortRange) * (space->port_range_count > 0 ? space->port_range_count : 1));
+    if (!store->chunks || !store->ports) {
+        free(store->chunks);
+        free(store->ports);
+        free(store);
+        return NULL;
+    }
+    memcpy(store->ports, space->ports, sizeof(PortRange) * space->port_range_count);
+    store->port_range_count = space->port_range_count;
+    store->port_count = space->port_count;
+    store->page_count = (space->port_count + STATE_PAGE_PORTS - 1) / STATE_PAGE_PORTS;
+
+    // 偏移0保留给空字符串
+    store->chunks[0] = malloc(STRING_CHUNK_SIZE);
+    if (!store->chunks[0]) {
+        free(store->chunks);
+        free(store->ports);
+        free(store);
+        return NULL;
+    }
+    store->chunks[0][0] = '\0';
+    store->chunk_count = 1;
+    store->chunk_used = 1;
+
+    pthread_mutex_init(&store->string_lock, NULL);
+    pthread_mutex_init(&store->state_lock, NULL);
+    return store;
+}
+
+void result_store_free(ResultStore *store) {
+    if (!store) {
+        return;
+    }
+    for (uint32_t i = 0; i < store->chunk_count; i++) {
+        free(store->chunks[i]);
+    }
+    for (size_t i = 0; i < store->host_capacity; i++) {
+        if (store->hosts[i].pages) {
+            for (size_t p = 0; p < store->page_count; p++) {
+                free(store->hosts[i].pages[p]);
+            }
+            free(store->hosts[i].pages);
+        }
+    }
+    free(store->chunks);
+    free(store->string_slots);
+    free(store->hosts);
+    free(store->ports);
+    free(store->results);
+    pthread_mutex_destroy(&store->string_lock);
+    pthread_mutex_destroy(&store->state_lock);
+    free(store);
+}
+
+// 偏移对应的字符串
+const char* result_string(const ResultStore *store, uint32_t offset) {
+    return store->chunks[offset >> STRING_CHUNK_BITS] + (offset & (STRING_CHUNK_SIZE - 1));
+}
+
+// 把偏移插入去重哈希，调用时持有锁
+static void string_slot_insert(uint32_t *slots, size_t capacity, uint32_t hash, uint32_t offset) {
+    size_t pos = hash & (capacity - 1);
+    while (slots[pos]) {
+        pos = (pos + 1) & (capacity - 1);
+    }
+    slots[pos] = offset;
+}
+
+static int string_slots_grow(ResultStore *store) {
+    size_t capacity = store->string_capacity ? store->string_capacity * 2 : 1024;
+    uint32_t *slots = calloc(capacity, sizeof(uint32_t));
+    if (!slots) {
+        return -1;
+    }
+    for (size_t i = 0; i < store->string_capacity; i++) {
+        uint32_t offset = store->string_slots[i];
+        if (offset) {
+            const char *s = result_string(store, offset);
+            string_slot_insert(slots, capacity, hash_bytes(s, strlen(s)), offset);
+        }
+    }
+    free(store->string_slots);
+    store->string_slots = slots;
+    store->string_capacity = capacity;
+    return 0;
+}
+
+// 把字符串（最多max_len-1个字节）放入字符串区，相同的内容只保存一份；
+// 返回偏移，空字符串或空间不足时返回0
+uint32_t result_store_intern(ResultStore *store, const char *s, size_t max_len) {
+    if (!s || !s[0] || max_len < 2) {
+        return 0;
+    }
+    size_t len = strnlen(s, max_len - 1);
+    uint32_t hash = hash_bytes(s, len);
+
+    pthread_mutex_lock(&store->string_lock);
+
+    if ((store->string_count + 1) * 2 > store->string_capacity && string_slots_grow(store) < 0) {
+        pthread_mutex_unlock(&store->string_lock);
+        return 0;
+    }
+
+    size_t pos = hash & (store->string_capacity - 1);
+    while (store->string_slots[pos]) {
+        uint32_t offset = store->string_slots[pos];
+        const char *existing = result_string(store, offset);
+        if (strncmp(existing, s, len) == 0 && existing[len] == '\0') {
+            pthread_mutex_unlock(&store->string_lock);
+            return offset;
+        }
+        pos = (pos + 1) & (store->string_capacity - 1);
+    }
+
+    // 字符串不跨块，当前块放不下时换新块
+    if (store->chunk_used + len + 1 > STRING_CHUNK_SIZE) {
+        if (store->chunk_count == STRING_CHUNK_MAX) {
+            pthread_mutex_unlock(&store->string_lock);
+            return 0;
+        }
+        char *chunk = malloc(STRING_CHUNK_SIZE);
+        if (!chunk) {
+            pthread_mutex_unlock(&store->string_lock);
+            return 0;
+        }
+        store->chunks[store->chunk_count++] = chunk;
+        store->chunk_used = 0;
+    }
+
+    uint32_t chunk_index = store->chunk_count - 1;
+    uint32_t offset = (chunk_index << STRING_CHUNK_BITS) | store->chunk_used;
+    char *dst = store->chunks[chunk_index] + store->chunk_used;
+    memcpy(dst, s, len);
+    dst[len] = '\0';
+    store->chunk_used += len + 1;
+    store->string_bytes += len + 1;
+
+    store->string_slots[pos] = offset;
+    store->string_count++;
+
+    pthread_mutex_unlock(&store->string_lock);
+    return offset;
+}
+
+static int state_to_bits(PortState state) {
+    switch (state) {
+        case PORT_OPEN: return STATE_BITS_OPEN;
+        case PORT_OPEN_FILTERED: return STATE_BITS_OPEN_FILTERED;
+        case PORT_UNFILTERED: return STATE_BITS_UNFILTERED;
+        default: return -1;
+    }
+}
+
+static int bits_to_state(int bits) {
+    switch (bits) {
+        case STATE_BITS_OPEN: return PORT_OPEN;
+        case STATE_BITS_OPEN_FILTERED: return PORT_OPEN_FILTERED;
+        case STATE_BITS_UNFILTERED: return PORT_UNFILTERED;
+        default: return -1;
+    }
+}
+
+// 端口在扫描空间中的下标，不在范围内返回-1
+static int64_t port_index(const ResultStore *store, int port) {
+    int lo = 0, hi = store->port_range_count - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (port < store->ports[mid].start) {
+            hi = mid - 1;
+        } else if (port > store->ports[mid].end) {
+            lo = mid + 1;
+        } else {
+            return (int64_t)(store->ports[mid].offset + (uint64_t)(port - store->ports[mid].start));
+        }
+    }
+    return -1;
+}
+
+// 查找主机的位图，create为真时不存在则创建；调用时持有锁
+static HostStates* host_states(ResultStore *store, uint32_t addr, int create) {
+    if (create && (store->host_count + 1) * 2 > store->host_capacity) {
+        size_t capacity = store->host_capacity ? store->host_capacity * 2 : 64;
+        HostStates *hosts = calloc(capacity, sizeof(HostStates));
+        if (!hosts) {
+            return NULL;
+        }
+        for (size_t i = 0; i < store->host_capacity; i++) {
+            if (store->hosts[i].pages) {
+                size_t pos = hash_addr(store->hosts[i].addr) & (capacity - 1);
+                while (hosts[pos].pages) pos = (pos + 1) & (capacity - 1);
+                hosts[pos] = store->hosts[i];
+            }
+        }
+        free(store->hosts);
+        store->hosts = hosts;
+        store->host_capacity = capacity;
+    }
+    if (store->host_capacity == 0) {
+        return NULL;
+    }
+
+    size_t pos = hash_addr(addr) & (store->host_capacity - 1);
+    while (store->hosts[pos].pages) {
+        if (store->hosts[pos].addr == addr) {
+            return &store->hosts[pos];
+        }
+        pos = (pos + 1) & (store->host_capacity - 1);
+    }
+    if (!create) {
+        return NULL;
+    }
+
+    uint64_t **pages = calloc(store->page_count > 0 ? store->page_count : 1, sizeof(uint64_t *));
+    if (!pages) {
+        return NULL;
+    }
+    store->hosts[pos].addr = addr;
+    store->hosts[pos].pages = pages;
+    store->host_count++;
+    return &store->hosts[pos];
+}
+
+// 在位图中记录端口状态。返回1表示新记录，0表示该端口已有结果（重复的响应），
+// -1表示无法记录（状态不保存为结果、端口不在范围内或内存不足）
+int result_store_mark(ResultStore *store, struct in_addr addr, int port, PortState state) {
+    int bits = state_to_bits(state);
+    int64_t index = port_index(store, port);
+    if (bits < 0 || index < 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&store->state_lock);
+    HostStates *host = host_states(store, ntohl(addr.s_addr), 1);
+    if (!host) {
+        pthread_mutex_unlock(&store->state_lock);
+        return -1;
+    }
+
+    uint64_t **page = &host->pages[(uint64_t)index / STATE_PAGE_PORTS];
+    if (!*page) {
+        *page = calloc(STATE_PAGE_WORDS, sizeof(uint64_t));
+        if (!*page) {
+            pthread_mutex_unlock(&store->state_lock);
+            return -1;
+        }
+        store->pages_used++;
+    }
+    uint64_t *word = &(*page)[(uint64_t)index % STATE_PAGE_PORTS / 32];
+    int shift = (int)((uint64_t)index % 32) * 2;
+    int fresh = ((*word >> shift) & 3) == STATE_BITS_NONE;
+    if (fresh) {
+        *word |= (uint64_t)bits << shift;
+    }
+    pthread_mutex_unlock(&store->state_lock);
+    return fresh;
+}
+
+// 查询端口状态，没有结果时返回-1
+int result_store_state(ResultStore *store, struct in_addr addr, int port) {
+    int64_t index = port_index(store, port);
+    if (index < 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&store->state_lock);
+    int state = -1;
+    HostStates *host = host_states(store, ntohl(addr.s_addr), 0);
+    const uint64_t *page = host ? host->pages[(uint64_t)index / STATE_PAGE_PORTS] : NULL;
+    if (page) {
+        uint64_t word = page[(uint64_t)index % STATE_PAGE_PORTS / 32];
+        state = bits_to_state((int)((word >> (((uint64_t)index % 32) * 2)) & 3));
+    }
+    pthread_mutex_unlock(&store->state_lock);
+    return state;
+}
+
+// 结果按主机、端口、协议排序
+static int compare_results(const void *a, const void *b) {
+    const ScanResult *x = a, *y = b;
+    uint32_t hx = ntohl(x->addr.s_addr), hy = ntohl(y->addr.s_addr);
+
+    if (hx != hy) {
+        return (hx > hy) - (hx < hy);
+    }
+    if (x->port != y->port) {
+        return x->port - y->port;
+    }
+    return x->protocol - y->protocol;
+}
+
+// 把各线程的结果块合并为一个有序数组并释放结果块，内存不足时返回-1
+int result_store_finish(ResultStore *store, ThreadShard *shards, int count) {
+    size_t total = 0;
+    for (int i = 0; i < count; i++) {
+        total += shards[i].result_count;
+    }
+
+    ScanResult *results = malloc((total > 0 ? total : 1) * sizeof(ScanResult));
+    size_t n = 0;
+    for (int i = 0; i < count; i++) {
+        ResultBlock *block = shards[i].head;
+        while (block) {
+            ResultBlock *next = block->next;
+            if (results) {
+                memcpy(&results[n], block->items, block->count * sizeof(ScanResult));
+                n += block->count;
+            }
+            free(block);
+            block = next;
+        }
+        shards[i].head = shards[i].tail = NULL;
+    }
+
+    if (!results) {
+        return -1;
+    }
+    qsort(results, total, sizeof(ScanResult), compare_results);
+    free(store->results);
+    store->results = results;
+    store->result_count = total;
+    return 0;
+}
+
+// 合并后的结果，按主机、端口排序
+ScanResult* result_store_results(ResultStore *store, size_t *count) {
+    *count = store->result_count;
+    return store->results;
+}
+
+// 结果、字符串区和位图占用的内存
+size_t result_store_memory(const ResultStore *store) {
+    return store->result_count * sizeof(ScanResult) +
+           (size_t)store->chunk_count * STRING_CHUNK_SIZE +
+           store->string_capacity * sizeof(uint32_t) +
+           store->host_capacity * sizeof(HostStates) +
+           store->host_count * store->page_count * sizeof(uint64_t *) +
+           store->pages_used * STATE_PAGE_WORDS * sizeof(uint64_t);
+}
+
+// 协议编码
+uint8_t result_protocol(const char *name) {
+    return (name && name[0] == 'u') ? RESULT_UDP : RESULT_TCP;
+}
+
+const char* result_protocol_name(uint8_t protocol) {
+    return protocol == RESULT_UDP ? "udp" : "tcp";
+}
+
+// 转换为输出用的结果
+void result_store_row(const ResultStore *store, const ScanResult *result, ResultRow *row) {
+    row->addr = result->addr;
+    row->port = result->port;
+    row->protocol = result_protocol_name(result->protocol);
+    row->state = port_state_name((PortState)result->state);
+    row->service = service_name(result->service);
+    row->hostname = result_string(store, result->hostname);
+    row->banner = result_string(store, result->banner);
+    row->product = result_string(store, result->product);
+    row->version = result_string(store, result->version);
+    row->response_time = result->response_time;
+    row->timestamp_us = result->timestamp_us;
+}
@@ -0,0 +1,461 @@
+/**
+ * 扫描引擎基准
+ * 在子进程中启动本地目标服务: 在回环地址上监听大量端口，按比例分为
+ * 开放(接受连接，延迟后发送横幅)、过滤(接受队列已满，SYN被丢弃)和关闭(未监听)三类，
+ * 不需要网络命名空间或iptables。然后用每个引擎调用perform_scan扫描这些端口，
+ * 每次运行输出一行JSON: 每秒端口数、扫描进程的CPU时间和探测延迟的p50/p99。
+ * 用法: make bench && ./scan_bench [--ports N] [--open F] [--filtered F] [--delay 毫秒]
+ *       [--banner 文本] [--engines thread,epoll,uring,syn] [--repeat N] [-b]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "port_scanner.h"
+
+#define BENCH_ADDR "127.77.0.1"
+#define BENCH_BASE_PORT 20000
+#define BENCH_PORTS 4000
+#define BENCH_BANNER "SSH-2.0-OpenSSH_8.9p1 Ubuntu-3ubuntu0.1\r\n"
+#define LISTENER_FLAG (1ULL << 63)
+
+typedef enum {
+    BENCH_OPEN = 0,
+    BENCH_FILTERED,
+    BENCH_CLOSED
+} BenchPortClass;
+
+typedef struct {
+    const char *addr;
+    int base_port;
+    int ports;
+    double open_fraction;
+    double filtered_fraction;
+    int delay_ms;              // 接受连接后延迟多少毫秒发送横幅
+    const char *banner;
+} TargetConfig;
+
+// 等待发送横幅的连接，延迟固定，按接受顺序即按到期顺序排列
+typedef struct {
+    int fd;
+    long deadline_ms;
+} PendingBanner;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static long now_ms(void) {
+    return (long)(now_sec() * 1000);
+}
+
+// 端口的类别由端口号的散列决定，扫描方不用和服务进程通信就能算出预期结果
+static BenchPortClass port_class(const TargetConfig *cfg, int port) {
+    uint32_t h = (uint32_t)port * 2654435761u;
+    double x = ((h >> 8) % 10000) / 10000.0;
+    if (x < cfg->open_fraction) return BENCH_OPEN;
+    if (x < cfg->open_fraction + cfg->filtered_fraction) return BENCH_FILTERED;
+    return BENCH_CLOSED;
+}
+
+static int bench_listen(struct in_addr addr, int port, int backlog) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in sin;
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr = addr;
+    sin.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *)&sin, sizeof(sin)) < 0 || listen(fd, backlog) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// 过滤端口: 接受队列长度为0，用一个不会被accept的连接占满，之后的SYN被内核丢弃
+static int bench_fill_queue(struct in_addr addr, int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct sockaddr_in sin;
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr = addr;
+    sin.sin_port = htons(port);
+    if (connect(fd, (struct sockaddr *)&sin, sizeof(sin)) < 0 && errno != EINPROGRESS) {
+        close(fd);
+        return -1;
+    }
+    struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (poll(&pfd, 1, 1000) != 1 ||
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void send_banner(int epfd, int fd, const char *banner) {
+    // 发送后半关闭，等对方关闭再释放，避免未读数据触发RST冲掉横幅
+    if (send(fd, banner, strlen(banner), MSG_NOSIGNAL) < 0 || shutdown(fd, SHUT_WR) < 0) {
+        close(fd);
+        return;
+    }
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP, .data.u64 = (uint64_t)fd };
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        close(fd);
+    }
+}
+
+// 目标服务进程，准备好后向ready写一个字节，之后一直运行到被终止
+static void run_target(const TargetConfig *cfg, int ready) {
+    signal(SIGPIPE, SIG_IGN);
+    raise_fd_limit(cfg->ports * 2 + 4096);
+
+    struct in_addr addr;
+    inet_pton(AF_INET, cfg->addr, &addr);
+    int epfd = epoll_create1(0);
+    char status = 1;
+
+    for (int i = 0; i < cfg->ports && epfd >= 0; i++) {
+        int port = cfg->base_port + i;
+        BenchPortClass cls = port_class(cfg, port);
+        if (cls == BENCH_CLOSED) {
+            continue;
+        }
+        int fd = bench_listen(addr, port, cls == BENCH_OPEN ? 4096 : 0);
+        if (fd < 0) {
+            fprintf(stderr, "错误: 无法监听 %s:%d: %s\n", cfg->addr, port, strerror(errno));
+            status = 0;
+            break;
+        }
+        if (cls == BENCH_FILTERED) {
+            if (bench_fill_queue(addr, port) < 0) {
+                fprintf(stderr, "错误: 无法占满 %s:%d 的接受队列\n", cfg->addr, port);
+                status = 0;
+                break;
+            }
+            continue;
+        }
+        struct epoll_event ev = { .events = EPOLLIN, .data.u64 = LISTENER_FLAG | (uint64_t)fd };
+        epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+    }
+    if (epfd < 0) {
+        status = 0;
+    }
+    if (write(ready, &status, 1) != 1 || !status) {
+        _exit(1);
+    }
+    close(ready);
+
+    int capacity = 65536;
+    PendingBanner *pending = malloc(sizeof(PendingBanner) * capacity);
+    int head = 0, count = 0;
+    struct epoll_event events[256];
+    char discard[4096];
+
+    for (;;) {
+        long now = now_ms();
+        while (count > 0 && pending[head].deadline_ms <= now) {
+            send_banner(epfd, pending[head].fd, cfg->banner);
+            head = (head + 1) % capacity;
+            count--;
+        }
+        int wait_ms = count > 0 ? (int)(pending[head].deadline_ms - now) : -1;
+
+        int n = epoll_wait(epfd, events, 256, wait_ms);
+        for (int i = 0; i < n; i++) {
+            uint64_t data = events[i].data.u64;
+            int fd = (int)(data & ~LISTENER_FLAG);
+            if (!(data & LISTENER_FLAG)) {
+                // 已发送横幅的连接: 丢弃对方发来的数据，对方关闭后释放
+                ssize_t r = recv(fd, discard, sizeof(discard), 0);
+                if (r <= 0 && !(r < 0 && errno == EAGAIN)) {
+                    close(fd);
+                }
+                continue;
+            }
+            int conn;
+            while ((conn = accept4(fd, NULL, NULL, SOCK_NONBLOCK)) >= 0) {
+                if (cfg->delay_ms <= 0) {
+                    send_banner(epfd, conn, cfg->banner);
+                } else if (count == capacity) {
+                    close(conn);
+                } else {
+                    pending[(head + count) % capacity] = (PendingBanner){ conn, now_ms() + cfg->delay_ms };
+                    count++;
+                }
+            }
+        }
+    }
+}
+
+// 扫描输出到标准错误，标准输出只留给JSON结果
+static int run_engine(const char *name, const TargetConfig *cfg, const ScanOptions *base,
+                      long expected_open, int run) {
+    ScanOptions opts = *base;
+    if (strcmp(name, "thread") == 0) {
+        opts.engine = ENGINE_THREAD;
+    } else if (strcmp(name, "epoll") == 0) {
+        opts.engine = ENGINE_EPOLL;
+    } else if (strcmp(name, "uring") == 0) {
+        opts.engine = ENGINE_URING;
+    } else if (strcmp(name, "syn") == 0) {
+        opts.scan_type = SCAN_TCP_SYN;
+    } else {
+        fprintf(stderr, "错误: 未知引擎 %s\n", name);
+        return -1;
+    }
+    if (strcmp(name, "uring") == 0 && !uring_engine_available()) {
+        printf("{\"engine\":\"%s\",\"run\":%d,\"skipped\":\"io_uring unavailable\"}\n", name, run);
+        return 0;
+    }
+    if (opts.scan_type == SCAN_TCP_SYN && geteuid() != 0) {
+        printf("{\"engine\":\"%s\",\"run\":%d,\"skipped\":\"requires root\"}\n", name, run);
+        return 0;
+    }
+
+    unsigned long *latency = calloc(LATENCY_BUCKETS, sizeof(unsigned long));
+    if (!latency) {
+        return -1;
+    }
+    opts.latency = latency;
+
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+
+    struct rusage before, after;
+    getrusage(RUSAGE_SELF, &before);
+    double start = now_sec();
+    ResultStore *store = NULL;
+    int rc = perform_scan(&opts, &store);
+    double wall = now_sec() - start;
+    getrusage(RUSAGE_SELF, &after);
+
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+
+    if (rc < 0 || !store) {
+        free(latency);
+        fprintf(stderr, "错误: %s引擎扫描失败\n", name);
+        return -1;
+    }
+
+    size_t count = 0;
+    ScanResult *results = result_store_results(store, &count);
+    long open = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (results[i].state == PORT_OPEN) {
+            open++;
+        }
+    }
+    result_store_free(store);
+
+    double user = (after.ru_utime.tv_sec - before.ru_utime.tv_sec) +
+                  (after.ru_utime.tv_usec - before.ru_utime.tv_usec) / 1e6;
+    double sys = (after.ru_stime.tv_sec - before.ru_stime.tv_sec) +
+                 (after.ru_stime.tv_usec - before.ru_stime.tv_usec) / 1e6;
+
+    // 无状态引擎不逐个计时，没有延迟样本
+    unsigned long samples = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        samples += latency[b];
+    }
+    long p50 = -1, p99 = -1;
+    unsigned long seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS && samples > 0; b++) {
+        seen += latency[b];
+        if (p50 < 0 && seen * 100 >= samples * 50) p50 = latency_bucket_floor(b);
+        if (p99 < 0 && seen * 100 >= samples * 99) p99 = latency_bucket_floor(b);
+    }
+    free(latency);
+
+    printf("{\"engine\":\"%s\",\"run\":%d,\"ports\":%d,\"expected_open\":%ld,\"open\":%ld,"
+           "\"wall_s\":%.3f,\"ports_per_sec\":%.0f,\"cpu_user_s\":%.3f,\"cpu_sys_s\":%.3f,"
+           "\"latency_samples\":%lu,",
+           name, run, cfg->ports, expected_open, open,
+           wall, wall > 0 ? cfg->ports / wall : 0.0, user, sys, samples);
+    if (samples > 0) {
+        printf("\"p50_us\":%ld,\"p99_us\":%ld}\n", p50, p99);
+    } else {
+        printf("\"p50_us\":null,\"p99_us\":null}\n");
+    }
+    fflush(stdout);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "用法: %s [选项]\n"
+            "  --addr A         目标服务监听的回环地址 (默认 %s)\n"
+            "  --base-port P    起始端口 (默认 %d)\n"
+            "  --ports N        端口数 (默认 %d)\n"
+            "  --open F         开放端口的比例 (默认 0.2)\n"
+            "  --filtered F     过滤端口的比例 (默认 0.05)\n"
+            "  --delay MS       接受连接后延迟多少毫秒发送横幅 (默认 0)\n"
+            "  --banner TEXT    开放端口发送的横幅\n"
+            "  --engines LIST   逗号分隔: thread,epoll,uring,syn (默认全部，syn需要root)\n"
+            "  --repeat N       每个引擎运行的次数 (默认 1)\n"
+            "  --threads N      线程引擎的线程数 (默认 200)\n"
+            "  --window N       事件驱动引擎的并发连接数 (默认 %d)\n"
+            "  --timeout MS     探测超时 (默认 300)\n"
+            "  --retries N      重传次数 (默认 0)\n"
+            "  -b               同时抓取横幅\n",
+            prog, BENCH_ADDR, BENCH_BASE_PORT, BENCH_PORTS, DEFAULT_CONNECT_WINDOW);
+}
+
+int main(int argc, char **argv) {
+    TargetConfig cfg = {
+        .addr = BENCH_ADDR,
+        .base_port = BENCH_BASE_PORT,
+        .ports = BENCH_PORTS,
+        .open_fraction = 0.2,
+        .filtered_fraction = 0.05,
+        .delay_ms = 0,
+        .banner = BENCH_BANNER
+    };
+    const char *engines = "thread,epoll,uring,syn";
+    int repeat = 1;
+    int threads = 200;
+    int window = DEFAULT_CONNECT_WINDOW;
+    int timeout_ms = 300;
+    int retries = 0;
+    int banner_grab = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *val = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(arg, "-b") == 0) {
+            banner_grab = 1;
+            continue;
+        }
+        if (!val || strncmp(arg, "--", 2) != 0) {
+            usage(argv[0]);
+            return 1;
+        }
+        i++;
+        if (strcmp(arg, "--addr") == 0) cfg.addr = val;
+        else if (strcmp(arg, "--base-port") == 0) cfg.base_port = atoi(val);
+        else if (strcmp(arg, "--ports") == 0) cfg.ports = atoi(val);
+        else if (strcmp(arg, "--open") == 0) cfg.open_fraction = atof(val);
+        else if (strcmp(arg, "--filtered") == 0) cfg.filtered_fraction = atof(val);
+        else if (strcmp(arg, "--delay") == 0) cfg.delay_ms = atoi(val);
+        else if (strcmp(arg, "--banner") == 0) cfg.banner = val;
+        else if (strcmp(arg, "--engines") == 0) engines = val;
+        else if (strcmp(arg, "--repeat") == 0) repeat = atoi(val);
+        else if (strcmp(arg, "--threads") == 0) threads = atoi(val);
+        else if (strcmp(arg, "--window") == 0) window = atoi(val);
+        else if (strcmp(arg, "--timeout") == 0) timeout_ms = atoi(val);
+        else if (strcmp(arg, "--retries") == 0) retries = atoi(val);
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    struct in_addr probe_addr;
+    if (inet_pton(AF_INET, cfg.addr, &probe_addr) != 1 ||
+        (ntohl(probe_addr.s_addr) >> 24) != 127) {
+        fprintf(stderr, "错误: --addr 必须是回环地址\n");
+        return 1;
+    }
+    if (cfg.ports < 1 || cfg.base_port < 1 || cfg.base_port + cfg.ports - 1 > 65535 ||
+        cfg.open_fraction < 0 || cfg.filtered_fraction < 0 ||
+        cfg.open_fraction + cfg.filtered_fraction > 1 || repeat < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    long expected_open = 0;
+    for (int i = 0; i < cfg.ports; i++) {
+        if (port_class(&cfg, cfg.base_port + i) == BENCH_OPEN) {
+            expected_open++;
+        }
+    }
+
+    // 目标服务放在子进程中，CPU时间不计入扫描进程
+    int pipefd[2];
+    if (pipe(pipefd) < 0) {
+        perror("pipe");
+        return 1;
+    }
+    pid_t child = fork();
+    if (child < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (child == 0) {
+        close(pipefd[0]);
+        run_target(&cfg, pipefd[1]);
+        _exit(0);
+    }
+    close(pipefd[1]);
+    char status = 0;
+    if (read(pipefd[0], &status, 1) != 1 || !status) {
+        fprintf(stderr, "错误: 目标服务启动失败\n");
+        kill(child, SIGKILL);
+        waitpid(child, NULL, 0);
+        return 1;
+    }
+    close(pipefd[0]);
+
+    char port_range[32];
+    snprintf(port_range, sizeof(port_range), "%d-%d", cfg.base_port, cfg.base_port + cfg.ports - 1);
+
+    ScanOptions base;
+    memset(&base, 0, sizeof(base));
+    base.targets = cfg.addr;
+    base.port_range = port_range;
+    base.thread_count = threads;
+    base.timeout_ms = timeout_ms;
+    base.min_timeout_ms = timeout_ms;
+    base.max_timeout_ms = timeout_ms;
+    base.retries = retries;
+    base.scan_type = SCAN_TCP_CONNECT;
+    base.window = window;
+    base.batch_size = DEFAULT_TX_BATCH;
+    base.randomize = 1;
+    base.banner_grab = banner_grab;
+
+    char *list = strdup(engines);
+    int failed = 0;
+    for (int run = 1; run <= repeat && !failed; run++) {
+        char *saveptr = NULL;
+        char *copy = strdup(list);
+        for (char *name = strtok_r(copy, ",", &saveptr); name && !failed;
+             name = strtok_r(NULL, ",", &saveptr)) {
+            failed = run_engine(name, &cfg, &base, expected_open, run) < 0;
+        }
+        free(copy);
+    }
+    free(list);
+
+    kill(child, SIGTERM);
+    waitpid(child, NULL, 0);
+    return failed ? 1 : 0;
+}
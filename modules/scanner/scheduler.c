@@ -0,0 +1,112 @@
+/**
+ * 探测调度
+ * 每个连接扫描线程按顺序取探测: 先取因主机窗口已满而暂缓的探测，
+ * 再取等待重传的探测，最后从扫描空间取新探测。
+ * 发出前向主机状态表申请窗口并从全局速率控制取令牌，结束后按结果调整窗口
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "port_scanner.h"
+
+int probe_scheduler_init(ProbeScheduler *sched, int capacity) {
+    memset(sched, 0, sizeof(*sched));
+    if (capacity < 1) capacity = 1;
+
+    // 等待重传的探测与未完成的探测之和不超过并发窗口
+    sched->retries = malloc(sizeof(Probe) * capacity);
+    if (!sched->retries) {
+        return -1;
+    }
+    sched->capacity = capacity;
+    return 0;
+}
+
+void probe_scheduler_free(ProbeScheduler *sched) {
+    free(sched->retries);
+    sched->retries = NULL;
+}
+
+// 取下一个探测并占用主机窗口
+// 返回1表示取得探测，0表示主机窗口已满或速率受限需稍后再试（后者在pace_wait_ns中给出等待时间），
+// -1表示没有剩余探测
+int probe_scheduler_next(ThreadParams *params, ProbeScheduler *sched,
+                         Probe *probe, int *timeout_ms) {
+    Probe candidate;
+
+    sched->pace_wait_ns = 0;
+    if (sched->has_pending) {
+        candidate = sched->pending;
+    } else if (sched->count > 0) {
+        candidate = sched->retries[sched->head];
+        sched->head = (sched->head + 1) % sched->capacity;
+        sched->count--;
+    } else if (!sched->exhausted &&
+               next_probe(params, &candidate.addr, &candidate.port) == 0) {
+        candidate.attempt = 0;
+    } else {
+        sched->exhausted = 1;
+        return -1;
+    }
+
+    if (!host_probe_start(params->hosts, candidate.addr, pacer_behind(params->pacer), timeout_ms)) {
+        sched->pending = candidate;
+        sched->has_pending = 1;
+        return 0;
+    }
+
+    // 最后取令牌，避免主机窗口已满时白白消耗令牌
+    long wait_ns = pacer_try(params->pacer);
+    if (wait_ns > 0) {
+        host_probe_finish(params->hosts, candidate.addr, PROBE_CANCELLED, -1);
+        sched->pending = candidate;
+        sched->has_pending = 1;
+        sched->pace_wait_ns = wait_ns;
+        return 0;
+    }
+
+    sched->has_pending = 0;
+    *probe = candidate;
+    return 1;
+}
+
+// 探测因本地资源不足未能发出，归还主机窗口并稍后重试
+void probe_scheduler_defer(ThreadParams *params, ProbeScheduler *sched, const Probe *probe) {
+    host_probe_finish(params->hosts, probe->addr, PROBE_CANCELLED, -1);
+    sched->pending = *probe;
+    sched->has_pending = 1;
+}
+
+// 探测得到响应（连接成功或被拒绝）
+void probe_answered(ThreadParams *params, const Probe *probe, long rtt_us) {
+    if (probe->attempt > 0) {
+        // 重传才得到响应，原探测被丢弃
+        host_probe_finish(params->hosts, probe->addr, PROBE_RETRY_ANSWERED, -1);
+    } else {
+        host_probe_finish(params->hosts, probe->addr, PROBE_ANSWERED, rtt_us);
+        if (rtt_us >= 0) {
+            params->shard->latency[latency_bucket(rtt_us)]++;
+        }
+    }
+}
+
+// 探测超时，还有重传次数时加入重传队列并返回1
+int probe_timed_out(ThreadParams *params, ProbeScheduler *sched, const Probe *probe) {
+    host_probe_finish(params->hosts, probe->addr, PROBE_NO_ANSWER, -1);
+
+    if (probe->attempt >= params->retries || sched->count == sched->capacity) {
+        return 0;
+    }
+
+    Probe *retry = &sched->retries[(sched->head + sched->count) % sched->capacity];
+    *retry = *probe;
+    retry->attempt++;
+    sched->count++;
+    return 1;
+}
+
+// 探测以不可达等错误结束，不重传
+void probe_unreachable(ThreadParams *params, const Probe *probe) {
+    host_probe_finish(params->hosts, probe->addr, PROBE_NO_ANSWER, -1);
+}
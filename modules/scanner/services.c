@@ -0,0 +1,673 @@
+/**
+ * 服务名称表
+ * tcp和udp各一张65536项的表，按端口号直接索引，查询为O(1)。
+ * 表从nmap-services格式的服务文件加载（含开放频率），找不到时使用/etc/services；
+ * 内置的常见服务覆盖在文件之上。
+ * 解析结果以二进制形式缓存，之后的启动直接mmap缓存文件，不再解析文本
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "port_scanner.h"
+
+#define SERVICE_PORTS 65536
+#define SERVICE_NAME_SIZE 32
+#define SERVICE_MAX_NAMES 65535        // 名称下标为uint16_t，0表示未知
+#define SERVICE_CACHE_MAGIC 0x5653544bU   // "KTSV"
+#define SERVICE_CACHE_VERSION 2
+#define SERVICE_EXTRA_MAX 256          // 版本识别得到的、表中没有的服务名称
+
+enum { SERVICE_TCP = 0, SERVICE_UDP = 1 };
+
+// 缓存文件布局: 文件头，两张名称下标表，两张频率表，名称数组
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t name_count;           // 包含下标0的"unknown"
+    uint32_t builtin_hash;         // 内置服务表和缓存布局的散列，程序更新后两者有变化时重建
+    int64_t source_mtime;          // 源文件的修改时间和大小，任一变化时重建
+    int64_t source_size;
+    char source_path[256];
+} ServiceCacheHeader;
+
+typedef struct {
+    const ServiceCacheHeader *header;
+    const uint16_t *index[2];
+    const float *freq[2];
+    const char (*names)[SERVICE_NAME_SIZE];
+    void *base;
+    size_t size;
+    int mapped;                    // base来自mmap还是malloc
+} ServiceTable;
+
+static ServiceTable service_table;
+
+// 名称到下标的反查表，第一次按名称查询时建立；
+// 表中没有的名称追加到extra，下标接在表中名称之后
+static pthread_mutex_t service_name_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint16_t *service_name_hash;
+static size_t service_name_hash_size;
+static char service_extra[SERVICE_EXTRA_MAX][SERVICE_NAME_SIZE];
+static int service_extra_count;
+
+// 内置的常见服务，优先于服务文件中的名称
+static const ServiceInfo builtin_services[] = {
+    {20, "ftp-data", "tcp", "FTP Data Transfer"},
+    {21, "ftp", "tcp", "File Transfer Protocol"},
+    {22, "ssh", "tcp", "Secure Shell"},
+    {23, "telnet", "tcp", "Telnet"},
+    {25, "smtp", "tcp", "Simple Mail Transfer Protocol"},
+    {53, "dns", "tcp/udp", "Domain Name System"},
+    {67, "dhcp", "udp", "DHCP Server"},
+    {68, "dhcp", "udp", "DHCP Client"},
+    {69, "tftp", "udp", "Trivial File Transfer Protocol"},
+    {80, "http", "tcp", "Hypertext Transfer Protocol"},
+    {110, "pop3", "tcp", "Post Office Protocol v3"},
+    {111, "rpcbind", "tcp/udp", "RPC Portmapper"},
+    {123, "ntp", "udp", "Network Time Protocol"},
+    {135, "msrpc", "tcp", "Microsoft RPC"},
+    {137, "netbios-ns", "udp", "NetBIOS Name Service"},
+    {138, "netbios-dgm", "udp", "NetBIOS Datagram Service"},
+    {139, "netbios-ssn", "tcp", "NetBIOS Session Service"},
+    {143, "imap", "tcp", "Internet Message Access Protocol"},
+    {161, "snmp", "udp", "Simple Network Management Protocol"},
+    {162, "snmptrap", "udp", "SNMP Trap"},
+    {389, "ldap", "tcp", "Lightweight Directory Access Protocol"},
+    {443, "https", "tcp", "HTTP over SSL/TLS"},
+    {445, "microsoft-ds", "tcp", "Microsoft Directory Services"},
+    {465, "smtps", "tcp", "SMTP over SSL"},
+    {514, "syslog", "udp", "System Logging Protocol"},
+    {587, "smtp", "tcp", "SMTP Submission"},
+    {636, "ldaps", "tcp", "LDAP over SSL"},
+    {993, "imaps", "tcp", "IMAP over SSL"},
+    {995, "pop3s", "tcp", "POP3 over SSL"},
+    {1080, "socks", "tcp", "SOCKS Proxy"},
+    {1433, "ms-sql-s", "tcp", "Microsoft SQL Server"},
+    {1521, "oracle", "tcp", "Oracle Database"},
+    {1723, "pptp", "tcp", "Point-to-Point Tunneling Protocol"},
+    {1883, "mqtt", "tcp", "MQ Telemetry Transport"},
+    {1900, "upnp", "udp", "Universal Plug and Play"},
+    {2049, "nfs", "tcp/udp", "Network File System"},
+    {2082, "cpanel", "tcp", "cPanel"},
+    {2083, "cpanel", "tcp", "cPanel SSL"},
+    {2086, "whm", "tcp", "WebHost Manager"},
+    {2087, "whm", "tcp", "WebHost Manager SSL"},
+    {2095, "webmail", "tcp", "cPanel WebMail"},
+    {2096, "webmail", "tcp", "cPanel WebMail SSL"},
+    {2181, "zookeeper", "tcp", "Apache ZooKeeper"},
+    {2375, "docker", "tcp", "Docker REST API"},
+    {2376, "docker", "tcp", "Docker REST API SSL"},
+    {3000, "nodejs", "tcp", "Node.js Application"},
+    {3306, "mysql", "tcp", "MySQL Database"},
+    {3389, "ms-wbt-server", "tcp", "Remote Desktop Protocol"},
+    {3690, "svn", "tcp", "Subversion"},
+    {4000, "remoteanything", "tcp", "Remote Anything"},
+    {4040, "yo", "tcp", "Yarn Application Manager"},
+    {4200, "angular", "tcp", "Angular Development Server"},
+    {4369, "epmd", "tcp", "Erlang Port Mapper Daemon"},
+    {5000, "upnp", "tcp", "Universal Plug and Play"},
+    {5432, "postgresql", "tcp", "PostgreSQL Database"},
+    {5601, "kibana", "tcp", "Kibana"},
+    {5672, "amqp", "tcp", "Advanced Message Queuing Protocol"},
+    {5900, "vnc", "tcp", "Virtual Network Computing"},
+    {5984, "couchdb", "tcp", "Apache CouchDB"},
+    {6379, "redis", "tcp", "Redis Key-Value Store"},
+    {7001, "weblogic", "tcp", "Oracle WebLogic Server"},
+    {7002, "weblogic", "tcp", "Oracle WebLogic Server SSL"},
+    {8000, "http-alt", "tcp", "HTTP Alternate"},
+    {8008, "http-alt", "tcp", "HTTP Alternate"},
+    {8080, "http-proxy", "tcp", "HTTP Proxy"},
+    {8081, "http-proxy", "tcp", "HTTP Proxy"},
+    {8088, "http-alt", "tcp", "HTTP Alternate"},
+    {8089, "splunk", "tcp", "Splunk"},
+    {8443, "https-alt", "tcp", "HTTPS Alternate"},
+    {8888, "http-alt", "tcp", "HTTP Alternate"},
+    {9000, "sonar", "tcp", "SonarQube"},
+    {9001, "tor", "tcp", "Tor"},
+    {9042, "cassandra", "tcp", "Apache Cassandra"},
+    {9092, "kafka", "tcp", "Apache Kafka"},
+    {9200, "elasticsearch", "tcp", "Elasticsearch"},
+    {9300, "elasticsearch", "tcp", "Elasticsearch Transport"},
+    {9418, "git", "tcp", "Git"},
+    {11211, "memcache", "tcp", "Memcached"},
+    {15672, "rabbitmq", "tcp", "RabbitMQ Management"},
+    {27017, "mongodb", "tcp", "MongoDB"},
+    {27018, "mongodb", "tcp", "MongoDB Sharding"},
+    {28017, "mongodb", "tcp", "MongoDB Web Interface"},
+    {50000, "db2", "tcp", "IBM DB2"},
+    {50070, "hadoop", "tcp", "Hadoop HDFS NameNode"},
+    {61616, "activemq", "tcp", "Apache ActiveMQ"}
+};
+
+// 按顺序查找的服务文件，PENTK_SERVICES环境变量指定的文件优先
+static const char *service_files[] = {
+    "/usr/share/nmap/nmap-services",
+    "/usr/local/share/nmap/nmap-services",
+    "/etc/services"
+};
+
+static size_t service_table_size(uint32_t name_count) {
+    return sizeof(ServiceCacheHeader) +
+           2 * SERVICE_PORTS * sizeof(uint16_t) +
+           2 * SERVICE_PORTS * sizeof(float) +
+           (size_t)name_count * SERVICE_NAME_SIZE;
+}
+
+// 在base上设置各表的指针，base的大小必须已经校验
+static void service_table_bind(ServiceTable *table, void *base, size_t size, int mapped) {
+    char *p = base;
+    table->header = base;
+    p += sizeof(ServiceCacheHeader);
+    table->index[SERVICE_TCP] = (const uint16_t *)p;
+    p += SERVICE_PORTS * sizeof(uint16_t);
+    table->index[SERVICE_UDP] = (const uint16_t *)p;
+    p += SERVICE_PORTS * sizeof(uint16_t);
+    table->freq[SERVICE_TCP] = (const float *)p;
+    p += SERVICE_PORTS * sizeof(float);
+    table->freq[SERVICE_UDP] = (const float *)p;
+    p += SERVICE_PORTS * sizeof(float);
+    table->names = (const char (*)[SERVICE_NAME_SIZE])p;
+    table->base = base;
+    table->size = size;
+    table->mapped = mapped;
+}
+
+// 构建过程中的临时状态
+typedef struct {
+    uint16_t index[2][SERVICE_PORTS];
+    float freq[2][SERVICE_PORTS];
+    char (*names)[SERVICE_NAME_SIZE];
+    uint32_t name_count;
+    uint32_t name_capacity;
+    uint16_t *hash;                // 名称去重用的开放寻址表，存名称下标
+    uint32_t hash_size;
+} ServiceBuilder;
+
+static uint32_t name_hash(const char *name) {
+    uint32_t h = 2166136261U;
+    while (*name) {
+        h = (h ^ (unsigned char)*name++) * 16777619U;
+    }
+    return h;
+}
+
+// 取得名称的下标，不存在时加入，名称过多时返回0
+static uint16_t builder_intern(ServiceBuilder *b, const char *name) {
+    uint32_t pos = name_hash(name) & (b->hash_size - 1);
+    while (b->hash[pos]) {
+        if (strcmp(b->names[b->hash[pos]], name) == 0) {
+            return b->hash[pos];
+        }
+        pos = (pos + 1) & (b->hash_size - 1);
+    }
+
+    if (b->name_count >= SERVICE_MAX_NAMES) {
+        return 0;
+    }
+    if (b->name_count == b->name_capacity) {
+        uint32_t new_capacity = b->name_capacity * 2;
+        char (*names)[SERVICE_NAME_SIZE] = realloc(b->names, (size_t)new_capacity * SERVICE_NAME_SIZE);
+        if (!names) {
+            return 0;
+        }
+        b->names = names;
+        b->name_capacity = new_capacity;
+    }
+
+    uint16_t id = (uint16_t)b->name_count++;
+    memset(b->names[id], 0, SERVICE_NAME_SIZE);
+    strncpy(b->names[id], name, SERVICE_NAME_SIZE - 1);
+    b->hash[pos] = id;
+    return id;
+}
+
+// 设置端口的服务名称；force为假时只在频率更高时替换已有名称
+static void builder_set(ServiceBuilder *b, int proto, int port, const char *name,
+                        float freq, int force) {
+    if (port < 0 || port >= SERVICE_PORTS) {
+        return;
+    }
+    if (!force && b->index[proto][port] && freq <= b->freq[proto][port]) {
+        return;
+    }
+    uint16_t id = builder_intern(b, name);
+    if (id) {
+        b->index[proto][port] = id;
+        if (freq > b->freq[proto][port]) {
+            b->freq[proto][port] = freq;
+        }
+    }
+}
+
+// 解析服务文件，每行: 名称 端口/协议 [频率|别名...] [# 注释]
+static int builder_parse(ServiceBuilder *b, FILE *fp) {
+    char line[512];
+    int entries = 0;
+
+    while (fgets(line, sizeof(line), fp)) {
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+
+        char *save = NULL;
+        char *name = strtok_r(line, " \t\r\n", &save);
+        char *port_proto = strtok_r(NULL, " \t\r\n", &save);
+        char *extra = strtok_r(NULL, " \t\r\n", &save);
+        if (!name || !port_proto || strcmp(name, "unknown") == 0) {
+            continue;
+        }
+
+        char *slash = strchr(port_proto, '/');
+        if (!slash) {
+            continue;
+        }
+        *slash = '\0';
+        int proto;
+        if (strcmp(slash + 1, "tcp") == 0) {
+            proto = SERVICE_TCP;
+        } else if (strcmp(slash + 1, "udp") == 0) {
+            proto = SERVICE_UDP;
+        } else {
+            continue;
+        }
+
+        char *end;
+        long port = strtol(port_proto, &end, 10);
+        if (*end != '\0') {
+            continue;
+        }
+
+        // nmap-services的第三列是开放频率，/etc/services的第三列是别名
+        float freq = 0;
+        if (extra) {
+            double value = strtod(extra, &end);
+            if (*end == '\0') {
+                freq = (float)value;
+            }
+        }
+
+        builder_set(b, proto, (int)port, name, freq, 0);
+        entries++;
+    }
+
+    return entries;
+}
+
+// 把内置服务覆盖到表中
+static void builder_add_builtin(ServiceBuilder *b) {
+    size_t count = sizeof(builtin_services) / sizeof(builtin_services[0]);
+    for (size_t i = 0; i < count; i++) {
+        const ServiceInfo *info = &builtin_services[i];
+        if (strstr(info->protocol, "tcp")) {
+            builder_set(b, SERVICE_TCP, info->port, info->name, 0, 1);
+        }
+        if (strstr(info->protocol, "udp")) {
+            builder_set(b, SERVICE_UDP, info->port, info->name, 0, 1);
+        }
+    }
+}
+
+static uint32_t fnv_bytes(uint32_t h, const void *data, size_t len) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ p[i]) * 16777619U;
+    }
+    return h;
+}
+
+// 内置服务表的内容和缓存布局参数的散列，写入缓存文件头
+static uint32_t builtin_fingerprint(void) {
+    uint32_t layout[] = {
+        sizeof(ServiceCacheHeader), SERVICE_PORTS, SERVICE_NAME_SIZE,
+        sizeof(uint16_t), sizeof(float)
+    };
+    uint32_t h = fnv_bytes(2166136261U, layout, sizeof(layout));
+
+    size_t count = sizeof(builtin_services) / sizeof(builtin_services[0]);
+    for (size_t i = 0; i < count; i++) {
+        const ServiceInfo *info = &builtin_services[i];
+        h = fnv_bytes(h, &info->port, sizeof(info->port));
+        h = fnv_bytes(h, info->name, strlen(info->name) + 1);
+        h = fnv_bytes(h, info->protocol, strlen(info->protocol) + 1);
+    }
+    return h;
+}
+
+// 从服务文件（可为NULL）构建表，返回按缓存布局排列的内存块
+static void* service_table_build(const char *path, const struct stat *st, size_t *size_out) {
+    ServiceBuilder *b = calloc(1, sizeof(ServiceBuilder));
+    if (!b) {
+        return NULL;
+    }
+    b->name_capacity = 1024;
+    b->names = malloc((size_t)b->name_capacity * SERVICE_NAME_SIZE);
+    b->hash_size = 131072;
+    b->hash = calloc(b->hash_size, sizeof(uint16_t));
+    void *base = NULL;
+    if (!b->names || !b->hash) {
+        goto out;
+    }
+
+    // 下标0保留给未知端口
+    memset(b->names[0], 0, SERVICE_NAME_SIZE);
+    strcpy(b->names[0], "unknown");
+    b->name_count = 1;
+
+    if (path) {
+        FILE *fp = fopen(path, "r");
+        if (fp) {
+            builder_parse(b, fp);
+            fclose(fp);
+        }
+    }
+    builder_add_builtin(b);
+
+    size_t size = service_table_size(b->name_count);
+    base = calloc(1, size);
+    if (!base) {
+        goto out;
+    }
+
+    ServiceCacheHeader *header = base;
+    header->magic = SERVICE_CACHE_MAGIC;
+    header->version = SERVICE_CACHE_VERSION;
+    header->name_count = b->name_count;
+    header->builtin_hash = builtin_fingerprint();
+    if (path && st) {
+        header->source_mtime = st->st_mtime;
+        header->source_size = st->st_size;
+        strncpy(header->source_path, path, sizeof(header->source_path) - 1);
+    }
+
+    char *p = (char *)base + sizeof(ServiceCacheHeader);
+    memcpy(p, b->index, sizeof(b->index));
+    p += sizeof(b->index);
+    memcpy(p, b->freq, sizeof(b->freq));
+    p += sizeof(b->freq);
+    memcpy(p, b->names, (size_t)b->name_count * SERVICE_NAME_SIZE);
+    *size_out = size;
+
+out:
+    free(b->names);
+    free(b->hash);
+    free(b);
+    return base;
+}
+
+// 缓存文件路径: $XDG_CACHE_HOME/pentk/services.bin 或 ~/.cache/pentk/services.bin
+static int service_cache_path(char *path, size_t size, int create_dir) {
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    char dir[256];
+
+    if (xdg && xdg[0]) {
+        snprintf(dir, sizeof(dir), "%s/pentk", xdg);
+    } else if (home && home[0]) {
+        snprintf(dir, sizeof(dir), "%s/.cache", home);
+        if (create_dir) mkdir(dir, 0755);
+        snprintf(dir, sizeof(dir), "%s/.cache/pentk", home);
+    } else {
+        return -1;
+    }
+
+    if (create_dir) {
+        mkdir(dir, 0755);
+    }
+    snprintf(path, size, "%s/services.bin", dir);
+    return 0;
+}
+
+// mmap缓存文件，与源文件不一致或格式不对时返回-1
+static int service_cache_load(const char *source, const struct stat *st) {
+    char path[512];
+    if (service_cache_path(path, sizeof(path), 0) < 0) {
+        return -1;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat cache_st;
+    if (fstat(fd, &cache_st) < 0 || (size_t)cache_st.st_size < sizeof(ServiceCacheHeader)) {
+        close(fd);
+        return -1;
+    }
+
+    size_t size = (size_t)cache_st.st_size;
+    void *base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return -1;
+    }
+
+    const ServiceCacheHeader *header = base;
+    if (header->magic != SERVICE_CACHE_MAGIC ||
+        header->version != SERVICE_CACHE_VERSION ||
+        header->builtin_hash != builtin_fingerprint() ||
+        header->name_count == 0 || header->name_count > SERVICE_MAX_NAMES ||
+        service_table_size(header->name_count) != size ||
+        strncmp(header->source_path, source ? source : "", sizeof(header->source_path)) != 0 ||
+        (st && (header->source_mtime != (int64_t)st->st_mtime ||
+                header->source_size != (int64_t)st->st_size))) {
+        munmap(base, size);
+        return -1;
+    }
+
+    service_table_bind(&service_table, base, size, 1);
+    return 0;
+}
+
+// 写入缓存文件，先写临时文件再改名，避免其他进程读到一半的文件
+static void service_cache_store(const void *base, size_t size) {
+    char path[512];
+    char tmp[576];
+    if (service_cache_path(path, sizeof(path), 1) < 0) {
+        return;
+    }
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return;
+    }
+    ssize_t written = write(fd, base, size);
+    close(fd);
+    if (written != (ssize_t)size || rename(tmp, path) < 0) {
+        unlink(tmp);
+    }
+}
+
+// 加载服务表，失败返回-1
+int service_table_load(void) {
+    if (service_table.base) {
+        return 0;
+    }
+
+    // 找到第一个存在的服务文件
+    const char *source = NULL;
+    struct stat st;
+    const char *env = getenv("PENTK_SERVICES");
+    if (env && env[0] && stat(env, &st) == 0) {
+        source = env;
+    }
+    for (size_t i = 0; !source && i < sizeof(service_files) / sizeof(service_files[0]); i++) {
+        if (stat(service_files[i], &st) == 0) {
+            source = service_files[i];
+        }
+    }
+
+    if (service_cache_load(source, source ? &st : NULL) == 0) {
+        return 0;
+    }
+
+    size_t size = 0;
+    void *base = service_table_build(source, source ? &st : NULL, &size);
+    if (!base) {
+        return -1;
+    }
+    service_cache_store(base, size);
+    service_table_bind(&service_table, base, size, 0);
+    return 0;
+}
+
+void service_table_free(void) {
+    pthread_mutex_lock(&service_name_lock);
+    free(service_name_hash);
+    service_name_hash = NULL;
+    service_name_hash_size = 0;
+    service_extra_count = 0;
+    pthread_mutex_unlock(&service_name_lock);
+
+    if (!service_table.base) {
+        return;
+    }
+    if (service_table.mapped) {
+        munmap(service_table.base, service_table.size);
+    } else {
+        free(service_table.base);
+    }
+    memset(&service_table, 0, sizeof(service_table));
+}
+
+static int service_proto(const char *protocol) {
+    return (protocol && protocol[0] == 'u') ? SERVICE_UDP : SERVICE_TCP;
+}
+
+// 表中名称的数量，extra的下标从这里开始
+static uint32_t service_name_count(void) {
+    return service_table.base ? service_table.header->name_count : 1;
+}
+
+// 端口对应的服务名称下标，0表示未知
+uint16_t get_service_id(int port, const char *protocol) {
+    if (!service_table.base || port < 0 || port >= SERVICE_PORTS) {
+        return 0;
+    }
+    uint16_t id = service_table.index[service_proto(protocol)][port];
+    if (id >= service_table.header->name_count) {
+        id = 0;
+    }
+    return id;
+}
+
+// 下标对应的服务名称
+const char* service_name(uint16_t id) {
+    uint32_t count = service_name_count();
+    if (id < count) {
+        return service_table.base ? service_table.names[id] : "unknown";
+    }
+    // extra只追加不修改，已发出的下标不需要加锁读取
+    if (id - count < (uint32_t)__atomic_load_n(&service_extra_count, __ATOMIC_ACQUIRE)) {
+        return service_extra[id - count];
+    }
+    return "unknown";
+}
+
+// 根据端口号获取服务名称
+const char* get_service_by_port(int port, const char* protocol) {
+    return service_name(get_service_id(port, protocol));
+}
+
+static uint32_t service_name_hash_of(const char *name) {
+    uint32_t h = 2166136261U;
+    for (; *name; name++) {
+        h = (h ^ (uint8_t)*name) * 16777619U;
+    }
+    return h;
+}
+
+static void service_name_hash_insert(uint16_t id) {
+    size_t mask = service_name_hash_size - 1;
+    size_t pos = service_name_hash_of(service_name(id)) & mask;
+    while (service_name_hash[pos]) {
+        pos = (pos + 1) & mask;
+    }
+    service_name_hash[pos] = id + 1;   // 0表示空槽
+}
+
+// 按名称查找服务下标，表中没有时登记为新名称；登记已满时返回0
+uint16_t service_id_by_name(const char *name) {
+    if (!name || !name[0]) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&service_name_lock);
+    uint32_t count = service_name_count();
+    if (!service_name_hash) {
+        size_t size = 1024;
+        while (size < 2 * ((size_t)count + SERVICE_EXTRA_MAX)) {
+            size *= 2;
+        }
+        service_name_hash = calloc(size, sizeof(uint16_t));
+        if (!service_name_hash) {
+            pthread_mutex_unlock(&service_name_lock);
+            return 0;
+        }
+        service_name_hash_size = size;
+        // 同名取第一个下标
+        for (uint32_t id = 1; id < count; id++) {
+            service_name_hash_insert((uint16_t)id);
+        }
+    }
+
+    size_t mask = service_name_hash_size - 1;
+    size_t pos = service_name_hash_of(name) & mask;
+    uint16_t found = 0;
+    while (service_name_hash[pos]) {
+        uint16_t id = service_name_hash[pos] - 1;
+        if (strcmp(service_name(id), name) == 0) {
+            found = id;
+            break;
+        }
+        pos = (pos + 1) & mask;
+    }
+
+    if (!found && service_extra_count < SERVICE_EXTRA_MAX && count + service_extra_count < SERVICE_MAX_NAMES) {
+        found = (uint16_t)(count + service_extra_count);
+        snprintf(service_extra[service_extra_count], SERVICE_NAME_SIZE, "%s", name);
+        __atomic_store_n(&service_extra_count, service_extra_count + 1, __ATOMIC_RELEASE);
+        service_name_hash_insert(found);
+    }
+    pthread_mutex_unlock(&service_name_lock);
+    return found;
+}
+
+// 端口的开放频率（来自nmap-services，其他来源为0）
+double get_service_frequency(int port, const char *protocol) {
+    if (!service_table.base || port < 0 || port >= SERVICE_PORTS) {
+        return 0;
+    }
+    return service_table.freq[service_proto(protocol)][port];
+}
+
+// 内置服务中标记为udp的端口，逗号分隔，作为UDP扫描的默认端口范围
+const char* service_udp_ports(void) {
+    static char ports[512];
+    if (ports[0]) {
+        return ports;
+    }
+
+    size_t count = sizeof(builtin_services) / sizeof(builtin_services[0]);
+    size_t used = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!strstr(builtin_services[i].protocol, "udp")) {
+            continue;
+        }
+        int n = snprintf(ports + used, sizeof(ports) - used, "%s%d",
+                         used ? "," : "", builtin_services[i].port);
+        if (n < 0 || (size_t)n >= sizeof(ports) - used) {
+            break;
+        }
+        used += n;
+    }
+    return ports;
+}
@@ -0,0 +1,274 @@
+/**
+ * 流式结果输出 (NDJSON)
+ * 每个结果确定后立即格式化为一行JSON追加到缓冲区，
+ * 缓冲区超过阈值或距上次写出超过间隔时写到文件、管道或标准输出。
+ * 输出到标准输出时，其余的提示信息改写到标准错误，保证输出流只有JSON行
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include "port_scanner.h"
+
+#define STREAM_LINE_MAX 8192       // 一个结果格式化后的最大长度
+
+struct ResultStream {
+    int fd;
+    int saved_stdout;              // 输出到标准输出时原来的fd 1，否则为-1
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t flusher;
+    char *buf;
+    size_t len;
+    size_t capacity;
+    size_t flush_bytes;
+    int flush_ms;
+    int closing;
+    int failed;                    // 写出失败（如管道另一端已关闭）后丢弃后续结果
+    unsigned long written;
+};
+
+// 转义JSON字符串中的引号、反斜杠和控制字符，返回写入的长度（不含结尾的0）
+size_t json_escape(const char *src, char *dst, size_t size) {
+    static const char hex[] = "0123456789abcdef";
+    size_t n = 0;
+
+    if (size == 0) {
+        return 0;
+    }
+    for (; *src; src++) {
+        unsigned char c = (unsigned char)*src;
+        char esc[7];
+        size_t len = 0;
+
+        if (c == '"' || c == '\\') {
+            esc[len++] = '\\';
+            esc[len++] = (char)c;
+        } else if (c < 0x20) {
+            esc[len++] = '\\';
+            esc[len++] = 'u';
+            esc[len++] = '0';
+            esc[len++] = '0';
+            esc[len++] = hex[c >> 4];
+            esc[len++] = hex[c & 0xf];
+        } else {
+            esc[len++] = (char)c;
+        }
+
+        if (n + len >= size) {
+            break;
+        }
+        memcpy(dst + n, esc, len);
+        n += len;
+    }
+    dst[n] = '\0';
+    return n;
+}
+
+// 写出全部数据；管道另一端关闭时不让SIGPIPE终止进程
+static int write_all(int fd, const char *data, size_t len) {
+    sigset_t pipe_set, old_set;
+    sigemptyset(&pipe_set);
+    sigaddset(&pipe_set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe_set, &old_set);
+
+    int ret = 0;
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EPIPE) {
+                // 丢弃已挂起的SIGPIPE
+                struct timespec zero = {0, 0};
+                sigtimedwait(&pipe_set, NULL, &zero);
+            }
+            ret = -1;
+            break;
+        }
+        data += n;
+        len -= n;
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+    return ret;
+}
+
+// 写出缓冲区，调用时持有锁
+static void stream_flush_locked(ResultStream *stream) {
+    if (stream->len == 0) {
+        return;
+    }
+    if (!stream->failed && write_all(stream->fd, stream->buf, stream->len) < 0) {
+        fprintf(stderr, "警告: 流式输出写入失败 (%s)，后续结果不再输出\n", strerror(errno));
+        stream->failed = 1;
+    }
+    stream->len = 0;
+}
+
+// 按时间间隔写出缓冲区，扫描发现结果较慢时也能及时输出
+static void* stream_flusher_func(void *arg) {
+    ResultStream *stream = (ResultStream *)arg;
+
+    pthread_mutex_lock(&stream->lock);
+    while (!stream->closing) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += stream->flush_ms / 1000;
+        deadline.tv_nsec += (long)(stream->flush_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&stream->cond, &stream->lock, &deadline);
+        stream_flush_locked(stream);
+    }
+    pthread_mutex_unlock(&stream->lock);
+    return NULL;
+}
+
+// 恢复标准输出并释放资源
+static void stream_release(ResultStream *stream) {
+    if (stream->saved_stdout >= 0) {
+        fflush(stdout);
+        dup2(stream->saved_stdout, STDOUT_FILENO);
+        close(stream->saved_stdout);
+    }
+    close(stream->fd);
+    pthread_cond_destroy(&stream->cond);
+    pthread_mutex_destroy(&stream->lock);
+    free(stream->buf);
+    free(stream);
+}
+
+// 打开流式输出，path为"-"时写到标准输出；
+// 缓冲区达到flush_bytes字节或距上次写出flush_ms毫秒时写出
+ResultStream* result_stream_open(const char *path, size_t flush_bytes, int flush_ms) {
+    ResultStream *stream = calloc(1, sizeof(ResultStream));
+    if (!stream) {
+        return NULL;
+    }
+    if (flush_bytes < 1) flush_bytes = 1;
+    if (flush_ms < 1) flush_ms = 1;
+
+    stream->flush_bytes = flush_bytes;
+    stream->flush_ms = flush_ms;
+    stream->capacity = flush_bytes + STREAM_LINE_MAX;
+    stream->buf = malloc(stream->capacity);
+    stream->saved_stdout = -1;
+    stream->fd = -1;
+    if (!stream->buf) {
+        free(stream);
+        return NULL;
+    }
+
+    if (strcmp(path, "-") == 0) {
+        // 标准输出只留给结果，其余输出改到标准错误
+        fflush(stdout);
+        stream->fd = dup(STDOUT_FILENO);
+        if (stream->fd >= 0) {
+            stream->saved_stdout = dup(STDOUT_FILENO);
+            dup2(STDERR_FILENO, STDOUT_FILENO);
+        }
+    } else {
+        stream->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    }
+    if (stream->fd < 0) {
+        printf("错误: 无法打开流式输出 %s (%s)\n", path, strerror(errno));
+        free(stream->buf);
+        free(stream);
+        return NULL;
+    }
+
+    pthread_mutex_init(&stream->lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&stream->cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (pthread_create(&stream->flusher, NULL, stream_flusher_func, stream) != 0) {
+        stream_release(stream);
+        return NULL;
+    }
+    return stream;
+}
+
+// 把结果格式化为一行JSON
+static int format_result(ResultStore *store, const ScanResult *result, char *line, size_t size) {
+    char addr[INET_ADDRSTRLEN];
+    char hostname[RESULT_HOSTNAME_MAX * 6];
+    char service[32 * 6];
+    char product[RESULT_PRODUCT_MAX * 6];
+    char version[RESULT_VERSION_MAX * 6];
+    char banner[RESULT_BANNER_MAX * 6];
+
+    inet_ntop(AF_INET, &result->addr, addr, sizeof(addr));
+    json_escape(result_string(store, result->hostname), hostname, sizeof(hostname));
+    json_escape(service_name(result->service), service, sizeof(service));
+    json_escape(result_string(store, result->product), product, sizeof(product));
+    json_escape(result_string(store, result->version), version, sizeof(version));
+    json_escape(result_string(store, result->banner), banner, sizeof(banner));
+
+    int n = snprintf(line, size,
+                     "{\"host\":\"%s\",\"hostname\":\"%s\",\"port\":%d,\"protocol\":\"%s\","
+                     "\"state\":\"%s\",\"service\":\"%s\",\"product\":\"%s\",\"version\":\"%s\","
+                     "\"response_time\":%d,\"banner\":\"%s\",\"timestamp\":%ld.%06ld}\n",
+                     addr, hostname, result->port, result_protocol_name(result->protocol),
+                     port_state_name(result->state), service, product, version,
+                     result->response_time, banner,
+                     (long)(result->timestamp_us / 1000000), (long)(result->timestamp_us % 1000000));
+    if (n < 0 || (size_t)n >= size) {
+        return -1;
+    }
+    return n;
+}
+
+// 输出一个已确定的结果，可由多个线程同时调用
+void result_stream_write(ResultStream *stream, ResultStore *store, const ScanResult *result) {
+    char line[STREAM_LINE_MAX];
+    int len = format_result(store, result, line, sizeof(line));
+    if (len < 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&stream->lock);
+    if (stream->len + len > stream->capacity) {
+        stream_flush_locked(stream);
+    }
+    memcpy(stream->buf + stream->len, line, len);
+    stream->len += len;
+    stream->written++;
+    if (stream->len >= stream->flush_bytes) {
+        stream_flush_locked(stream);
+    }
+    pthread_mutex_unlock(&stream->lock);
+}
+
+// 写出剩余结果并关闭，返回输出的结果数
+unsigned long result_stream_close(ResultStream *stream) {
+    if (!stream) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&stream->lock);
+    stream->closing = 1;
+    pthread_cond_signal(&stream->cond);
+    pthread_mutex_unlock(&stream->lock);
+    pthread_join(stream->flusher, NULL);
+
+    pthread_mutex_lock(&stream->lock);
+    stream_flush_locked(stream);
+    pthread_mutex_unlock(&stream->lock);
+
+    unsigned long written = stream->written;
+    stream_release(stream);
+    return written;
+}
@@ -0,0 +1,628 @@
+/**
+ * 无状态原始TCP扫描引擎 (SYN/ACK/FIN/XMAS/NULL)
+ * 发送线程按预构造的报文模板连续发送探测包，
+ * 接收线程通过序列号中编码的cookie匹配响应，
+ * 不保存每个探测的状态，也不为每个端口创建套接字
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <linux/filter.h>
+#include "port_scanner.h"
+
+#define RAW_PACKET_LEN (sizeof(struct iphdr) + sizeof(struct tcphdr))
+#define RAW_RCVBUF (8 * 1024 * 1024)
+#define RAW_MAX_SOURCES 16      // 不同出口地址的上限，超出时沿用第一个
+#define ROUTE_PREFIX_BITS 8     // 路由按/24缓存
+
+// 一个出口地址: 发往经由该地址的目标的探测都从这里发出
+typedef struct {
+    uint32_t addr;              // 网络字节序
+    uint16_t port;              // 主机字节序
+    int bound_sock;             // 占用源端口的TCP套接字
+    char template[RAW_PACKET_LEN];
+} RawSource;
+
+// 目标前缀到出口下标的缓存，只由发送线程使用
+typedef struct {
+    uint32_t *keys;             // 前缀+1，0表示空槽
+    uint8_t *values;
+    size_t capacity;            // 2的幂
+    size_t count;
+} RouteCache;
+
+// 一次原始扫描共享的状态
+typedef struct {
+    ThreadParams *params;
+    int raw_sock;               // 发送用原始套接字 (IP_HDRINCL)
+    int recv_sock;              // 无接收环时使用的TCP原始套接字
+    int icmp_sock;              // 无接收环时使用的ICMP原始套接字
+    PacketRing *ring;           // TPACKET_V3接收环
+    // 出口地址由发送线程追加，填好后才增加计数，接收线程按计数读取
+    RawSource sources[RAW_MAX_SOURCES];
+    int source_count;
+    int source_overflow;        // 是否已提示过出口地址过多
+    RouteCache routes;
+    uint32_t secret[2];
+    uint8_t probe_flags;        // 探测包的TCP标志
+    PortState silent_state;     // 无响应时的端口状态
+    IndexSet answered;          // 已收到响应的探测（扫描空间下标）
+    volatile int tx_done;
+} RawScan;
+
+static long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+// 计算探测cookie，作为探测包的序列号
+static uint32_t probe_cookie(const RawScan *scan, uint32_t daddr, uint16_t dport, uint16_t sport) {
+    uint64_t h = ((uint64_t)daddr << 32) | ((uint32_t)dport << 16) | sport;
+    h ^= ((uint64_t)scan->secret[0] << 32) | scan->secret[1];
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return (uint32_t)h;
+}
+
+// 各扫描类型的探测标志
+static uint8_t probe_flags_for(ScanType type) {
+    switch (type) {
+        case SCAN_TCP_SYN:  return TH_SYN;
+        case SCAN_TCP_ACK:  return TH_ACK;
+        case SCAN_TCP_FIN:  return TH_FIN;
+        case SCAN_TCP_XMAS: return TH_FIN | TH_PUSH | TH_URG;
+        case SCAN_TCP_NULL: return 0;
+        default:            return TH_SYN;
+    }
+}
+
+// 通过路由查找确定发往目标时使用的本地地址
+static int find_source_address(struct in_addr target, uint32_t *src_addr) {
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        return -1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(53);
+    addr.sin_addr = target;
+
+    // UDP connect不发送数据，只触发路由选择
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    struct sockaddr_in local;
+    socklen_t len = sizeof(local);
+    if (getsockname(sock, (struct sockaddr *)&local, &len) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    close(sock);
+    *src_addr = local.sin_addr.s_addr;
+    return 0;
+}
+
+// 绑定一个TCP套接字占用源端口，避免与本机其他连接冲突
+static int reserve_source_port(uint32_t src_addr, uint16_t *src_port) {
+    int sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        return -1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = src_addr;
+    addr.sin_port = 0;
+
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    socklen_t len = sizeof(addr);
+    if (getsockname(sock, (struct sockaddr *)&addr, &len) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    *src_port = ntohs(addr.sin_port);
+    return sock;
+}
+
+// 构造报文模板，发送时只修改目标地址、目标端口、序列号和校验和；
+// 模板的校验和按可变字段为0计算，发送时增量更新
+static void build_probe_template(const RawScan *scan, const RawSource *source, char *packet) {
+    struct iphdr *iph = (struct iphdr *)packet;
+    struct tcphdr *tcph = (struct tcphdr *)(packet + sizeof(struct iphdr));
+
+    memset(packet, 0, RAW_PACKET_LEN);
+
+    iph->ihl = 5;
+    iph->version = 4;
+    iph->tos = 0;
+    iph->tot_len = htons(RAW_PACKET_LEN);
+    iph->id = 0;                // 由内核填充
+    iph->frag_off = 0;
+    iph->ttl = 64;
+    iph->protocol = IPPROTO_TCP;
+    iph->check = 0;             // 由内核填充
+    iph->saddr = source->addr;
+
+    tcph->source = htons(source->port);
+    tcph->doff = 5;
+    tcph->th_flags = scan->probe_flags;
+    tcph->window = htons(1024);
+
+    struct pseudo_header psh;
+    psh.source_address = iph->saddr;
+    psh.dest_address = 0;
+    psh.placeholder = 0;
+    psh.protocol = IPPROTO_TCP;
+    psh.tcp_length = htons(sizeof(struct tcphdr));
+    uint32_t sum = csum_partial(&psh, sizeof(psh), 0);
+    tcph->check = csum_fold(csum_partial(tcph, sizeof(struct tcphdr), sum));
+}
+
+// 填充目标地址、目标端口和cookie，校验和由模板中的值增量更新
+static void finish_probe_packet(const RawScan *scan, const RawSource *source, char *packet,
+                                struct in_addr addr, uint16_t port) {
+    struct iphdr *iph = (struct iphdr *)packet;
+    struct tcphdr *tcph = (struct tcphdr *)(packet + sizeof(struct iphdr));
+    uint32_t cookie = probe_cookie(scan, addr.s_addr, port, source->port);
+
+    iph->daddr = addr.s_addr;
+    tcph->dest = htons(port);
+    tcph->seq = htonl(cookie);
+
+    // 这些字段在模板中为零，新值直接计入模板校验和的反码，最后只折叠一次（RFC 1624 式3）
+    uint32_t sum = (uint16_t)~tcph->check;
+    sum = csum_add32(sum, iph->daddr);     // 伪首部中的目标地址
+    sum += tcph->dest;
+    sum = csum_add32(sum, tcph->seq);
+
+    // ACK探测的RST响应以我们的确认号作为序列号
+    if (scan->probe_flags & TH_ACK) {
+        tcph->ack_seq = tcph->seq;
+        sum = csum_add32(sum, tcph->ack_seq);
+    }
+    tcph->check = csum_fold(sum);
+}
+
+// 标记探测已响应，返回0表示之前已经记录过或不在扫描空间内
+static int mark_answered(RawScan *scan, uint32_t addr, uint16_t port) {
+    struct in_addr host = { .s_addr = addr };
+    int64_t index = scan_space_locate(scan->params->space, host, port);
+    if (index < 0) {
+        return 0;
+    }
+    return index_set_add(&scan->answered, (uint64_t)index) == 1;
+}
+
+// 响应的来源是否为扫描目标
+static int is_scan_target(const RawScan *scan, uint32_t addr) {
+    struct in_addr host = { .s_addr = addr };
+    return scan_space_host_index(scan->params->space, host) >= 0;
+}
+
+// 本地地址对应的出口，不是我们的出口地址时返回NULL
+static const RawSource* source_by_addr(const RawScan *scan, uint32_t addr) {
+    int count = __atomic_load_n(&scan->source_count, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < count; i++) {
+        if (scan->sources[i].addr == addr) {
+            return &scan->sources[i];
+        }
+    }
+    return NULL;
+}
+
+// 校验TCP响应是否针对我们的探测
+static int tcp_reply_matches(const RawScan *scan, const struct tcphdr *tcph, uint32_t target) {
+    uint32_t cookie = probe_cookie(scan, target, ntohs(tcph->source), ntohs(tcph->dest));
+
+    if (scan->probe_flags & TH_ACK) {
+        return tcph->rst && ntohl(tcph->seq) == cookie;
+    }
+
+    // SYN和FIN各占一个序列号
+    uint32_t expected = cookie + ((scan->probe_flags & (TH_SYN | TH_FIN)) ? 1 : 0);
+    return tcph->ack && ntohl(tcph->ack_seq) == expected;
+}
+
+// 根据扫描类型解读TCP响应，返回-1表示忽略
+static int classify_tcp_reply(const RawScan *scan, const struct tcphdr *tcph) {
+    switch (scan->params->scan_type) {
+        case SCAN_TCP_SYN:
+            if (tcph->syn && tcph->ack) return PORT_OPEN;
+            if (tcph->rst) return PORT_CLOSED;
+            return -1;
+        case SCAN_TCP_ACK:
+            return tcph->rst ? PORT_UNFILTERED : -1;
+        default:
+            // FIN/XMAS/NULL: 关闭端口回应RST，开放端口不回应
+            return tcph->rst ? PORT_CLOSED : -1;
+    }
+}
+
+// 解析一个IP报文，分类SYN-ACK、RST和ICMP不可达
+static void handle_reply(const uint8_t *packet, size_t len, void *user) {
+    RawScan *scan = (RawScan *)user;
+
+    if (len < sizeof(struct iphdr)) {
+        return;
+    }
+
+    const struct iphdr *iph = (const struct iphdr *)packet;
+    size_t ip_len = iph->ihl * 4;
+    if (iph->version != 4 || ip_len < sizeof(struct iphdr) || len < ip_len + 8) {
+        return;
+    }
+
+    if (iph->protocol == IPPROTO_TCP && is_scan_target(scan, iph->saddr)) {
+        if (len < ip_len + sizeof(struct tcphdr)) {
+            return;
+        }
+
+        const struct tcphdr *tcph = (const struct tcphdr *)(packet + ip_len);
+        const RawSource *source = source_by_addr(scan, iph->daddr);
+        if (!source || ntohs(tcph->dest) != source->port ||
+            !tcp_reply_matches(scan, tcph, iph->saddr)) {
+            return;
+        }
+
+        int state = classify_tcp_reply(scan, tcph);
+        uint16_t port = ntohs(tcph->source);
+        if (state >= 0 && mark_answered(scan, iph->saddr, port)) {
+            struct in_addr host = { .s_addr = iph->saddr };
+            record_port_state(scan->params, host, port, "tcp", (PortState)state, -1, NULL);
+        }
+    } else if (iph->protocol == IPPROTO_ICMP) {
+        // ICMP不可达中带有原始IP头和TCP头的前8字节（端口和序列号）
+        const struct icmphdr *icmph = (const struct icmphdr *)(packet + ip_len);
+        if (icmph->type != ICMP_DEST_UNREACH) {
+            return;
+        }
+
+        const uint8_t *inner = packet + ip_len + 8;
+        size_t inner_avail = len - ip_len - 8;
+        if (inner_avail < sizeof(struct iphdr)) {
+            return;
+        }
+
+        const struct iphdr *inner_iph = (const struct iphdr *)inner;
+        size_t inner_ip_len = inner_iph->ihl * 4;
+        if (inner_avail < inner_ip_len + 8 || inner_iph->protocol != IPPROTO_TCP ||
+            !is_scan_target(scan, inner_iph->daddr)) {
+            return;
+        }
+        const RawSource *source = source_by_addr(scan, inner_iph->saddr);
+        if (!source) {
+            return;
+        }
+
+        const struct tcphdr *inner_tcph = (const struct tcphdr *)(inner + inner_ip_len);
+        uint16_t port = ntohs(inner_tcph->dest);
+        if (ntohs(inner_tcph->source) != source->port ||
+            ntohl(inner_tcph->seq) != probe_cookie(scan, inner_iph->daddr, port, source->port)) {
+            return;
+        }
+
+        if (mark_answered(scan, inner_iph->daddr, port)) {
+            struct in_addr host = { .s_addr = inner_iph->daddr };
+            record_port_state(scan->params, host, port, "tcp", PORT_FILTERED, -1, NULL);
+        }
+    }
+}
+
+// 无接收环时逐包读取原始套接字
+static void poll_raw_sockets(RawScan *scan, int timeout_ms) {
+    static __thread uint8_t buffer[4096];
+    struct pollfd pfds[2] = {
+        { .fd = scan->recv_sock, .events = POLLIN },
+        { .fd = scan->icmp_sock, .events = POLLIN },
+    };
+    int nfds = (scan->icmp_sock >= 0) ? 2 : 1;
+
+    if (poll(pfds, nfds, timeout_ms) <= 0) {
+        return;
+    }
+
+    for (int i = 0; i < nfds; i++) {
+        if (!(pfds[i].revents & POLLIN)) {
+            continue;
+        }
+        ssize_t received;
+        while ((received = recv(pfds[i].fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+            handle_reply(buffer, received, scan);
+        }
+    }
+}
+
+// 接收线程: 匹配并分类响应
+static void* raw_recv_thread_func(void *arg) {
+    RawScan *scan = (RawScan *)arg;
+    long drain_deadline = 0;
+
+    while (1) {
+        if (scan->tx_done) {
+            long now = monotonic_ms();
+            if (drain_deadline == 0) {
+                drain_deadline = now + scan->params->timeout_ms;
+            } else if (now >= drain_deadline) {
+                break;
+            }
+        }
+
+        if (scan->ring) {
+            packet_ring_poll(scan->ring, 100, handle_reply, scan);
+        } else {
+            poll_raw_sockets(scan, 100);
+        }
+    }
+
+    return NULL;
+}
+
+// 发送套接字不需要接收，让内核丢弃所有入站报文
+static void drop_incoming(int fd) {
+    struct sock_filter code[] = {
+        BPF_STMT(BPF_RET | BPF_K, 0),
+    };
+    struct sock_fprog prog = {
+        .len = 1,
+        .filter = code,
+    };
+
+    setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog));
+}
+
+// 打开接收端: 优先使用TPACKET_V3接收环，不可用时退回原始套接字。
+// 多个目标可能经由不同网卡，这时接收环收所有网卡的报文
+static int open_receiver(RawScan *scan) {
+    uint32_t local = (scan->params->space->host_count == 1) ? scan->sources[0].addr
+                                                           : htonl(INADDR_ANY);
+    scan->ring = packet_ring_open(local);
+    if (scan->ring) {
+        return 0;
+    }
+
+    if (scan->params->verbose) {
+        printf("TPACKET_V3接收环不可用，使用原始套接字接收\n");
+    }
+
+    scan->recv_sock = socket(AF_INET, SOCK_RAW, IPPROTO_TCP);
+    if (scan->recv_sock < 0) {
+        return -1;
+    }
+    scan->icmp_sock = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
+
+    int rcvbuf = RAW_RCVBUF;
+    setsockopt(scan->recv_sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    if (scan->icmp_sock >= 0) {
+        setsockopt(scan->icmp_sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+    return 0;
+}
+
+// 释放扫描资源
+static void raw_scan_close(RawScan *scan) {
+    if (scan->raw_sock >= 0) close(scan->raw_sock);
+    if (scan->recv_sock >= 0) close(scan->recv_sock);
+    if (scan->icmp_sock >= 0) close(scan->icmp_sock);
+    for (int i = 0; i < scan->source_count; i++) {
+        close(scan->sources[i].bound_sock);
+    }
+    free(scan->routes.keys);
+    free(scan->routes.values);
+    packet_ring_close(scan->ring);
+    index_set_free(&scan->answered);
+    free(scan);
+}
+
+// 加入一个出口地址: 占用源端口并构造报文模板，返回下标，失败时返回-1
+static int add_source(RawScan *scan, uint32_t addr) {
+    for (int i = 0; i < scan->source_count; i++) {
+        if (scan->sources[i].addr == addr) {
+            return i;
+        }
+    }
+    if (scan->source_count == RAW_MAX_SOURCES) {
+        return -1;
+    }
+
+    RawSource *source = &scan->sources[scan->source_count];
+    source->addr = addr;
+    source->bound_sock = reserve_source_port(addr, &source->port);
+    if (source->bound_sock < 0) {
+        return -1;
+    }
+    build_probe_template(scan, source, source->template);
+
+    if (scan->params->verbose) {
+        struct in_addr src = { .s_addr = addr };
+        printf("原始扫描源地址: %s:%d\n", inet_ntoa(src), source->port);
+    }
+    __atomic_store_n(&scan->source_count, scan->source_count + 1, __ATOMIC_RELEASE);
+    return scan->source_count - 1;
+}
+
+// 发往目标的出口，按目标所在的/24缓存路由查找的结果；
+// 查不到路由或出口过多时沿用第一个出口
+static const RawSource* route_source(RawScan *scan, struct in_addr target) {
+    RouteCache *cache = &scan->routes;
+    uint32_t key = (ntohl(target.s_addr) >> ROUTE_PREFIX_BITS) + 1;
+
+    if ((cache->count + 1) * 2 > cache->capacity) {
+        size_t capacity = cache->capacity ? cache->capacity * 2 : 256;
+        uint32_t *keys = calloc(capacity, sizeof(uint32_t));
+        uint8_t *values = malloc(capacity);
+        if (!keys || !values) {
+            free(keys);
+            free(values);
+            return &scan->sources[0];
+        }
+        for (size_t i = 0; i < cache->capacity; i++) {
+            if (cache->keys[i]) {
+                size_t pos = (cache->keys[i] * 0x9e3779b1U) & (capacity - 1);
+                while (keys[pos]) pos = (pos + 1) & (capacity - 1);
+                keys[pos] = cache->keys[i];
+                values[pos] = cache->values[i];
+            }
+        }
+        free(cache->keys);
+        free(cache->values);
+        cache->keys = keys;
+        cache->values = values;
+        cache->capacity = capacity;
+    }
+
+    size_t pos = (key * 0x9e3779b1U) & (cache->capacity - 1);
+    while (cache->keys[pos]) {
+        if (cache->keys[pos] == key) {
+            return &scan->sources[cache->values[pos]];
+        }
+        pos = (pos + 1) & (cache->capacity - 1);
+    }
+
+    uint32_t addr;
+    int index = 0;
+    if (find_source_address(target, &addr) == 0 && (index = add_source(scan, addr)) < 0) {
+        index = 0;
+        if (!scan->source_overflow) {
+            printf("警告: 出口地址过多或无法分配源端口，部分目标沿用第一个出口地址\n");
+            scan->source_overflow = 1;
+        }
+    }
+    cache->keys[pos] = key;
+    cache->values[pos] = (uint8_t)index;
+    cache->count++;
+    return &scan->sources[index];
+}
+
+// 无状态原始TCP扫描线程函数（同时作为发送线程）
+void* raw_scan_thread_func(void *arg) {
+    ThreadParams *params = (ThreadParams *)arg;
+
+    RawScan *scan = calloc(1, sizeof(RawScan));
+    if (!scan) {
+        scan_running = 0;
+        return NULL;
+    }
+    scan->params = params;
+    scan->raw_sock = -1;
+    scan->recv_sock = -1;
+    scan->icmp_sock = -1;
+    scan->probe_flags = probe_flags_for(params->scan_type);
+    scan->silent_state = (params->scan_type == SCAN_TCP_SYN || params->scan_type == SCAN_TCP_ACK)
+                         ? PORT_FILTERED : PORT_OPEN_FILTERED;
+
+    scan->raw_sock = create_raw_socket();
+    if (scan->raw_sock < 0) {
+        printf("错误: 原始TCP扫描需要root权限 (CAP_NET_RAW)\n");
+        raw_scan_close(scan);
+        scan_running = 0;
+        return NULL;
+    }
+    drop_incoming(scan->raw_sock);
+
+    if (getrandom(scan->secret, sizeof(scan->secret), 0) != sizeof(scan->secret)) {
+        scan->secret[0] = (uint32_t)time(NULL);
+        scan->secret[1] = (uint32_t)getpid() ^ (uint32_t)monotonic_ms();
+    }
+
+    // 源地址和源端口取自到每个目标的实际出口，先确定到第一个目标的出口；
+    // 其余出口在发送时按路由查找加入
+    struct in_addr first_target = { .s_addr = htonl(params->space->hosts[0].start) };
+    uint32_t first_source;
+    if (find_source_address(first_target, &first_source) < 0) {
+        printf("错误: 无法确定到目标的出口地址\n");
+        raw_scan_close(scan);
+        scan_running = 0;
+        return NULL;
+    }
+    if (add_source(scan, first_source) < 0) {
+        printf("错误: 无法分配源端口\n");
+        raw_scan_close(scan);
+        scan_running = 0;
+        return NULL;
+    }
+
+    if (open_receiver(scan) < 0) {
+        printf("错误: 无法创建接收套接字\n");
+        raw_scan_close(scan);
+        scan_running = 0;
+        return NULL;
+    }
+
+    if (params->verbose) {
+        printf("接收方式: %s\n", scan->ring ? "TPACKET_V3" : "raw socket");
+    }
+
+    pthread_t recv_thread;
+    if (pthread_create(&recv_thread, NULL, raw_recv_thread_func, scan) != 0) {
+        raw_scan_close(scan);
+        scan_running = 0;
+        return NULL;
+    }
+
+    // 发送循环: 出口的模板复制到批量发送槽位后只填写可变字段
+
+    struct sockaddr_in dst;
+    memset(&dst, 0, sizeof(dst));
+    dst.sin_family = AF_INET;
+
+    TxBatch *tx = tx_batch_create(scan->raw_sock, params->batch_size, RAW_PACKET_LEN,
+                                  params->batch_delay_us, params->pacer);
+    while (tx) {
+        int port;
+        if (next_probe(params, &dst.sin_addr, &port) < 0) {
+            break;
+        }
+
+        const RawSource *source = route_source(scan, dst.sin_addr);
+        char *packet = (char *)tx_batch_slot(tx);
+        memcpy(packet, source->template, RAW_PACKET_LEN);
+        finish_probe_packet(scan, source, packet, dst.sin_addr, port);
+        tx_batch_commit(tx, RAW_PACKET_LEN, &dst);
+    }
+
+    if (tx) {
+        tx_batch_flush(tx);
+        if (tx_batch_failed(tx) > 0) {
+            printf("警告: %lu 个探测包发送失败\n", tx_batch_failed(tx));
+        }
+        tx_batch_destroy(tx);
+    } else {
+        scan_running = 0;
+    }
+
+    scan->tx_done = 1;
+    pthread_join(recv_thread, NULL);
+
+    // 没有响应的探测按扫描类型确定状态
+    record_silent_probes(params, &scan->answered, NULL, "tcp", scan->silent_state);
+
+    raw_scan_close(scan);
+    return NULL;
+}
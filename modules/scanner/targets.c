@@ -0,0 +1,570 @@
+/**
+ * 扫描空间
+ * 目标支持单个地址、主机名、CIDR、地址范围和目标文件，
+ * 端口以区间保存；(主机, 端口)空间通过Feistel网络
+ * 按需生成随机排列，内存占用与扫描规模无关
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include "port_scanner.h"
+
+#define FEISTEL_ROUNDS 4
+
+// 目标解析状态: 主机名先收集起来，最后批量解析
+typedef struct {
+    int capacity;            // space->hosts的容量
+    DnsLookup *names;
+    int name_count;
+    int name_capacity;
+} TargetParser;
+
+// 追加一个地址区间
+static int add_host_range(ScanSpace *space, int *capacity, uint32_t start, uint32_t end) {
+    if (start > end) {
+        uint32_t tmp = start;
+        start = end;
+        end = tmp;
+    }
+
+    if (space->host_range_count == *capacity) {
+        int new_capacity = *capacity ? *capacity * 2 : 16;
+        AddrRange *ranges = realloc(space->hosts, new_capacity * sizeof(AddrRange));
+        if (!ranges) {
+            return -1;
+        }
+        space->hosts = ranges;
+        *capacity = new_capacity;
+    }
+
+    space->hosts[space->host_range_count].start = start;
+    space->hosts[space->host_range_count].end = end;
+    space->host_range_count++;
+    return 0;
+}
+
+// 解析一个目标: 地址、CIDR、地址范围或主机名
+static int parse_target_item(ScanSpace *space, TargetParser *parser, char *item) {
+    struct in_addr addr;
+    char *slash = strchr(item, '/');
+    char *dash = strchr(item, '-');
+
+    if (slash) {
+        // CIDR: 10.0.0.0/16
+        *slash = '\0';
+        int prefix = atoi(slash + 1);
+        if (inet_pton(AF_INET, item, &addr) <= 0 || prefix < 0 || prefix > 32) {
+            printf("错误: 无效的CIDR '%s/%s'\n", item, slash + 1);
+            return -1;
+        }
+        uint32_t mask = (prefix == 0) ? 0 : 0xffffffffU << (32 - prefix);
+        uint32_t base = ntohl(addr.s_addr) & mask;
+        return add_host_range(space, &parser->capacity, base, base | ~mask);
+    }
+
+    // 地址范围: 10.0.0.1-10.0.0.50 或 10.0.0.1-50；
+    // 横线前不是地址时按主机名处理 (如my-host.example.com)
+    if (dash) {
+        *dash = '\0';
+        if (inet_pton(AF_INET, item, &addr) <= 0) {
+            *dash = '-';
+            dash = NULL;
+        }
+    }
+
+    if (dash) {
+        struct in_addr end_addr;
+        uint32_t start = ntohl(addr.s_addr);
+        uint32_t end;
+        if (inet_pton(AF_INET, dash + 1, &end_addr) > 0) {
+            end = ntohl(end_addr.s_addr);
+        } else {
+            int last = atoi(dash + 1);
+            if (last < 0 || last > 255) {
+                printf("错误: 无效的地址范围 '%s-%s'\n", item, dash + 1);
+                return -1;
+            }
+            end = (start & 0xffffff00U) | (uint32_t)last;
+        }
+        return add_host_range(space, &parser->capacity, start, end);
+    }
+
+    if (inet_pton(AF_INET, item, &addr) > 0) {
+        uint32_t host = ntohl(addr.s_addr);
+        return add_host_range(space, &parser->capacity, host, host);
+    }
+
+    // 主机名在全部目标读完后批量解析
+    if (strlen(item) >= MAX_HOSTNAME) {
+        printf("错误: 无法解析目标地址 %s\n", item);
+        return -1;
+    }
+    if (parser->name_count == parser->name_capacity) {
+        int new_capacity = parser->name_capacity ? parser->name_capacity * 2 : 16;
+        DnsLookup *names = realloc(parser->names, new_capacity * sizeof(DnsLookup));
+        if (!names) {
+            return -1;
+        }
+        parser->names = names;
+        parser->name_capacity = new_capacity;
+    }
+    DnsLookup *lookup = &parser->names[parser->name_count++];
+    memset(lookup, 0, sizeof(*lookup));
+    strcpy(lookup->name, item);
+    return 0;
+}
+
+// 批量解析收集到的主机名，每个名字取第一个地址
+static int resolve_target_names(ScanSpace *space, TargetParser *parser) {
+    if (parser->name_count == 0) {
+        return 0;
+    }
+
+    dns_resolve(parser->names, parser->name_count);
+
+    for (int i = 0; i < parser->name_count; i++) {
+        DnsLookup *lookup = &parser->names[i];
+        if (!lookup->resolved) {
+            printf("错误: 无法解析目标地址 %s\n", lookup->name);
+            return -1;
+        }
+        uint32_t host = ntohl(lookup->addr.s_addr);
+        if (add_host_range(space, &parser->capacity, host, host) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// 解析逗号或空白分隔的目标列表
+static int parse_target_list(ScanSpace *space, TargetParser *parser, const char *list) {
+    char *copy = strdup(list);
+    if (!copy) {
+        return -1;
+    }
+
+    int ret = 0;
+    char *saveptr = NULL;
+    for (char *item = strtok_r(copy, ", \t\r\n", &saveptr); item;
+         item = strtok_r(NULL, ", \t\r\n", &saveptr)) {
+        if (parse_target_item(space, parser, item) < 0) {
+            ret = -1;
+            break;
+        }
+    }
+
+    free(copy);
+    return ret;
+}
+
+// 读取目标文件，每行一个或多个目标，#开头为注释
+static int parse_target_file(ScanSpace *space, TargetParser *parser, const char *filename) {
+    FILE *fp = fopen(filename, "r");
+    if (!fp) {
+        printf("错误: 无法打开目标文件 %s\n", filename);
+        return -1;
+    }
+
+    char line[1024];
+    int ret = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+        if (parse_target_list(space, parser, line) < 0) {
+            ret = -1;
+            break;
+        }
+    }
+
+    fclose(fp);
+    return ret;
+}
+
+static int compare_addr_range(const void *a, const void *b) {
+    const AddrRange *x = a, *y = b;
+    return (x->start > y->start) - (x->start < y->start);
+}
+
+static int compare_port_range(const void *a, const void *b) {
+    const PortRange *x = a, *y = b;
+    return (x->start > y->start) - (x->start < y->start);
+}
+
+// 排序并合并重叠区间，计算前缀和
+static void normalize_hosts(ScanSpace *space) {
+    qsort(space->hosts, space->host_range_count, sizeof(AddrRange), compare_addr_range);
+
+    int merged = 0;
+    for (int i = 0; i < space->host_range_count; i++) {
+        if (merged > 0 && (uint64_t)space->hosts[i].start <= (uint64_t)space->hosts[merged - 1].end + 1) {
+            if (space->hosts[i].end > space->hosts[merged - 1].end) {
+                space->hosts[merged - 1].end = space->hosts[i].end;
+            }
+        } else {
+            space->hosts[merged++] = space->hosts[i];
+        }
+    }
+    space->host_range_count = merged;
+
+    space->host_count = 0;
+    for (int i = 0; i < merged; i++) {
+        space->hosts[i].offset = space->host_count;
+        space->host_count += (uint64_t)space->hosts[i].end - space->hosts[i].start + 1;
+    }
+}
+
+static void normalize_ports(ScanSpace *space) {
+    qsort(space->ports, space->port_range_count, sizeof(PortRange), compare_port_range);
+
+    int merged = 0;
+    for (int i = 0; i < space->port_range_count; i++) {
+        if (merged > 0 && space->ports[i].start <= space->ports[merged - 1].end + 1) {
+            if (space->ports[i].end > space->ports[merged - 1].end) {
+                space->ports[merged - 1].end = space->ports[i].end;
+            }
+        } else {
+            space->ports[merged++] = space->ports[i];
+        }
+    }
+    space->port_range_count = merged;
+
+    space->port_count = 0;
+    for (int i = 0; i < merged; i++) {
+        space->ports[i].offset = space->port_count;
+        space->port_count += space->ports[i].end - space->ports[i].start + 1;
+    }
+}
+
+// 解析端口范围字符串为区间列表
+static int parse_port_ranges(ScanSpace *space, const char *range_str) {
+    if (!range_str || strlen(range_str) == 0) {
+        return -1;
+    }
+
+    int capacity = 0;
+    char *token, *str, *tofree;
+    tofree = str = strdup(range_str);
+    if (!str) {
+        return -1;
+    }
+
+    while ((token = strsep(&str, ",")) != NULL) {
+        int start, end;
+        char *dash = strchr(token, '-');
+        if (dash) {
+            // 端口范围
+            *dash = '\0';
+            start = atoi(token);
+            end = atoi(dash + 1);
+            if (start > end) {
+                int temp = start;
+                start = end;
+                end = temp;
+            }
+            if (start < 1) start = 1;
+            if (end > MAX_PORTS) end = MAX_PORTS;
+        } else {
+            // 单个端口
+            start = end = atoi(token);
+        }
+
+        if (start < 1 || end > MAX_PORTS || start > end) {
+            continue;
+        }
+
+        if (space->port_range_count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            PortRange *ranges = realloc(space->ports, capacity * sizeof(PortRange));
+            if (!ranges) {
+                free(tofree);
+                return -1;
+            }
+            space->ports = ranges;
+        }
+        space->ports[space->port_range_count].start = start;
+        space->ports[space->port_range_count].end = end;
+        space->port_range_count++;
+    }
+
+    free(tofree);
+    if (space->port_range_count == 0) {
+        return -1;
+    }
+
+    normalize_ports(space);
+    return 0;
+}
+
+// Feistel轮函数
+static uint64_t feistel_round(uint64_t value, uint64_t key) {
+    uint64_t h = value ^ key;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// 在[0, 2^bits)上的平衡Feistel置换
+static uint64_t feistel_encrypt(const ScanSpace *space, uint64_t value) {
+    uint64_t left = value >> space->half_bits;
+    uint64_t right = value & space->half_mask;
+
+    for (int r = 0; r < FEISTEL_ROUNDS; r++) {
+        uint64_t next = left ^ (feistel_round(right, space->keys[r]) & space->half_mask);
+        left = right;
+        right = next;
+    }
+
+    return (left << space->half_bits) | right;
+}
+
+// feistel_encrypt的逆置换，按相反的顺序执行各轮
+static uint64_t feistel_decrypt(const ScanSpace *space, uint64_t value) {
+    uint64_t left = value >> space->half_bits;
+    uint64_t right = value & space->half_mask;
+
+    for (int r = FEISTEL_ROUNDS - 1; r >= 0; r--) {
+        uint64_t prev = right ^ (feistel_round(left, space->keys[r]) & space->half_mask);
+        right = left;
+        left = prev;
+    }
+
+    return (left << space->half_bits) | right;
+}
+
+// 初始化扫描空间
+int scan_space_init(ScanSpace *space, const char *targets, const char *target_file,
+                    const char *port_range, int randomize) {
+    memset(space, 0, sizeof(*space));
+    TargetParser parser;
+    memset(&parser, 0, sizeof(parser));
+
+    int ret = 0;
+    if (targets && parse_target_list(space, &parser, targets) < 0) {
+        ret = -1;
+    } else if (target_file && parse_target_file(space, &parser, target_file) < 0) {
+        ret = -1;
+    } else {
+        ret = resolve_target_names(space, &parser);
+    }
+    free(parser.names);
+    if (ret < 0) {
+        scan_space_free(space);
+        return -1;
+    }
+    if (space->host_range_count == 0) {
+        printf("错误: 没有指定扫描目标\n");
+        scan_space_free(space);
+        return -1;
+    }
+    normalize_hosts(space);
+
+    if (parse_port_ranges(space, port_range) < 0) {
+        printf("错误: 无效的端口范围\n");
+        scan_space_free(space);
+        return -1;
+    }
+
+    if (space->host_count > UINT64_MAX / space->port_count) {
+        printf("错误: 扫描空间过大\n");
+        scan_space_free(space);
+        return -1;
+    }
+    space->total = space->host_count * space->port_count;
+
+    // 置换域取不小于总数的偶数位宽
+    space->randomize = randomize;
+    int bits = 2;
+    while (bits < 64 && (1ULL << bits) < space->total) bits++;
+    if (bits & 1) bits++;
+    space->half_bits = bits / 2;
+    space->half_mask = (space->half_bits >= 64) ? UINT64_MAX : (1ULL << space->half_bits) - 1;
+
+    if (getrandom(space->keys, sizeof(space->keys), 0) != sizeof(space->keys)) {
+        uint64_t seed = (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32);
+        for (int r = 0; r < FEISTEL_ROUNDS; r++) {
+            space->keys[r] = feistel_round(seed + r, 0x9e3779b97f4a7c15ULL);
+        }
+    }
+
+    return 0;
+}
+
+void scan_space_free(ScanSpace *space) {
+    free(space->hosts);
+    free(space->ports);
+    space->hosts = NULL;
+    space->ports = NULL;
+}
+
+// 第sequence个探测对应的扫描空间下标
+uint64_t scan_space_permute(const ScanSpace *space, uint64_t sequence) {
+    if (!space->randomize) {
+        return sequence;
+    }
+
+    // 循环加密直到落入[0, total)，保证仍是双射
+    uint64_t value = sequence;
+    do {
+        value = feistel_encrypt(space, value);
+    } while (value >= space->total);
+    return value;
+}
+
+// 扫描空间下标对应的探测序号，scan_space_permute的逆映射
+uint64_t scan_space_unpermute(const ScanSpace *space, uint64_t index) {
+    if (!space->randomize) {
+        return index;
+    }
+
+    uint64_t value = index;
+    do {
+        value = feistel_decrypt(space, value);
+    } while (value >= space->total);
+    return value;
+}
+
+// 主机区间和端口区间的FNV-1a摘要，用于判断两次扫描的扫描空间是否相同
+uint64_t scan_space_digest(const ScanSpace *space) {
+    uint64_t h = 14695981039346656037ULL;
+    for (int i = 0; i < space->host_range_count; i++) {
+        uint64_t values[2] = { space->hosts[i].start, space->hosts[i].end };
+        for (int k = 0; k < 2; k++) {
+            h = (h ^ values[k]) * 1099511628211ULL;
+        }
+    }
+    for (int i = 0; i < space->port_range_count; i++) {
+        uint64_t values[2] = { (uint64_t)space->ports[i].start, (uint64_t)space->ports[i].end };
+        for (int k = 0; k < 2; k++) {
+            h = (h ^ values[k]) * 1099511628211ULL;
+        }
+    }
+    return h;
+}
+
+// 将扫描空间下标还原为(地址, 端口)
+void scan_space_decode(const ScanSpace *space, uint64_t index, struct in_addr *addr, int *port) {
+    uint64_t host_index = index % space->host_count;
+    uint64_t port_index = index / space->host_count;
+
+    int lo = 0, hi = space->host_range_count - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (space->hosts[mid].offset <= host_index) lo = mid; else hi = mid - 1;
+    }
+    addr->s_addr = htonl(space->hosts[lo].start + (uint32_t)(host_index - space->hosts[lo].offset));
+
+    lo = 0;
+    hi = space->port_range_count - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (space->ports[mid].offset <= port_index) lo = mid; else hi = mid - 1;
+    }
+    *port = space->ports[lo].start + (int)(port_index - space->ports[lo].offset);
+}
+
+// 主机在扫描空间中的下标，不在范围内返回-1
+int64_t scan_space_host_index(const ScanSpace *space, struct in_addr addr) {
+    uint32_t host = ntohl(addr.s_addr);
+    int lo = 0, hi = space->host_range_count - 1;
+
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (host < space->hosts[mid].start) {
+            hi = mid - 1;
+        } else if (host > space->hosts[mid].end) {
+            lo = mid + 1;
+        } else {
+            return (int64_t)(space->hosts[mid].offset + (host - space->hosts[mid].start));
+        }
+    }
+    return -1;
+}
+
+// (地址, 端口)在扫描空间中的下标，不在范围内返回-1
+int64_t scan_space_locate(const ScanSpace *space, struct in_addr addr, int port) {
+    int64_t host_index = scan_space_host_index(space, addr);
+    if (host_index < 0) {
+        return -1;
+    }
+
+    int lo = 0, hi = space->port_range_count - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (port < space->ports[mid].start) {
+            hi = mid - 1;
+        } else if (port > space->ports[mid].end) {
+            lo = mid + 1;
+        } else {
+            uint64_t port_index = space->ports[mid].offset + (port - space->ports[mid].start);
+            return (int64_t)(port_index * space->host_count + (uint64_t)host_index);
+        }
+    }
+    return -1;
+}
+
+// 已响应探测的集合，开放寻址哈希，内存与响应数成正比
+int index_set_add(IndexSet *set, uint64_t value) {
+    if ((set->count + 1) * 2 > set->capacity) {
+        size_t new_capacity = set->capacity ? set->capacity * 2 : 1024;
+        uint64_t *slots = calloc(new_capacity, sizeof(uint64_t));
+        if (!slots) {
+            return -1;
+        }
+        for (size_t i = 0; i < set->capacity; i++) {
+            if (set->slots[i]) {
+                size_t pos = feistel_round(set->slots[i], 0) & (new_capacity - 1);
+                while (slots[pos]) pos = (pos + 1) & (new_capacity - 1);
+                slots[pos] = set->slots[i];
+            }
+        }
+        free(set->slots);
+        set->slots = slots;
+        set->capacity = new_capacity;
+    }
+
+    uint64_t key = value + 1;   // 0表示空槽
+    size_t pos = feistel_round(key, 0) & (set->capacity - 1);
+    while (set->slots[pos]) {
+        if (set->slots[pos] == key) {
+            return 0;
+        }
+        pos = (pos + 1) & (set->capacity - 1);
+    }
+
+    set->slots[pos] = key;
+    set->count++;
+    return 1;
+}
+
+int index_set_contains(const IndexSet *set, uint64_t value) {
+    if (set->capacity == 0) {
+        return 0;
+    }
+
+    uint64_t key = value + 1;
+    size_t pos = feistel_round(key, 0) & (set->capacity - 1);
+    while (set->slots[pos]) {
+        if (set->slots[pos] == key) {
+            return 1;
+        }
+        pos = (pos + 1) & (set->capacity - 1);
+    }
+    return 0;
+}
+
+void index_set_free(IndexSet *set) {
+    free(set->slots);
+    memset(set, 0, sizeof(*set));
+}
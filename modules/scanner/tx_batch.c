@@ -0,0 +1,185 @@
+/**
+ * 批量发送阶段
+ * 将预构造的探测包填入向量，用sendmmsg一次系统调用发出一批，
+ * 原始TCP扫描和UDP扫描共用。
+ * 设定了全局速率时每个报文按令牌时间发出，只有令牌时间相距不超过
+ * PACER_SLACK_NS的报文才合并为一批
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "port_scanner.h"
+
+struct TxBatch {
+    int fd;
+    int batch_size;
+    int packet_size;            // 每个槽位的最大报文长度
+    int count;                  // 当前批中的报文数
+    uint8_t *buffers;
+    struct mmsghdr *msgs;
+    struct iovec *iovs;
+    struct sockaddr_in *addrs;
+    long delay_ns;              // 两批之间的最小间隔
+    struct timespec next_flush;
+    Pacer *pacer;               // 全局速率控制，可为NULL
+    long first_due_ns;          // 当前批第一个报文的令牌时间
+    unsigned long sent;
+    unsigned long failed;
+    TxFailureHandler on_failure; // 报文无法发送时调用，可为NULL
+    void *failure_user;
+};
+
+// 创建发送阶段，batch_delay_us为两批之间的间隔（0表示不限速）
+TxBatch* tx_batch_create(int fd, int batch_size, int packet_size, int batch_delay_us,
+                         Pacer *pacer) {
+    if (batch_size < 1) batch_size = 1;
+    if (batch_size > MAX_TX_BATCH) batch_size = MAX_TX_BATCH;
+
+    TxBatch *tx = calloc(1, sizeof(TxBatch));
+    if (!tx) {
+        return NULL;
+    }
+
+    tx->fd = fd;
+    tx->batch_size = batch_size;
+    tx->packet_size = packet_size;
+    tx->delay_ns = (long)batch_delay_us * 1000L;
+    tx->pacer = pacer;
+    tx->buffers = calloc(batch_size, packet_size);
+    tx->msgs = calloc(batch_size, sizeof(struct mmsghdr));
+    tx->iovs = calloc(batch_size, sizeof(struct iovec));
+    tx->addrs = calloc(batch_size, sizeof(struct sockaddr_in));
+
+    if (!tx->buffers || !tx->msgs || !tx->iovs || !tx->addrs) {
+        tx_batch_destroy(tx);
+        return NULL;
+    }
+
+    // 向量结构只需建立一次
+    for (int i = 0; i < batch_size; i++) {
+        tx->iovs[i].iov_base = tx->buffers + (size_t)i * packet_size;
+        tx->msgs[i].msg_hdr.msg_iov = &tx->iovs[i];
+        tx->msgs[i].msg_hdr.msg_iovlen = 1;
+        tx->msgs[i].msg_hdr.msg_name = &tx->addrs[i];
+        tx->msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &tx->next_flush);
+    return tx;
+}
+
+// 按设定的间隔等待下一批
+static void tx_batch_pace(TxBatch *tx) {
+    // 实际速率低于--min-rate时不再等待
+    if (tx->delay_ns <= 0 || pacer_behind(tx->pacer)) {
+        return;
+    }
+
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &tx->next_flush, NULL);
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    tx->next_flush = now;
+    tx->next_flush.tv_nsec += tx->delay_ns;
+    while (tx->next_flush.tv_nsec >= 1000000000L) {
+        tx->next_flush.tv_nsec -= 1000000000L;
+        tx->next_flush.tv_sec++;
+    }
+}
+
+// 发出当前批中的全部报文，返回发送成功的数量
+int tx_batch_flush(TxBatch *tx) {
+    int done = 0;
+    int skipped = 0;
+
+    if (tx->count == 0) {
+        return 0;
+    }
+
+    tx_batch_pace(tx);
+
+    while (done < tx->count) {
+        int ret = sendmmsg(tx->fd, tx->msgs + done, tx->count - done, 0);
+        if (ret > 0) {
+            done += ret;
+            continue;
+        }
+
+        if (ret < 0 && (errno == ENOBUFS || errno == EAGAIN || errno == EINTR)) {
+            // 发送缓冲区满，稍后重试
+            usleep(100);
+            continue;
+        }
+
+        // 第一个报文无法发送（如目标不可达），跳过它
+        if (tx->on_failure) {
+            tx->on_failure(tx->failure_user, &tx->addrs[done]);
+        }
+        skipped++;
+        done++;
+    }
+
+    int sent = tx->count - skipped;
+    tx->sent += sent;
+    tx->failed += skipped;
+    tx->count = 0;
+    return sent;
+}
+
+// 取得下一个报文槽位，批已满时先发送；限速时等到该报文的令牌时间
+uint8_t* tx_batch_slot(TxBatch *tx) {
+    if (tx->count == tx->batch_size) {
+        tx_batch_flush(tx);
+    }
+
+    if (tx->pacer) {
+        long due = pacer_reserve(tx->pacer);
+        // 已在批中的报文不能因为等待而推迟太久
+        if (tx->count > 0 && due - tx->first_due_ns > PACER_SLACK_NS) {
+            tx_batch_flush(tx);
+        }
+        if (tx->count == 0) {
+            tx->first_due_ns = due;
+        }
+        pacer_sleep_until(due);
+    }
+    return tx->buffers + (size_t)tx->count * tx->packet_size;
+}
+
+// 提交tx_batch_slot返回的槽位中长度为len的报文
+void tx_batch_commit(TxBatch *tx, int len, const struct sockaddr_in *dst) {
+    tx->iovs[tx->count].iov_len = len;
+    tx->addrs[tx->count] = *dst;
+    tx->count++;
+
+    if (tx->count == tx->batch_size) {
+        tx_batch_flush(tx);
+    }
+}
+
+// 设置报文无法发送时的回调，调用方据此知道哪些探测没有发出
+void tx_batch_on_failure(TxBatch *tx, TxFailureHandler handler, void *user) {
+    tx->on_failure = handler;
+    tx->failure_user = user;
+}
+
+unsigned long tx_batch_failed(const TxBatch *tx) {
+    return tx->failed;
+}
+
+void tx_batch_destroy(TxBatch *tx) {
+    if (!tx) {
+        return;
+    }
+    free(tx->buffers);
+    free(tx->msgs);
+    free(tx->iovs);
+    free(tx->addrs);
+    free(tx);
+}
@@ -0,0 +1,439 @@
+/**
+ * UDP扫描引擎
+ * 所有探测共用一个UDP套接字，经批量发送阶段发出，
+ * 接收线程用recvmmsg批量读取响应。
+ * 常见服务发送协议负载以引出真实应答；套接字开启IP_RECVERR，
+ * ICMP不可达从错误队列读出，不需要原始套接字
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/ip_icmp.h>
+#include <arpa/inet.h>
+#include <linux/errqueue.h>
+#include "port_scanner.h"
+
+#define UDP_PROBE_MAX 512
+#define UDP_RECV_BATCH 64
+#define UDP_SOCKBUF (8 * 1024 * 1024)
+
+// 一次UDP扫描共享的状态
+typedef struct {
+    ThreadParams *params;
+    int sock;
+    IndexSet answered;          // 已收到响应的探测（扫描空间下标）
+    pthread_mutex_t answered_lock;  // 重传时发送线程也要读answered
+    IndexSet unsent;            // 首次发送失败的探测，只由发送线程访问
+    IndexSet resent;            // 其中重传时发出的探测
+    int retransmitting;         // 重传的发送失败不计入unsent
+    volatile int tx_done;
+} UdpScan;
+
+// 协议负载，收到应答即可确认端口开放
+typedef struct {
+    int port;
+    const uint8_t *data;
+    int len;
+} UdpPayload;
+
+// DNS: 根域NS查询
+static const uint8_t dns_query[] = {
+    0x50, 0x4b, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x02, 0x00, 0x01
+};
+
+// NTP: v4客户端请求
+static const uint8_t ntp_request[48] = { 0xe3 };
+
+// SNMP: v1 get-request, community "public", sysDescr.0
+static const uint8_t snmp_get[] = {
+    0x30, 0x29, 0x02, 0x01, 0x00, 0x04, 0x06, 'p', 'u', 'b', 'l', 'i', 'c',
+    0xa0, 0x1c, 0x02, 0x04, 0x50, 0x4b, 0x54, 0x4b, 0x02, 0x01, 0x00, 0x02, 0x01, 0x00,
+    0x30, 0x0e, 0x30, 0x0c, 0x06, 0x08, 0x2b, 0x06, 0x01, 0x02, 0x01, 0x01, 0x01, 0x00,
+    0x05, 0x00
+};
+
+// NetBIOS: 对名称"*"的节点状态查询 (NBSTAT)
+static const uint8_t netbios_nbstat[] =
+    "\x50\x4b\x00\x00\x00\x01\x00\x00\x00\x00\x00\x00"
+    "\x20" "CKAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA" "\x00"
+    "\x00\x21\x00\x01";
+
+// SSDP: 单播M-SEARCH
+static const uint8_t ssdp_search[] =
+    "M-SEARCH * HTTP/1.1\r\n"
+    "HOST: 239.255.255.250:1900\r\n"
+    "MAN: \"ssdp:discover\"\r\n"
+    "MX: 1\r\n"
+    "ST: ssdp:all\r\n"
+    "\r\n";
+
+static const UdpPayload udp_payloads[] = {
+    { 53, dns_query, sizeof(dns_query) },
+    { 123, ntp_request, sizeof(ntp_request) },
+    { 137, netbios_nbstat, sizeof(netbios_nbstat) - 1 },
+    { 161, snmp_get, sizeof(snmp_get) },
+    { 1900, ssdp_search, sizeof(ssdp_search) - 1 },
+};
+
+static long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+// 标记探测已响应，返回0表示之前已经记录过或不在扫描空间内
+static int mark_answered(UdpScan *scan, struct in_addr addr, uint16_t port) {
+    int64_t index = scan_space_locate(scan->params->space, addr, port);
+    if (index < 0) {
+        return 0;
+    }
+    pthread_mutex_lock(&scan->answered_lock);
+    int added = index_set_add(&scan->answered, (uint64_t)index) == 1;
+    pthread_mutex_unlock(&scan->answered_lock);
+    return added;
+}
+
+static int is_answered(UdpScan *scan, uint64_t index) {
+    pthread_mutex_lock(&scan->answered_lock);
+    int found = index_set_contains(&scan->answered, index);
+    pthread_mutex_unlock(&scan->answered_lock);
+    return found;
+}
+
+// 所有探测都已有应答时不必再等待
+static int all_answered(UdpScan *scan) {
+    pthread_mutex_lock(&scan->answered_lock);
+    int done = scan->answered.count >= probes_dispatched(scan->params);
+    pthread_mutex_unlock(&scan->answered_lock);
+    return done;
+}
+
+// 构造端口对应的探测负载，返回长度
+// 内置负载优先，其次是nmap-service-probes中的UDP探测，都没有时发送一个空字节
+static int build_udp_probe(int port, uint8_t *payload) {
+    for (size_t i = 0; i < sizeof(udp_payloads) / sizeof(udp_payloads[0]); i++) {
+        if (udp_payloads[i].port == port) {
+            memcpy(payload, udp_payloads[i].data, udp_payloads[i].len);
+            return udp_payloads[i].len;
+        }
+    }
+
+    int len = fingerprint_probe(port, "udp", (char *)payload, UDP_PROBE_MAX);
+    if (len > 0) {
+        return len;
+    }
+
+    payload[0] = 0;
+    return 1;
+}
+
+// 按ICMP不可达的代码判断端口状态，其他错误返回-1
+static int classify_icmp_error(const struct sock_extended_err *ee) {
+    if (ee->ee_origin != SO_EE_ORIGIN_ICMP || ee->ee_type != ICMP_DEST_UNREACH) {
+        return -1;
+    }
+    switch (ee->ee_code) {
+        case ICMP_PORT_UNREACH:
+            return PORT_CLOSED;
+        case ICMP_NET_UNREACH:
+        case ICMP_HOST_UNREACH:
+        case ICMP_PROT_UNREACH:
+        case ICMP_NET_ANO:
+        case ICMP_HOST_ANO:
+        case ICMP_PKT_FILTERED:
+            return PORT_FILTERED;
+        default:
+            return -1;
+    }
+}
+
+// 读出错误队列中的ICMP不可达，msg_name为原探测的目标地址和端口
+static void drain_error_queue(UdpScan *scan) {
+    uint8_t data[UDP_PROBE_MAX];
+    char control[256];
+
+    while (1) {
+        struct sockaddr_in dst;
+        struct iovec iov = { .iov_base = data, .iov_len = sizeof(data) };
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = &dst;
+        msg.msg_namelen = sizeof(dst);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (recvmsg(scan->sock, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            break;
+        }
+
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level != SOL_IP || cmsg->cmsg_type != IP_RECVERR) {
+                continue;
+            }
+            int state = classify_icmp_error((const struct sock_extended_err *)CMSG_DATA(cmsg));
+            uint16_t port = ntohs(dst.sin_port);
+            if (state >= 0 && mark_answered(scan, dst.sin_addr, port)) {
+                record_port_state(scan->params, dst.sin_addr, port, "udp", (PortState)state, -1, NULL);
+            }
+        }
+    }
+}
+
+// 记录收到应答的端口，开启横幅抓取时保存应答内容并识别服务
+static void record_udp_reply(UdpScan *scan, struct in_addr addr, uint16_t port,
+                             uint8_t *data, int len) {
+    ThreadParams *params = scan->params;
+
+    if (!params->banner_grab || len <= 0) {
+        record_port_state(params, addr, port, "udp", PORT_OPEN, -1, NULL);
+        return;
+    }
+
+    // 整理横幅会改写原始数据，先做识别
+    ServiceMatch match;
+    int matched = fingerprint_match((const char *)data, len, "udp", &match);
+    char *banner = sanitize_banner((char *)data, len);
+    record_scan_result_banner(params, addr, port, "udp", 1, -1, banner, matched ? &match : NULL);
+    free(banner);
+}
+
+// 接收线程: 收到目标端口的应答说明端口开放，ICMP不可达说明关闭或被过滤
+static void* udp_recv_thread_func(void *arg) {
+    UdpScan *scan = (UdpScan *)arg;
+    ThreadParams *params = scan->params;
+    long drain_deadline = 0;
+
+    static __thread uint8_t buffers[UDP_RECV_BATCH][UDP_PROBE_MAX];
+    struct mmsghdr msgs[UDP_RECV_BATCH];
+    struct iovec iovs[UDP_RECV_BATCH];
+    struct sockaddr_in addrs[UDP_RECV_BATCH];
+
+    // 错误队列非空时poll返回POLLERR
+    struct pollfd pfd = { .fd = scan->sock, .events = POLLIN };
+
+    while (1) {
+        int pending_errors = 0;
+        if (scan->tx_done) {
+            long now = monotonic_ms();
+            if (drain_deadline == 0) {
+                drain_deadline = now + params->timeout_ms;
+            } else if (now >= drain_deadline || all_answered(scan)) {
+                break;
+            }
+        }
+
+        if (poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+
+        // 先清空错误队列，否则挂起的套接字错误会让recvmmsg失败
+        if (pfd.revents & POLLERR) {
+            drain_error_queue(scan);
+        }
+
+        while (1) {
+            memset(msgs, 0, sizeof(msgs));
+            for (int i = 0; i < UDP_RECV_BATCH; i++) {
+                iovs[i].iov_base = buffers[i];
+                iovs[i].iov_len = sizeof(buffers[i]);
+                msgs[i].msg_hdr.msg_iov = &iovs[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+                msgs[i].msg_hdr.msg_name = &addrs[i];
+                msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+            }
+
+            int n = recvmmsg(scan->sock, msgs, UDP_RECV_BATCH, MSG_DONTWAIT, NULL);
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+                pending_errors++ < UDP_RECV_BATCH) {
+                // 返回的是挂起的ICMP错误，读取后已清除，继续收数据
+                drain_error_queue(scan);
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+
+            for (int i = 0; i < n; i++) {
+                uint16_t port = ntohs(addrs[i].sin_port);
+                if (mark_answered(scan, addrs[i].sin_addr, port)) {
+                    record_udp_reply(scan, addrs[i].sin_addr, port, buffers[i], (int)msgs[i].msg_len);
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static void send_probe(TxBatch *tx, struct sockaddr_in *dst, struct in_addr addr, int port) {
+    uint8_t *payload = tx_batch_slot(tx);
+    int len = build_udp_probe(port, payload);
+    dst->sin_addr = addr;
+    dst->sin_port = htons(port);
+    tx_batch_commit(tx, len, dst);
+}
+
+// 批量发送阶段报告的发送失败
+static void probe_send_failed(void *user, const struct sockaddr_in *dst) {
+    UdpScan *scan = (UdpScan *)user;
+    if (scan->retransmitting) {
+        return;
+    }
+    int64_t index = scan_space_locate(scan->params->space, dst->sin_addr, ntohs(dst->sin_port));
+    if (index >= 0) {
+        index_set_add(&scan->unsent, (uint64_t)index);
+    }
+}
+
+// 首次发送失败的探测单独发出并立即确认，重传成功的记入resent
+static void resend_unsent(UdpScan *scan, TxBatch *tx, struct sockaddr_in *dst,
+                          struct in_addr addr, int port, uint64_t index) {
+    tx_batch_flush(tx);
+    unsigned long failed = tx_batch_failed(tx);
+    send_probe(tx, dst, addr, port);
+    tx_batch_flush(tx);
+    if (tx_batch_failed(tx) == failed) {
+        index_set_add(&scan->resent, index);
+    }
+}
+
+// 从未发出的探测: unsent中重传也没有成功的
+static void collect_unsent(UdpScan *scan, IndexSet *out) {
+    memset(out, 0, sizeof(*out));
+    for (size_t i = 0; i < scan->unsent.capacity; i++) {
+        uint64_t key = scan->unsent.slots[i];
+        if (key && !index_set_contains(&scan->resent, key - 1)) {
+            index_set_add(out, key - 1);
+        }
+    }
+}
+
+// 等待一个超时后重发仍未应答的探测，UDP丢包和ICMP限速都会造成漏报
+static void retransmit_unanswered(UdpScan *scan, TxBatch *tx, struct sockaddr_in *dst) {
+    ThreadParams *params = scan->params;
+    const ScanSpace *space = params->space;
+
+    // 中断后不再重传，剩余的探测按无应答处理
+    for (int round = 0; round < params->retries; round++) {
+        tx_batch_flush(tx);
+        long deadline = monotonic_ms() + params->timeout_ms;
+        while (monotonic_ms() < deadline && !all_answered(scan)) {
+            usleep(10000);
+        }
+
+        if (all_answered(scan) || scan_interrupted) {
+            break;
+        }
+        uint64_t dispatched = probes_dispatched(params);
+        for (uint64_t n = 0; n < dispatched; n++) {
+            uint64_t index = probe_index(params, n);
+            if (is_answered(scan, index)) {
+                continue;
+            }
+            struct in_addr addr;
+            int port;
+            scan_space_decode(space, index, &addr, &port);
+            if (index_set_contains(&scan->unsent, index) &&
+                !index_set_contains(&scan->resent, index)) {
+                resend_unsent(scan, tx, dst, addr, port, index);
+            } else {
+                send_probe(tx, dst, addr, port);
+            }
+        }
+    }
+}
+
+// UDP扫描线程函数（同时作为发送线程）
+void* udp_scan_thread_func(void *arg) {
+    ThreadParams *params = (ThreadParams *)arg;
+
+    UdpScan *scan = calloc(1, sizeof(UdpScan));
+    if (!scan) {
+        scan_running = 0;
+        return NULL;
+    }
+    scan->params = params;
+    pthread_mutex_init(&scan->answered_lock, NULL);
+
+    scan->sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (scan->sock < 0) {
+        perror("创建UDP套接字失败");
+        pthread_mutex_destroy(&scan->answered_lock);
+        free(scan);
+        scan_running = 0;
+        return NULL;
+    }
+
+    int bufsize = UDP_SOCKBUF;
+    int on = 1;
+    setsockopt(scan->sock, SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize));
+    setsockopt(scan->sock, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+    setsockopt(scan->sock, SOL_IP, IP_RECVERR, &on, sizeof(on));
+
+    pthread_t recv_thread;
+    if (pthread_create(&recv_thread, NULL, udp_recv_thread_func, scan) != 0) {
+        close(scan->sock);
+        pthread_mutex_destroy(&scan->answered_lock);
+        free(scan);
+        scan_running = 0;
+        return NULL;
+    }
+
+    struct sockaddr_in dst;
+    memset(&dst, 0, sizeof(dst));
+    dst.sin_family = AF_INET;
+
+    TxBatch *tx = tx_batch_create(scan->sock, params->batch_size, UDP_PROBE_MAX,
+                                  params->batch_delay_us, params->pacer);
+    if (tx) {
+        tx_batch_on_failure(tx, probe_send_failed, scan);
+    }
+    while (tx) {
+        struct in_addr addr;
+        int port;
+        if (next_probe(params, &addr, &port) < 0) {
+            break;
+        }
+        send_probe(tx, &dst, addr, port);
+    }
+
+    if (tx) {
+        tx_batch_flush(tx);
+        scan->retransmitting = 1;
+        retransmit_unanswered(scan, tx, &dst);
+        tx_batch_flush(tx);
+        tx_batch_destroy(tx);
+    } else {
+        scan_running = 0;
+    }
+
+    scan->tx_done = 1;
+    pthread_join(recv_thread, NULL);
+
+    // 没有应答的探测可能开放，也可能被过滤；没有发出的探测不记录状态
+    IndexSet never_sent;
+    collect_unsent(scan, &never_sent);
+    if (never_sent.count > 0) {
+        printf("警告: %zu 个UDP探测未能发出，未记录其状态\n", never_sent.count);
+    }
+    record_silent_probes(params, &scan->answered, &never_sent, "udp", PORT_OPEN_FILTERED);
+    index_set_free(&never_sent);
+    index_set_free(&scan->unsent);
+    index_set_free(&scan->resent);
+
+    close(scan->sock);
+    index_set_free(&scan->answered);
+    pthread_mutex_destroy(&scan->answered_lock);
+    free(scan);
+    return NULL;
+}
@@ -0,0 +1,563 @@
+/**
+ * io_uring连接扫描引擎
+ * 批量提交connect/send/recv，用链接超时(LINK_TIMEOUT)代替SO_RCVTIMEO，
+ * 直接使用系统调用，不依赖liburing
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <linux/io_uring.h>
+#include "port_scanner.h"
+
+#define URING_MAX_WINDOW 16384     // 单个线程的并发上限，保证CQ容量足够
+#define URING_MAX_SQ 4096
+
+// user_data低8位为操作类型，其余为槽位下标
+#define OP_CONNECT 1
+#define OP_SEND 2
+#define OP_RECV 3
+#define OP_TIMEOUT 4
+
+// 槽位状态
+#define SLOT_FREE 0
+#define SLOT_CONNECT 1
+#define SLOT_BANNER 2
+#define SLOT_DONE 3
+
+// 内核共享的提交/完成队列
+typedef struct {
+    int fd;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_entries;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_ptr;
+    void *cq_ptr;
+    size_t sq_size;
+    size_t cq_size;
+    size_t sqes_size;
+    unsigned sq_local_tail;    // 已准备的SQE
+    unsigned sq_submitted;     // 已提交给内核的SQE
+} Uring;
+
+// 一个探测的状态
+typedef struct {
+    int fd;
+    Probe probe;
+    int state;
+    int pending;               // 尚未返回的CQE数量
+    long start_us;
+    long response_time;
+    struct sockaddr_in addr;
+    struct __kernel_timespec ts;
+    char *buf;                 // 横幅缓冲区，按需分配
+    int len;
+} UringSlot;
+
+static int uring_setup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static long monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000L + ts.tv_nsec / 1000L;
+}
+
+static void uring_exit(Uring *ring) {
+    if (ring->sqes && ring->sqes != MAP_FAILED) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ptr && ring->cq_ptr != MAP_FAILED && ring->cq_ptr != ring->sq_ptr) {
+        munmap(ring->cq_ptr, ring->cq_size);
+    }
+    if (ring->sq_ptr && ring->sq_ptr != MAP_FAILED) {
+        munmap(ring->sq_ptr, ring->sq_size);
+    }
+    if (ring->fd >= 0) {
+        close(ring->fd);
+    }
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+// 创建并映射队列，失败返回-1
+static int uring_init(Uring *ring, unsigned sq_entries, unsigned cq_entries) {
+    struct io_uring_params p;
+
+    memset(ring, 0, sizeof(*ring));
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = cq_entries;
+
+    ring->fd = uring_setup(sq_entries, &p);
+    if (ring->fd < 0) {
+        ring->fd = -1;
+        return -1;
+    }
+
+    ring->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    int single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        if (ring->cq_size > ring->sq_size) ring->sq_size = ring->cq_size;
+        ring->cq_size = ring->sq_size;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+        uring_exit(ring);
+        return -1;
+    }
+
+    if (single_mmap) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) {
+            uring_exit(ring);
+            return -1;
+        }
+    }
+
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        uring_exit(ring);
+        return -1;
+    }
+
+    char *sq = ring->sq_ptr;
+    char *cq = ring->cq_ptr;
+    ring->sq_head = (unsigned *)(sq + p.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    ring->sq_entries = (unsigned *)(sq + p.sq_off.ring_entries);
+    ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+    ring->cq_head = (unsigned *)(cq + p.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    ring->sq_local_tail = *ring->sq_tail;
+    ring->sq_submitted = ring->sq_local_tail;
+
+    return 0;
+}
+
+// 提交队列剩余空间
+static unsigned uring_sq_space(Uring *ring) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    return *ring->sq_entries - (ring->sq_local_tail - head);
+}
+
+static struct io_uring_sqe *uring_get_sqe(Uring *ring) {
+    if (uring_sq_space(ring) == 0) {
+        return NULL;
+    }
+
+    unsigned index = ring->sq_local_tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    ring->sq_array[index] = index;
+    ring->sq_local_tail++;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+// 提交已准备的SQE，wait_nr > 0时等待完成事件
+static int uring_submit(Uring *ring, unsigned wait_nr) {
+    unsigned to_submit = ring->sq_local_tail - ring->sq_submitted;
+    if (to_submit == 0 && wait_nr == 0) {
+        return 0;
+    }
+
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+
+    int ret;
+    do {
+        ret = uring_enter(ring->fd, to_submit, wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0);
+    } while (ret < 0 && errno == EINTR && to_submit == 0);
+
+    if (ret > 0) {
+        ring->sq_submitted += ret;
+    }
+    return ret;
+}
+
+// 提交已准备的SQE并等待一个完成事件，最多等待timeout_ns纳秒
+// 内核不支持带超时的等待时只提交，由调用者自行睡眠，返回-1且errno为EINVAL
+static int uring_submit_timeout(Uring *ring, long timeout_ns) {
+    unsigned to_submit = ring->sq_local_tail - ring->sq_submitted;
+    struct __kernel_timespec ts = { timeout_ns / 1000000000L, timeout_ns % 1000000000L };
+    struct io_uring_getevents_arg arg;
+
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = (uint64_t)(uintptr_t)&ts;
+
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+
+    int ret = (int)syscall(__NR_io_uring_enter, ring->fd, to_submit, 1,
+                           IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    if (ret > 0) {
+        ring->sq_submitted += ret;
+    } else if (ret < 0 && errno == EINVAL) {
+        uring_submit(ring, 0);
+        errno = EINVAL;
+    }
+    return ret;
+}
+
+// 检查内核是否支持所需的操作
+static int uring_ops_supported(int fd) {
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, size);
+    if (!probe) {
+        return 0;
+    }
+
+    int ok = 0;
+    if (uring_register(fd, IORING_REGISTER_PROBE, probe, 256) == 0) {
+        int ops[] = {IORING_OP_CONNECT, IORING_OP_SEND, IORING_OP_RECV, IORING_OP_LINK_TIMEOUT};
+        ok = 1;
+        for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+            if (ops[i] > probe->last_op ||
+                !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED)) {
+                ok = 0;
+            }
+        }
+    }
+
+    free(probe);
+    return ok;
+}
+
+// 检测当前内核能否使用io_uring引擎
+int uring_engine_available(void) {
+    static int available = -1;
+    if (available >= 0) {
+        return available;
+    }
+
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = uring_setup(8, &p);
+    if (fd < 0) {
+        available = 0;
+        return available;
+    }
+
+    available = uring_ops_supported(fd);
+    close(fd);
+    return available;
+}
+
+// 准备一个带链接超时的操作
+static void prep_linked(Uring *ring, UringSlot *slot, uint32_t slot_index,
+                        struct io_uring_sqe *sqe, int op, int timeout_ms) {
+    sqe->flags |= IOSQE_IO_LINK;
+    sqe->user_data = ((uint64_t)slot_index << 8) | op;
+    slot->pending++;
+
+    slot->ts.tv_sec = timeout_ms / 1000;
+    slot->ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000LL;
+
+    struct io_uring_sqe *tsqe = uring_get_sqe(ring);
+    tsqe->opcode = IORING_OP_LINK_TIMEOUT;
+    tsqe->fd = -1;
+    tsqe->addr = (uint64_t)(uintptr_t)&slot->ts;
+    tsqe->len = 1;
+    tsqe->user_data = ((uint64_t)slot_index << 8) | OP_TIMEOUT;
+    slot->pending++;
+}
+
+// 确保提交队列至少有need个空位
+static void ensure_sq_space(Uring *ring, unsigned need) {
+    while (uring_sq_space(ring) < need) {
+        if (uring_submit(ring, 0) < 0 && errno != EAGAIN && errno != EBUSY) {
+            break;
+        }
+    }
+}
+
+// 发起连接，返回-1表示资源不足
+static int start_probe(Uring *ring, UringSlot *slot, uint32_t slot_index,
+                       const Probe *probe, int timeout_ms) {
+    int sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        return -1;
+    }
+
+    slot->fd = sock;
+    slot->probe = *probe;
+    slot->state = SLOT_CONNECT;
+    slot->pending = 0;
+    slot->len = 0;
+    slot->response_time = -1;
+    slot->start_us = monotonic_us();
+
+    memset(&slot->addr, 0, sizeof(slot->addr));
+    slot->addr.sin_family = AF_INET;
+    slot->addr.sin_port = htons(probe->port);
+    slot->addr.sin_addr = probe->addr;
+
+    ensure_sq_space(ring, 2);
+    struct io_uring_sqe *sqe = uring_get_sqe(ring);
+    sqe->opcode = IORING_OP_CONNECT;
+    sqe->fd = sock;
+    sqe->addr = (uint64_t)(uintptr_t)&slot->addr;
+    sqe->off = sizeof(slot->addr);
+    prep_linked(ring, slot, slot_index, sqe, OP_CONNECT, timeout_ms);
+    return 0;
+}
+
+// 发送探针（如果有）并接收横幅
+static void queue_banner_read(Uring *ring, ThreadParams *params, UringSlot *slot,
+                              uint32_t slot_index, int send_probe) {
+    // 探针放在横幅缓冲区之后，保证请求完成前一直有效
+    char *probe = slot->buf + MAX_BANNER_SIZE;
+    int probe_len = send_probe ? get_banner_probe(slot->probe.port, probe) : 0;
+
+    ensure_sq_space(ring, probe_len > 0 ? 3 : 2);
+
+    if (probe_len > 0) {
+        struct io_uring_sqe *sqe = uring_get_sqe(ring);
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = slot->fd;
+        sqe->addr = (uint64_t)(uintptr_t)probe;
+        sqe->len = probe_len;
+        sqe->flags = IOSQE_IO_LINK;
+        sqe->user_data = ((uint64_t)slot_index << 8) | OP_SEND;
+        slot->pending++;
+    }
+
+    struct io_uring_sqe *sqe = uring_get_sqe(ring);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = slot->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(slot->buf + slot->len);
+    sqe->len = MAX_BANNER_SIZE - 1 - slot->len;
+    prep_linked(ring, slot, slot_index, sqe, OP_RECV, params->timeout_ms);
+}
+
+// 关闭连接，槽位在所有CQE返回后释放
+static void release_slot(UringSlot *slot) {
+    close_with_reset(slot->fd);
+    slot->fd = -1;
+    slot->state = SLOT_DONE;
+}
+
+// 结束一个探测
+static void finish_probe(ThreadParams *params, UringSlot *slot, int result) {
+    if (result > 0 && params->banner_grab) {
+        ServiceMatch match;
+        int matched = fingerprint_match(slot->buf, slot->len, "tcp", &match);
+        char *banner = sanitize_banner(slot->buf, slot->len);
+        record_scan_result_banner(params, slot->probe.addr, slot->probe.port, "tcp",
+                                  result, slot->response_time, banner, matched ? &match : NULL);
+        free(banner);
+    } else {
+        record_scan_result_banner(params, slot->probe.addr, slot->probe.port, "tcp",
+                                  result, slot->response_time, NULL, NULL);
+    }
+
+    release_slot(slot);
+}
+
+// 处理一个完成事件
+static void handle_cqe(Uring *ring, ThreadParams *params, ProbeScheduler *sched,
+                       UringSlot *slots, struct io_uring_cqe *cqe) {
+    uint32_t slot_index = (uint32_t)(cqe->user_data >> 8);
+    int op = (int)(cqe->user_data & 0xff);
+    UringSlot *slot = &slots[slot_index];
+    int res = cqe->res;
+
+    slot->pending--;
+
+    if (op == OP_CONNECT && slot->state == SLOT_CONNECT) {
+        if (res == 0 || res == -ECONNREFUSED) {
+            // 连接成功和被拒绝都是一次完整的往返
+            probe_answered(params, &slot->probe, monotonic_us() - slot->start_us);
+        }
+
+        if (res == 0) {
+            slot->response_time = (monotonic_us() - slot->start_us) / 1000;
+            if (params->banner_grab) {
+                if (!slot->buf) {
+                    slot->buf = malloc(MAX_BANNER_SIZE + 256);
+                }
+                if (slot->buf) {
+                    slot->state = SLOT_BANNER;
+                    queue_banner_read(ring, params, slot, slot_index, 1);
+                    return;
+                }
+            }
+            finish_probe(params, slot, 1);
+        } else if (res == -ECONNREFUSED) {
+            finish_probe(params, slot, 0);
+        } else if (res == -ECANCELED) {
+            // 链接超时触发，还有重传次数时不记录结果
+            if (probe_timed_out(params, sched, &slot->probe)) {
+                release_slot(slot);
+            } else {
+                finish_probe(params, slot, -1);
+            }
+        } else {
+            // 不可达等错误
+            probe_unreachable(params, &slot->probe);
+            finish_probe(params, slot, -1);
+        }
+    } else if (op == OP_RECV && slot->state == SLOT_BANNER) {
+        if (res > 0) {
+            slot->len += res;
+            if (slot->len < MAX_BANNER_SIZE - 1) {
+                queue_banner_read(ring, params, slot, slot_index, 0);
+                return;
+            }
+        }
+        finish_probe(params, slot, 1);
+    }
+}
+
+// io_uring连接扫描线程函数
+void* uring_connect_thread_func(void *arg) {
+    ThreadParams *params = (ThreadParams *)arg;
+    int window = params->window > 0 ? params->window : 1;
+    if (window > URING_MAX_WINDOW) window = URING_MAX_WINDOW;
+
+    unsigned sq_entries = 1;
+    while (sq_entries < (unsigned)window * 2 && sq_entries < URING_MAX_SQ) sq_entries <<= 1;
+    unsigned cq_entries = 1;
+    while (cq_entries < (unsigned)window * 4) cq_entries <<= 1;
+
+    Uring ring;
+    if (uring_init(&ring, sq_entries, cq_entries) < 0) {
+        // 运行时创建失败（如内存锁定限制），退回epoll引擎
+        fprintf(stderr, "警告: 线程 %d 无法创建io_uring (%s)，改用epoll\n",
+                params->thread_id, strerror(errno));
+        return epoll_connect_thread_func(arg);
+    }
+
+    UringSlot *slots = calloc(window, sizeof(UringSlot));
+    uint32_t *free_list = malloc(sizeof(uint32_t) * window);
+    ProbeScheduler sched;
+    if (!slots || !free_list || probe_scheduler_init(&sched, window) < 0) {
+        free(slots);
+        free(free_list);
+        uring_exit(&ring);
+        return NULL;
+    }
+
+    for (int i = 0; i < window; i++) {
+        slots[i].fd = -1;
+        free_list[i] = window - 1 - i;
+    }
+    int free_count = window;
+    int probes_exhausted = 0;
+
+    while (1) {
+        // 在主机拥塞窗口允许的范围内填满并发窗口
+        probes_exhausted = 0;
+        while (free_count > 0) {
+            Probe probe;
+            int timeout_ms;
+            int got = probe_scheduler_next(params, &sched, &probe, &timeout_ms);
+            if (got <= 0) {
+                probes_exhausted = (got < 0);
+                break;
+            }
+
+            uint32_t slot_index = free_list[free_count - 1];
+            if (start_probe(&ring, &slots[slot_index], slot_index, &probe, timeout_ms) < 0) {
+                probe_scheduler_defer(params, &sched, &probe);
+                break;
+            }
+            free_count--;
+        }
+
+        if (free_count == window) {
+            if (probes_exhausted) {
+                break;
+            }
+            if (sched.pace_wait_ns > 0) {
+                pacer_sleep(sched.pace_wait_ns);
+            } else {
+                usleep(1000);
+            }
+            continue;
+        }
+
+        // 批量提交并至少等待一个完成事件；受速率限制时最多等到下一个令牌
+        int ret;
+        if (sched.pace_wait_ns > 0) {
+            ret = uring_submit_timeout(&ring, sched.pace_wait_ns);
+            if (ret < 0 && errno == EINVAL) {
+                pacer_sleep(sched.pace_wait_ns);
+                ret = 0;
+            }
+        } else {
+            ret = uring_submit(&ring, 1);
+        }
+        if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY && errno != ETIME) {
+            perror("io_uring_enter失败");
+            break;
+        }
+
+        // 收割完成队列
+        unsigned head = *ring.cq_head;
+        unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cq_mask];
+            handle_cqe(&ring, params, &sched, slots, cqe);
+
+            uint32_t slot_index = (uint32_t)(cqe->user_data >> 8);
+            UringSlot *slot = &slots[slot_index];
+            if (slot->state == SLOT_DONE && slot->pending == 0) {
+                slot->state = SLOT_FREE;
+                free_list[free_count++] = slot_index;
+            }
+
+            head++;
+            if (head == tail) {
+                __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+                tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+            }
+        }
+        __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    for (int i = 0; i < window; i++) {
+        if (slots[i].fd >= 0) {
+            close(slots[i].fd);
+        }
+        free(slots[i].buf);
+    }
+
+    probe_scheduler_free(&sched);
+    free(slots);
+    free(free_list);
+    uring_exit(&ring);
+    return NULL;
+}